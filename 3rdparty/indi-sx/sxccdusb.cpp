@@ -44,6 +44,7 @@
 
 #include "sxconfig.h"
 #include "sxccdusb.h"
+#include "indiusbdevice.h"
 
 /*
  * Control request fields.
@@ -114,7 +115,8 @@
 #define BULK_COMMAND_TIMEOUT        2000
 #define BULK_DATA_TIMEOUT           10000
 
-#define CHUNK_SIZE                  (10*1024*1024)
+#define CHUNK_SIZE                  (256*1024)
+#define CHUNK_DEPTH                 4
 
 #if 1
 #define TRACE(c) (c)
@@ -636,17 +638,14 @@ int sxExposePixelsGated(HANDLE sxHandle, unsigned short flags, unsigned short ca
 }
 
 int sxReadPixels(HANDLE sxHandle, void *pixels, unsigned long count) {
-  int transferred;
   unsigned long read=0;
   int rc=0;
+  // Keep several chunks in flight so the bus is not idle between them, going on after a short one as before
   while (read < count && rc >= 0) {
-    int size = count - read;
-    if (size > CHUNK_SIZE)
-      size = CHUNK_SIZE;
-    rc = libusb_bulk_transfer(sxHandle, BULK_IN, (unsigned char *)pixels + read, size, &transferred, BULK_DATA_TIMEOUT);
-    DEBUG(log(true, "sxReadPixels: libusb_control_transfer -> %s\n", rc < 0 ? libusb_error_name(rc) : "OK"));
-    if (transferred >= 0) {
-      read+=transferred;
+    rc = INDI::USBDevice::ReadBulkAsync(ctx, sxHandle, BULK_IN, (unsigned char *)pixels + read, count - read, CHUNK_SIZE, CHUNK_DEPTH, BULK_DATA_TIMEOUT, NULL, NULL, NULL);
+    DEBUG(log(true, "sxReadPixels: ReadBulkAsync -> %s\n", rc < 0 ? libusb_error_name(rc) : "OK"));
+    if (rc >= 0) {
+      read+=rc;
     }
   }
   return rc >= 0;
@@ -27,6 +27,11 @@
 /* Pair of functions to convert to/from base64.
  * Also can be used to build a standalone utility and a loopback test.
  * see http://www.faqs.org/rfcs/rfc3548.html
+ *
+ * The bulk of each conversion runs through the fastest kernel this CPU has,
+ * picked on first use: AVX2 or SSSE3 on x86, NEON on 64 bit ARM, else the
+ * table lookups of base64_luts.h. All give bit-identical results, the
+ * INDI_BASE64 environment variable or base64SetKernel() can force one.
  */
 
 /** \file base64.c
@@ -36,31 +41,107 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "base64.h"
 #include "base64_luts.h"
 #include <stdio.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define	B64_X86
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define	B64_NEON
+#include <arm_neon.h>
+#endif
+
+/* a kernel converts as much of the front of in as it can in large blocks.
+ * enc returns input bytes used, a multiple of 3, having written 4/3 as many
+ *   chars to out.
+ * dec returns input chars used, a multiple of 4, having written 3/4 as many
+ *   bytes to out. it stops at the first block with anything but base64
+ *   digits, so never uses newlines or padding. it may store a few bytes
+ *   beyond those it reports but never beyond 3/4 of the chars it was given.
+ */
+typedef struct {
+    const char *name;
+    int (*enc)(unsigned char *out, const unsigned char *in, int inlen);
+    int (*dec)(char *out, const char *in, int inlen);
+    int (*usable)(void);
+} B64Kernel;
+
+static int encLUT (unsigned char *out, const unsigned char *in, int inlen);
+static int decLUT (char *out, const char *in, int inlen);
+static void decGroup (char *out, const char *in);
+static const B64Kernel *pickKernel (void);
+
+#if defined(B64_X86)
+static int encSSSE3 (unsigned char *out, const unsigned char *in, int inlen);
+static int decSSSE3 (char *out, const char *in, int inlen);
+static int encAVX2 (unsigned char *out, const unsigned char *in, int inlen);
+static int decAVX2 (char *out, const char *in, int inlen);
+static int haveSSSE3 (void) { return (__builtin_cpu_supports ("ssse3")); }
+static int haveAVX2 (void) { return (__builtin_cpu_supports ("avx2")); }
+#endif
+#if defined(B64_NEON)
+static int encNEON (unsigned char *out, const unsigned char *in, int inlen);
+static int decNEON (char *out, const char *in, int inlen);
+static int haveNEON (void) { return (1); }
+#endif
+
+/* all kernels built in, best first, the LUT one last as it always works */
+static const B64Kernel kernels[] = {
+#if defined(B64_X86)
+    {"avx2",  encAVX2,  decAVX2,  haveAVX2},
+    {"ssse3", encSSSE3, decSSSE3, haveSSSE3},
+#endif
+#if defined(B64_NEON)
+    {"neon",  encNEON,  decNEON,  haveNEON},
+#endif
+    {"lut",   encLUT,   decLUT,   NULL},
+};
+#define	NKERNELS	((int)(sizeof(kernels)/sizeof(kernels[0])))
+
+/* kernel in use. set once, racing threads all pick the same one */
+static const B64Kernel *kernel;
+
+/* value of each base64 digit, -2 for whitespace, -1 for anything else */
+static const signed char digitTab[256] = {
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -2, -2, -2, -2, -2, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+	 -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	 -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
 /* convert inlen raw bytes at in to base64 string (NUL-terminated) at out. 
  * out size should be at least 4*inlen/3 + 4.
  * return length of out (sans trailing NUL).
  */
 int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
 {
-	uint16_t* b64lut = (uint16_t*)base64lut;
 	int dlen = ((inlen+2)/3)*4; /* 4/3, rounded up */
-	uint16_t* wbuf = (uint16_t*)out;
-
-	for(; inlen > 2; inlen -= 3 ) {
-		uint32_t n = in[0] << 16 | in[1] << 8 | in[2];
+	int n;
 
-		wbuf[0] = b64lut[ n >> 12 ];
-		wbuf[1] = b64lut[ n & 0x00000fff ];
+	/* whole groups */
+	n = pickKernel()->enc(out, in, inlen);
+	n += encLUT(out + 4*n/3, in + n, inlen - n);
+	out += 4*n/3;
+	in += n;
+	inlen -= n;
 
-		wbuf += 2;
-		in += 3;
-	}
-
-	out = (unsigned char*)wbuf;
 	if ( inlen > 0 ) {
 		unsigned char fragment;
 		*out++ = base64digits[in[0] >> 2];
@@ -87,62 +168,577 @@ int from64tobits(char* out, const char* in)
 }
 
 
+/* convert inlen chars of base64 at in to raw bytes at out, return count.
+ * each group of 4 chars may be preceded by one newline, as IDSetBLOB()
+ * writes them. chars are not checked, nor is a partial last group used.
+ * out should be at least 3/4 inlen.
+ */
 int from64tobits_fast(char* out, const char* in, int inlen)
 {
-	int outlen = 0;
-	uint8_t b1, b2, b3;
-	uint16_t s1, s2;
-	uint32_t n32;
-	int j;
-	int n = (inlen/4)-1;
-	uint16_t* inp = (uint16_t*)in;
+	const B64Kernel *kp = pickKernel();
+	const char *end = in + inlen;
+	char *out0 = out;
+	int n;
+
+	while (1) {
+		int nafter;
+
+		/* as many blocks as the kernel takes, then groups by LUT up to
+		 * the next newline or the last group
+		 */
+		n = kp->dec(out, in, end - in);
+		in += n;
+		out += 3*n/4;
+		while (end - in >= 12 && in[0] != '\n') {
+			decGroup(out, in);
+			in += 4;
+			out += 3;
+		}
+		if (in < end && in[0] == '\n') in++;
+		if (end - in < 4)
+			break;
+
+		/* last group may have padding */
+		nafter = end - in - 4;
+		if (nafter > 0 && in[4] == '\n') nafter--;
+		if (nafter < 4) {
+			char b[3];
+
+			decGroup(b, in);
+			*out++ = b[0];
+			if (in[2] != '=')  {
+				*out++ = b[1];
+				if (in[3] != '=')
+					*out++ = b[2];
+			}
+			break;
+		}
+		decGroup(out, in);
+		in += 4;
+		out += 3;
+	}
+
+	return out - out0;
+}
+
+/* start encoding a stream of bytes, breaking lines every linelen chars if
+ * linelen > 0. linelen should be a multiple of 4.
+ */
+void to64init(base64_stream *sp, int linelen)
+{
+	memset (sp, 0, sizeof(*sp));
+	sp->linelen = linelen > 0 ? linelen - linelen%4 : 0;
+}
+
+/* encode the next inlen bytes at in of a stream to out, return chars
+ * written. out should be at least 4*inlen/3 + 4 plus one per line.
+ * nothing is NUL terminated.
+ */
+int to64update(base64_stream *sp, unsigned char *out, const unsigned char *in, int inlen)
+{
+	const B64Kernel *kp = pickKernel();
+	unsigned char *out0 = out;
+
+	/* finish a group started last time */
+	while (sp->ncarry > 0 && sp->ncarry < 3 && inlen > 0) {
+		sp->carry[sp->ncarry++] = *in++;
+		inlen--;
+	}
+	if (sp->ncarry == 3) {
+		sp->ncarry = 0;
+		encLUT(out, (unsigned char *)sp->carry, 3);
+		out += 4;
+		if ((sp->col += 4) == sp->linelen) {
+			*out++ = '\n';
+			sp->col = 0;
+		}
+	}
 
-	for( j = 0; j < n; j++ ) {
-		if (in[0] == '\n') in++;
-		inp = (uint16_t*)in;
+	/* whole groups, up to the end of each line */
+	while (inlen >= 3) {
+		int n = inlen - inlen%3, nk;
+
+		if (sp->linelen > 0 && n > 3*(sp->linelen - sp->col)/4)
+			n = 3*(sp->linelen - sp->col)/4;
+		nk = kp->enc(out, in, n);
+		nk += encLUT(out + 4*nk/3, in + nk, n - nk);
+		out += 4*nk/3;
+		in += nk;
+		inlen -= nk;
+		if (sp->linelen > 0 && (sp->col += 4*nk/3) == sp->linelen) {
+			*out++ = '\n';
+			sp->col = 0;
+		}
+	}
 
-		s1 = rbase64lut[ inp[0] ];
-		s2 = rbase64lut[ inp[1] ];
+	/* save the rest for next time */
+	while (inlen-- > 0)
+		sp->carry[sp->ncarry++] = *in++;
 
-		n32 = s1;
-		n32 <<= 10;
-		n32 |= s2 >> 2;
+	return out - out0;
+}
 
-		b3 = ( n32 & 0x00ff ); n32 >>= 8;
-		b2 = ( n32 & 0x00ff ); n32 >>= 8;
-		b1 = ( n32 & 0x00ff );
+/* encode what is left of a stream to out, with padding, and end its last
+ * line. return chars written, out should be at least 6.
+ */
+int to64finish(base64_stream *sp, unsigned char *out)
+{
+	int n = 0;
 
-		out[0] = b1;
-		out[1] = b2;
-		out[2] = b3;
+	if (sp->ncarry > 0) {
+		n = to64frombits(out, (unsigned char *)sp->carry, sp->ncarry);
+		sp->col += n;
+		sp->ncarry = 0;
+	}
+	if (sp->linelen > 0 && sp->col > 0) {
+		out[n++] = '\n';
+		sp->col = 0;
+	}
+	return n;
+}
 
-		in += 4;
-		out += 3;
+/* start decoding a stream of base64 chars */
+void from64init(base64_stream *sp)
+{
+	memset (sp, 0, sizeof(*sp));
+}
+
+/* decode the next inlen chars at in of a stream to out. whitespace is
+ * skipped wherever it is. return bytes written, or -1 if in has anything
+ * else that is not base64 or it continues after padding.
+ * out should be at least 3*inlen/4 + 3.
+ */
+int from64update(base64_stream *sp, char *out, const char *in, int inlen)
+{
+	const B64Kernel *kp = pickKernel();
+	const char *end = in + inlen;
+	char *out0 = out;
+	int npad;
+
+	while (in < end) {
+		int c = (unsigned char)*in;
+
+		/* bulk, when between groups */
+		if (sp->ncarry == 0 && !sp->done) {
+			int n = kp->dec(out, in, end - in);
+
+			in += n;
+			out += 3*n/4;
+			while (end - in >= 4 &&
+			        (digitTab[(unsigned char)in[0]] | digitTab[(unsigned char)in[1]] |
+			         digitTab[(unsigned char)in[2]] | digitTab[(unsigned char)in[3]]) >= 0) {
+				decGroup(out, in);
+				in += 4;
+				out += 3;
+			}
+			if (in == end)
+				break;
+			c = (unsigned char)*in;
+		}
+
+		/* then a char at a time */
+		in++;
+		if (digitTab[c] == -2)
+			continue;
+		if (sp->done || (c == '=' ? sp->ncarry < 2 : digitTab[c] < 0))
+			return (-1);
+		sp->carry[sp->ncarry++] = c;
+		if (sp->ncarry < 4)
+			continue;
+
+		/* whole group, maybe with padding */
+		sp->ncarry = 0;
+		npad = (sp->carry[2] == '=') + (sp->carry[3] == '=');
+		if (npad == 0) {
+			decGroup(out, sp->carry);
+			out += 3;
+		} else if (sp->carry[3] != '=') {
+			return (-1);
+		} else {
+			char b[3];
+
+			sp->carry[2] = npad == 2 ? 'A' : sp->carry[2];
+			sp->carry[3] = 'A';
+			decGroup(b, sp->carry);
+			*out++ = b[0];
+			if (npad == 1)
+				*out++ = b[1];
+			sp->done = 1;
+		}
 	}
-	outlen = (inlen / 4 - 1) * 3;
-	if (in[0] == '\n') in++;
-	inp = (uint16_t*)in;
 
-	s1 = rbase64lut[ inp[0] ];
-	s2 = rbase64lut[ inp[1] ];
+	return out - out0;
+}
+
+/* return 0 if a decoded stream ended on a whole group, else -1 */
+int from64finish(base64_stream *sp)
+{
+	return (sp->ncarry == 0 ? 0 : -1);
+}
+
+/* use the named kernel from now on, return 0 if it is built in and this
+ * CPU can run it, else -1 and no change.
+ */
+int base64SetKernel(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NKERNELS; i++) {
+		if (strcmp (name, kernels[i].name) == 0) {
+			if (kernels[i].usable && !kernels[i].usable())
+				return (-1);
+			kernel = &kernels[i];
+			return (0);
+		}
+	}
+	return (-1);
+}
+
+/* return the name of the kernel in use */
+const char *base64Kernel(void)
+{
+	return (pickKernel()->name);
+}
+
+/* return the kernel to use, picking it the first time */
+static const B64Kernel *
+pickKernel (void)
+{
+	const char *env;
+	int i;
+
+	if (kernel)
+		return (kernel);
+
+	if ((env = getenv ("INDI_BASE64")) != NULL && base64SetKernel (env) == 0)
+		return (kernel);
+	for (i = 0; i < NKERNELS; i++) {
+		if (!kernels[i].usable || kernels[i].usable()) {
+			kernel = &kernels[i];
+			break;
+		}
+	}
+	return (kernel);
+}
+
+/* encode whole groups of 3 bytes by table lookup, 12 bits at a time */
+static int
+encLUT (unsigned char *out, const unsigned char *in, int inlen)
+{
+	int n;
+
+	for (n = 0; inlen - n > 2; n += 3) {
+		uint32_t v = in[0] << 16 | in[1] << 8 | in[2];
+
+		memcpy (out, &base64lut[ 2*(v >> 12) ], 2);
+		memcpy (out+2, &base64lut[ 2*(v & 0x00000fff) ], 2);
+
+		out += 4;
+		in += 3;
+	}
+	return (n);
+}
+
+/* the LUT kernel has no blocks, whole groups come one by one */
+static int
+decLUT (char *out, const char *in, int inlen)
+{
+	(void)out; (void)in; (void)inlen;
+	return (0);
+}
+
+/* decode the group of 4 chars at in to 3 bytes at out by table lookup,
+ * 2 chars at a time, as the table was built for little endian loads.
+ * no checking.
+ */
+static void
+decGroup (char *out, const char *in)
+{
+	uint16_t i1, i2, s1, s2;
+	uint32_t n32;
+
+	memcpy (&i1, in, 2);
+	memcpy (&i2, in+2, 2);
+	s1 = rbase64lut[ i1 ];
+	s2 = rbase64lut[ i2 ];
 
 	n32 = s1;
 	n32 <<= 10;
 	n32 |= s2 >> 2;
 
-	b3 = ( n32 & 0x00ff ); n32 >>= 8;
-	b2 = ( n32 & 0x00ff ); n32 >>= 8;
-	b1 = ( n32 & 0x00ff );
+	out[2] = ( n32 & 0x00ff ); n32 >>= 8;
+	out[1] = ( n32 & 0x00ff ); n32 >>= 8;
+	out[0] = ( n32 & 0x00ff );
+}
 
-	*out++ = b1;  outlen++;
-	if ((inp[1] & 0x00FF) != 0x003D)  {
-		*out++ = b2;  outlen++;
-		if ((inp[1] & 0xFF00) != 0x3D00)  {
-			*out++ = b3;  outlen++;
+#if defined(B64_X86)
+/* SSSE3 and AVX2 kernels after W. Mula and D. Lemire, "Faster Base64
+ * Encoding and Decoding using AVX2 Instructions", ACM TOW 2018.
+ * each 128 bit lane turns 12 bytes into 16 chars and back.
+ */
+
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i
+encBlock128 (__m128i in)
+{
+	const __m128i lut = _mm_setr_epi8 (65, 71, -4, -4, -4, -4, -4, -4,
+	                                   -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i v, idx;
+
+	in = _mm_shuffle_epi8 (in, _mm_set_epi8 (10, 11, 9, 10, 7, 8, 6, 7,
+	                                         4, 5, 3, 4, 1, 2, 0, 1));
+	v = _mm_or_si128 (
+	        _mm_mulhi_epu16 (_mm_and_si128 (in, _mm_set1_epi32 (0x0FC0FC00)),
+	                                        _mm_set1_epi32 (0x04000040)),
+	        _mm_mullo_epi16 (_mm_and_si128 (in, _mm_set1_epi32 (0x003F03F0)),
+	                                        _mm_set1_epi32 (0x01000010)));
+
+	/* 0..25 -> 'A', 26..51 -> 'a', 52..61 -> '0', 62 -> '+', 63 -> '/' */
+	idx = _mm_subs_epu8 (v, _mm_set1_epi8 (51));
+	idx = _mm_sub_epi8 (idx, _mm_cmpgt_epi8 (v, _mm_set1_epi8 (25)));
+	return (_mm_add_epi8 (v, _mm_shuffle_epi8 (lut, idx)));
+}
+
+/* turn 16 chars into 6-bit values in *vp, return 0 if any are not base64 */
+__attribute__((target("ssse3"), always_inline))
+static inline int
+decBlock128 (__m128i in, __m128i *vp)
+{
+	const __m128i lut_lo = _mm_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11,
+	        0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04,
+	        0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8 (0, 16, 19, 4, -65, -65, -71,
+	        -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i m2f = _mm_set1_epi8 (0x2F);
+	__m128i hi = _mm_and_si128 (_mm_srli_epi32 (in, 4), m2f);
+	__m128i lo = _mm_and_si128 (in, m2f);
+	__m128i bad = _mm_and_si128 (_mm_shuffle_epi8 (lut_lo, lo),
+	                             _mm_shuffle_epi8 (lut_hi, hi));
+
+	if (_mm_movemask_epi8 (_mm_cmpgt_epi8 (bad, _mm_setzero_si128())))
+		return (0);
+	*vp = _mm_add_epi8 (in, _mm_shuffle_epi8 (lut_roll,
+	                        _mm_add_epi8 (_mm_cmpeq_epi8 (in, m2f), hi)));
+	return (1);
+}
+
+/* pack 16 6-bit values into 12 bytes at the front of the lane */
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i
+decPack128 (__m128i v)
+{
+	v = _mm_maddubs_epi16 (v, _mm_set1_epi32 (0x01400140));
+	v = _mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000));
+	return (_mm_shuffle_epi8 (v, _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8,
+	                                     14, 13, 12, -1, -1, -1, -1)));
+}
+
+/* each block reads 16 bytes to use 12.
+ * the AVX2 kernels inline these for their ends too, as calling SSE code
+ * from AVX code costs more than these few blocks.
+ */
+__attribute__((target("ssse3"), always_inline))
+static inline int
+encLoop128 (unsigned char *out, const unsigned char *in, int inlen)
+{
+	int n;
+
+	for (n = 0; inlen - n >= 16; n += 12, out += 16) {
+		__m128i x = _mm_loadu_si128 ((const __m128i *)(in+n));
+		_mm_storeu_si128 ((__m128i *)out, encBlock128 (x));
+	}
+	return (n);
+}
+
+/* each block writes 16 bytes to use 12, so stop 24 chars from the end */
+__attribute__((target("ssse3"), always_inline))
+static inline int
+decLoop128 (char *out, const char *in, int inlen)
+{
+	int n;
+
+	for (n = 0; inlen - n >= 24; n += 16, out += 12) {
+		__m128i v;
+		if (!decBlock128 (_mm_loadu_si128 ((const __m128i *)(in+n)), &v))
+			break;
+		_mm_storeu_si128 ((__m128i *)out, decPack128 (v));
+	}
+	return (n);
+}
+
+__attribute__((target("ssse3")))
+static int
+encSSSE3 (unsigned char *out, const unsigned char *in, int inlen)
+{
+	return (encLoop128 (out, in, inlen));
+}
+
+__attribute__((target("ssse3")))
+static int
+decSSSE3 (char *out, const char *in, int inlen)
+{
+	return (decLoop128 (out, in, inlen));
+}
+
+/* the same a lane at a time on 256 bits, each lane loaded separately */
+__attribute__((target("avx2")))
+static int
+encAVX2 (unsigned char *out, const unsigned char *in, int inlen)
+{
+	const __m256i lut = _mm256_setr_epi8 (65, 71, -4, -4, -4, -4, -4, -4,
+	        -4, -4, -4, -4, -19, -16, 0, 0, 65, 71, -4, -4, -4, -4, -4, -4,
+	        -4, -4, -4, -4, -19, -16, 0, 0);
+	const __m256i shuf = _mm256_set_epi8 (10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3,
+	        4, 1, 2, 0, 1, 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	int n;
+
+	for (n = 0; inlen - n >= 28; n += 24, out += 32) {
+		__m256i x = _mm256_inserti128_si256 (_mm256_castsi128_si256 (
+		        _mm_loadu_si128 ((const __m128i *)(in+n))),
+		        _mm_loadu_si128 ((const __m128i *)(in+n+12)), 1);
+		__m256i v, idx;
+
+		x = _mm256_shuffle_epi8 (x, shuf);
+		v = _mm256_or_si256 (
+		    _mm256_mulhi_epu16 (_mm256_and_si256 (x,
+		                            _mm256_set1_epi32 (0x0FC0FC00)),
+		                        _mm256_set1_epi32 (0x04000040)),
+		    _mm256_mullo_epi16 (_mm256_and_si256 (x,
+		                            _mm256_set1_epi32 (0x003F03F0)),
+		                        _mm256_set1_epi32 (0x01000010)));
+		idx = _mm256_subs_epu8 (v, _mm256_set1_epi8 (51));
+		idx = _mm256_sub_epi8 (idx,
+		                _mm256_cmpgt_epi8 (v, _mm256_set1_epi8 (25)));
+		_mm256_storeu_si256 ((__m256i *)out,
+		                _mm256_add_epi8 (v, _mm256_shuffle_epi8 (lut, idx)));
+	}
+	return (n + encLoop128 (out, in+n, inlen-n));
+}
+
+/* each block writes 32 bytes to use 24, so stop 48 chars from the end */
+__attribute__((target("avx2")))
+static int
+decAVX2 (char *out, const char *in, int inlen)
+{
+	const __m256i lut_lo = _mm256_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11,
+	        0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+	        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13,
+	        0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04,
+	        0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10,
+	        0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8 (0, 16, 19, 4, -65, -65, -71,
+	        -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4, -65, -65, -71, -71,
+	        0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i m2f = _mm256_set1_epi8 (0x2F);
+	const __m256i pack = _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+	        13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+	        -1, -1, -1, -1);
+	int n;
+
+	for (n = 0; inlen - n >= 48; n += 32, out += 24) {
+		__m256i x = _mm256_loadu_si256 ((const __m256i *)(in+n));
+		__m256i hi = _mm256_and_si256 (_mm256_srli_epi32 (x, 4), m2f);
+		__m256i lo = _mm256_and_si256 (x, m2f);
+		__m256i bad = _mm256_and_si256 (_mm256_shuffle_epi8 (lut_lo, lo),
+		                                _mm256_shuffle_epi8 (lut_hi, hi));
+
+		if (_mm256_movemask_epi8 (_mm256_cmpgt_epi8 (bad,
+		                                        _mm256_setzero_si256())))
+			break;
+		x = _mm256_add_epi8 (x, _mm256_shuffle_epi8 (lut_roll,
+		                _mm256_add_epi8 (_mm256_cmpeq_epi8 (x, m2f), hi)));
+		x = _mm256_maddubs_epi16 (x, _mm256_set1_epi32 (0x01400140));
+		x = _mm256_madd_epi16 (x, _mm256_set1_epi32 (0x00011000));
+		x = _mm256_shuffle_epi8 (x, pack);
+		x = _mm256_permutevar8x32_epi32 (x,
+		                        _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_storeu_si256 ((__m256i *)out, x);
+	}
+	return (n + decLoop128 (out, in+n, inlen-n));
+}
+#endif /* B64_X86 */
+
+#if defined(B64_NEON)
+/* NEON splits 48 bytes into 3 registers and 64 chars into 4 as it loads,
+ * so 6-bit values are just shifts and a 64 entry table lookup.
+ */
+static int
+encNEON (unsigned char *out, const unsigned char *in, int inlen)
+{
+	const uint8x16x4_t lut = vld1q_u8_x4 ((const uint8_t *)base64digits);
+	const uint8x16_t m3f = vdupq_n_u8 (0x3F);
+	int n;
+
+	for (n = 0; inlen - n >= 48; n += 48, out += 64) {
+		uint8x16x3_t b = vld3q_u8 (in+n);
+		uint8x16x4_t c;
+
+		c.val[0] = vshrq_n_u8 (b.val[0], 2);
+		c.val[1] = vandq_u8 (vorrq_u8 (vshlq_n_u8 (b.val[0], 4),
+		                               vshrq_n_u8 (b.val[1], 4)), m3f);
+		c.val[2] = vandq_u8 (vorrq_u8 (vshlq_n_u8 (b.val[1], 2),
+		                               vshrq_n_u8 (b.val[2], 6)), m3f);
+		c.val[3] = vandq_u8 (b.val[2], m3f);
+		c.val[0] = vqtbl4q_u8 (lut, c.val[0]);
+		c.val[1] = vqtbl4q_u8 (lut, c.val[1]);
+		c.val[2] = vqtbl4q_u8 (lut, c.val[2]);
+		c.val[3] = vqtbl4q_u8 (lut, c.val[3]);
+		vst4q_u8 (out, c);
+	}
+	return (n);
+}
+
+/* chars 0..127 to 6-bit values, 0xFF if not base64, in two tables of 64 */
+static const uint8_t neonDec[128] = {
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255, 62,255,255,255, 63,
+	 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255,255,255,255,
+	255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255,255,
+	255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255,
+};
+
+static int
+decNEON (char *out, const char *in, int inlen)
+{
+	const uint8x16x4_t lo = vld1q_u8_x4 (neonDec);
+	const uint8x16x4_t hi = vld1q_u8_x4 (neonDec+64);
+	const uint8x16_t k64 = vdupq_n_u8 (64);
+	int n, i;
+
+	for (n = 0; inlen - n >= 64; n += 64, out += 48) {
+		uint8x16x4_t c = vld4q_u8 ((const uint8_t *)in+n);
+		uint8x16_t bad = vdupq_n_u8 (0);
+		uint8x16x3_t b;
+
+		/* out of range indices give 0 from tbl and keep the tbl result
+		 * from tbx, so chars >= 128 stay >= 128 and count as bad.
+		 */
+		for (i = 0; i < 4; i++) {
+			uint8x16_t v = vqtbl4q_u8 (lo, c.val[i]);
+			v = vqtbx4q_u8 (v, hi, vsubq_u8 (c.val[i], k64));
+			v = vorrq_u8 (v, vandq_u8 (c.val[i], vdupq_n_u8 (0x80)));
+			bad = vorrq_u8 (bad, v);
+			c.val[i] = v;
 		}
+		if (vmaxvq_u8 (bad) > 63)
+			break;
+
+		b.val[0] = vorrq_u8 (vshlq_n_u8 (c.val[0], 2),
+		                     vshrq_n_u8 (c.val[1], 4));
+		b.val[1] = vorrq_u8 (vshlq_n_u8 (c.val[1], 4),
+		                     vshrq_n_u8 (c.val[2], 2));
+		b.val[2] = vorrq_u8 (vshlq_n_u8 (c.val[2], 6), c.val[3]);
+		vst3q_u8 ((uint8_t *)out, b);
 	}
-	return outlen;
+	return (n);
 }
+#endif /* B64_NEON */
 
 #ifdef BASE64_PROGRAM
 /* standalone program that converts to/from base64.
@@ -250,7 +846,7 @@ main (int ac, char *av[])
 
 	/* convert back to raw */
 	rawback = malloc (3*nb64/4);
-	nrawback = from64tobits_fast(rawback, b64, nrawin);
+	nrawback = from64tobits_fast(rawback, b64, nb64);
 	if (nrawback < 0) {
 	    fprintf (stderr, "base64 error: %d\n", nrawback);
 	    return(1);
@@ -47,8 +47,75 @@ extern int to64frombits(unsigned char *out, const unsigned char *in,
  */
 
 extern int from64tobits(char *out, const char *in);
+
+/** \brief Convert base64 to bytes array, given its length.
+    \param out output buffer in bytes. The buffer size must be at least (3 * inlen / 4) bytes long.
+    \param in input base64 buffer. Each group of 4 characters may be preceded by one newline, as IDSetBLOB() writes them.
+    \param inlen base64 buffer length, newlines included
+    \return number of bytes in out.
+ */
 extern int from64tobits_fast(char *out, const char *in, int inlen);
 
+/** \brief State of a base64 conversion done a chunk at a time. */
+typedef struct {
+    int linelen;        /*!< Encoding: characters per line, 0 for no newlines */
+    int col;            /*!< Encoding: characters on the current line */
+    int ncarry;         /*!< Bytes or characters in carry */
+    int done;           /*!< Decoding: padding has been seen */
+    char carry[4];      /*!< Start of a group waiting for the next chunk */
+} base64_stream;
+
+/** \brief Start encoding a stream of bytes to base64.
+    \param sp stream state to initialize.
+    \param linelen add a newline after every linelen characters, rounded down to a multiple of 4. 0 for none.
+ */
+extern void to64init(base64_stream *sp, int linelen);
+
+/** \brief Encode the next chunk of a stream. Chunks may have any length.
+    \param sp stream state.
+    \param out output buffer. The buffer size must be at least (4 * inlen / 3 + 4) bytes long, plus one byte for each line if linelen is set. It is not NUL terminated.
+    \param in next input bytes.
+    \param inlen number of bytes in in.
+    \return number of characters written to out.
+ */
+extern int to64update(base64_stream *sp, unsigned char *out, const unsigned char *in, int inlen);
+
+/** \brief Finish encoding a stream: encode any bytes left with padding, then end the last line if linelen is set.
+    \param sp stream state.
+    \param out output buffer, at least 6 bytes long.
+    \return number of characters written to out.
+ */
+extern int to64finish(base64_stream *sp, unsigned char *out);
+
+/** \brief Start decoding a stream of base64 characters.
+    \param sp stream state to initialize.
+ */
+extern void from64init(base64_stream *sp);
+
+/** \brief Decode the next chunk of a stream. Chunks may split groups anywhere, and whitespace is skipped wherever it is.
+    \param sp stream state.
+    \param out output buffer. The buffer size must be at least (3 * inlen / 4 + 3) bytes long.
+    \param in next input characters.
+    \param inlen number of characters in in.
+    \return number of bytes written to out, or -1 if in holds a character that is not base64 or whitespace, or data after padding.
+ */
+extern int from64update(base64_stream *sp, char *out, const char *in, int inlen);
+
+/** \brief Finish decoding a stream.
+    \param sp stream state.
+    \return 0 if the stream ended on a whole group, else -1.
+ */
+extern int from64finish(base64_stream *sp);
+
+/** \brief Choose the implementation used by all base64 functions. The fastest one this CPU supports is used by default, or the one named by the INDI_BASE64 environment variable.
+    \param name one of "avx2", "ssse3", "neon" or "lut", the portable table lookup.
+    \return 0 on success, -1 if name is not built in or this CPU can not run it.
+ */
+extern int base64SetKernel(const char *name);
+
+/** \brief Name of the implementation in use by the base64 functions. */
+extern const char *base64Kernel(void);
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -907,23 +907,11 @@ void V4L2_Driver::stackFrame()
   struct timeval current_exposure;
 
   if (!V4LFrame->stackedFrame) {
-    float *src, *dest;
-    unsigned int i;
-    
     V4LFrame->stackedFrame = (float *)malloc(sizeof(float) * v4l_base->getWidth() * v4l_base->getHeight());
-    src=v4l_base->getLinearY();
-    dest=V4LFrame->stackedFrame;
-    for (i=0; i < v4l_base->getWidth() * v4l_base->getHeight(); i++)
-      *dest++ = *src++;
+    memcpy(V4LFrame->stackedFrame, v4l_base->getLinearY(), sizeof(float) * v4l_base->getWidth() * v4l_base->getHeight());
     subframeCount=1;
   } else {
-    float *src, *dest;
-    unsigned int i;
-    
-    src=v4l_base->getLinearY();
-    dest=V4LFrame->stackedFrame;
-    for (i=0; i < v4l_base->getWidth() * v4l_base->getHeight(); i++)
-      *dest++ += *src++;
+    stackLinear(V4LFrame->stackedFrame, v4l_base->getLinearY(), v4l_base->getWidth() * v4l_base->getHeight());
     subframeCount+=1;    
   }
 
@@ -101,6 +101,28 @@ popFQ (FQ *q)
 	return (q->nq > 0 ? q->q[q->head - q->nq--] : NULL);
 }
 
+/* remove in place each element of the given FQ for which keep(e, i, arg)
+ * returns 0, where i is its index from the head, keeping the others in order.
+ * return number of elements removed.
+ */
+int
+filterFQ (FQ *q, int (*keep)(void *e, int i, void *arg), void *arg)
+{
+	int first = q->head - q->nq;
+	int i, n = 0;
+
+	for (i = 0; i < q->nq; i++) {
+	    void *e = q->q[first + i];
+	    if ((*keep) (e, i, arg))
+		q->q[first + n++] = e;
+	}
+
+	i = q->nq - n;
+	q->head -= i;
+	q->nq = n;
+	return (i);
+}
+
 /* return next element in the given FQ leaving it on the q, or NULL if empty */
 void *
 peekFQ (FQ *q)
@@ -25,6 +25,7 @@ extern void *popFQ (FQ *q);
 extern void *peekFQ (FQ *q);
 extern void *peekiFQ (FQ *q, int i);
 extern int nFQ (FQ *q);
+extern int filterFQ (FQ *q, int (*keep)(void *e, int i, void *arg), void *arg);
 extern void setMemFuncsFQ (void *(*newmalloc)(size_t size),
    void *(*newrealloc)(void *ptr, size_t size),
    void (*newfree)(void *ptr));
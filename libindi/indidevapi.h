@@ -226,6 +226,9 @@ extern void IDSetLight (const ILightVectorProperty *l, const char *msg, ...)
 ;
 
 /** \brief Tell client to update an existing BLOB vector property.
+
+    Each BLOB goes in a setBLOBVector of its own, and messages other threads send meanwhile go between them
+    rather than waiting for the whole vector.
     \param b pointer to the vector BLOB property.
     \param msg message in printf style to send to the client. May be NULL.
  */
@@ -235,6 +238,25 @@ extern void IDSetBLOB (const IBLOBVectorProperty *b, const char *msg, ...)
 #endif
 ;
 
+/** \brief Set how IDSet calls for a vector property are published, so clients see its changes rather than every poll.
+    Without a policy every call is sent. Updates carrying a message or a new state are always sent at once.
+    \param vp pointer to the number, switch, text or light vector property, as given to its IDSet function.
+    \param skipUnchanged if non-zero, updates whose elements all equal the last ones published are dropped.
+    \param minInterval seconds. Updates sooner than this after the last one sent are held, and the latest of them is
+    sent as soon as the interval is up, with the timestamp it was held with. 0 to send at once.
+    \param deadband numbers only: a change in an element of no more than this counts as unchanged.
+    Set skipUnchanged and minInterval to 0 to remove the policy. The policy belongs to the device and name of vp, so it
+    still applies after the property is deleted and defined again.
+*/
+extern void IDSetPublishPolicy (const void *vp, int skipUnchanged, double minInterval, double deadband);
+
+/** \brief Set the deadband of one element of a number vector property, in place of the one given to IDSetPublishPolicy().
+    \param n pointer to the vector number property, which must have a publish policy.
+    \param name name of the element.
+    \param deadband a change in the element of no more than this counts as unchanged.
+*/
+extern void IDSetPublishDeadband (const INumberVectorProperty *n, const char *name, double deadband);
+
 /*@}*/
 
 /**
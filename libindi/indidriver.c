@@ -28,8 +28,10 @@
 #include <time.h>
 #include <unistd.h>
 #include <locale.h>
+#include <math.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <pthread.h>
 
 #include "lilxml.h"
@@ -38,9 +40,30 @@
 #include "indidevapi.h"
 #include "indicom.h"
 #include "indidriver.h"
+#include "outbuf.h"
 
 pthread_mutex_t stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* while one thread writes a BLOB to stdout without holding stdout_mutex,
+ * messages from the others are kept here in order and sent between its
+ * setBLOBVectors.
+ * N.B. all guarded by stdout_mutex
+ */
+typedef struct PendMsg {
+    struct PendMsg *next;               /* next to send, or NULL */
+    size_t len;                         /* bytes in buf */
+    char buf[1];                        /* the message, malloced to len */
+} PendMsg;
+static PendMsg *pendHead, **pendTail = &pendHead;
+static int blobBusy;                    /* set while blobThread owns stdout */
+static pthread_t blobThread;
+static pthread_cond_t blobCond = PTHREAD_COND_INITIALIZER;
+
+static void pubForget (const char *dev, const char *name);
+static int writeAll (int fd, const void *buf, size_t n);
+static void msgSend (OutBuf *ob);
+static int pendKeep (const char *buf, size_t n);
+
 #define MAXRBUF 2048
 
 /*! INDI property type */
@@ -106,24 +129,28 @@ char * escapeXML(const char *s, unsigned int MAX_BUF_SIZE)
 void
 IDDelete (const char *dev, const char *name, const char *fmt, ...)
 {
-    pthread_mutex_lock(&stdout_mutex);
+    pubForget (dev, name);
 
-	xmlv1();
-	printf ("<delProperty\n  device='%s'\n", dev);
-	if (name)
-	    printf (" name='%s'\n", name);
-	printf ("  timestamp='%s'\n", timestamp());
-	if (fmt) {
-	    va_list ap;
-	    va_start (ap, fmt);
-	    printf ("  message='");
-	    vprintf (fmt, ap);
-	    printf ("'\n");
-	    va_end (ap);
-	}
-	printf ("/>\n");
-	fflush (stdout);
+    OutBuf *ob = outBufGet();
+
+    outBufPrintf (ob, "<?xml version='1.0'?>\n<delProperty\n  device='%s'\n", dev);
+    if (name)
+        outBufPrintf (ob, " name='%s'\n", name);
+    outBufPuts (ob, "  timestamp='");
+    outBufTimestamp (ob);
+    outBufPuts (ob, "'\n");
+    if (fmt) {
+        va_list ap;
+        va_start (ap, fmt);
+        outBufPuts (ob, "  message='");
+        outBufVPrintf (ob, fmt, ap);
+        outBufPuts (ob, "'\n");
+        va_end (ap);
+    }
+    outBufPuts (ob, "/>\n");
 
+    pthread_mutex_lock(&stdout_mutex);
+    msgSend (ob);
     pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -133,13 +160,16 @@ IDDelete (const char *dev, const char *name, const char *fmt, ...)
 void
 IDSnoopDevice (const char *snooped_device_name, const char *snooped_property_name)
 {
+    OutBuf *ob = outBufGet();
+
+    outBufPuts (ob, "<?xml version='1.0'?>\n");
+    if (snooped_property_name && snooped_property_name[0])
+        outBufPrintf (ob, "<getProperties version='%g' device='%s' name='%s'/>\n", INDIV, snooped_device_name, snooped_property_name);
+    else
+        outBufPrintf (ob, "<getProperties version='%g' device='%s'/>\n", INDIV, snooped_device_name);
+
     pthread_mutex_lock(&stdout_mutex);
-	xmlv1();
-	if (snooped_property_name && snooped_property_name[0])
-        printf ("<getProperties version='%g' device='%s' name='%s'/>\n", INDIV, snooped_device_name, snooped_property_name);
-	else
-        printf ("<getProperties version='%g' device='%s'/>\n", INDIV, snooped_device_name);
-	fflush (stdout);
+    msgSend (ob);
     pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -150,6 +180,7 @@ void
 IDSnoopBLOBs (const char *snooped_device, BLOBHandling bh)
 {
 	const char *how;
+	OutBuf *ob;
 
 	switch (bh) {
 	case B_NEVER: how = "Never"; break;
@@ -158,11 +189,12 @@ IDSnoopBLOBs (const char *snooped_device, BLOBHandling bh)
 	default: return;
 	}
 
-    pthread_mutex_lock(&stdout_mutex);
-	xmlv1();
-	printf ("<enableBLOB device='%s'>%s</enableBLOB>\n",
+	ob = outBufGet();
+	outBufPrintf (ob, "<?xml version='1.0'?>\n<enableBLOB device='%s'>%s</enableBLOB>\n",
 						snooped_device, how);
-	fflush (stdout);
+
+    pthread_mutex_lock(&stdout_mutex);
+    msgSend (ob);
     pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -1194,76 +1226,476 @@ dispatch (XMLEle *root, char msg[])
     return(1);
 }
 
-int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[])
+/* Config cache.
+ *
+ * Drivers load their config a property at a time, so each file is parsed
+ * once into a ConfigFile: every element as its own XML text, in file
+ * order, with their indices sorted by property name to find those of one
+ * quickly. Each dispatch parses its element afresh, so the driver gets a
+ * tree of its own, as before. A file is parsed again only if stat() says
+ * it changed since, or when IUWriteConfig() replaces it: then the new
+ * contents are written to a temporary file renamed over the old one, so a
+ * crash never leaves half a config, and cached once that succeeded.
+ */
+typedef struct
 {
-    char configFileName[MAXRBUF];
+    char *dev, *name;                   /* of the element */
+    char *xml;                          /* the element */
+    int len;
+} ConfigItem;
+
+typedef struct ConfigFile
+{
+    char path[MAXRBUF];
+    struct stat st;                     /* of the file when read */
+    int nel;                            /* elements in the file */
+    ConfigItem *items;                  /* those before any bad one, in order */
+    int nitems;
+    int *byname;                        /* items sorted by name, then order */
+    int bad;                            /* an element lacked device or name */
+    char badmsg[MAXRBUF];
+    int refs;                           /* IUReadConfig()s using it */
+    struct ConfigFile *next;
+} ConfigFile;
+
+static ConfigFile *configFiles;
+static pthread_mutex_t configLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t configWriteLock = PTHREAD_MUTEX_INITIALIZER;    /* one IUWriteConfig() at a time */
+
+/* fill path with the config file for filename or dev */
+static void
+configPath (const char *filename, const char *dev, char path[MAXRBUF])
+{
+    if (filename)
+         snprintf(path, MAXRBUF, "%s", filename);
+    else if (getenv("INDICONFIG"))
+         snprintf(path, MAXRBUF, "%s", getenv("INDICONFIG"));
+    else
+         snprintf(path, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+}
+
+/* fill errmsg with a message about a config file, cut to fit */
+static void
+configErrmsg (char errmsg[], const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start (ap, fmt);
+    vsnprintf (errmsg, MAXRBUF, fmt, ap);
+    va_end (ap);
+}
+
+/* return whether a and b stat the same file, unchanged */
+static int
+configSame (const struct stat *a, const struct stat *b)
+{
+    if (a->st_dev != b->st_dev || a->st_ino != b->st_ino || a->st_size != b->st_size
+            || a->st_mtime != b->st_mtime || a->st_ctime != b->st_ctime)
+        return (0);
+#if defined(__APPLE__)
+    return (a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec && a->st_ctimespec.tv_nsec == b->st_ctimespec.tv_nsec);
+#else
+    return (a->st_mtim.tv_nsec == b->st_mtim.tv_nsec && a->st_ctim.tv_nsec == b->st_ctim.tv_nsec);
+#endif
+}
+
+static void
+configFree (ConfigFile *cf)
+{
+    int i;
+
+    for (i = 0; i < cf->nitems; i++)
+    {
+        free (cf->items[i].dev);
+        free (cf->items[i].name);
+        free (cf->items[i].xml);
+    }
+    free (cf->items);
+    free (cf->byname);
+    free (cf);
+}
+
+/* unlink cf from configFiles, freeing it unless still in use.
+ * N.B. call with configLock locked
+ */
+static void
+configUnlink (ConfigFile *cf)
+{
+    ConfigFile **cfp;
+
+    for (cfp = &configFiles; *cfp; cfp = &(*cfp)->next)
+        if (*cfp == cf) {
+            *cfp = cf->next;
+            break;
+        }
+    cf->next = NULL;
+    if (cf->refs == 0)
+        configFree (cf);
+    else
+        cf->path[0] = '\0';             /* freed by the last configPut() */
+}
+
+static ConfigFile *
+configFind (const char *path)
+{
+    ConfigFile *cf;
+
+    for (cf = configFiles; cf; cf = cf->next)
+        if (!strcmp (cf->path, path))
+            return (cf);
+    return (NULL);
+}
+
+static const ConfigItem *sortItems;     /* for byName() */
+
+static int
+byName (const void *a, const void *b)
+{
+    int ia = *(const int *)a, ib = *(const int *)b;
+    int c = strcmp (sortItems[ia].name, sortItems[ib].name);
+
+    return (c ? c : ia - ib);
+}
+
+/* build a ConfigFile from the elements of fproot, NULL if no memory.
+ * N.B. call with configLock locked
+ */
+static ConfigFile *
+configBuild (const char *path, XMLEle *fproot)
+{
+    ConfigFile *cf = (ConfigFile *) calloc (1, sizeof(ConfigFile));
+    XMLEle *root;
     char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
-    LilXML *lp = newLilXML();
 
-    FILE *fp = NULL;
+    if (!cf)
+        return (NULL);
+    strncpy (cf->path, path, MAXRBUF-1);
+    cf->nel = nXMLEle(fproot);
+    cf->items = (ConfigItem *) calloc (cf->nel > 0 ? cf->nel : 1, sizeof(ConfigItem));
+    cf->byname = (int *) malloc ((cf->nel > 0 ? cf->nel : 1) * sizeof(int));
+    if (!cf->items || !cf->byname) {
+        configFree (cf);
+        return (NULL);
+    }
 
-    if (filename)
-         strncpy(configFileName, filename, MAXRBUF);
-     else
+    for (root = nextXMLEle (fproot, 1); root != NULL; root = nextXMLEle (fproot, 0))
     {
-        if (getenv("INDICONFIG"))
-            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
-        else
-           snprintf(configFileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+        ConfigItem *ip = &cf->items[cf->nitems];
+
+        /* stop at one without device and name, as loading will */
+        if (crackDN (root, &rdev, &rname, cf->badmsg) < 0)
+        {
+            cf->bad = 1;
+            break;
+        }
+
+        ip->len = sprlXMLEle (root, 0);
+        ip->xml = (char *) malloc (ip->len + 1);
+        if (!ip->xml) {
+            configFree (cf);
+            return (NULL);
+        }
+        ip->len = sprXMLEle (ip->xml, root, 0);
+        ip->xml[ip->len] = '\0';
+
+        ip->dev = strdup (rdev);
+        ip->name = strdup (rname);
+        cf->byname[cf->nitems] = cf->nitems;
+        cf->nitems++;
+        if (!ip->dev || !ip->name) {
+            configFree (cf);
+            return (NULL);
+        }
+    }
+
+    sortItems = cf->items;
+    qsort (cf->byname, cf->nitems, sizeof(int), byName);
+
+    return (cf);
+}
 
+/* return the ConfigFile for path, reading it if it is not cached or has
+ * changed since, marked in use until configPut(). NULL with errmsg if it
+ * can not be read.
+ */
+static ConfigFile *
+configGet (const char *path, char errmsg[])
+{
+    ConfigFile *cf;
+    struct stat st;
+    XMLEle *fproot;
+    LilXML *lp;
+    FILE *fp;
+
+    pthread_mutex_lock(&configLock);
+
+    cf = configFind (path);
+    if (cf && stat (path, &st) == 0 && configSame (&st, &cf->st))
+    {
+        cf->refs++;
+        pthread_mutex_unlock(&configLock);
+        return (cf);
     }
+    if (cf)
+        configUnlink (cf);
 
-    fp = fopen(configFileName, "r");
+    fp = fopen(path, "r");
     if (fp == NULL)
     {
-         snprintf(errmsg, MAXRBUF, "Unable to read user config file. Error loading file %s: %s\n", configFileName, strerror(errno));
-         return -1;
+         configErrmsg(errmsg, "Unable to read user config file. Error loading file %s: %s\n", path, strerror(errno));
+         pthread_mutex_unlock(&configLock);
+         return NULL;
     }
 
+    lp = newLilXML();
+    arenaLilXML(lp, 1);
     fproot = readXMLFile(fp, lp, errmsg);
+    delLilXML(lp);
 
     if (fproot == NULL)
     {
-        snprintf(errmsg, MAXRBUF, "Unable to parse config XML: %s", errmsg);
+        char *why = strdup(errmsg);
+        configErrmsg(errmsg, "Unable to parse config XML: %s", why ? why : "");
+        free(why);
         fclose(fp);
-        return -1;
+        pthread_mutex_unlock(&configLock);
+        return NULL;
     }
 
-    if (nXMLEle(fproot) > 0 && silent != 1)
-        IDMessage(dev, "Loading device configuration...");
+    cf = configBuild (path, fproot);
+    delXMLEle(fproot);
+    if (cf)
+    {
+        fstat (fileno(fp), &cf->st);
+        cf->refs = 1;
+        cf->next = configFiles;
+        configFiles = cf;
+    }
+    else
+        configErrmsg(errmsg, "Unable to load config file %s: out of memory", path);
+    fclose(fp);
 
-    for (root = nextXMLEle (fproot, 1); root != NULL; root = nextXMLEle (fproot, 0))
+    pthread_mutex_unlock(&configLock);
+    return (cf);
+}
+
+/* done with cf from configGet() */
+static void
+configPut (ConfigFile *cf)
+{
+    pthread_mutex_lock(&configLock);
+    if (--cf->refs == 0 && cf->path[0] == '\0')
+        configFree (cf);
+    pthread_mutex_unlock(&configLock);
+}
+
+/* parse ip afresh and hand it to the driver */
+static void
+configDispatch (LilXML *lp, const ConfigItem *ip, char errmsg[])
+{
+    XMLEle **nodes = parseXMLChunk (lp, ip->xml, ip->len, errmsg);
+    int i;
+
+    if (!nodes)
+        return;
+    for (i = 0; nodes[i]; i++)
     {
+        dispatch(nodes[i], errmsg);
+        delXMLEle(nodes[i]);
+    }
+    free (nodes);
+}
+
+int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[])
+{
+    char configFileName[MAXRBUF];
+    ConfigFile *cf;
+    LilXML *lp;
+    int i, lo, hi;
+
+    configPath (filename, dev, configFileName);
+
+    cf = configGet (configFileName, errmsg);
+    if (cf == NULL)
+        return -1;
+
+    if (cf->nel > 0 && silent != 1)
+        IDMessage(dev, "Loading device configuration...");
+
+    lp = newLilXML();
 
-        /* pull out device and name */
-        if (crackDN (root, &rdev, &rname, errmsg) < 0)
+    if (property)
+    {
+        /* first of those named property */
+        for (lo = 0, hi = cf->nitems; lo < hi; )
         {
-            fclose(fp);
-            return -1;
+            int mid = (lo + hi)/2;
+            if (strcmp (cf->items[cf->byname[mid]].name, property) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
+        for (i = lo; i < cf->nitems && !strcmp (cf->items[cf->byname[i]].name, property); i++)
+            if (!strcmp (dev, cf->items[cf->byname[i]].dev))
+                configDispatch (lp, &cf->items[cf->byname[i]], errmsg);
+    }
+    else
+    {
+        for (i = 0; i < cf->nitems; i++)
+            if (!strcmp (dev, cf->items[i].dev))
+                configDispatch (lp, &cf->items[i], errmsg);
+    }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
-
-        if ( (property && !strcmp(property, rname)) || property == NULL)
-            dispatch(root, errmsg);
+    delLilXML(lp);
 
+    if (cf->bad)
+    {
+        strncpy(errmsg, cf->badmsg, MAXRBUF);
+        configPut (cf);
+        return -1;
     }
 
-    if (nXMLEle(fproot) > 0 && silent != 1)
+    if (cf->nel > 0 && silent != 1)
         IDMessage(dev, "Device configuration applied.");
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delXMLEle(root);
-    delLilXML(lp);
+    configPut (cf);
 
     return (0);
 
 }
 
+/* write data to a temporary file beside path, with its mode if it exists,
+ * then rename that over it. a symlink is followed, so the file it points
+ * to is the one replaced. return 0 or -1 with errno set.
+ */
+static int
+configWriteFile (const char *path, const char *data, size_t len)
+{
+    char *real, *tmp;
+    struct stat st;
+    int fd, err;
+
+    real = realpath (path, NULL);
+    if (!real && errno != ENOENT)
+        return (-1);
+    if (!real && !(real = strdup (path)))
+        return (-1);
+    tmp = (char *) malloc (strlen (real) + 32);
+    if (!tmp)
+    {
+        free (real);
+        errno = ENOMEM;
+        return (-1);
+    }
+
+    /* one writer per process at a time, so the pid makes the name ours */
+    sprintf (tmp, "%s.%ld.tmp", real, (long)getpid());
+    unlink (tmp);
+    fd = open (tmp, O_WRONLY|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+    if (fd < 0)
+    {
+        err = errno;
+        free (tmp);
+        free (real);
+        errno = err;
+        return (-1);
+    }
+    if (stat (real, &st) == 0)
+        fchmod (fd, st.st_mode & 07777);
+
+    if (writeAll (fd, data, len) < 0 || fsync (fd) < 0)
+    {
+        err = errno;
+        close (fd);
+        unlink (tmp);
+        free (tmp);
+        free (real);
+        errno = err;
+        return (-1);
+    }
+    if (close (fd) < 0 || rename (tmp, real) < 0)
+    {
+        err = errno;
+        unlink (tmp);
+        free (tmp);
+        free (real);
+        errno = err;
+        return (-1);
+    }
+
+    free (tmp);
+    free (real);
+    return (0);
+}
+
+int IUWriteConfig(const char *filename, const char *dev, const char *data, size_t len, char errmsg[])
+{
+    char configFileName[MAXRBUF];
+    char configDir[MAXRBUF];
+    struct stat st;
+    ConfigFile *cf;
+    XMLEle *fproot;
+    LilXML *lp;
+    FILE *fp;
+
+    snprintf(configDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
+    configPath (filename, dev, configFileName);
+
+    if(stat(configDir,&st) != 0)
+    {
+        if (mkdir(configDir, S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) < 0)
+        {
+            configErrmsg(errmsg, "Unable to create config directory. Error %s: %s\n", configDir, strerror(errno));
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&configWriteLock);
+
+    if (configWriteFile (configFileName, data, len) < 0)
+    {
+        configErrmsg(errmsg, "Unable to save config file %s: %s", configFileName, strerror(errno));
+        pthread_mutex_lock(&configLock);
+        if ((cf = configFind (configFileName)) != NULL)
+            configUnlink (cf);
+        pthread_mutex_unlock(&configLock);
+        pthread_mutex_unlock(&configWriteLock);
+        return -1;
+    }
+
+    /* cache what was written, so loads from now on need not read it back */
+    pthread_mutex_lock(&configLock);
+    if ((cf = configFind (configFileName)) != NULL)
+        configUnlink (cf);
+    cf = NULL;
+    fp = fmemopen ((void *)data, len, "r");
+    if (fp)
+    {
+        char why[MAXRBUF];
+        lp = newLilXML();
+        arenaLilXML(lp, 1);
+        fproot = readXMLFile (fp, lp, why);
+        delLilXML(lp);
+        fclose (fp);
+        if (fproot)
+        {
+            cf = configBuild (configFileName, fproot);
+            delXMLEle (fproot);
+        }
+    }
+    if (cf && stat (configFileName, &cf->st) == 0)
+    {
+        cf->next = configFiles;
+        configFiles = cf;
+    }
+    else if (cf)
+        configFree (cf);
+    pthread_mutex_unlock(&configLock);
+
+    pthread_mutex_unlock(&configWriteLock);
+
+    return 0;
+}
 
 void IUSaveDefaultConfig(const char *source_config, const char *dest_config, const char *dev)
 {
@@ -1316,26 +1748,27 @@ void IUSaveDefaultConfig(const char *source_config, const char *dest_config, con
 void
 IDMessage (const char *dev, const char *fmt, ...)
 {
+        OutBuf *ob = outBufGet();
 
-    pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        printf ("<message\n");
+        outBufPuts (ob, "<?xml version='1.0'?>\n<message\n");
         if (dev)
-            printf (" device='%s'\n", dev);
-        printf ("  timestamp='%s'\n", timestamp());
+            outBufPrintf (ob, " device='%s'\n", dev);
+        outBufPuts (ob, "  timestamp='");
+        outBufTimestamp (ob);
+        outBufPuts (ob, "'\n");
         if (fmt) {
             va_list ap;
             va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
+            outBufPuts (ob, "  message='");
+            outBufVPrintf (ob, fmt, ap);
+            outBufPuts (ob, "'\n");
             va_end (ap);
         }
-        printf ("/>\n");
-        fflush (stdout);
+        outBufPuts (ob, "/>\n");
 
-     pthread_mutex_unlock(&stdout_mutex);
+        pthread_mutex_lock(&stdout_mutex);
+        msgSend (ob);
+        pthread_mutex_unlock(&stdout_mutex);
 }
 
 FILE * IUGetConfigFP(const char *filename, const char *dev, char errmsg[])
@@ -1367,6 +1800,13 @@ FILE * IUGetConfigFP(const char *filename, const char *dev, char errmsg[])
          }
      }
 
+     /* written by the caller from here on, not by IUWriteConfig() */
+     pthread_mutex_lock(&configLock);
+     ConfigFile *cf = configFind (configFileName);
+     if (cf)
+         configUnlink (cf);
+     pthread_mutex_unlock(&configLock);
+
      fp = fopen(configFileName, "w");
      if (fp == NULL)
      {
@@ -1489,195 +1929,660 @@ void IUSaveConfigBLOB (FILE *fp, const IBLOBVectorProperty *bvp)
 
 }
 
-/* tell client to create a text vector property */
-void
-IDDefText (const ITextVectorProperty *tvp, const char *fmt, ...)
+/* add pre, then value and its closing quote */
+static void
+msgAttr (OutBuf *ob, const char *pre, const char *value)
 {
-        int i;
-        ROSC *SC;
+        outBufPuts (ob, pre);
+        outBufPuts (ob, value);
+        outBufPuts (ob, "'");
+}
 
-        pthread_mutex_lock(&stdout_mutex);
+/* start a message on the calling thread's OutBuf: the xml declaration, the
+ * opening of tag and its device and name.
+ */
+static OutBuf *
+msgStart (const char *tag, const char *dev, const char *name)
+{
+        OutBuf *ob = outBufGet();
 
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<defTextVector\n");
-        printf ("  device='%s'\n", tvp->device);
-        printf ("  name='%s'\n", tvp->name);
-        printf ("  label='%s'\n", tvp->label);
-        printf ("  group='%s'\n", tvp->group);
-        printf ("  state='%s'\n", pstateStr(tvp->s));
-        printf ("  perm='%s'\n", permStr(tvp->p));
-        printf ("  timeout='%g'\n", tvp->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
+        outBufPuts (ob, "<?xml version='1.0'?>\n<");
+        outBufPuts (ob, tag);
+        msgAttr (ob, "\n  device='", dev);
+        msgAttr (ob, "\n  name='", name);
+        return (ob);
+}
+
+/* add the timeout unless it is < 0, the timestamp and the message if fmt,
+ * then close the opening tag.
+ */
+static void
+msgHeadEnd (OutBuf *ob, double timeout, const char *fmt, va_list ap)
+{
+        if (timeout >= 0) {
+            outBufPuts (ob, "\n  timeout='");
+            outBufDouble (ob, timeout);
+            outBufPuts (ob, "'");
+        }
+        outBufPuts (ob, "\n  timestamp='");
+        outBufTimestamp (ob);
+        outBufPuts (ob, "'\n");
         if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
+            outBufPuts (ob, "  message='");
+            outBufVPrintf (ob, fmt, ap);
+            outBufPuts (ob, "'\n");
         }
-        printf (">\n");
+        outBufPuts (ob, ">\n");
+}
 
-        for (i = 0; i < tvp->ntp; i++) {
-            IText *tp = &tvp->tp[i];
-            printf ("  <defText\n");
-            printf ("    name='%s'\n", tp->name);
-            printf ("    label='%s'>\n", tp->label);
-            printf ("      %s\n", tp->text ? tp->text : "");
-            printf ("  </defText>\n");
-        }
+/* add one element: "  <tag name='name'>\n      value\n  </tag>\n" */
+static void
+msgElement (OutBuf *ob, const char *tag, const char *name, const char *value)
+{
+        outBufPuts (ob, "  <");
+        outBufPuts (ob, tag);
+        msgAttr (ob, " name='", name);
+        outBufPuts (ob, ">\n      ");
+        outBufPuts (ob, value);
+        outBufPuts (ob, "\n  </");
+        outBufPuts (ob, tag);
+        outBufPuts (ob, ">\n");
+}
 
-        printf ("</defTextVector>\n");
+/* add the opening of a def element with its name and label, leaving the
+ * tag open.
+ */
+static void
+msgDefElement (OutBuf *ob, const char *tag, const char *name, const char *label)
+{
+        outBufPuts (ob, "  <");
+        outBufPuts (ob, tag);
+        msgAttr (ob, "\n    name='", name);
+        msgAttr (ob, "\n    label='", label);
+}
 
-        if (isPropDefined(tvp->name) < 0)
-        {
-                /* Add this property to insure proper sanity check */
-                propCache = propCache ? (ROSC *) realloc ( propCache, sizeof(ROSC) * (nPropCache+1))
-                                : (ROSC *) malloc  ( sizeof(ROSC));
-                SC      = &propCache[nPropCache++];
-
-                strcpy(SC->propName, tvp->name);
-                SC->perm = tvp->p;
-                SC->ptr = tvp;
-                SC->type= INDI_TEXT;
+/* send ob to the Client in one write.
+ * N.B. call with stdout_mutex locked
+ */
+static void
+msgSend (OutBuf *ob)
+{
+        if (ob && pendKeep (ob->buf, ob->len)) {
+            ob->len = 0;
+            return;
         }
 
-        setlocale(LC_NUMERIC,orig);
+        /* anything still in stdio must go first */
         fflush (stdout);
-
-        pthread_mutex_unlock(&stdout_mutex);
+        outBufWrite (ob, 1);
 }
 
-/* tell client to create a new numeric vector property */
-void
-IDDefNumber (const INumberVectorProperty *n, const char *fmt, ...)
+/* keep a copy of the n bytes at buf to send after the part of a BLOB another
+ * thread is now writing. return 1 if kept, 0 if the caller may write now.
+ * N.B. call with stdout_mutex locked
+ */
+static int
+pendKeep (const char *buf, size_t n)
 {
-        int i;
-        ROSC *SC;
+        PendMsg *pm;
 
-        pthread_mutex_lock(&stdout_mutex);
+        if (!blobBusy || pthread_equal (blobThread, pthread_self()))
+            return (0);
 
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<defNumberVector\n");
-        printf ("  device='%s'\n", n->device);
-        printf ("  name='%s'\n", n->name);
-        printf ("  label='%s'\n", n->label);
-        printf ("  group='%s'\n", n->group);
-        printf ("  state='%s'\n", pstateStr(n->s));
-        printf ("  perm='%s'\n", permStr(n->p));
-        printf ("  timeout='%g'\n", n->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
+        pm = malloc (sizeof(PendMsg) + n);
+        if (!pm) {
+            /* rather wait than lose it */
+            while (blobBusy)
+                pthread_cond_wait (&blobCond, &stdout_mutex);
+            return (0);
+        }
 
+        memcpy (pm->buf, buf, n);
+        pm->len = n;
+        pm->next = NULL;
+        *pendTail = pm;
+        pendTail = &pm->next;
+        return (1);
+}
 
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
+/* send what pendKeep kept.
+ * N.B. call with stdout_mutex locked
+ */
+static void
+pendFlush (void)
+{
+        while (pendHead) {
+            PendMsg *pm = pendHead;
+            pendHead = pm->next;
+            writeAll (1, pm->buf, pm->len);
+            free (pm);
         }
-        printf (">\n");
+        pendTail = &pendHead;
+}
 
+/* add prop to propCache unless already there.
+ * N.B. call with stdout_mutex locked
+ */
+static void
+cacheProp (const char *name, IPerm perm, const void *ptr, int type)
+{
+        ROSC *SC;
 
-        for (i = 0; i < n->nnp; i++) {
+        if (isPropDefined(name) >= 0)
+            return;
 
-            INumber *np = &n->np[i];
+        /* Add this property to insure proper sanity check */
+        propCache = propCache ? (ROSC *) realloc ( propCache, sizeof(ROSC) * (nPropCache+1))
+                        : (ROSC *) malloc  ( sizeof(ROSC));
+        SC      = &propCache[nPropCache++];
 
-            printf ("  <defNumber\n");
-            printf ("    name='%s'\n", np->name);
-            printf ("    label='%s'\n", np->label);
-            printf ("    format='%s'\n", np->format);
-            printf ("    min='%.20g'\n", np->min);
-            printf ("    max='%.20g'\n", np->max);
-            printf ("    step='%.20g'>\n", np->step);
-            printf ("      %.20g\n", np->value);
+        strcpy(SC->propName, name);
+        SC->perm = perm;
+        SC->ptr = ptr;
+        SC->type= type;
+}
 
-            printf ("  </defNumber>\n");
-        }
+/* Publish policies.
+ *
+ * A vector property with a policy has the elements and state of the last
+ * update accepted for it kept here, and IDSet compares each new one with
+ * them: one with a message or a new state is sent at once, one with no
+ * element changed by more than its deadband is dropped if skipUnchanged,
+ * and one within minInterval of the last sent is held instead, replacing
+ * any held before, for pubThread to send when the interval is up. Held
+ * updates are kept as the bytes to send so pubThread never reads a
+ * property the driver may be changing. Policies are found by the device and
+ * name of the property, so one deleted and defined again keeps its policy
+ * while another that happens to reuse its memory does not inherit it.
+ * N.B. lock pubLock before stdout_mutex.
+ */
+typedef struct
+{
+    char device[MAXINDIDEVICE];         /* of the vector property */
+    char name[MAXINDINAME];
+    int skipUnchanged;                  /* drop updates changing nothing */
+    double minInterval;                 /* least secs between updates */
+    double deadband;                    /* numbers: least change seen */
+    int nel;                            /* elements below, -1 until published */
+    double *last;                       /* numbers, switch or light states */
+    char **lastText;                    /* texts */
+    double *deadbands;                  /* per number element, or NULL */
+    int ndeadbands;
+    IPState s;                          /* last state */
+    double sent;                        /* when last sent, secs */
+    char *held;                         /* update held for later */
+    size_t nheld;
+} PubPolicy;
+
+static PubPolicy *pubPolicies;
+static int nPubPolicies;
+static pthread_mutex_t pubLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pubCond;         /* timed on PUBCLOCK, set up by pubStart */
+static int pubThreadStarted;
+
+/* a clock no one can set, so held updates neither stall nor rush when the
+ * time of day is changed. macOS can not time a cond on it.
+ */
+#ifdef __APPLE__
+#define PUBCLOCK        CLOCK_REALTIME
+#else
+#define PUBCLOCK        CLOCK_MONOTONIC
+#endif
 
-        printf ("</defNumberVector>\n");
+/* return seconds now */
+static double
+pubNow (void)
+{
+        struct timespec ts;
 
-        if (isPropDefined(n->name) < 0)
-        {
-                /* Add this property to insure proper sanity check */
-                propCache = propCache ? (ROSC *) realloc ( propCache, sizeof(ROSC) * (nPropCache+1))
-                                : (ROSC *) malloc  ( sizeof(ROSC));
-                SC      = &propCache[nPropCache++];
-
-                strcpy(SC->propName, n->name);
-                SC->perm = n->p;
-                SC->ptr = n;
-                SC->type= INDI_NUMBER;
-        }
+        clock_gettime (PUBCLOCK, &ts);
+        return (ts.tv_sec + ts.tv_nsec*1e-9);
+}
 
-        setlocale(LC_NUMERIC,orig);
-        fflush (stdout);
+/* return the policy for vector property vp, or NULL.
+ * N.B. call with pubLock locked
+ */
+static PubPolicy *
+pubFind (const void *vp)
+{
+        /* all vector properties start with device and name */
+        const ITextVectorProperty *tvp = (const ITextVectorProperty *)vp;
+        int i;
+
+        for (i = 0; i < nPubPolicies; i++)
+            if (!strcmp (pubPolicies[i].name, tvp->name) && !strcmp (pubPolicies[i].device, tvp->device))
+                return (&pubPolicies[i]);
+        return (NULL);
+}
+
+/* drop whatever pp has held and remembered of its property */
+static void
+pubReset (PubPolicy *pp)
+{
+        int i;
+
+        if (pp->lastText)
+            for (i = 0; i < pp->nel; i++)
+                free (pp->lastText[i]);
+        free (pp->lastText);
+        free (pp->last);
+        free (pp->held);
+        pp->lastText = NULL;
+        pp->last = NULL;
+        pp->held = NULL;
+        pp->nheld = 0;
+        pp->nel = -1;
+}
+
+/* compare the elements and state of vp, of the given INDI_ type, with
+ * those last accepted by pp. return 2 if the state changed, 1 if an
+ * element did, else 0. unless 0, remember them as the last accepted.
+ * N.B. call with pubLock locked
+ */
+static int
+pubChanged (PubPolicy *pp, const void *vp, int type, IPState s)
+{
+        int i, n, changed;
+
+        switch (type) {
+        case INDI_NUMBER:   n = ((const INumberVectorProperty *)vp)->nnp; break;
+        case INDI_SWITCH:   n = ((const ISwitchVectorProperty *)vp)->nsp; break;
+        case INDI_LIGHT:    n = ((const ILightVectorProperty *)vp)->nlp; break;
+        case INDI_TEXT:     n = ((const ITextVectorProperty *)vp)->ntp; break;
+        default:            return (2);
+        }
+
+        /* first update, or the vector changed shape */
+        if (pp->nel != n) {
+            pubReset (pp);
+            if (type == INDI_TEXT)
+                pp->lastText = (char **) calloc (n, sizeof(char *));
+            else
+                pp->last = (double *) calloc (n, sizeof(double));
+            if (!pp->last && !pp->lastText)
+                return (2);
+            pp->nel = n;
+            changed = 2;
+        } else
+            changed = pp->s != s ? 2 : 0;
+
+        for (i = 0; i < n && !changed; i++) {
+            switch (type) {
+            case INDI_NUMBER: {
+                double v = ((const INumberVectorProperty *)vp)->np[i].value;
+                double db = i < pp->ndeadbands ? pp->deadbands[i] : pp->deadband;
+                changed = db > 0 ? fabs (v - pp->last[i]) > db : v != pp->last[i];
+                break;
+            }
+            case INDI_SWITCH:
+                changed = ((const ISwitchVectorProperty *)vp)->sp[i].s != pp->last[i];
+                break;
+            case INDI_LIGHT:
+                changed = ((const ILightVectorProperty *)vp)->lp[i].s != pp->last[i];
+                break;
+            case INDI_TEXT: {
+                const char *t = ((const ITextVectorProperty *)vp)->tp[i].text;
+                changed = strcmp (t ? t : "", pp->lastText[i] ? pp->lastText[i] : "") != 0;
+                break;
+            }
+            }
+        }
+        if (!changed)
+            return (0);
+
+        pp->s = s;
+        for (i = 0; i < n; i++)
+            switch (type) {
+            case INDI_NUMBER: pp->last[i] = ((const INumberVectorProperty *)vp)->np[i].value; break;
+            case INDI_SWITCH: pp->last[i] = ((const ISwitchVectorProperty *)vp)->sp[i].s; break;
+            case INDI_LIGHT:  pp->last[i] = ((const ILightVectorProperty *)vp)->lp[i].s; break;
+            case INDI_TEXT: {
+                const char *t = ((const ITextVectorProperty *)vp)->tp[i].text;
+                free (pp->lastText[i]);
+                pp->lastText[i] = strdup (t ? t : "");
+                break;
+            }
+            }
+        return (changed);
+}
+
+/* send held updates as they fall due, forever */
+static void *
+pubThread (void *arg)
+{
+        (void) arg;
+
+        pthread_mutex_lock(&pubLock);
+        for (;;) {
+            PubPolicy *due = NULL;
+            double now = pubNow(), when = 0;
+            int i;
+
+            for (i = 0; i < nPubPolicies; i++) {
+                PubPolicy *pp = &pubPolicies[i];
+                if (pp->held && (!due || pp->sent + pp->minInterval < when)) {
+                    due = pp;
+                    when = pp->sent + pp->minInterval;
+                }
+            }
+
+            if (!due)
+                pthread_cond_wait (&pubCond, &pubLock);
+            else if (when > now) {
+                struct timespec ts;
+                ts.tv_sec = (time_t)when;
+                ts.tv_nsec = (long)((when - ts.tv_sec)*1e9);
+                pthread_cond_timedwait (&pubCond, &pubLock, &ts);
+            } else {
+                pthread_mutex_lock(&stdout_mutex);
+                if (!pendKeep (due->held, due->nheld)) {
+                    fflush (stdout);
+                    writeAll (1, due->held, due->nheld);
+                }
+                pthread_mutex_unlock(&stdout_mutex);
+                free (due->held);
+                due->held = NULL;
+                due->nheld = 0;
+                due->sent = now;
+            }
+        }
+
+        return (NULL);
+}
+
+/* start pubThread, first setting up pubCond to be timed by PUBCLOCK.
+ * N.B. call with pubLock locked
+ */
+static void
+pubStart (void)
+{
+        static int condReady;
+        pthread_t tid;
+
+        if (!condReady) {
+            pthread_condattr_t attr;
+
+            pthread_condattr_init (&attr);
+#ifndef __APPLE__
+            pthread_condattr_setclock (&attr, PUBCLOCK);
+#endif
+            pthread_cond_init (&pubCond, &attr);
+            pthread_condattr_destroy (&attr);
+            condReady = 1;
+        }
+
+        pubThreadStarted = pthread_create (&tid, NULL, pubThread, NULL) == 0;
+        if (pubThreadStarted)
+            pthread_detach (tid);
+}
+
+/* send ob, the update of vp, an INDI_ type, in state s, now, later or
+ * never as its publish policy says. force sends it now regardless.
+ */
+static void
+msgPublish (OutBuf *ob, const void *vp, int type, IPState s, int force)
+{
+        PubPolicy *pp;
+        int changed;
+        double now;
+
+        pthread_mutex_lock(&pubLock);
+
+        pp = nPubPolicies > 0 ? pubFind (vp) : NULL;
+        changed = pp ? pubChanged (pp, vp, type, s) : 2;
+
+        if (pp && !force && !changed && pp->skipUnchanged) {
+            /* nothing new, though whatever was held still goes */
+            pthread_mutex_unlock(&pubLock);
+            return;
+        }
 
+        now = pubNow();
+        if (pp && !force && changed < 2 && now < pp->sent + pp->minInterval && ob) {
+            /* hold it, in place of any held before */
+            char *held = (char *) realloc (pp->held, ob->len);
+            if (held) {
+                memcpy (held, ob->buf, ob->len);
+                pp->held = held;
+                pp->nheld = ob->len;
+                if (!pubThreadStarted)
+                    pubStart();
+                pthread_cond_signal (&pubCond);
+                pthread_mutex_unlock(&pubLock);
+                return;
+            }
+        }
+
+        if (pp) {
+            free (pp->held);
+            pp->held = NULL;
+            pp->nheld = 0;
+            pp->sent = now;
+        }
+
+        pthread_mutex_lock(&stdout_mutex);
+        msgSend (ob);
         pthread_mutex_unlock(&stdout_mutex);
+
+        pthread_mutex_unlock(&pubLock);
+}
+
+/* vp has just been defined: forget what was last published of it */
+static void
+pubDefined (const void *vp)
+{
+        PubPolicy *pp;
+
+        pthread_mutex_lock(&pubLock);
+        if ((pp = pubFind (vp)) != NULL)
+            pubReset (pp);
+        pthread_mutex_unlock(&pubLock);
+}
+
+/* property name of dev, or all of dev if !name, is gone: drop its held
+ * updates and what was last published of it. the policy stays for when
+ * it is defined again.
+ */
+static void
+pubForget (const char *dev, const char *name)
+{
+        int i;
+
+        pthread_mutex_lock(&pubLock);
+        for (i = 0; i < nPubPolicies; i++) {
+            PubPolicy *pp = &pubPolicies[i];
+            if (!strcmp (pp->device, dev) && (!name || !strcmp (pp->name, name)))
+                pubReset (pp);
+        }
+        pthread_mutex_unlock(&pubLock);
 }
 
-/* tell client to create a new switch vector property */
 void
-IDDefSwitch (const ISwitchVectorProperty *s, const char *fmt, ...)
+IDSetPublishPolicy (const void *vp, int skipUnchanged, double minInterval, double deadband)
+{
+        PubPolicy *pp;
+
+        pthread_mutex_lock(&pubLock);
+
+        pp = pubFind (vp);
+        if (!skipUnchanged && minInterval <= 0) {
+            /* remove it, sending whatever it held */
+            if (pp) {
+                if (pp->held) {
+                    pthread_mutex_lock(&stdout_mutex);
+                    if (!pendKeep (pp->held, pp->nheld)) {
+                        fflush (stdout);
+                        writeAll (1, pp->held, pp->nheld);
+                    }
+                    pthread_mutex_unlock(&stdout_mutex);
+                }
+                pubReset (pp);
+                free (pp->deadbands);
+                *pp = pubPolicies[--nPubPolicies];
+            }
+            pthread_mutex_unlock(&pubLock);
+            return;
+        }
+
+        if (!pp) {
+            PubPolicy *pubs = (PubPolicy *) realloc (pubPolicies, sizeof(PubPolicy) * (nPubPolicies+1));
+            if (!pubs) {
+                pthread_mutex_unlock(&pubLock);
+                return;
+            }
+            pubPolicies = pubs;
+            pp = &pubPolicies[nPubPolicies];
+            memset (pp, 0, sizeof(*pp));
+            snprintf (pp->device, sizeof(pp->device), "%s", ((const ITextVectorProperty *)vp)->device);
+            snprintf (pp->name, sizeof(pp->name), "%s", ((const ITextVectorProperty *)vp)->name);
+            pp->nel = -1;
+            nPubPolicies++;
+        }
+        pp->skipUnchanged = skipUnchanged;
+        pp->minInterval = minInterval > 0 ? minInterval : 0;
+        pp->deadband = deadband > 0 ? deadband : 0;
 
+        pthread_mutex_unlock(&pubLock);
+}
+
+void
+IDSetPublishDeadband (const INumberVectorProperty *nvp, const char *name, double deadband)
 {
+        PubPolicy *pp;
         int i;
-        ROSC *SC;
+
+        pthread_mutex_lock(&pubLock);
+
+        if ((pp = pubFind (nvp)) != NULL) {
+            if (pp->ndeadbands != nvp->nnp) {
+                double *deadbands = (double *) realloc (pp->deadbands, nvp->nnp * sizeof(double));
+                if (!deadbands) {
+                    pthread_mutex_unlock(&pubLock);
+                    return;
+                }
+                for (i = pp->ndeadbands; i < nvp->nnp; i++)
+                    deadbands[i] = pp->deadband;
+                pp->deadbands = deadbands;
+                pp->ndeadbands = nvp->nnp;
+            }
+            for (i = 0; i < nvp->nnp; i++)
+                if (!strcmp (nvp->np[i].name, name))
+                    pp->deadbands[i] = deadband > 0 ? deadband : 0;
+        }
+
+        pthread_mutex_unlock(&pubLock);
+}
+
+/* tell client to create a text vector property */
+void
+IDDefText (const ITextVectorProperty *tvp, const char *fmt, ...)
+{
+        va_list ap;
+        int i;
+
+        OutBuf *ob = msgStart ("defTextVector", tvp->device, tvp->name);
+        msgAttr (ob, "\n  label='", tvp->label);
+        msgAttr (ob, "\n  group='", tvp->group);
+        msgAttr (ob, "\n  state='", pstateStr(tvp->s));
+        msgAttr (ob, "\n  perm='", permStr(tvp->p));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, tvp->timeout, fmt, ap);
+        va_end (ap);
+
+        for (i = 0; i < tvp->ntp; i++) {
+            IText *tp = &tvp->tp[i];
+            msgDefElement (ob, "defText", tp->name, tp->label);
+            outBufPuts (ob, ">\n      ");
+            outBufPuts (ob, tp->text ? tp->text : "");
+            outBufPuts (ob, "\n  </defText>\n");
+        }
+
+        outBufPuts (ob, "</defTextVector>\n");
+
+        pubDefined (tvp);
 
         pthread_mutex_lock(&stdout_mutex);
+        cacheProp (tvp->name, tvp->p, tvp, INDI_TEXT);
+        msgSend (ob);
+        pthread_mutex_unlock(&stdout_mutex);
+}
 
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<defSwitchVector\n");
-        printf ("  device='%s'\n", s->device);
-        printf ("  name='%s'\n", s->name);
-        printf ("  label='%s'\n", s->label);
-        printf ("  group='%s'\n", s->group);
-        printf ("  state='%s'\n", pstateStr(s->s));
-        printf ("  perm='%s'\n", permStr(s->p));
-        printf ("  rule='%s'\n", ruleStr (s->r));
-        printf ("  timeout='%g'\n", s->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
+/* tell client to create a new numeric vector property */
+void
+IDDefNumber (const INumberVectorProperty *n, const char *fmt, ...)
+{
+        va_list ap;
+        int i;
+
+        OutBuf *ob = msgStart ("defNumberVector", n->device, n->name);
+        msgAttr (ob, "\n  label='", n->label);
+        msgAttr (ob, "\n  group='", n->group);
+        msgAttr (ob, "\n  state='", pstateStr(n->s));
+        msgAttr (ob, "\n  perm='", permStr(n->p));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, n->timeout, fmt, ap);
+        va_end (ap);
+
+        for (i = 0; i < n->nnp; i++) {
+
+            INumber *np = &n->np[i];
+
+            msgDefElement (ob, "defNumber", np->name, np->label);
+            msgAttr (ob, "\n    format='", np->format);
+            outBufPuts (ob, "\n    min='");
+            outBufDouble (ob, np->min);
+            outBufPuts (ob, "'\n    max='");
+            outBufDouble (ob, np->max);
+            outBufPuts (ob, "'\n    step='");
+            outBufDouble (ob, np->step);
+            outBufPuts (ob, "'>\n      ");
+            outBufDouble (ob, np->value);
+            outBufPuts (ob, "\n  </defNumber>\n");
         }
-        printf (">\n");
+
+        outBufPuts (ob, "</defNumberVector>\n");
+
+        pubDefined (n);
+
+        pthread_mutex_lock(&stdout_mutex);
+        cacheProp (n->name, n->p, n, INDI_NUMBER);
+        msgSend (ob);
+        pthread_mutex_unlock(&stdout_mutex);
+}
+
+/* tell client to create a new switch vector property */
+void
+IDDefSwitch (const ISwitchVectorProperty *s, const char *fmt, ...)
+
+{
+        va_list ap;
+        int i;
+
+        OutBuf *ob = msgStart ("defSwitchVector", s->device, s->name);
+        msgAttr (ob, "\n  label='", s->label);
+        msgAttr (ob, "\n  group='", s->group);
+        msgAttr (ob, "\n  state='", pstateStr(s->s));
+        msgAttr (ob, "\n  perm='", permStr(s->p));
+        msgAttr (ob, "\n  rule='", ruleStr (s->r));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, s->timeout, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < s->nsp; i++) {
             ISwitch *sp = &s->sp[i];
-            printf ("  <defSwitch\n");
-            printf ("    name='%s'\n", sp->name);
-            printf ("    label='%s'>\n", sp->label);
-            printf ("      %s\n", sstateStr(sp->s));
-            printf ("  </defSwitch>\n");
+            msgDefElement (ob, "defSwitch", sp->name, sp->label);
+            outBufPuts (ob, ">\n      ");
+            outBufPuts (ob, sstateStr(sp->s));
+            outBufPuts (ob, "\n  </defSwitch>\n");
         }
 
-        printf ("</defSwitchVector>\n");
-
-        if (isPropDefined(s->name) < 0)
-        {
-                /* Add this property to insure proper sanity check */
-                propCache = propCache ? (ROSC *) realloc ( propCache, sizeof(ROSC) * (nPropCache+1))
-                                : (ROSC *) malloc  ( sizeof(ROSC));
-                SC      = &propCache[nPropCache++];
-
-                strcpy(SC->propName, s->name);
-                SC->perm = s->p;
-                SC->ptr = s;
-                SC->type= INDI_SWITCH;
-        }
+        outBufPuts (ob, "</defSwitchVector>\n");
 
-        setlocale(LC_NUMERIC,orig);
-        fflush (stdout);
+        pubDefined (s);
 
+        pthread_mutex_lock(&stdout_mutex);
+        cacheProp (s->name, s->p, s, INDI_SWITCH);
+        msgSend (ob);
         pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -1685,40 +2590,31 @@ IDDefSwitch (const ISwitchVectorProperty *s, const char *fmt, ...)
 void
 IDDefLight (const ILightVectorProperty *lvp, const char *fmt, ...)
 {
+        va_list ap;
         int i;
 
-        pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        printf ("<defLightVector\n");
-        printf ("  device='%s'\n", lvp->device);
-        printf ("  name='%s'\n", lvp->name);
-        printf ("  label='%s'\n", lvp->label);
-        printf ("  group='%s'\n", lvp->group);
-        printf ("  state='%s'\n", pstateStr(lvp->s));
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
-        }
-        printf (">\n");
+        OutBuf *ob = msgStart ("defLightVector", lvp->device, lvp->name);
+        msgAttr (ob, "\n  label='", lvp->label);
+        msgAttr (ob, "\n  group='", lvp->group);
+        msgAttr (ob, "\n  state='", pstateStr(lvp->s));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, -1, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < lvp->nlp; i++) {
             ILight *lp = &lvp->lp[i];
-            printf ("  <defLight\n");
-            printf ("    name='%s'\n", lp->name);
-            printf ("    label='%s'>\n", lp->label);
-            printf ("      %s\n", pstateStr(lp->s));
-            printf ("  </defLight>\n");
+            msgDefElement (ob, "defLight", lp->name, lp->label);
+            outBufPuts (ob, ">\n      ");
+            outBufPuts (ob, pstateStr(lp->s));
+            outBufPuts (ob, "\n  </defLight>\n");
         }
 
-        printf ("</defLightVector>\n");
-        fflush (stdout);
+        outBufPuts (ob, "</defLightVector>\n");
 
+        pubDefined (lvp);
+
+        pthread_mutex_lock(&stdout_mutex);
+        msgSend (ob);
         pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -1726,58 +2622,31 @@ IDDefLight (const ILightVectorProperty *lvp, const char *fmt, ...)
 void
 IDDefBLOB (const IBLOBVectorProperty *b, const char *fmt, ...)
 {
-  int i;
-  ROSC *SC;
+        va_list ap;
+        int i;
 
-  pthread_mutex_lock(&stdout_mutex);
+        OutBuf *ob = msgStart ("defBLOBVector", b->device, b->name);
+        msgAttr (ob, "\n  label='", b->label);
+        msgAttr (ob, "\n  group='", b->group);
+        msgAttr (ob, "\n  state='", pstateStr(b->s));
+        msgAttr (ob, "\n  perm='", permStr(b->p));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, b->timeout, fmt, ap);
+        va_end (ap);
 
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<defBLOBVector\n");
-        printf ("  device='%s'\n", b->device);
-        printf ("  name='%s'\n", b->name);
-        printf ("  label='%s'\n", b->label);
-        printf ("  group='%s'\n", b->group);
-        printf ("  state='%s'\n", pstateStr(b->s));
-        printf ("  perm='%s'\n", permStr(b->p));
-        printf ("  timeout='%g'\n", b->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
+        for (i = 0; i < b->nbp; i++) {
+            IBLOB *bp = &b->bp[i];
+            msgDefElement (ob, "defBLOB", bp->name, bp->label);
+            outBufPuts (ob, "\n  />\n");
         }
-        printf (">\n");
-
-  for (i = 0; i < b->nbp; i++) {
-    IBLOB *bp = &b->bp[i];
-    printf ("  <defBLOB\n");
-    printf ("    name='%s'\n", bp->name);
-    printf ("    label='%s'\n", bp->label);
-    printf ("  />\n");
-  }
 
-        printf ("</defBLOBVector>\n");
+        outBufPuts (ob, "</defBLOBVector>\n");
 
-        if (isPropDefined(b->name) < 0)
-        {
-                /* Add this property to insure proper sanity check */
-                propCache = propCache ? (ROSC *) realloc ( propCache, sizeof(ROSC) * (nPropCache+1))
-                                : (ROSC *) malloc  ( sizeof(ROSC));
-                SC      = &propCache[nPropCache++];
-
-                strcpy(SC->propName, b->name);
-                SC->perm = b->p;
-                SC->ptr = b;
-                SC->type= INDI_BLOB;
-        }
-
-        setlocale(LC_NUMERIC,orig);
-        fflush (stdout);
+        pubDefined (b);
 
+        pthread_mutex_lock(&stdout_mutex);
+        cacheProp (b->name, b->p, b, INDI_BLOB);
+        msgSend (ob);
         pthread_mutex_unlock(&stdout_mutex);
 }
 
@@ -1785,225 +2654,201 @@ IDDefBLOB (const IBLOBVectorProperty *b, const char *fmt, ...)
 void
 IDSetText (const ITextVectorProperty *tvp, const char *fmt, ...)
 {
+        va_list ap;
         int i;
 
-        pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<setTextVector\n");
-        printf ("  device='%s'\n", tvp->device);
-        printf ("  name='%s'\n", tvp->name);
-        printf ("  state='%s'\n", pstateStr(tvp->s));
-        printf ("  timeout='%g'\n", tvp->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
-        }
-        printf (">\n");
+        OutBuf *ob = msgStart ("setTextVector", tvp->device, tvp->name);
+        msgAttr (ob, "\n  state='", pstateStr(tvp->s));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, tvp->timeout, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < tvp->ntp; i++) {
             IText *tp = &tvp->tp[i];
-            printf ("  <oneText name='%s'>\n", tp->name);
-            printf ("      %s\n", tp->text ? tp->text : "");
-            printf ("  </oneText>\n");
+            msgElement (ob, "oneText", tp->name, tp->text ? tp->text : "");
         }
 
-        printf ("</setTextVector>\n");
-        setlocale(LC_NUMERIC,orig);
-        fflush (stdout);
+        outBufPuts (ob, "</setTextVector>\n");
 
-        pthread_mutex_unlock(&stdout_mutex);
+        msgPublish (ob, tvp, INDI_TEXT, tvp->s, fmt != NULL);
 }
 
 /* tell client to update an existing numeric vector property */
 void
 IDSetNumber (const INumberVectorProperty *nvp, const char *fmt, ...)
 {
+        va_list ap;
         int i;
 
-        pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<setNumberVector\n");
-        printf ("  device='%s'\n", nvp->device);
-        printf ("  name='%s'\n", nvp->name);
-        printf ("  state='%s'\n", pstateStr(nvp->s));
-        printf ("  timeout='%g'\n", nvp->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
-        }
-        printf (">\n");
+        OutBuf *ob = msgStart ("setNumberVector", nvp->device, nvp->name);
+        msgAttr (ob, "\n  state='", pstateStr(nvp->s));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, nvp->timeout, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < nvp->nnp; i++) {
             INumber *np = &nvp->np[i];
-            printf ("  <oneNumber name='%s'>\n", np->name);
-            printf ("      %.20g\n", np->value);
-            printf ("  </oneNumber>\n");
+            msgAttr (ob, "  <oneNumber name='", np->name);
+            outBufPuts (ob, ">\n      ");
+            outBufDouble (ob, np->value);
+            outBufPuts (ob, "\n  </oneNumber>\n");
         }
 
-        printf ("</setNumberVector>\n");
-        setlocale(LC_NUMERIC,orig);
-        fflush (stdout);
+        outBufPuts (ob, "</setNumberVector>\n");
 
-        pthread_mutex_unlock(&stdout_mutex);
+        msgPublish (ob, nvp, INDI_NUMBER, nvp->s, fmt != NULL);
 }
 
 /* tell client to update an existing switch vector property */
 void
 IDSetSwitch (const ISwitchVectorProperty *svp, const char *fmt, ...)
 {
+        va_list ap;
         int i;
 
-        pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        char *orig = setlocale(LC_NUMERIC,"C");
-        printf ("<setSwitchVector\n");
-        printf ("  device='%s'\n", svp->device);
-        printf ("  name='%s'\n", svp->name);
-        printf ("  state='%s'\n", pstateStr(svp->s));
-        printf ("  timeout='%g'\n", svp->timeout);
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
-        }
-        printf (">\n");
+        OutBuf *ob = msgStart ("setSwitchVector", svp->device, svp->name);
+        msgAttr (ob, "\n  state='", pstateStr(svp->s));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, svp->timeout, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < svp->nsp; i++) {
             ISwitch *sp = &svp->sp[i];
-            printf ("  <oneSwitch name='%s'>\n", sp->name);
-            printf ("      %s\n", sstateStr(sp->s));
-            printf ("  </oneSwitch>\n");
+            msgElement (ob, "oneSwitch", sp->name, sstateStr(sp->s));
         }
 
-        printf ("</setSwitchVector>\n");
-        setlocale(LC_NUMERIC,orig);
-       fflush (stdout);
+        outBufPuts (ob, "</setSwitchVector>\n");
 
-       pthread_mutex_unlock(&stdout_mutex);
+        msgPublish (ob, svp, INDI_SWITCH, svp->s, fmt != NULL);
 }
 
 /* tell client to update an existing lights vector property */
 void
 IDSetLight (const ILightVectorProperty *lvp, const char *fmt, ...)
 {
+        va_list ap;
         int i;
 
-        pthread_mutex_lock(&stdout_mutex);
-
-        xmlv1();
-        printf ("<setLightVector\n");
-        printf ("  device='%s'\n", lvp->device);
-        printf ("  name='%s'\n", lvp->name);
-        printf ("  state='%s'\n", pstateStr(lvp->s));
-        printf ("  timestamp='%s'\n", timestamp());
-        if (fmt) {
-            va_list ap;
-            va_start (ap, fmt);
-            printf ("  message='");
-            vprintf (fmt, ap);
-            printf ("'\n");
-            va_end (ap);
-        }
-        printf (">\n");
+        OutBuf *ob = msgStart ("setLightVector", lvp->device, lvp->name);
+        msgAttr (ob, "\n  state='", pstateStr(lvp->s));
+        va_start (ap, fmt);
+        msgHeadEnd (ob, -1, fmt, ap);
+        va_end (ap);
 
         for (i = 0; i < lvp->nlp; i++) {
             ILight *lp = &lvp->lp[i];
-            printf ("  <oneLight name='%s'>\n", lp->name);
-            printf ("      %s\n", pstateStr(lp->s));
-            printf ("  </oneLight>\n");
+            msgElement (ob, "oneLight", lp->name, pstateStr(lp->s));
         }
 
-        printf ("</setLightVector>\n");
-        fflush (stdout);
+        outBufPuts (ob, "</setLightVector>\n");
 
-        pthread_mutex_unlock(&stdout_mutex);
+        msgPublish (ob, lvp, INDI_LIGHT, lvp->s, fmt != NULL);
 }
 
-/* tell client to update an existing BLOB vector property */
-void
-IDSetBLOB (const IBLOBVectorProperty *bvp, const char *fmt, ...)
+/* write all n bytes at buf to fd, return 0 or -1 */
+static int
+writeAll (int fd, const void *buf, size_t n)
 {
-    int i;
-
-    pthread_mutex_lock(&stdout_mutex);
+    const char *p = (const char *) buf;
 
-    xmlv1();
-    char *orig = setlocale(LC_NUMERIC,"C");
-    printf ("<setBLOBVector\n");
-    printf ("  device='%s'\n", bvp->device);
-    printf ("  name='%s'\n", bvp->name);
-    printf ("  state='%s'\n", pstateStr(bvp->s));
-    printf ("  timeout='%g'\n", bvp->timeout);
-    printf ("  timestamp='%s'\n", timestamp());
-    if (fmt)
+    while (n > 0)
     {
-        va_list ap;
-        va_start (ap, fmt);
-        printf ("  message='");
-        vprintf (fmt, ap);
-        printf ("'\n");
-        va_end (ap);
+        ssize_t nw = write (fd, p, n);
+        if (nw < 0 && errno == EINTR)
+            continue;
+        if (nw <= 0)
+            return (-1);
+        p += nw;
+        n -= nw;
     }
-    printf (">\n");
-
-    for (i = 0; i < bvp->nbp; i++)
-    {
-        IBLOB *bp = &bvp->bp[i];
-        unsigned char *encblob;
-        int l;
+    return (0);
+}
 
-        printf ("  <oneBLOB\n");
-        printf ("    name='%s'\n", bp->name);
-        printf ("    size='%d'\n", bp->size);
-        //printf ("    format='%s'>\n", bp->format);
+/* write bp to fd as base64 in lines of 72, encoding BLOBCHUNK bytes at a
+ * time so no copy of the whole of it is ever made. return 0 or -1.
+ */
+#define BLOBCHUNK   (54*1024)           /* raw bytes encoded at once, 768 lines */
+static int
+writeBLOB (int fd, const IBLOB *bp)
+{
+    const unsigned char *blob = (const unsigned char *) bp->blob;
+    unsigned char *enc = malloc (4*BLOBCHUNK/3 + 4*BLOBCHUNK/3/72 + 8);
+    base64_stream st;
+    int i, n, ret = 0;
 
-        encblob = malloc (4*bp->bloblen/3+4);
-        l = to64frombits(encblob, bp->blob, bp->bloblen);
-        printf ("    enclen='%d'\n", l);
-        printf ("    format='%s'>\n", bp->format);
-        size_t written = 0;
-        size_t towrite = l;
-        while (written < l)
-        {
-            towrite = ((l - written) > 72) ? 72 : l - written;
-            size_t wr = fwrite(encblob + written, 1, towrite, stdout);
-            if (wr > 0) written += wr;
-            if ((written % 72) == 0)
-                fputc('\n', stdout);
-        }
+    if (!enc)
+        return (-1);
 
-        if ((written % 72) != 0)
-            fputc('\n', stdout);
+    to64init (&st, 72);
+    for (i = 0; ret == 0 && i < bp->bloblen; i += BLOBCHUNK)
+    {
+        n = to64update (&st, enc, blob + i,
+                        bp->bloblen - i < BLOBCHUNK ? bp->bloblen - i : BLOBCHUNK);
+        ret = writeAll (fd, enc, n);
+    }
+    if (ret == 0)
+    {
+        n = to64finish (&st, enc);
+        ret = writeAll (fd, enc, n);
+    }
 
-        free (encblob);
+    free (enc);
+    return (ret);
+}
 
-        printf ("  </oneBLOB>\n");
-    }
+/* tell client to update an existing BLOB vector property.
+ * each BLOB goes in a setBLOBVector of its own, encoded and written a chunk at
+ * a time without stdout_mutex: blobBusy keeps stdout ours meanwhile, and what
+ * other threads send is kept by pendKeep and goes between them.
+ * N.B. exit if stdout fails, as stdio would have with SIGPIPE: the server
+ *   is gone or will never make sense of what we have sent so far.
+ */
+void
+IDSetBLOB (const IBLOBVectorProperty *bvp, const char *fmt, ...)
+{
+    int i;
+    va_list ap;
 
-    printf ("</setBLOBVector>\n");
-    setlocale(LC_NUMERIC,orig);
+    pthread_mutex_lock(&stdout_mutex);
+    while (blobBusy)
+        pthread_cond_wait (&blobCond, &stdout_mutex);
+    blobBusy = 1;
+    blobThread = pthread_self();
     fflush (stdout);
-
     pthread_mutex_unlock(&stdout_mutex);
+
+    va_start (ap, fmt);
+    for (i = 0; i == 0 || i < bvp->nbp; i++)
+    {
+        IBLOB *bp = i < bvp->nbp ? &bvp->bp[i] : NULL;
+        OutBuf *ob = msgStart ("setBLOBVector", bvp->device, bvp->name);
+
+        msgAttr (ob, "\n  state='", pstateStr(bvp->s));
+        msgHeadEnd (ob, bvp->timeout, i == 0 ? fmt : NULL, ap);
+        if (bp)
+            outBufPrintf (ob, "  <oneBLOB\n    name='%s'\n    size='%d'\n"
+                          "    enclen='%d'\n    format='%s'>\n",
+                          bp->name, bp->size, 4*((bp->bloblen+2)/3), bp->format);
+
+        if (outBufWrite (ob, 1) < 0 || (bp && (writeBLOB (1, bp) < 0 ||
+                    writeAll (1, "  </oneBLOB>\n", 13) < 0)) ||
+                    writeAll (1, "</setBLOBVector>\n", 17) < 0)
+        {
+            fprintf (stderr, "%s: sending BLOB %s.%s.%s: %s\n", me, bvp->device,
+                     bvp->name, bp ? bp->name : "", strerror(errno));
+            exit(1);
+        }
+
+        /* what others sent meanwhile goes now, at a message boundary */
+        pthread_mutex_lock(&stdout_mutex);
+        pendFlush();
+        if (i + 1 >= bvp->nbp) {
+            blobBusy = 0;
+            pthread_cond_broadcast (&blobCond);
+        }
+        pthread_mutex_unlock(&stdout_mutex);
+    }
+    va_end (ap);
 }
 
 /* tell client to update min/max elements of an existing number vector property */
@@ -2011,31 +2856,24 @@ void IUUpdateMinMax(const INumberVectorProperty *nvp)
 {
   int i;
 
-  pthread_mutex_lock(&stdout_mutex);
-  xmlv1();
-  char *orig = setlocale(LC_NUMERIC,"C");
-  printf ("<setNumberVector\n");
-  printf ("  device='%s'\n", nvp->device);
-  printf ("  name='%s'\n", nvp->name);
-  printf ("  state='%s'\n", pstateStr(nvp->s));
-  printf ("  timeout='%g'\n", nvp->timeout);
-  printf ("  timestamp='%s'\n", timestamp());
-  printf (">\n");
+  OutBuf *ob = msgStart ("setNumberVector", nvp->device, nvp->name);
+  msgAttr (ob, "\n  state='", pstateStr(nvp->s));
+  outBufPrintf (ob, "\n  timeout='%g'\n  timestamp='", nvp->timeout);
+  outBufTimestamp (ob);
+  outBufPuts (ob, "'\n>\n");
 
   for (i = 0; i < nvp->nnp; i++) {
     INumber *np = &nvp->np[i];
-    printf ("  <oneNumber name='%s'\n", np->name);
-    printf ("    min='%g'\n", np->min);
-    printf ("    max='%g'\n", np->max);
-    printf ("    step='%g'\n", np->step);
-    printf(">\n");
-    printf ("      %g\n", np->value);
-    printf ("  </oneNumber>\n");
+    msgAttr (ob, "  <oneNumber name='", np->name);
+    outBufPrintf (ob, "\n    min='%g'\n    max='%g'\n    step='%g'\n>\n      %g\n",
+                  np->min, np->max, np->step, np->value);
+    outBufPuts (ob, "  </oneNumber>\n");
   }
 
-  printf ("</setNumberVector>\n");
-  setlocale(LC_NUMERIC,orig);
-  fflush (stdout);
+  outBufPuts (ob, "</setNumberVector>\n");
+
+  pthread_mutex_lock(&stdout_mutex);
+  msgSend (ob);
   pthread_mutex_unlock(&stdout_mutex);
 }
 
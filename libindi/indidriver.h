@@ -101,6 +101,21 @@ extern FILE * IUGetConfigFP(const char *filename, const char *dev, char errmsg[]
 */
 extern int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[]);
 
+/** \brief Saves a configuration file.
+
+  The file is written to a temporary file in the same directory, which then replaces the configuration file, so the old contents
+  are kept whole if writing fails. A symbolic link is followed and the file it points to replaced, keeping its permissions. The
+  new contents are cached for IUReadConfig() once written.
+    \param filename full path of the configuration file. If set, the function will save to it.
+           If set to NULL, it will attempt to generate the filename as described in the <b>Detailed Description</b> introduction and then save to it.
+    \param dev device name. This is used if the filename parameter is NULL, and INDICONFIG environment variable is not set as described in the <b>Detailed Description</b> introduction.
+    \param data the whole configuration file, from \<INDIDriver\> to \</INDIDriver\>.
+    \param len bytes in data.
+    \param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+    \return 0 once the file is written, -1 if there is an error and errmsg is set.
+*/
+extern int IUWriteConfig(const char *filename, const char *dev, const char *data, size_t len, char errmsg[]);
+
 /** \brief Copies an existing configuration file into a default configuration file.
 
   If no <i>default</i> configuration file for the supplied <i>dev</i> exists, it gets created and its contentes copied from an exiting source configuration file.
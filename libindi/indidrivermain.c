@@ -91,6 +91,7 @@ main (int ac, char *av[])
 
 	/* init */
 	clixml =  newLilXML();
+	arenaLilXML (clixml, 1);
 	addCallback (0, clientMsgCB, NULL);
 
 	/* service client */
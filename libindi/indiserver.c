@@ -38,7 +38,21 @@
  * one client or device, they are queued and only removed after the last
  * consumer is finished. XMLEle are converted to linear strings before being
  * sent to optimize write system calls and avoid blocking to slow clients.
+ * Message content comes from small pools of size-classed buffers, and each
+ * write gathers several queued messages into one writev().
+ * setBLOBVector from drivers is never parsed into XMLEle: only its start tag
+ * is read for routing and the raw bytes become the message as they are.
  * Clients that get more than maxqsiz bytes behind are shut down.
+ * On Linux all fds are nonblocking and serviced by an edge-triggered epoll
+ * loop, so each wakeup only costs as much as the fds that are actually ready.
+ * Building with INDI_SERVER_SELECT restores the classic select() loop.
+ * With epoll, -t hands all writing to clients to a pool of I/O threads. The
+ *   main thread keeps reading and routing, so there is no locking anywhere:
+ *   Msgs go to the worker owning each client through a lock-free ring and
+ *   come back the same way to be counted and freed.
+ *   This is off by default: one thread keeps up with a few clients easily,
+ *   and workers only pay off when fan-out to many BLOB clients saturates a
+ *   core. Measure with tools/benchINDIserver.c before turning it on.
  */
 
 #include "config.h"
@@ -48,6 +62,7 @@
 #include <stdarg.h>
 #include <signal.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
@@ -56,9 +71,17 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#ifdef WITH_EPOLL
+#include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 #include "lilxml.h"
 #include "indiapi.h"
@@ -69,8 +92,14 @@
 #define MAXSBUF         512
 #define	MAXRBUF         49152	/* max read buffering here */
 #define	MAXWSIZ         49152	/* max bytes/write */
+#define	MAXIOV          64	/* max queued Msgs gathered per writev */
+#define	MAXPOOLED       64	/* max idle Msg buffers kept per size class */
+#define	MAXFRAME        (1024*1024*1024) /* max bytes of one raw setBLOBVector */
 #define	DEFMAXQSIZ      128		/* default max q behind, MB */
 #define DEFMAXRESTART   10      /* default max restarts */
+#ifdef WITH_EPOLL
+#define MAXEPEVENTS     64      /* max events reported per epoll_wait */
+#endif
 
 #ifdef OSX_EMBEDED_MODE
 #define LOGNAME "/Users/%s/Library/Logs/indiserver.log"
@@ -82,10 +111,24 @@
 typedef struct {
     int count;				/* number of consumers left */
     unsigned long cl;			/* content length */
-    char *cp;				/* content: buf or malloced */
-    char buf[MAXWSIZ];		/* local buf for most messages */
+    char *cp;				/* content: pooled or malloced */
+    int pool;				/* msgpool[] class of cp, or -1 */
+    char dev[MAXINDIDEVICE];		/* device and name of a set*Vector */
+    char name[MAXINDINAME];		/*   other than BLOBs, else "" */
+    char *key;				/* malloced state and element names if a
+					 * later update like it may make this
+					 * one stale, else NULL */
 } Msg;
 
+/* idle content buffers of one size class, recycled by freeMsg() */
+typedef struct {
+    char *free[MAXPOOLED];		/* stack of idle buffers */
+    int nfree;				/* n entries in free[] */
+} MsgPool;
+#define	NMSGPOOLS       5		/* n size classes */
+static const unsigned long msgpoolsz[NMSGPOOLS] = {256, 1024, 4096, 16384, 65536};
+static MsgPool msgpool[NMSGPOOLS];
+
 /* BLOB handling, NEVER is the default */
 typedef enum {B_NEVER=0, B_ALSO, B_ONLY} BLOBHandling;
 
@@ -121,11 +164,42 @@ typedef struct {
     int s;				/* socket for this client */
     LilXML *lp;				/* XML parsing context */
     FQ *msgq;				/* Msg queue */
+    unsigned long qbytes;		/* content bytes of all Msgs on msgq */
+    unsigned long compactat;		/* drop stale Msgs if qbytes exceeds */
     unsigned int nsent;				/* bytes of current Msg sent so far */
+    unsigned int mark;			/* routegen when last visited */
+#ifdef WITH_EPOLL
+    int worker;				/* workers[] writing to us, or -1 */
+#endif
 } ClInfo;
 static ClInfo *clinfo;			/*  malloced pool of clients */
 static int nclinfo;			/* n total (not active) */
 
+/* where we are in the top-level elements of a driver stream */
+typedef enum {
+    FR_TOP = 0,				/* between elements */
+    FR_TAG,				/* reading root tag, held in tag[] */
+    FR_STAG,				/* in start tag of a lilxml root */
+    FR_BODY,				/* in body of a lilxml root */
+    FR_BSTAG,				/* in start tag of a raw setBLOBVector */
+    FR_BBODY				/* in body of a raw setBLOBVector */
+} FrameState;
+
+/* framing of a driver stream so setBLOBVector can bypass lilxml */
+typedef struct {
+    FrameState state;
+    char tag[MAXINDINAME];		/* '<' and root tag name */
+    int ntag;				/* chars in tag[] */
+    int quote;				/* open quote in start tag, else 0 */
+    int comment;			/* start tag is a <!-- comment --> */
+    int lastc, lastc2;			/* previous two chars in start tag */
+    int nclose;				/* chars of "</tag" matched so far */
+    char *raw;				/* malloced raw setBLOBVector */
+    int nraw;				/* bytes used in raw */
+    int mraw;				/* bytes malloced in raw */
+    int nstag;				/* length of its start tag */
+} DvrFrame;
+
 /* info for each connected driver */
 typedef struct {
     char name[MAXINDINAME];		/* persistent name */
@@ -145,20 +219,125 @@ typedef struct {
     int efd;				/* stderr from driver, if local */
     int restarts;			/* times process has been restarted */
     LilXML *lp;				/* XML parsing context */
+    DvrFrame fr;			/* raw BLOB framing */
     FQ *msgq;				/* Msg queue */
+    unsigned long qbytes;		/* content bytes of all Msgs on msgq */
     unsigned int nsent;			/* bytes of current Msg sent so far */
+    unsigned int mark;			/* routegen when last visited */
 } DvrInfo;
 static DvrInfo *dvrinfo;		/* malloced array of drivers */
 static int ndvrinfo;			/* n total */
 
+/* subscription routing index: for each dev/name (name "" for all of dev)
+ * the clients, snooping drivers and responsible drivers to consider, so
+ * q2*() need not scan every client and driver for each message.
+ */
+typedef enum {RT_CL=0, RT_SD, RT_RD, NRTKINDS} RouteKind;
+typedef struct {
+    int slot;				/* clinfo[] or dvrinfo[] index */
+    int prop;				/* its props[] or sprops[] index */
+} RouteRef;
+typedef struct _Route {
+    struct _Route *next;		/* hash chain */
+    unsigned int hash;			/* hashDevName(dev,name) */
+    char dev[MAXINDIDEVICE];
+    char name[MAXINDINAME];
+    RouteRef *refs[NRTKINDS];		/* malloced, by RouteKind */
+    int nrefs[NRTKINDS];		/* n entries in each refs[] */
+} Route;
+static Route **routes;			/* malloced hash buckets */
+static int nbuckets;			/* n buckets, power of 2 */
+static int nroutes;			/* n Routes in all buckets */
+static RouteRef *allcl;			/* clients with allprops set */
+static int nallcl;			/* n entries in allcl[] */
+static unsigned int routegen;		/* stamp to visit each slot once */
+
+#ifdef WITH_EPOLL
+/* optional I/O workers that write to clients on their own threads.
+ * the main thread still reads everything and routes each Msg, then hands
+ * it to the worker owning the client through a lock-free ring. Msgs come
+ * back the same way once written so counts and pools stay single threaded.
+ * each client's Msgs keep their order since one worker writes them all.
+ */
+#define	MAXWORKERS      64	/* max -t */
+#define	WRINGSIZ        4096	/* entries per ring, power of 2 */
+typedef enum {
+    WK_ADD=0,				/* to worker: new client fd */
+    WK_MSG,				/* to worker: queue mp for fd */
+    WK_DEL,				/* to worker: forget fd, drop its q */
+    WK_DONE,				/* from worker: fd is finished with mp */
+    WK_CLOSED,				/* from worker: fd may now be closed */
+    WK_FAIL				/* from worker: it stopped, fd is errno */
+} WkOp;
+typedef struct {
+    int op;				/* WkOp */
+    int fd;				/* client socket */
+    int slot;				/* its clinfo[] index */
+    Msg *mp;				/* for WK_MSG and WK_DONE */
+} WkCmd;
+
+/* single producer, single consumer ring */
+typedef struct {
+    WkCmd cmd[WRINGSIZ];
+    unsigned int head;			/* next to fill, stored by producer */
+    unsigned int tail;			/* next to take, stored by consumer */
+} WkRing;
+
+/* a client as seen by the worker writing to it */
+typedef struct {
+    FQ *msgq;				/* Msg queue, NULL if fd not ours */
+    int slot;				/* clinfo[] index */
+    unsigned long qbytes;		/* content bytes of all Msgs on msgq */
+    unsigned long compactat;		/* drop stale Msgs if qbytes exceeds */
+    unsigned int nsent;			/* bytes of current Msg sent so far */
+    int blocked;			/* socket full, wait for EPOLLOUT */
+    int dead;				/* write failed, just drop Msgs */
+    int fd;				/* client socket */
+    struct _Worker *wp;			/* worker this belongs to */
+} WkConn;
+
+typedef struct _Worker {
+    pthread_t tid;
+    int epfd;				/* epoll of our sockets and tofd */
+    int tofd;				/* eventfd, main to worker */
+    int fromfd;				/* eventfd, worker to main */
+    WkRing to;				/* main to worker */
+    WkRing from;			/* worker to main */
+    int kick;				/* main: to has news for worker */
+    int nclients;			/* main: clients given to worker */
+    WkConn *conns;			/* worker: indexed by fd */
+    int nconns;				/* worker: n entries in conns[] */
+    int posted;				/* worker: from has news for main */
+    char ts[64];			/* worker: indi_tstamp() buffer */
+} Worker;
+static Worker *workers;			/* malloced array of nworkers */
+static int nworkers;			/* -t, 0 to write from main thread */
+static int *staged;			/* clinfo[] with Msgs to hand over */
+static int nstaged, mstaged;		/* n used and malloced in staged[] */
+#endif
+
 static char *me;			/* our name */
 static int port = INDIPORT;		/* public INDI port */
 static int verbose;			/* chattiness */
 static int lsocket;			/* listen socket */
 static char *ldir;			/* where to log driver messages */
 static int maxqsiz = (DEFMAXQSIZ*1024*1024); /* kill if these bytes behind */
+static unsigned long hiwater;		/* drop stale updates past this behind */
+static unsigned long lowater;		/* until drained below this again */
 static int maxrestarts = DEFMAXRESTART;
 static int terminateddrv = 0;
+#ifdef WITH_EPOLL
+static int epfd = -1;			/* epoll instance watching all our fds */
+
+/* kinds of fds we register with epoll. data.u64 packs kind, slot index and
+ * fd so events for slots recycled earlier in the same batch can be detected.
+ */
+typedef enum {EP_LISTEN=0, EP_FIFO, EP_CLIENT, EP_DRIVER, EP_DRIVERERR, EP_WORKER} EPKind;
+#define EPDATA(k,i,fd)  (((uint64_t)(uint32_t)(fd)<<32) | ((uint64_t)(i)<<8) | (uint64_t)(k))
+#define EPKIND(d)       ((int)((d) & 0xff))
+#define EPSLOT(d)       ((int)(((d) >> 8) & 0xffffff))
+#define EPFD(d)         ((int)((d) >> 32))
+#endif
 
 static void logStartup(int ac, char *av[]);
 static void usage (void);
@@ -169,7 +348,7 @@ static void indiFIFO(void);
 static void indiRun (void);
 static void indiListen (void);
 static void newFIFO(void);
-static void newClient (void);
+static int newClient (void);
 static int newClSocket (void);
 static void shutdownClient (ClInfo *cp);
 static int readFromClient (ClInfo *cp);
@@ -184,20 +363,71 @@ static void q2SDrivers (int isblob, const char *dev, const char *name, Msg *mp,
     XMLEle *root);
 static int q2Clients (ClInfo *notme, int isblob, const char *dev, const char *name,
     Msg *mp, XMLEle *root);
+static void q2Client (ClInfo *cp, ClInfo *notme, int isblob, Property *pp,
+    Msg *mp, XMLEle *root, ClInfo ***slow, int *nslow);
 static int q2Servers (ClInfo *notme, Msg *mp, XMLEle *root);
+static Route *findRoute (const char *dev, const char *name, int create);
+static void addRouteRef (const char *dev, const char *name, int kind, int slot,
+    int prop);
+static void rmRouteRef (const char *dev, const char *name, int kind, int slot);
+static void pushRef (RouteRef **refs, int *nrefs, int slot, int prop);
+static void pullRef (RouteRef *refs, int *nrefs, int slot);
 static void addSDevice (DvrInfo *dp, const char *dev, const char *name);
 static Property *findSDevice (DvrInfo *dp, const char *dev, const char *name);
 static void addClDevice (ClInfo *cp, const char *dev, const char *name, int isblob);
 static int findClDevice (ClInfo *cp, const char *dev, const char *name);
+static Property *findClProp (ClInfo *cp, const char *dev, const char *name);
 static int readFromDriver (DvrInfo *dp);
+static int xmlFromDriver (DvrInfo *dp, char *buf, int nr);
+static int rawBLOBFromDriver (DvrInfo *dp);
+static int routeDvrMsg (DvrInfo *dp, XMLEle *root, DvrFrame *fr);
+static void traceDvrMsg (DvrInfo *dp, XMLEle *root);
+static int appendFrame (DvrFrame *fr, const char *buf, int n);
+static int closeTagChar (DvrFrame *fr, int k);
+static int matchCloseTag (DvrFrame *fr, int c);
+static int badFrame (DvrInfo *dp, const char *why);
+static void resetFrame (DvrFrame *fr);
 static int stderrFromDriver (DvrInfo *dp);
-static int msgQSize (FQ *q);
+static int compactMsgQ (FQ *q, unsigned int nsent, unsigned long *qbytes,
+    void (*retire)(Msg *mp, void *arg), void *arg);
+static int keepMsg (void *e, int i, void *arg);
+static unsigned int hashDevName (const char *dev, const char *name);
+static char *msgKey (XMLEle *root);
 static void setMsgXMLEle (Msg *mp, XMLEle *root);
 static void setMsgStr (Msg *mp, char *str);
+static void setMsgFrame (Msg *mp, DvrFrame *fr);
+static void allocMsgBuf (Msg *mp);
 static void freeMsg (Msg *mp);
 static Msg *newMsg (void);
+static Msg *newXMLMsg (XMLEle *root);
+static int gatherMsgQ (FQ *q, unsigned int nsent, struct iovec iov[MAXIOV]);
+static void consumeMsgQ (FQ *q, unsigned int *nsent, unsigned long *qbytes,
+    size_t nw, void (*retire)(Msg *mp, void *arg), void *arg);
+static void releaseMsg (Msg *mp, void *arg);
 static int sendClientMsg (ClInfo *cp);
 static int sendDriverMsg (DvrInfo *cp);
+static void pushClMsg (ClInfo *cp, Msg *mp);
+static void pushDvrMsg (DvrInfo *dp, Msg *mp);
+#ifdef WITH_EPOLL
+static void setNonBlock (int fd);
+static void watchFd (int op, int fd, uint32_t events, int kind, int slot);
+static void unwatchFd (int fd);
+static void watchClient (ClInfo *cp, int op);
+static void watchDvr (DvrInfo *dp, int op);
+static void startWorkers (void);
+static int ringPut (WkRing *r, const WkCmd *cmd);
+static int ringGet (WkRing *r, WkCmd *cmd);
+static void wakeFd (int fd);
+static void wkPost (Worker *wp, int op, int fd, int slot, Msg *mp);
+static void kickWorkers (void);
+static void reapWorker (Worker *wp);
+static void wkReply (Worker *wp, int op, int fd, int slot, Msg *mp);
+static void wkRetire (Msg *mp, void *arg);
+static void wkDropQ (WkConn *wc);
+static void wkCommand (Worker *wp, WkCmd *cmd);
+static void wkSend (WkConn *wc);
+static void *workerMain (void *arg);
+#endif
 static void crackBLOB (const char *enableBLOB, BLOBHandling *bp);
 static void crackBLOBHandling(const char *dev, const char *name, const char *enableBLOB, ClInfo *cp);
 static void traceMsg (XMLEle *root);
@@ -276,6 +506,18 @@ main (int ac, char *av[])
                     maxrestarts=0;
                 ac--;
                 break;
+#ifdef WITH_EPOLL
+            case 't':
+                if (ac < 2) {
+                    fprintf (stderr, "-t requires number of I/O threads\n");
+                    usage();
+                }
+                nworkers = atoi(*++av);
+                if (nworkers < 0 || nworkers > MAXWORKERS)
+                    usage();
+                ac--;
+                break;
+#endif
             case 'v':
                 verbose++;
                 break;
@@ -290,11 +532,29 @@ main (int ac, char *av[])
     if (ac == 0 && !fifo.name)
         usage();
 
+    /* congested clients start dropping stale updates halfway to maxqsiz */
+    hiwater = maxqsiz/2;
+    lowater = maxqsiz/8;
+
     /* take care of some unixisms */
     /*noZombies();*/
     reapZombies();
     noSIGPIPE();
 
+#ifdef WITH_EPOLL
+    /* one epoll instance for everything, drivers register as they start */
+    epfd = epoll_create1 (EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        fprintf (stderr, "%s: epoll_create1: %s\n", indi_tstamp(NULL),
+                                strerror(errno));
+        Bye();
+    }
+
+    /* optional threads to write to clients */
+    if (nworkers > 0)
+        startWorkers();
+#endif
+
     /* realloc seed for client pool */
     clinfo = (ClInfo *) malloc (1);
     nclinfo = 0;
@@ -346,8 +606,13 @@ usage(void)
     fprintf (stderr, "Options:\n");
         fprintf (stderr, " -l d     : log driver messages to <d>/YYYY-MM-DD.islog\n");
         fprintf (stderr, " -m m     : kill client if gets more than this many MB behind, default %d\n", DEFMAXQSIZ);
+        fprintf (stderr, "            stale updates are dropped once a client is m/2 MB behind\n");
         fprintf (stderr, " -p p     : alternate IP port, default %d\n", INDIPORT);
         fprintf (stderr, " -r r     : maximum driver restarts on error, default %d\n", DEFMAXRESTART);
+#ifdef WITH_EPOLL
+        fprintf (stderr, " -t n     : write to clients from n I/O threads, default 0 (all in one)\n");
+        fprintf (stderr, "            only worth it with many clients taking heavy BLOB traffic\n");
+#endif
         fprintf (stderr, " -f path  : Path to fifo for dynamic startup and shutdown of drivers.\n");
         fprintf (stderr, " -v       : show key events, no traffic\n");
         fprintf (stderr, " -vv      : -v + key message content\n");
@@ -553,7 +818,10 @@ startLocalDvr (DvrInfo *dp)
     dp->wfd = wp[1];
     dp->efd = ep[0];
     dp->lp = newLilXML();
+    arenaLilXML (dp->lp, 1);
+    memset (&dp->fr, 0, sizeof(dp->fr));
     dp->msgq = newFQ(1);
+    dp->qbytes = 0;
     dp->sprops = (Property*) malloc (1);	/* seed for realloc */
     dp->nsprops = 0;
     dp->nsent = 0;
@@ -561,14 +829,21 @@ startLocalDvr (DvrInfo *dp)
     dp->ndev = 0;
     dp->dev = (char **) malloc(sizeof(char *));
 
+#ifdef WITH_EPOLL
+    setNonBlock (dp->rfd);
+    setNonBlock (dp->wfd);
+    setNonBlock (dp->efd);
+    watchDvr (dp, EPOLL_CTL_ADD);
+#endif
+
     /* first message primes driver to report its properties -- dev known
      * if restarting
      */
     mp = newMsg();
-    pushFQ (dp->msgq, mp);
     sprintf (buf, "<getProperties version='%g'/>\n", INDIV);
     setMsgStr (mp, buf);
     mp->count++;
+    pushDvrMsg (dp, mp);
 
     if (verbose > 0)
         fprintf (stderr, "%s: Driver %s: pid=%d rfd=%d wfd=%d efd=%d\n",
@@ -602,7 +877,10 @@ startRemoteDvr (DvrInfo *dp)
     dp->rfd = sockfd;
     dp->wfd = sockfd;
     dp->lp = newLilXML();
+    arenaLilXML (dp->lp, 1);
+    memset (&dp->fr, 0, sizeof(dp->fr));
     dp->msgq = newFQ(1);
+    dp->qbytes = 0;
     dp->sprops = (Property*) malloc (1);	/* seed for realloc */
     dp->nsprops = 0;
     dp->nsent = 0;
@@ -616,16 +894,22 @@ startRemoteDvr (DvrInfo *dp)
     dp->dev[0] = (char *) malloc(MAXINDIDEVICE * sizeof(char));
     strncpy (dp->dev[0], dev, MAXINDIDEVICE-1);
     dp->dev[0][MAXINDIDEVICE-1] = '\0';
+    addRouteRef (dp->dev[0], "", RT_RD, dp - dvrinfo, 0);
+
+#ifdef WITH_EPOLL
+    setNonBlock (sockfd);
+    watchDvr (dp, EPOLL_CTL_ADD);
+#endif
 
     /* Sending getProperties with device lets remote server limit its
      * outbound (and our inbound) traffic on this socket to this device.
      */
     mp = newMsg();
-    pushFQ (dp->msgq, mp);
     sprintf (buf, "<getProperties device='%s' version='%g'/>\n",
              dp->dev[0], INDIV);
     setMsgStr (mp, buf);
     mp->count++;
+    pushDvrMsg (dp, mp);
 
     if (verbose > 0)
         fprintf (stderr, "%s: Driver %s: socket=%d\n", indi_tstamp(NULL),
@@ -713,6 +997,11 @@ indiListen ()
 
     /* ok */
     lsocket = sfd;
+#ifdef WITH_EPOLL
+    /* accept()s are drained until EAGAIN on each edge */
+    setNonBlock (sfd);
+    watchFd (EPOLL_CTL_ADD, sfd, EPOLLIN|EPOLLET, EP_LISTEN, 0);
+#endif
     if (verbose > 0)
         fprintf (stderr, "%s: listening to port %d on fd %d\n",
                             indi_tstamp(NULL), port, sfd);
@@ -721,6 +1010,10 @@ indiListen ()
 /* Attempt to open up FIFO */
 static void indiFIFO(void)
 {
+#ifdef WITH_EPOLL
+    if (fifo.fd >= 0)
+        unwatchFd (fifo.fd);
+#endif
     close(fifo.fd);
     fifo.fd=-1;
 
@@ -734,181 +1027,776 @@ static void indiFIFO(void)
            fprintf(stderr, "%s: open(%s): %s.\n", indi_tstamp(NULL), fifo.name, strerror(errno));
            Bye();
        }
+#ifdef WITH_EPOLL
+       watchFd (EPOLL_CTL_ADD, fifo.fd, EPOLLIN|EPOLLET, EP_FIFO, 0);
+#endif
     }
 
 }
 
-/* service traffic from clients and drivers */
+#ifdef WITH_EPOLL
+/* service traffic from clients and drivers.
+ * all registrations are edge-triggered so each handler drains its fd until
+ * it would block. events are tagged with slot and fd, any event whose slot
+ * was shut down or recycled earlier in this batch is simply skipped.
+ */
 static void
 indiRun(void)
 {
-    fd_set rs, ws;
-        int maxfd=0;
-    int i, s;
+    struct epoll_event evs[MAXEPEVENTS];
+    int i, n;
 
-    /* init with no writers or readers */
-    FD_ZERO(&ws);
-    FD_ZERO(&rs);
+    /* wait for action */
+    n = epoll_wait (epfd, evs, MAXEPEVENTS, -1);
+    if (n < 0) {
+        if (errno == EINTR)
+            return;
+        fprintf (stderr, "%s: epoll_wait: %s\n", indi_tstamp(NULL),
+                                strerror(errno));
+        Bye();
+    }
 
-        if (fifo.name && fifo.fd >=0)
-        {
-           FD_SET(fifo.fd, &rs);
-           maxfd = fifo.fd;
+    for (i = 0; i < n; i++) {
+        uint64_t d = evs[i].data.u64;
+        uint32_t ev = evs[i].events;
+        int fd = EPFD(d);
+        int slot = EPSLOT(d);
+
+        switch (EPKIND(d)) {
+        case EP_LISTEN:
+            /* new clients? */
+            while (newClient() == 0)
+                continue;
+            break;
+
+        case EP_FIFO:
+            /* new command from FIFO? */
+            if (fifo.fd == fd)
+                newFIFO();
+            break;
+
+        case EP_CLIENT: {
+            /* message to/from client? */
+            ClInfo *cp;
+
+            if (slot >= nclinfo)
+                break;
+            cp = &clinfo[slot];
+            if (ev & (EPOLLIN|EPOLLHUP|EPOLLERR))
+                while (cp->active && cp->s == fd && readFromClient(cp) != 0)
+                    continue;
+            if (ev & EPOLLOUT)
+                while (cp->active && cp->s == fd && nFQ(cp->msgq) > 0 &&
+                                                    sendClientMsg(cp) > 0)
+                    continue;
+            break;
         }
 
-    /* always listen for new clients */
-    FD_SET(lsocket, &rs);
-        if (lsocket > maxfd)
-                maxfd = lsocket;
+        case EP_DRIVER: {
+            /* message to/from driver? rfd and wfd are the same if remote */
+            DvrInfo *dp;
 
-    /* add all client readers and client writers with work to send */
-    for (i = 0; i < nclinfo; i++) {
-        ClInfo *cp = &clinfo[i];
-        if (cp->active) {
-        FD_SET(cp->s, &rs);
-        if (nFQ(cp->msgq) > 0)
-            FD_SET(cp->s, &ws);
-        if (cp->s > maxfd)
-            maxfd = cp->s;
+            if (slot >= ndvrinfo)
+                break;
+            dp = &dvrinfo[slot];
+            if (ev & (EPOLLIN|EPOLLHUP|EPOLLERR))
+                while (dp->active && dp->rfd == fd && readFromDriver(dp) != 0)
+                    continue;
+            if (ev & (EPOLLOUT|EPOLLERR))
+                while (dp->active && dp->wfd == fd && nFQ(dp->msgq) > 0 &&
+                                                    sendDriverMsg(dp) > 0)
+                    continue;
+            break;
         }
-    }
 
-    /* add all driver readers and driver writers with work to send */
-        for (i = 0; i < ndvrinfo; i++)
-        {
-        DvrInfo *dp = &dvrinfo[i];
-            if (dp->active)
-            {
-                FD_SET(dp->rfd, &rs);
-                if (dp->rfd > maxfd)
-                   maxfd = dp->rfd;
-                if (dp->pid != REMOTEDVR)
-                {
-                   FD_SET(dp->efd, &rs);
-                   if (dp->efd > maxfd)
-                      maxfd = dp->efd;
-                }
-                if (nFQ(dp->msgq) > 0)
-                {
-                   FD_SET(dp->wfd, &ws);
-                   if (dp->wfd > maxfd)
-                       maxfd = dp->wfd;
-                }
-            }
+        case EP_WORKER:
+            /* Msgs a worker has finished with? */
+            if (slot < nworkers)
+                reapWorker (&workers[slot]);
+            break;
+
+        case EP_DRIVERERR: {
+            /* driver chatter on stderr? */
+            DvrInfo *dp;
+
+            if (slot >= ndvrinfo)
+                break;
+            dp = &dvrinfo[slot];
+            while (dp->active && dp->pid != REMOTEDVR && dp->efd == fd &&
+                                                stderrFromDriver(dp) > 0)
+                continue;
+            break;
+        }
+        }
     }
 
-    /* wait for action */
-    s = select (maxfd+1, &rs, &ws, NULL, NULL);
-    if (s < 0) {
-        fprintf (stderr, "%s: select(%d): %s\n", indi_tstamp(NULL), maxfd+1,
+    /* let workers at whatever this batch handed them */
+    kickWorkers();
+}
+
+/* make fd nonblocking or exit */
+static void
+setNonBlock (int fd)
+{
+    int flags = fcntl (fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        fprintf (stderr, "%s: fcntl(%d): %s\n", indi_tstamp(NULL), fd,
                                 strerror(errno));
         Bye();
     }
+}
 
+/* add or modify the epoll registration of fd, tagged with kind and slot.
+ * exit if trouble.
+ */
+static void
+watchFd (int op, int fd, uint32_t events, int kind, int slot)
+{
+    struct epoll_event ev;
 
-        /* new command from FIFO? */
-        if (s > 0 && fifo.fd >= 0 && FD_ISSET(fifo.fd, &rs))
-        {
-            newFIFO();
-            s--;
-        }
-
-    /* new client? */
-    if (s > 0 && FD_ISSET(lsocket, &rs)) {
-        newClient();
-        s--;
+    memset (&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = EPDATA(kind, slot, fd);
+    if (epoll_ctl (epfd, op, fd, &ev) < 0) {
+        fprintf (stderr, "%s: epoll_ctl(%d): %s\n", indi_tstamp(NULL), fd,
+                                strerror(errno));
+        Bye();
     }
+}
 
-    /* message to/from client? */
-    for (i = 0; s > 0 && i < nclinfo; i++) {
-        ClInfo *cp = &clinfo[i];
-        if (cp->active) {
-        if (FD_ISSET(cp->s, &rs)) {
-            if (readFromClient(cp) < 0)
-            return;	/* fds effected */
-            s--;
-        }
-        if (s > 0 && FD_ISSET(cp->s, &ws)) {
-            if (sendClientMsg(cp) < 0)
-            return;	/* fds effected */
-            s--;
-        }
-        }
-    }
+/* forget fd before it is closed. benign if it was never registered. */
+static void
+unwatchFd (int fd)
+{
+    struct epoll_event ev;
 
-    /* message to/from driver? */
-    for (i = 0; s > 0 && i < ndvrinfo; i++) {
-        DvrInfo *dp = &dvrinfo[i];
-        if (dp->pid != REMOTEDVR && FD_ISSET(dp->efd, &rs)) {
-        if (stderrFromDriver(dp) < 0)
-            return;	/* fds effected */
-        s--;
-        }
-        if (s > 0 && FD_ISSET(dp->rfd, &rs)) {
-        if (readFromDriver(dp) < 0)
-            return;	/* fds effected */
-        s--;
-        }
-        if (s > 0 && FD_ISSET(dp->wfd, &ws) && nFQ(dp->msgq) > 0) {
-        if (sendDriverMsg(dp) < 0)
-           return;	/* fds effected */
-        s--;
-        }
-    }
+    (void) epoll_ctl (epfd, EPOLL_CTL_DEL, fd, &ev);
 }
 
-int isDeviceInDriver(const char *dev, DvrInfo *dp)
+/* register client cp, or re-arm it after its queue went from empty to busy.
+ * EPOLL_CTL_MOD makes epoll recheck readiness so a writable socket reports
+ * a fresh EPOLLOUT edge. clients with a worker are only read here.
+ */
+static void
+watchClient (ClInfo *cp, int op)
 {
-    int i=0;
-    for (i=0; i <dp->ndev; i++)
-    {
-        if (!strcmp(dev, dp->dev[i]))
-            return 1;
+    uint32_t events = EPOLLIN|EPOLLET;
+
+    /* a worker does the writing, if any */
+    if (cp->worker < 0)
+        events |= EPOLLOUT;
+    watchFd (op, cp->s, events, EP_CLIENT, cp - clinfo);
+}
+
+/* register driver dp, or re-arm its writer after its queue became busy.
+ * remote drivers share one socket for both directions.
+ */
+static void
+watchDvr (DvrInfo *dp, int op)
+{
+    int slot = dp - dvrinfo;
+
+    if (dp->pid == REMOTEDVR) {
+        watchFd (op, dp->rfd, EPOLLIN|EPOLLOUT|EPOLLET, EP_DRIVER, slot);
+        return;
     }
 
-    return 0;
+    if (op == EPOLL_CTL_ADD) {
+        watchFd (op, dp->rfd, EPOLLIN|EPOLLET, EP_DRIVER, slot);
+        watchFd (op, dp->efd, EPOLLIN|EPOLLET, EP_DRIVERERR, slot);
+    }
+    watchFd (op, dp->wfd, EPOLLOUT|EPOLLET, EP_DRIVER, slot);
 }
 
-/* Read commands from FIFO and process them. Start/stop drivers accordingly */
-static void newFIFO(void)
+/* start nworkers I/O threads, each with its own epoll and a pair of
+ * eventfds to hear about and announce ring traffic. exit if trouble.
+ */
+static void
+startWorkers (void)
 {
-    //char line[MAXRBUF], tDriver[MAXRBUF], tConfig[MAXRBUF], tDev[MAXRBUF], tSkel[MAXRBUF], envDev[MAXRBUF], envConfig[MAXRBUF], envSkel[MAXR];
-    char line[MAXRBUF];
-    DvrInfo *dp = NULL;
-    int startCmd=0, i=0, remoteDriver=0;
+    int i;
 
-    while (i < MAXRBUF)
-    {
-        if (read(fifo.fd, line+i, 1) <= 0)
-        {
-            // Reset FIFO now, otherwise select will always return with no data from FIFO.
-            indiFIFO();
-            return;
+    workers = (Worker *) calloc (nworkers, sizeof(Worker));
+    if (!workers) {
+        fprintf (stderr, "no memory for %d workers\n", nworkers);
+        Bye();
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        Worker *wp = &workers[i];
+        struct epoll_event ev;
+
+        wp->epfd = epoll_create1 (EPOLL_CLOEXEC);
+        wp->tofd = eventfd (0, EFD_NONBLOCK|EFD_CLOEXEC);
+        wp->fromfd = eventfd (0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if (wp->epfd < 0 || wp->tofd < 0 || wp->fromfd < 0) {
+            fprintf (stderr, "%s: worker %d: %s\n", indi_tstamp(NULL), i,
+                                strerror(errno));
+            Bye();
         }
 
-        if (line[i] == '\n')
-        {
-            line[i] = '\0';
-            i=0;
+        memset (&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN|EPOLLET;
+        ev.data.fd = wp->tofd;
+        if (epoll_ctl (wp->epfd, EPOLL_CTL_ADD, wp->tofd, &ev) < 0) {
+            fprintf (stderr, "%s: worker %d: epoll_ctl: %s\n",
+                                indi_tstamp(NULL), i, strerror(errno));
+            Bye();
         }
-        else
-        {
-          i++;
-          continue;
+        watchFd (EPOLL_CTL_ADD, wp->fromfd, EPOLLIN|EPOLLET, EP_WORKER, i);
+
+        if ((errno = pthread_create (&wp->tid, NULL, workerMain, wp)) != 0) {
+            fprintf (stderr, "%s: worker %d: pthread_create: %s\n",
+                                indi_tstamp(NULL), i, strerror(errno));
+            Bye();
         }
+    }
 
-     if (verbose)
-            fprintf(stderr, "FIFO: %s\n", line);
+    if (verbose)
+        fprintf (stderr, "%s: writing to clients from %d threads\n",
+                                indi_tstamp(NULL), nworkers);
+}
 
-     char cmd[MAXSBUF], arg[4][1], var[4][MAXSBUF], tDriver[MAXSBUF], tName[MAXSBUF], envConfig[MAXSBUF], envSkel[MAXSBUF], envPrefix[MAXSBUF];
+/* add cmd to ring r if there is room.
+ * return 1 if added, 0 if full.
+ */
+static int
+ringPut (WkRing *r, const WkCmd *cmd)
+{
+    unsigned int head = r->head;
 
-     memset(&tDriver[0], 0, sizeof(MAXSBUF));
-     memset(&tName[0], 0, sizeof(MAXSBUF));
-     memset(&envConfig[0], 0, sizeof(MAXSBUF));
-     memset(&envSkel[0], 0, sizeof(MAXSBUF));
-     memset(&envPrefix[0], 0, sizeof(MAXSBUF));
+    if (head - __atomic_load_n (&r->tail, __ATOMIC_ACQUIRE) == WRINGSIZ)
+        return (0);
+    r->cmd[head & (WRINGSIZ-1)] = *cmd;
+    __atomic_store_n (&r->head, head+1, __ATOMIC_RELEASE);
+    return (1);
+}
 
-     int n = 0;
+/* take the oldest entry off ring r into *cmd.
+ * return 1 if got one, 0 if empty.
+ */
+static int
+ringGet (WkRing *r, WkCmd *cmd)
+{
+    unsigned int tail = r->tail;
+
+    if (tail == __atomic_load_n (&r->head, __ATOMIC_ACQUIRE))
+        return (0);
+    *cmd = r->cmd[tail & (WRINGSIZ-1)];
+    __atomic_store_n (&r->tail, tail+1, __ATOMIC_RELEASE);
+    return (1);
+}
+
+/* bump eventfd fd to wake whoever is waiting on it */
+static void
+wakeFd (int fd)
+{
+    uint64_t one = 1;
+
+    if (write (fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        fprintf (stderr, "%s: eventfd write: %s\n", indi_tstamp(NULL),
+                                strerror(errno));
+}
+
+/* hand op for client fd in slot, and Msg mp if any, to worker wp.
+ * if its ring is full, wake it and take back what it has finished with
+ * until there is room. the worker hears about it in kickWorkers().
+ * N.B. cp->msgq of a client with a worker only ever holds Msgs staged for
+ *   it, which is why shutdownClient() can still just drop them.
+ */
+static void
+wkPost (Worker *wp, int op, int fd, int slot, Msg *mp)
+{
+    WkCmd cmd;
+
+    cmd.op = op;
+    cmd.fd = fd;
+    cmd.slot = slot;
+    cmd.mp = mp;
+    while (!ringPut (&wp->to, &cmd)) {
+        int i;
+
+        wakeFd (wp->tofd);
+        for (i = 0; i < nworkers; i++)
+            reapWorker (&workers[i]);
+        sched_yield();
+    }
+    wp->kick = 1;
+}
+
+/* hand each worker the Msgs staged for its clients, then wake each one
+ * we handed something since last time.
+ */
+static void
+kickWorkers (void)
+{
+    int i;
+
+    for (i = 0; i < nstaged; i++) {
+        ClInfo *cp = &clinfo[staged[i]];
+        Msg *mp;
+
+        if (!cp->active || cp->worker < 0)
+            continue;
+        while ((mp = (Msg *) popFQ (cp->msgq)) != NULL)
+            wkPost (&workers[cp->worker], WK_MSG, cp->s, cp - clinfo, mp);
+    }
+    nstaged = 0;
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].kick) {
+            workers[i].kick = 0;
+            wakeFd (workers[i].tofd);
+        }
+    }
+}
+
+/* take back everything worker wp has finished with.
+ * N.B. may be called again from within wkPost(), so each entry is off the
+ *   ring before it is acted upon.
+ */
+static void
+reapWorker (Worker *wp)
+{
+    uint64_t n;
+    WkCmd cmd;
+
+    if (read (wp->fromfd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+        fprintf (stderr, "%s: eventfd read: %s\n", indi_tstamp(NULL),
+                                strerror(errno));
+
+    while (ringGet (&wp->from, &cmd)) {
+        ClInfo *cp;
+
+        switch (cmd.op) {
+        case WK_DONE:
+            /* still the same client? then it is this much less behind */
+            cp = cmd.slot < nclinfo ? &clinfo[cmd.slot] : NULL;
+            if (cp && cp->active && cp->s == cmd.fd && cp->worker == wp-workers)
+                cp->qbytes -= cmd.mp->cl;
+            releaseMsg (cmd.mp, NULL);
+            break;
+
+        case WK_CLOSED:
+            /* worker no longer touches fd, safe to let it be reused */
+            shutdown (cmd.fd, SHUT_RDWR);
+            close (cmd.fd);
+            break;
+
+        case WK_FAIL:
+            /* its clients can no longer be served, give up like we would */
+            fprintf (stderr, "%s: worker %d epoll_wait: %s\n",
+                        indi_tstamp(NULL), (int)(wp-workers), strerror(cmd.fd));
+            Bye();
+            break;
+        }
+    }
+}
+
+/* send op for client fd in slot, and Msg mp if any, back to the main
+ * thread. if our ring is full, wake main and wait for room; main never
+ * waits for us with its own ring full without also draining this one.
+ */
+static void
+wkReply (Worker *wp, int op, int fd, int slot, Msg *mp)
+{
+    WkCmd cmd;
+
+    cmd.op = op;
+    cmd.fd = fd;
+    cmd.slot = slot;
+    cmd.mp = mp;
+    while (!ringPut (&wp->from, &cmd)) {
+        wakeFd (wp->fromfd);
+        sched_yield();
+    }
+    wp->posted = 1;
+}
+
+/* retire function used by workers: send mp back to main as done */
+static void
+wkRetire (Msg *mp, void *arg)
+{
+    WkConn *wc = (WkConn *) arg;
+
+    wkReply (wc->wp, WK_DONE, wc->fd, wc->slot, mp);
+}
+
+/* return everything still queued on wc */
+static void
+wkDropQ (WkConn *wc)
+{
+    Msg *mp;
+
+    while ((mp = (Msg *) popFQ (wc->msgq)) != NULL)
+        wkRetire (mp, wc);
+    wc->qbytes = 0;
+    wc->nsent = 0;
+}
+
+/* act on one command from main */
+static void
+wkCommand (Worker *wp, WkCmd *cmd)
+{
+    WkConn *wc;
+
+    if (cmd->fd >= wp->nconns) {
+        int n = cmd->fd + 16;
+
+        wp->conns = (WkConn *) realloc (wp->conns, n*sizeof(WkConn));
+        memset (&wp->conns[wp->nconns], 0, (n-wp->nconns)*sizeof(WkConn));
+        wp->nconns = n;
+    }
+    wc = &wp->conns[cmd->fd];
+
+    switch (cmd->op) {
+    case WK_ADD: {
+        struct epoll_event ev;
+
+        memset (wc, 0, sizeof(*wc));
+        wc->msgq = newFQ(1);
+        wc->wp = wp;
+        wc->fd = cmd->fd;
+        wc->slot = cmd->slot;
+        wc->compactat = hiwater;
+
+        /* writable edges only, main does all the reading */
+        memset (&ev, 0, sizeof(ev));
+        ev.events = EPOLLOUT|EPOLLET;
+        ev.data.fd = cmd->fd;
+        if (epoll_ctl (wp->epfd, EPOLL_CTL_ADD, cmd->fd, &ev) < 0) {
+            fprintf (stderr, "%s: Client %d: worker epoll_ctl: %s\n",
+                        indi_tstamp(wc->wp->ts), cmd->fd, strerror(errno));
+            wc->dead = 1;
+        }
+        break;
+    }
+
+    case WK_MSG:
+        if (!wc->msgq || wc->dead) {
+            wkReply (wp, WK_DONE, cmd->fd, cmd->slot, cmd->mp);
+            break;
+        }
+        pushFQ (wc->msgq, cmd->mp);
+        wc->qbytes += cmd->mp->cl;
+        if (wc->qbytes > wc->compactat) {
+            int ndrop = compactMsgQ (wc->msgq, wc->nsent, &wc->qbytes,
+                                                            wkRetire, wc);
+            if (verbose && ndrop > 0)
+                fprintf (stderr, "%s: Client %d: %lu bytes behind, dropped %d stale updates\n",
+                            indi_tstamp(wc->wp->ts), wc->fd, wc->qbytes, ndrop);
+            wc->compactat = wc->qbytes + lowater;
+            if (wc->compactat < hiwater)
+                wc->compactat = hiwater;
+        }
+        break;
+
+    case WK_DEL:
+        if (wc->msgq) {
+            struct epoll_event ev;
+
+            (void) epoll_ctl (wp->epfd, EPOLL_CTL_DEL, cmd->fd, &ev);
+            wkDropQ (wc);
+            delFQ (wc->msgq);
+            wc->msgq = NULL;
+        }
+        wkReply (wp, WK_CLOSED, cmd->fd, cmd->slot, NULL);
+        break;
+    }
+}
+
+/* write as much queued for wc as its socket takes without blocking.
+ * if the client is gone, shut down its socket so main hears about it on
+ * the read side, and just return whatever comes for it from now on.
+ */
+static void
+wkSend (WkConn *wc)
+{
+    while (wc->msgq && !wc->dead && !wc->blocked && nFQ(wc->msgq) > 0) {
+        struct iovec iov[MAXIOV];
+        ssize_t nw;
+        int niov;
+
+        niov = gatherMsgQ (wc->msgq, wc->nsent, iov);
+        nw = writev (wc->fd, iov, niov);
+        if (nw < 0 && errno == EINTR)
+            continue;
+        if (nw < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            wc->blocked = 1;
+            break;
+        }
+
+        if (nw <= 0) {
+            if (nw == 0)
+            fprintf (stderr, "%s: Client %d: write returned 0\n",
+                            indi_tstamp(wc->wp->ts), wc->fd);
+            else
+            fprintf (stderr, "%s: Client %d: write: %s\n",
+                            indi_tstamp(wc->wp->ts), wc->fd, strerror(errno));
+            shutdown (wc->fd, SHUT_RDWR);
+            wc->dead = 1;
+            wkDropQ (wc);
+            break;
+        }
+
+        if (verbose > 1)
+            fprintf(stderr, "%s: Client %d: sending %.50s\n",
+                            indi_tstamp(wc->wp->ts), wc->fd, (char *)iov[0].iov_base);
+
+        consumeMsgQ (wc->msgq, &wc->nsent, &wc->qbytes, nw, wkRetire, wc);
+        if (wc->qbytes < lowater)
+            wc->compactat = hiwater;
+    }
+}
+
+/* body of each I/O worker thread: take Msgs from main, write them to our
+ * clients as their sockets allow, and give them back when done.
+ */
+static void *
+workerMain (void *arg)
+{
+    Worker *wp = (Worker *) arg;
+    struct epoll_event evs[MAXEPEVENTS];
+    sigset_t ss;
+    int *ready = NULL;
+    int nready, mready = 0;
+
+    /* signals are for the main thread */
+    sigfillset (&ss);
+    pthread_sigmask (SIG_BLOCK, &ss, NULL);
+
+    while (1) {
+        WkCmd cmd;
+        int i, n;
+
+        n = epoll_wait (wp->epfd, evs, MAXEPEVENTS, -1);
+        if (n < 0 && errno != EINTR) {
+            /* exiting is for the main thread, tell it and stop here */
+            wkReply (wp, WK_FAIL, errno, -1, NULL);
+            wakeFd (wp->fromfd);
+            break;
+        }
+
+        /* sockets that can take more */
+        nready = 0;
+        for (i = 0; i < n; i++) {
+            int fd = evs[i].data.fd;
+            uint64_t nk;
+
+            if (fd == wp->tofd) {
+                if (read (fd, &nk, sizeof(nk)) < 0 && errno != EAGAIN)
+                    fprintf (stderr, "worker eventfd read: %s\n", strerror(errno));
+                continue;
+            }
+            if (fd < wp->nconns && wp->conns[fd].msgq) {
+                wp->conns[fd].blocked = 0;
+                if (nready == mready)
+                    ready = (int *) realloc (ready, (mready += 64)*sizeof(int));
+                ready[nready++] = fd;
+            }
+        }
+
+        /* new work from main, note each socket with something to write */
+        while (ringGet (&wp->to, &cmd)) {
+            wkCommand (wp, &cmd);
+            if (cmd.op == WK_MSG && wp->conns[cmd.fd].msgq &&
+                                        nFQ(wp->conns[cmd.fd].msgq) == 1) {
+                if (nready == mready)
+                    ready = (int *) realloc (ready, (mready += 64)*sizeof(int));
+                ready[nready++] = cmd.fd;
+            }
+        }
+
+        /* write, gathering everything queued meanwhile */
+        for (i = 0; i < nready; i++)
+            if (ready[i] < wp->nconns)
+                wkSend (&wp->conns[ready[i]]);
+
+        if (wp->posted) {
+            wp->posted = 0;
+            wakeFd (wp->fromfd);
+        }
+    }
+
+    free (ready);
+    return (NULL);
+}
+
+#else
+
+/* service traffic from clients and drivers */
+static void
+indiRun(void)
+{
+    fd_set rs, ws;
+        int maxfd=0;
+    int i, s;
+
+    /* init with no writers or readers */
+    FD_ZERO(&ws);
+    FD_ZERO(&rs);
+
+        if (fifo.name && fifo.fd >=0)
+        {
+           FD_SET(fifo.fd, &rs);
+           maxfd = fifo.fd;
+        }
+
+    /* always listen for new clients */
+    FD_SET(lsocket, &rs);
+        if (lsocket > maxfd)
+                maxfd = lsocket;
+
+    /* add all client readers and client writers with work to send */
+    for (i = 0; i < nclinfo; i++) {
+        ClInfo *cp = &clinfo[i];
+        if (cp->active) {
+        FD_SET(cp->s, &rs);
+        if (nFQ(cp->msgq) > 0)
+            FD_SET(cp->s, &ws);
+        if (cp->s > maxfd)
+            maxfd = cp->s;
+        }
+    }
+
+    /* add all driver readers and driver writers with work to send */
+        for (i = 0; i < ndvrinfo; i++)
+        {
+        DvrInfo *dp = &dvrinfo[i];
+            if (dp->active)
+            {
+                FD_SET(dp->rfd, &rs);
+                if (dp->rfd > maxfd)
+                   maxfd = dp->rfd;
+                if (dp->pid != REMOTEDVR)
+                {
+                   FD_SET(dp->efd, &rs);
+                   if (dp->efd > maxfd)
+                      maxfd = dp->efd;
+                }
+                if (nFQ(dp->msgq) > 0)
+                {
+                   FD_SET(dp->wfd, &ws);
+                   if (dp->wfd > maxfd)
+                       maxfd = dp->wfd;
+                }
+            }
+    }
+
+    /* wait for action */
+    s = select (maxfd+1, &rs, &ws, NULL, NULL);
+    if (s < 0) {
+        fprintf (stderr, "%s: select(%d): %s\n", indi_tstamp(NULL), maxfd+1,
+                                strerror(errno));
+        Bye();
+    }
+
+
+        /* new command from FIFO? */
+        if (s > 0 && fifo.fd >= 0 && FD_ISSET(fifo.fd, &rs))
+        {
+            newFIFO();
+            s--;
+        }
+
+    /* new client? */
+    if (s > 0 && FD_ISSET(lsocket, &rs)) {
+        newClient();
+        s--;
+    }
+
+    /* message to/from client? */
+    for (i = 0; s > 0 && i < nclinfo; i++) {
+        ClInfo *cp = &clinfo[i];
+        if (cp->active) {
+        if (FD_ISSET(cp->s, &rs)) {
+            if (readFromClient(cp) < 0)
+            return;	/* fds effected */
+            s--;
+        }
+        if (s > 0 && FD_ISSET(cp->s, &ws)) {
+            if (sendClientMsg(cp) < 0)
+            return;	/* fds effected */
+            s--;
+        }
+        }
+    }
+
+    /* message to/from driver? */
+    for (i = 0; s > 0 && i < ndvrinfo; i++) {
+        DvrInfo *dp = &dvrinfo[i];
+        if (dp->pid != REMOTEDVR && FD_ISSET(dp->efd, &rs)) {
+        if (stderrFromDriver(dp) < 0)
+            return;	/* fds effected */
+        s--;
+        }
+        if (s > 0 && FD_ISSET(dp->rfd, &rs)) {
+        if (readFromDriver(dp) < 0)
+            return;	/* fds effected */
+        s--;
+        }
+        if (s > 0 && FD_ISSET(dp->wfd, &ws) && nFQ(dp->msgq) > 0) {
+        if (sendDriverMsg(dp) < 0)
+           return;	/* fds effected */
+        s--;
+        }
+    }
+}
+#endif /* WITH_EPOLL */
+
+int isDeviceInDriver(const char *dev, DvrInfo *dp)
+{
+    int i=0;
+    for (i=0; i <dp->ndev; i++)
+    {
+        if (!strcmp(dev, dp->dev[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Read commands from FIFO and process them. Start/stop drivers accordingly */
+static void newFIFO(void)
+{
+    //char line[MAXRBUF], tDriver[MAXRBUF], tConfig[MAXRBUF], tDev[MAXRBUF], tSkel[MAXRBUF], envDev[MAXRBUF], envConfig[MAXRBUF], envSkel[MAXR];
+    char line[MAXRBUF];
+    DvrInfo *dp = NULL;
+    int startCmd=0, i=0, remoteDriver=0;
+
+    while (i < MAXRBUF)
+    {
+        if (read(fifo.fd, line+i, 1) <= 0)
+        {
+            // Reset FIFO now, otherwise select will always return with no data from FIFO.
+            indiFIFO();
+            return;
+        }
+
+        if (line[i] == '\n')
+        {
+            line[i] = '\0';
+            i=0;
+        }
+        else
+        {
+          i++;
+          continue;
+        }
+
+     if (verbose)
+            fprintf(stderr, "FIFO: %s\n", line);
+
+     char cmd[MAXSBUF], arg[4][1], var[4][MAXSBUF], tDriver[MAXSBUF], tName[MAXSBUF], envConfig[MAXSBUF], envSkel[MAXSBUF], envPrefix[MAXSBUF];
+
+     memset(&tDriver[0], 0, sizeof(MAXSBUF));
+     memset(&tName[0], 0, sizeof(MAXSBUF));
+     memset(&envConfig[0], 0, sizeof(MAXSBUF));
+     memset(&envSkel[0], 0, sizeof(MAXSBUF));
+     memset(&envPrefix[0], 0, sizeof(MAXSBUF));
+
+     int n = 0;
 
      // If remote driver
      if (strstr(line, "@"))
@@ -1024,7 +1912,7 @@ static void newFIFO(void)
                 addXMLAtt(root, "device", dp->dev[i]);
 
                 prXMLEle(stderr, root, 0);
-                Msg * mp = newMsg();
+                Msg * mp = newXMLMsg(root);
 
                 q2Clients(NULL, 0, dp->dev[i], NULL, mp, root);
                if (mp->count > 0)
@@ -1043,16 +1931,21 @@ static void newFIFO(void)
 }
 
 /* prepare for new client arriving on lsocket.
- * exit if trouble.
+ * return 0 if one was added, -1 if none was pending. exit if trouble.
  */
-static void
+static int
 newClient()
 {
     ClInfo *cp = NULL;
     int s, cli;
+#ifdef WITH_EPOLL
+    int i;
+#endif
 
     /* assign new socket */
     s = newClSocket ();
+    if (s < 0)
+        return (-1);
 
     /* try to reuse a clinfo slot, else add one */
     for (cli = 0; cli < nclinfo; cli++)
@@ -1073,9 +1966,25 @@ newClient()
     cp->active = 1;
     cp->s = s;
     cp->lp = newLilXML();
+    arenaLilXML (cp->lp, 1);
     cp->msgq = newFQ(1);
     cp->props = malloc (1);
     cp->nsent = 0;
+    cp->qbytes = 0;
+    cp->compactat = hiwater;
+#ifdef WITH_EPOLL
+    /* give the least busy worker, if any, the writing */
+    cp->worker = -1;
+    for (i = 0; i < nworkers; i++)
+        if (cp->worker < 0 || workers[i].nclients < workers[cp->worker].nclients)
+            cp->worker = i;
+    setNonBlock (s);
+    watchClient (cp, EPOLL_CTL_ADD);
+    if (cp->worker >= 0) {
+        workers[cp->worker].nclients++;
+        wkPost (&workers[cp->worker], WK_ADD, s, cli, NULL);
+    }
+#endif
 
     if (verbose > 0) {
         struct sockaddr_in addr;
@@ -1092,11 +2001,14 @@ newClient()
       active++;
   fprintf(stderr, "CLIENTS %d\n", active); fflush(stderr);
 #endif
+
+    return (0);
 }
 
 /* read more from the given client, send to each appropriate driver when see
  * xml closure. also send all newXXX() to all other interested clients.
- * return -1 if had to shut down anything, else 0.
+ * return -1 if had to shut down anything, 0 if there was nothing to read
+ * without blocking, else 1.
  */
 static int
 readFromClient (ClInfo *cp)
@@ -1107,6 +2019,10 @@ readFromClient (ClInfo *cp)
 
     /* read client */
     nr = read (cp->s, buf, sizeof(buf));
+    if (nr < 0 && errno == EINTR)
+        return (1);
+    if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return (0);
     if (nr <= 0)
     {
         if (nr < 0)
@@ -1151,15 +2067,18 @@ readFromClient (ClInfo *cp)
          */
         if (dev[0])
             addClDevice (cp, dev, name, isblob);
-        else if (!strcmp (roottag, "getProperties") && !cp->nprops)
+        else if (!strcmp (roottag, "getProperties") && !cp->nprops &&
+                                                            !cp->allprops) {
             cp->allprops = 1;
+            pushRef (&allcl, &nallcl, cp - clinfo, -1);
+        }
 
         /* snag enableBLOB -- send to remote drivers too */
         if (!strcmp (roottag, "enableBLOB"))
             crackBLOBHandling (dev, name, pcdataXMLEle(root), cp);
 
         /* build a new message -- set content iff anyone cares */
-        mp = newMsg();
+        mp = newXMLMsg(root);
 
         /* send message to driver(s) responsible for dev */
         q2RDrivers (dev, mp, root);
@@ -1196,26 +2115,31 @@ readFromClient (ClInfo *cp)
         }
     }
 
-    return (shutany ? -1 : 0);
+    return (shutany ? -1 : 1);
 }
 
 /* read more from the given driver, send to each interested client when see
  * xml closure. if driver dies, try restarting.
- * return 0 if ok else -1 if had to shut down anything.
+ * setBLOBVector is framed here and routed as raw bytes, everything else goes
+ * through lilxml as before.
+ * return -1 if had to shut down anything, 0 if there was nothing to read
+ * without blocking, else 1.
  */
 static int
 readFromDriver (DvrInfo *dp)
 {
+    DvrFrame *fr = &dp->fr;
     char buf[MAXRBUF];
     int shutany = 0;
-    ssize_t i, nr;
-    char err[1024];
-    XMLEle **nodes;
-    XMLEle *root;
-    int inode=0;
-    
+    ssize_t i, nr, run;
+    int s;
+
     /* read driver */
     nr = read (dp->rfd, buf, sizeof(buf));
+    if (nr < 0 && errno == EINTR)
+        return (1);
+    if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return (0);
     if (nr <= 0)
     {
         if (nr < 0)
@@ -1227,6 +2151,160 @@ readFromDriver (DvrInfo *dp)
         return (-1);
     }
 
+    /* watch top-level element boundaries. bytes [run,i) are pending for
+     * lilxml, a root tag is held back in fr->tag until we know whether it
+     * starts a setBLOBVector.
+     */
+    for (i = run = 0; i < nr; i++)
+    {
+        int c = buf[i];
+
+        switch (fr->state)
+        {
+        case FR_TOP:
+            if (c == '<')
+            {
+                if (i > run)
+                {
+                    if ((s = xmlFromDriver (dp, buf+run, i-run)) < 0)
+                        return (-1);
+                    shutany += s;
+                }
+                fr->tag[0] = '<';
+                fr->ntag = 1;
+                fr->state = FR_TAG;
+            }
+            break;
+
+        case FR_TAG:
+            if (!isspace(c) && c != '>' && c != '/' && fr->ntag < (int)sizeof(fr->tag)-1)
+            {
+                fr->tag[fr->ntag++] = c;
+                break;
+            }
+            fr->tag[fr->ntag] = '\0';
+            fr->quote = 0;
+            fr->comment = !strncmp (fr->tag, "<!--", 4);
+            /* a comment may end in its own "tag": <!--x--> */
+            fr->lastc = fr->comment && fr->ntag > 4 ? fr->tag[fr->ntag-1] : 0;
+            fr->lastc2 = fr->comment && fr->ntag > 5 ? fr->tag[fr->ntag-2] : 0;
+            if (!strcmp (fr->tag, "<setBLOBVector"))
+            {
+                fr->nraw = 0;
+                if (appendFrame (fr, fr->tag, fr->ntag) < 0)
+                    return (badFrame (dp, "setBLOBVector too large"));
+                fr->state = FR_BSTAG;
+            }
+            else
+            {
+                if ((s = xmlFromDriver (dp, fr->tag, fr->ntag)) < 0)
+                    return (-1);
+                shutany += s;
+                run = i;
+                fr->state = FR_STAG;
+            }
+            i--;        /* look at c again in its start tag */
+            break;
+
+        case FR_STAG:
+        case FR_BSTAG:
+            if (fr->state == FR_BSTAG && appendFrame (fr, &buf[i], 1) < 0)
+                return (badFrame (dp, "setBLOBVector too large"));
+            if (fr->comment)
+            {
+                /* quotes and '>' mean nothing until "-->" */
+                if (c == '>' && fr->lastc == '-' && fr->lastc2 == '-')
+                    fr->state = FR_TOP;
+            }
+            else if (fr->quote)
+            {
+                if (c == fr->quote)
+                    fr->quote = 0;
+            }
+            else if (c == '"' || c == '\'')
+                fr->quote = c;
+            else if (c == '>')
+            {
+                /* <.../>, <?...?> and <!...> have no body */
+                int empty = fr->lastc == '/' || fr->tag[1] == '?' || fr->tag[1] == '!';
+
+                fr->nclose = 0;
+                if (fr->state == FR_STAG)
+                    fr->state = empty ? FR_TOP : FR_BODY;
+                else if (!empty)
+                {
+                    fr->nstag = fr->nraw;
+                    fr->state = FR_BBODY;
+                }
+                else
+                {
+                    fr->nstag = fr->nraw;
+                    fr->state = FR_TOP;
+                    run = i+1;
+                    if ((s = rawBLOBFromDriver (dp)) < 0)
+                        return (-1);
+                    shutany += s;
+                }
+            }
+            fr->lastc2 = fr->lastc;
+            fr->lastc = c;
+            break;
+
+        case FR_BODY:
+            if (matchCloseTag (fr, c))
+                fr->state = FR_TOP;
+            break;
+
+        case FR_BBODY:
+            if (fr->nclose == 0 && c != '<')
+            {
+                /* bulk copy base64 up to the next tag */
+                char *lt = memchr (buf+i, '<', nr-i);
+                ssize_t n = lt ? lt-(buf+i) : nr-i;
+
+                if (appendFrame (fr, buf+i, n) < 0)
+                    return (badFrame (dp, "setBLOBVector too large"));
+                i += n-1;
+                break;
+            }
+            if (appendFrame (fr, &buf[i], 1) < 0)
+                return (badFrame (dp, "setBLOBVector too large"));
+            if (matchCloseTag (fr, c))
+            {
+                fr->state = FR_TOP;
+                run = i+1;
+                if ((s = rawBLOBFromDriver (dp)) < 0)
+                    return (-1);
+                shutany += s;
+            }
+            break;
+        }
+    }
+
+    /* hand lilxml whatever is left of a pass-through run */
+    if ((fr->state == FR_TOP || fr->state == FR_STAG || fr->state == FR_BODY) && nr > run)
+    {
+        if ((s = xmlFromDriver (dp, buf+run, nr-run)) < 0)
+            return (-1);
+        shutany += s;
+    }
+
+    return (shutany ? -1 : 1);
+}
+
+/* parse the given chunk of driver dp's non-BLOB traffic and route each
+ * element it completes.
+ * return -1 if dp had to be shut down, else number of clients shut down.
+ */
+static int
+xmlFromDriver (DvrInfo *dp, char *buf, int nr)
+{
+    int shutany = 0;
+    char err[1024];
+    XMLEle **nodes;
+    XMLEle *root;
+    int inode=0;
+
     /* process XML chunk */
     nodes=parseXMLChunk(dp->lp, buf, nr, err);
 
@@ -1236,7 +2314,7 @@ readFromDriver (DvrInfo *dp)
       {
         char *ts = indi_tstamp(NULL);
         fprintf (stderr, "%s: Driver %s: XML error: %s\n", ts, dp->name, err);
-        fprintf (stderr, "%s: Driver %s: XML read: %.*s\n", ts,  dp->name, (int)nr, buf);
+        fprintf (stderr, "%s: Driver %s: XML read: %.*s\n", ts,  dp->name, nr, buf);
         shutdownDvr (dp, 1);
         return (-1);
       }
@@ -1249,26 +2327,16 @@ readFromDriver (DvrInfo *dp)
         char *roottag = tagXMLEle(root);
         const char *dev = findXMLAttValu (root, "device");
         const char *name = findXMLAttValu (root, "name");
-        int isblob = !strcmp (tagXMLEle(root), "setBLOBVector");
         Msg *mp;
 
-        if (verbose > 2)
-        {
-            fprintf(stderr, "%s: Driver %s: read ", indi_tstamp(0),dp->name);
-            traceMsg (root);
-        } else if (verbose > 1)
-        {
-                fprintf (stderr, "%s: Driver %s: read <%s device='%s' name='%s'>\n", indi_tstamp(NULL), dp->name, tagXMLEle(root),
-                         findXMLAttValu (root, "device"),
-                         findXMLAttValu (root, "name"));
-        }
+        traceDvrMsg (dp, root);
 
       /* that's all if driver is just registering a snoop */
       /* JM 2016-05-18: Send getProperties to upstream chained servers as well.*/
       if (!strcmp (roottag, "getProperties"))
       {
           addSDevice (dp, dev, name);
-          mp = newMsg();
+          mp = newXMLMsg(root);
           /* send to interested chained servers upstream */
           if (q2Servers(NULL, mp, root) < 0)
               shutany++;
@@ -1295,6 +2363,77 @@ readFromDriver (DvrInfo *dp)
           continue;
       }
 
+      shutany += routeDvrMsg (dp, root, NULL);
+      delXMLEle (root);
+      inode++; root=nodes[inode];
+    }
+
+    free(nodes);
+
+    return (shutany);
+}
+
+/* route the complete setBLOBVector gathered raw in dp's frame.
+ * only its start tag is parsed, for device, name and the like. the raw bytes
+ * become the message content as they are, without any DOM or copy.
+ * return -1 if dp had to be shut down, else number of clients shut down.
+ */
+static int
+rawBLOBFromDriver (DvrInfo *dp)
+{
+    static const char closer[] = "</setBLOBVector>";
+    DvrFrame *fr = &dp->fr;
+    LilXML *lp = newLilXML();
+    XMLEle *root = NULL;
+    char err[1024];
+    int i, shutany;
+
+    arenaLilXML (lp, 1);
+    err[0] = '\0';
+
+    /* a shallow element from the start tag alone */
+    for (i = 0; i < fr->nstag && !root; i++)
+        root = readXMLEle (lp, fr->raw[i], err);
+    for (i = 0; closer[i] && !root; i++)
+        root = readXMLEle (lp, closer[i], err);
+    delLilXML (lp);
+
+    if (!root)
+    {
+        fprintf (stderr, "%s: Driver %s: XML error: %s\n", indi_tstamp(NULL), dp->name,
+                                                    err[0] ? err : "bad setBLOBVector start tag");
+        fprintf (stderr, "%s: Driver %s: XML read: %.*s\n", indi_tstamp(NULL), dp->name, fr->nstag, fr->raw);
+        shutdownDvr (dp, 1);
+        return (-1);
+    }
+
+    traceDvrMsg (dp, root);
+
+    /* content ends like a printed element */
+    appendFrame (fr, "\n", 1);
+    fr->raw[fr->nraw] = '\0';
+
+    shutany = routeDvrMsg (dp, root, fr);
+    delXMLEle (root);
+    fr->nraw = 0;
+
+    return (shutany);
+}
+
+/* route message root from driver dp to interested clients and snoopers.
+ * if fr is given, its raw bytes become the content and it gives them up,
+ * else root is printed into the content.
+ * return number of clients shut down.
+ */
+static int
+routeDvrMsg (DvrInfo *dp, XMLEle *root, DvrFrame *fr)
+{
+    const char *dev = findXMLAttValu (root, "device");
+    const char *name = findXMLAttValu (root, "name");
+    int isblob = !strcmp (tagXMLEle(root), "setBLOBVector");
+    int shutany = 0;
+    Msg *mp;
+
       /* Found a new device? Let's add it to driver info */
       if (dev[0] && isDeviceInDriver(dev, dp) == 0)
         {
@@ -1309,6 +2448,7 @@ readFromDriver (DvrInfo *dp)
 	    fprintf(stderr, "STARTED \"%s\"\n", dp->name); fflush(stderr);
 #endif
 	  
+	  addRouteRef (dp->dev[dp->ndev], "", RT_RD, dp - dvrinfo, dp->ndev);
 	  dp->ndev++;
         }
 
@@ -1317,7 +2457,13 @@ readFromDriver (DvrInfo *dp)
 	logDMsg (root, dev);
       
       /* build a new message -- set content iff anyone cares */
-      mp = newMsg();
+      if (fr)
+      {
+        mp = newMsg();
+        mp->cl = fr->nraw;
+      }
+      else
+        mp = newXMLMsg(root);
       
       /* send to interested clients */
       if (q2Clients (NULL, isblob, dev, name, mp, root) < 0)
@@ -1328,20 +2474,124 @@ readFromDriver (DvrInfo *dp)
       
       /* set message content if anyone cares else forget it */
       if (mp->count > 0)
-	setMsgXMLEle (mp, root);
+      {
+        if (fr)
+          setMsgFrame (mp, fr);
+        else
+          setMsgXMLEle (mp, root);
+      }
       else
 	freeMsg (mp);
-      delXMLEle (root);
-      inode++; root=nodes[inode];
+
+    return (shutany);
+}
+
+/* print what we read from driver dp, as chatty as asked */
+static void
+traceDvrMsg (DvrInfo *dp, XMLEle *root)
+{
+        if (verbose > 2)
+        {
+            fprintf(stderr, "%s: Driver %s: read ", indi_tstamp(0),dp->name);
+            traceMsg (root);
+        } else if (verbose > 1)
+        {
+                fprintf (stderr, "%s: Driver %s: read <%s device='%s' name='%s'>\n", indi_tstamp(NULL), dp->name, tagXMLEle(root),
+                         findXMLAttValu (root, "device"),
+                         findXMLAttValu (root, "name"));
+        }
+}
+
+/* append n bytes of buf to the raw element gathered in fr, always leaving
+ * room for a final \0.
+ * return 0, or -1 if that would make it larger than MAXFRAME.
+ */
+static int
+appendFrame (DvrFrame *fr, const char *buf, int n)
+{
+    if (fr->nraw + n + 1 > MAXFRAME)
+        return (-1);
+    if (fr->nraw + n + 1 > fr->mraw)
+    {
+        int m = fr->mraw ? fr->mraw : MAXRBUF;
+        while (fr->nraw + n + 1 > m)
+            m = m > MAXFRAME/2 ? MAXFRAME : m*2;
+        fr->raw = (char *) realloc (fr->raw, m);
+        if (!fr->raw)
+        {
+            fprintf (stderr, "no memory for BLOB frame\n");
+            Bye();
+        }
+        fr->mraw = m;
     }
+    memcpy (fr->raw + fr->nraw, buf, n);
+    fr->nraw += n;
+    return (0);
+}
+
+/* advance the match of the closing tag of the root being framed in fr by
+ * char c. "</tag" may be followed by white space before its '>'.
+ * return 1 when c completes it, else 0.
+ */
+static int
+matchCloseTag (DvrFrame *fr, int c)
+{
+    if (fr->nclose == fr->ntag+1)
+    {
+        /* all of "</tag" seen */
+        if (c == '>')
+        {
+            fr->nclose = 0;
+            return (1);
+        }
+        if (isspace(c))
+            return (0);
+    }
+    else if (c == closeTagChar (fr, fr->nclose))
+    {
+        fr->nclose++;
+        return (0);
+    }
+    fr->nclose = (c == '<');
+    return (0);
+}
+
+/* report a framing error in the stream from dp and shut it down, as for
+ * any other XML error.
+ * return -1.
+ */
+static int
+badFrame (DvrInfo *dp, const char *why)
+{
+    fprintf (stderr, "%s: Driver %s: XML error: %s\n", indi_tstamp(NULL), dp->name, why);
+    shutdownDvr (dp, 1);
+    return (-1);
+}
 
-    free(nodes);
+/* return char k of the closing tag "</tag>" of the root being framed in fr */
+static int
+closeTagChar (DvrFrame *fr, int k)
+{
+    if (k == 0)
+        return ('<');
+    if (k == 1)
+        return ('/');
+    if (k <= fr->ntag)
+        return (fr->tag[k-1]);
+    return ('>');
+}
 
-    return (shutany ? -1 : 0);
+/* forget any partial element in fr and its buffer */
+static void
+resetFrame (DvrFrame *fr)
+{
+    free (fr->raw);
+    memset (fr, 0, sizeof(*fr));
 }
 
 /* read more from the given driver stderr, add prefix and send to our stderr.
- * return 0 if ok else -1 if had to restart.
+ * return -1 if had to restart, 0 if there was nothing to read without
+ * blocking, else 1.
  */
 static int
 stderrFromDriver (DvrInfo *dp)
@@ -1352,6 +2602,10 @@ stderrFromDriver (DvrInfo *dp)
 
     /* read more */
     nr = read (dp->efd, exbuf+nexbuf, sizeof(exbuf)-nexbuf);
+    if (nr < 0 && errno == EINTR)
+        return (1);
+    if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return (0);
     if (nr <= 0) {
         if (nr < 0)
         fprintf (stderr, "%s: Driver %s: stderr %s\n", indi_tstamp(NULL),
@@ -1376,7 +2630,7 @@ stderrFromDriver (DvrInfo *dp)
         }
     }
 
-    return (0);
+    return (1);
 }
 
 /* close down the given client */
@@ -1384,10 +2638,28 @@ static void
 shutdownClient (ClInfo *cp)
 {
     Msg *mp;
+    int i;
 
-    /* close connection */
+    /* close connection. with a worker, closing waits until it lets go */
+#ifdef WITH_EPOLL
+    unwatchFd (cp->s);
+    if (cp->worker >= 0) {
+        workers[cp->worker].nclients--;
+        wkPost (&workers[cp->worker], WK_DEL, cp->s, cp - clinfo, NULL);
+    } else {
+        shutdown (cp->s, SHUT_RDWR);
+        close (cp->s);
+    }
+#else
     shutdown (cp->s, SHUT_RDWR);
     close (cp->s);
+#endif
+
+    /* drop from routing index */
+    for (i = 0; i < cp->nprops; i++)
+        rmRouteRef (cp->props[i].dev, cp->props[i].name, RT_CL, cp - clinfo);
+    if (cp->allprops)
+        pullRef (allcl, &nallcl, cp - clinfo);
 
     /* free memory */
     delLilXML (cp->lp);
@@ -1398,6 +2670,7 @@ shutdownClient (ClInfo *cp)
         if (--mp->count == 0)
         freeMsg (mp);
     delFQ (cp->msgq);
+    cp->qbytes = 0;
 
     /* ok now to recycle */
     cp->active = 0;
@@ -1419,8 +2692,16 @@ static void
 shutdownDvr (DvrInfo *dp, int restart)
 {
     Msg *mp;
+    int i;
 
     /* make sure it's dead, reclaim resources */
+#ifdef WITH_EPOLL
+    unwatchFd (dp->rfd);
+    if (dp->pid != REMOTEDVR) {
+        unwatchFd (dp->wfd);
+        unwatchFd (dp->efd);
+    }
+#endif
     if (dp->pid == REMOTEDVR) {
         /* socket connection */
         shutdown (dp->wfd, SHUT_RDWR);
@@ -1437,10 +2718,17 @@ shutdownDvr (DvrInfo *dp, int restart)
   fprintf(stderr, "STOPPED \"%s\"\n", dp->name); fflush(stderr);
 #endif
 
+    /* drop from routing index */
+    for (i = 0; i < dp->nsprops; i++)
+        rmRouteRef (dp->sprops[i].dev, dp->sprops[i].name, RT_SD, dp - dvrinfo);
+    for (i = 0; i < dp->ndev; i++)
+        rmRouteRef (dp->dev[i], "", RT_RD, dp - dvrinfo);
+
     /* free memory */
     free (dp->sprops);
     free(dp->dev);
     delLilXML (dp->lp);
+    resetFrame (&dp->fr);
 
    /* ok now to recycle */
    dp->active = 0;
@@ -1451,6 +2739,7 @@ shutdownDvr (DvrInfo *dp, int restart)
         if (--mp->count == 0)
         freeMsg (mp);
     delFQ (dp->msgq);
+    dp->qbytes = 0;
 
         if (restart)
         {
@@ -1479,20 +2768,27 @@ q2RDrivers (const char *dev, Msg *mp, XMLEle *root)
     int sawremote = 0;
     DvrInfo *dp;
     char *roottag = tagXMLEle(root);
+    Route *rp = dev[0] ? findRoute (dev, "", 0) : NULL;
+    int i, n;
+
+    /* candidates are the drivers known to serve dev, else all of them */
+    if (dev[0])
+        n = rp ? rp->nrefs[RT_RD] : 0;
+    else
+        n = ndvrinfo;
 
     /* queue message to each interested driver.
      * N.B. don't send generic getProps to more than one remote driver,
      *   otherwise they all fan out and we get multiple responses back.
      */
-    for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++)
+    for (i = 0; i < n; i++)
     {
-        int isremote = (dp->pid == REMOTEDVR);
+        int isremote;
 
-        if (dp->active == 0)
-            continue;
+        dp = &dvrinfo[dev[0] ? rp->refs[RT_RD][i].slot : i];
+        isremote = (dp->pid == REMOTEDVR);
 
-        /* driver known to not support this dev */
-        if (dev[0] && isDeviceInDriver(dev, dp) == 0)
+        if (dp->active == 0)
             continue;
 
         /* already sent generic to another remote */
@@ -1508,7 +2804,7 @@ q2RDrivers (const char *dev, Msg *mp, XMLEle *root)
 
         /* ok: queue message to this driver */
         mp->count++;
-        pushFQ (dp->msgq, mp);
+        pushDvrMsg (dp, mp);
         if (verbose > 1)
         {
             fprintf (stderr, "%s: Driver %s: queuing responsible for <%s device='%s' name='%s'>\n",
@@ -1520,30 +2816,42 @@ q2RDrivers (const char *dev, Msg *mp, XMLEle *root)
 }
 
 /* put Msg mp on queue of each driver snooping dev/name.
+ * drivers snooping exactly dev/name come first, so their BLOB mode wins
+ * over one snooping all of dev.
  * if BLOB always honor current mode.
  */
 static void
 q2SDrivers (int isblob, const char *dev, const char *name, Msg *mp, XMLEle *root)
 {
-    DvrInfo *dp;
+    Route *rp[2];
+    int i, j;
 
-    for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++) {
-            Property *sp = findSDevice (dp, dev, name);
+    rp[0] = findRoute (dev, name, 0);
+    rp[1] = name[0] ? findRoute (dev, "", 0) : NULL;
+    routegen++;
 
-        /* nothing for dp if not snooping for dev/name or wrong BLOB mode */
-        if (!sp)
-        continue;
-        if ((isblob && sp->blob==B_NEVER) || (!isblob && sp->blob==B_ONLY))
-        continue;
+    for (j = 0; j < 2; j++) {
+        for (i = 0; rp[j] && i < rp[j]->nrefs[RT_SD]; i++) {
+            RouteRef *rr = &rp[j]->refs[RT_SD][i];
+            DvrInfo *dp = &dvrinfo[rr->slot];
+            Property *sp = &dp->sprops[rr->prop];
 
-        /* ok: queue message to this device */
-        mp->count++;
-        pushFQ (dp->msgq, mp);
-        if (verbose > 1) {
-        fprintf (stderr, "%s: Driver %s: queuing snooped <%s device='%s' name='%s'>\n",
-                    indi_tstamp(NULL), dp->name, tagXMLEle(root),
-                    findXMLAttValu (root, "device"),
-                    findXMLAttValu (root, "name"));
+            /* once per driver, nothing if wrong BLOB mode */
+            if (dp->mark == routegen)
+                continue;
+            dp->mark = routegen;
+            if ((isblob && sp->blob==B_NEVER) || (!isblob && sp->blob==B_ONLY))
+                continue;
+
+            /* ok: queue message to this device */
+            mp->count++;
+            pushDvrMsg (dp, mp);
+            if (verbose > 1) {
+            fprintf (stderr, "%s: Driver %s: queuing snooped <%s device='%s' name='%s'>\n",
+                        indi_tstamp(NULL), dp->name, tagXMLEle(root),
+                        findXMLAttValu (root, "device"),
+                        findXMLAttValu (root, "name"));
+            }
         }
     }
 }
@@ -1577,6 +2885,9 @@ addSDevice (DvrInfo *dp, const char *dev, const char *name)
 
     sp->blob = B_NEVER;
 
+    /* index it for q2SDrivers() */
+    addRouteRef (sp->dev, sp->name, RT_SD, dp - dvrinfo, dp->nsprops-1);
+
     if (verbose)
         fprintf (stderr, "%s: Driver %s: snooping on %s.%s\n", indi_tstamp(NULL),
                             dp->name, dev, name);
@@ -1601,73 +2912,91 @@ findSDevice (DvrInfo *dp, const char *dev, const char *name)
 
 
 /* put Msg mp on queue of each client interested in dev/name, except notme.
+ * candidates come from the routes for exactly dev/name, then all of dev,
+ * then clients that want everything. messages without a device go to all.
  * if BLOB always honor current mode.
  * return -1 if had to shut down any clients, else 0.
  */
 static int
 q2Clients (ClInfo *notme, int isblob, const char *dev, const char *name, Msg *mp, XMLEle *root)
 {
-    int shutany = 0;
-    ClInfo *cp;
-    int ql,i=0;
+    ClInfo **slow = NULL;
+    int nslow = 0;
+    Route *rp[2];
+    int i, j;
+
+    if (!name)
+        name = "";
+    routegen++;
+
+    if (!dev[0]) {
+        for (i = 0; i < nclinfo; i++)
+            q2Client (&clinfo[i], notme, isblob, NULL, mp, root, &slow, &nslow);
+    } else {
+        rp[0] = findRoute (dev, name, 0);
+        rp[1] = name[0] ? findRoute (dev, "", 0) : NULL;
+
+        /* exact subscribers first, they carry a per-property BLOB mode */
+        for (j = 0; j < 2; j++)
+            for (i = 0; rp[j] && i < rp[j]->nrefs[RT_CL]; i++) {
+                RouteRef *rr = &rp[j]->refs[RT_CL][i];
+                ClInfo *cp = &clinfo[rr->slot];
+                Property *pp = j == 0 ? &cp->props[rr->prop] : NULL;
+                q2Client (cp, notme, isblob, pp, mp, root, &slow, &nslow);
+            }
 
-    /* queue message to each interested client */
-    for (cp = clinfo; cp < &clinfo[nclinfo]; cp++) {
-        /* cp in use? notme? want this dev/name? blob? */
-        if (!cp->active || cp == notme)
-        continue;
-            if (findClDevice (cp, dev, name) < 0)
-        continue;
+        for (i = 0; i < nallcl; i++)
+            q2Client (&clinfo[allcl[i].slot], notme, isblob, NULL, mp, root,
+                                                            &slow, &nslow);
+    }
 
-            //if ((isblob && cp->blob==B_NEVER) || (!isblob && cp->blob==B_ONLY))
-            if (!isblob && cp->blob==B_ONLY)
-                continue;
+    /* shut down the clients that were too far behind, now that no route
+     * is being walked
+     */
+    for (i = 0; i < nslow; i++)
+        shutdownClient (slow[i]);
+    free (slow);
 
-            if (isblob)
-            {
-                if (cp->nprops > 0)
-                {
-                Property *pp = NULL;
-                int blob_found=0;
-                for (i = 0; i < cp->nprops; i++)
-                {
-                    pp = &cp->props[i];
-                    if (!strcmp (pp->dev, dev) && (!strcmp(pp->name, name)))
-                    {
-                        blob_found = 1;
-                        break;
-                    }
-                }
+    return (nslow ? -1 : 0);
+}
 
-                if ( (blob_found && pp->blob == B_NEVER) || (blob_found==0 && cp->blob == B_NEVER) )
-                    continue;
-               }
-               else if (cp->blob == B_NEVER)
-                   continue;
-           }
+/* queue Msg mp for client cp unless it is notme, already has it or its BLOB
+ * mode says no. pp is cp's Property for exactly this dev/name, if any.
+ * if cp's q is already too large add it to *slow instead.
+ */
+static void
+q2Client (ClInfo *cp, ClInfo *notme, int isblob, Property *pp, Msg *mp,
+    XMLEle *root, ClInfo ***slow, int *nslow)
+{
+    /* cp in use? notme? seen for this message already? */
+    if (!cp->active || cp == notme || cp->mark == routegen)
+        return;
+    cp->mark = routegen;
 
-        /* shut down this client if its q is already too large */
-        ql = msgQSize(cp->msgq);
-        if (ql > maxqsiz) {
+    /* blob? */
+    if (!isblob && cp->blob==B_ONLY)
+        return;
+    if (isblob && (pp ? pp->blob : cp->blob) == B_NEVER)
+        return;
+
+    /* shut down this client if its q is already too large */
+    if (cp->qbytes > (unsigned long)maxqsiz) {
         if (verbose)
-            fprintf (stderr, "%s: Client %d: %d bytes behind, shutting down\n",
-                            indi_tstamp(NULL), cp->s, ql);
-        shutdownClient (cp);
-        shutany++;
-        continue;
-        }
+            fprintf (stderr, "%s: Client %d: %lu bytes behind, shutting down\n",
+                            indi_tstamp(NULL), cp->s, cp->qbytes);
+        *slow = (ClInfo **) realloc (*slow, (*nslow+1)*sizeof(ClInfo *));
+        (*slow)[(*nslow)++] = cp;
+        return;
+    }
 
-        /* ok: queue message to this client */
-        mp->count++;
-        pushFQ (cp->msgq, mp);
-        if (verbose > 1)
+    /* ok: queue message to this client */
+    mp->count++;
+    pushClMsg (cp, mp);
+    if (verbose > 1)
         fprintf (stderr, "%s: Client %d: queuing <%s device='%s' name='%s'>\n",
                     indi_tstamp(NULL), cp->s, tagXMLEle(root),
                     findXMLAttValu (root, "device"),
                     findXMLAttValu (root, "name"));
-    }
-
-    return (shutany ? -1 : 0);
 }
 
 /* put Msg mp on queue of each chained server client, except notme.
@@ -1678,7 +3007,6 @@ q2Servers (ClInfo *notme, Msg *mp, XMLEle *root)
 {
     int shutany = 0;
     ClInfo *cp;
-    int ql=0;
 
     /* queue message to each interested client */
     for (cp = clinfo; cp < &clinfo[nclinfo]; cp++)
@@ -1688,12 +3016,11 @@ q2Servers (ClInfo *notme, Msg *mp, XMLEle *root)
             continue;
 
         /* shut down this client if its q is already too large */
-        ql = msgQSize(cp->msgq);
-        if (ql > maxqsiz)
+        if (cp->qbytes > (unsigned long)maxqsiz)
         {
         if (verbose)
-            fprintf (stderr, "%s: Client %d: %d bytes behind, shutting down\n",
-                            indi_tstamp(NULL), cp->s, ql);
+            fprintf (stderr, "%s: Client %d: %lu bytes behind, shutting down\n",
+                            indi_tstamp(NULL), cp->s, cp->qbytes);
         shutdownClient (cp);
         shutany++;
         continue;
@@ -1701,7 +3028,7 @@ q2Servers (ClInfo *notme, Msg *mp, XMLEle *root)
 
         /* ok: queue message to this client */
         mp->count++;
-        pushFQ (cp->msgq, mp);
+        pushClMsg (cp, mp);
         if (verbose > 1)
         fprintf (stderr, "%s: Client %d: queuing <%s device='%s' name='%s'>\n",
                     indi_tstamp(NULL), cp->s, tagXMLEle(root),
@@ -1712,31 +3039,260 @@ q2Servers (ClInfo *notme, Msg *mp, XMLEle *root)
     return (shutany ? -1 : 0);
 }
 
-/* return size of all Msqs on the given q */
+/* what compactMsgQ() hands keepMsg() */
+typedef struct {
+    char *stale;			/* flag per Msg on the queue */
+    unsigned long *qbytes;
+    void (*retire)(Msg *mp, void *arg);
+    void *arg;
+} Compaction;
+
+/* drop Msgs on a client queue q that a later Msg has made stale, passing
+ * each to retire. a Msg is stale only if the next Msg for the same device
+ * and property is the same kind of update: the same state and elements, and
+ * neither carries a message. so no element value, message or state change
+ * is ever lost, only repeats of it are skipped. the Msg being written right
+ * now, nsent bytes in, is never dropped.
+ * called each time a congested client falls another lowater bytes behind,
+ * so the cost is spread over the bytes queued meanwhile.
+ * return number of Msgs dropped.
+ */
+static int
+compactMsgQ (FQ *q, unsigned int nsent, unsigned long *qbytes,
+    void (*retire)(Msg *mp, void *arg), void *arg)
+{
+    int i, n = nFQ(q), ndrop = 0;
+    unsigned int mask = 1;
+    Compaction c;
+    Msg **next;
+
+    /* open-addressed table of the next newer Msg per property */
+    while (mask < 2*(unsigned int)n)
+        mask <<= 1;
+    next = (Msg **) calloc (mask, sizeof(Msg *));
+    c.stale = (char *) calloc (n > 0 ? n : 1, 1);
+    if (!next || !c.stale) {
+        /* no harm done, just try again later */
+        free (next);
+        free (c.stale);
+        return (0);
+    }
+    mask--;
+
+    /* walk newest to oldest, comparing each Msg with the next one after it */
+    for (i = n-1; i >= 0; i--) {
+        Msg *mp = (Msg *) peekiFQ (q, i);
+        unsigned int h;
+
+        if (!mp->name[0])
+            continue;
+        h = hashDevName (mp->dev, mp->name) & mask;
+        while (next[h] && (strcmp (next[h]->name, mp->name) ||
+                                            strcmp (next[h]->dev, mp->dev)))
+            h = (h+1) & mask;
+        if (next[h] && mp->key && next[h]->key && !strcmp (mp->key, next[h]->key)
+                                                && !(i == 0 && nsent > 0)) {
+            c.stale[i] = 1;
+            ndrop++;
+        } else
+            next[h] = mp;
+    }
+
+    /* remove them in place */
+    if (ndrop > 0) {
+        c.qbytes = qbytes;
+        c.retire = retire;
+        c.arg = arg;
+        filterFQ (q, keepMsg, &c);
+    }
+
+    free (next);
+    free (c.stale);
+
+    return (ndrop);
+}
+
+/* filterFQ() callback for compactMsgQ(): retire Msg e, number i on the
+ * queue, if it is stale.
+ * return 1 to keep it, 0 if retired.
+ */
 static int
-msgQSize (FQ *q)
+keepMsg (void *e, int i, void *arg)
+{
+    Compaction *cp = (Compaction *) arg;
+    Msg *mp = (Msg *) e;
+
+    if (!cp->stale[i])
+        return (1);
+    *cp->qbytes -= mp->cl;
+    (*cp->retire) (mp, cp->arg);
+    return (0);
+}
+
+/* return a malloced key of the state and element names of set*Vector root
+ * if a later one with the same key may make it stale, NULL if it carries a
+ * message so must always be delivered, or if there is no memory.
+ */
+static char *
+msgKey (XMLEle *root)
+{
+    const char *state = findXMLAttValu (root, "state");
+    size_t len, n;
+    XMLEle *ep;
+    char *key;
+
+    if (findXMLAtt (root, "message"))
+        return (NULL);
+
+    /* "state\nelement\nelement..." */
+    len = strlen (state) + 1;
+    for (ep = nextXMLEle (root, 1); ep; ep = nextXMLEle (root, 0))
+        len += strlen (findXMLAttValu (ep, "name")) + 1;
+    key = (char *) malloc (len);
+    if (!key)
+        return (NULL);
+    n = strlen (state);
+    memcpy (key, state, n);
+    for (ep = nextXMLEle (root, 1); ep; ep = nextXMLEle (root, 0)) {
+        const char *name = findXMLAttValu (ep, "name");
+        key[n++] = '\n';
+        memcpy (key + n, name, strlen (name));
+        n += strlen (name);
+    }
+    key[n] = '\0';
+
+    return (key);
+}
+
+/* return a FNV-1a hash of device dev and property name */
+static unsigned int
+hashDevName (const char *dev, const char *name)
+{
+    unsigned int h = 2166136261u;
+
+    while (*dev)
+        h = (h ^ (unsigned char)*dev++) * 16777619u;
+    h = (h ^ '.') * 16777619u;
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+
+    return (h);
+}
+
+/* return the Route for exactly dev/name, else NULL or, if create, a new
+ * empty one.
+ */
+static Route *
+findRoute (const char *dev, const char *name, int create)
 {
-    int i, l = 0;
+    unsigned int h = hashDevName (dev, name);
+    Route *rp;
+    int i;
 
-    for (i = 0; i < nFQ(q); i++) {
-        Msg *mp = (Msg *) peekiFQ(q,i);
-        l += mp->cl;
+    if (nbuckets) {
+        for (rp = routes[h & (nbuckets-1)]; rp; rp = rp->next)
+            if (rp->hash == h && !strcmp (rp->dev, dev) &&
+                                                !strcmp (rp->name, name))
+                return (rp);
     }
+    if (!create)
+        return (NULL);
+
+    /* keep chains short */
+    if (nroutes >= 2*nbuckets) {
+        int nnb = nbuckets ? 2*nbuckets : 64;
+        Route **nrt = (Route **) calloc (nnb, sizeof(Route *));
+
+        for (i = 0; i < nbuckets; i++) {
+            while ((rp = routes[i]) != NULL) {
+                routes[i] = rp->next;
+                rp->next = nrt[rp->hash & (nnb-1)];
+                nrt[rp->hash & (nnb-1)] = rp;
+            }
+        }
+        free (routes);
+        routes = nrt;
+        nbuckets = nnb;
+    }
+
+    rp = (Route *) calloc (1, sizeof(Route));
+    rp->hash = h;
+    strncpy (rp->dev, dev, MAXINDIDEVICE-1);
+    strncpy (rp->name, name, MAXINDINAME-1);
+    rp->next = routes[h & (nbuckets-1)];
+    routes[h & (nbuckets-1)] = rp;
+    nroutes++;
+
+    return (rp);
+}
+
+/* note slot, with its entry prop, as a kind of consumer of dev/name.
+ */
+static void
+addRouteRef (const char *dev, const char *name, int kind, int slot, int prop)
+{
+    Route *rp = findRoute (dev, name, 1);
+
+    pushRef (&rp->refs[kind], &rp->nrefs[kind], slot, prop);
+}
+
+/* forget slot as a kind of consumer of dev/name, and the Route itself once
+ * nothing refers to it.
+ */
+static void
+rmRouteRef (const char *dev, const char *name, int kind, int slot)
+{
+    Route *rp = findRoute (dev, name, 0);
+    Route **rpp;
+    int i;
+
+    if (!rp)
+        return;
+    pullRef (rp->refs[kind], &rp->nrefs[kind], slot);
+
+    for (i = 0; i < NRTKINDS; i++)
+        if (rp->nrefs[i])
+            return;
+    for (rpp = &routes[rp->hash & (nbuckets-1)]; *rpp != rp; rpp = &(*rpp)->next)
+        continue;
+    *rpp = rp->next;
+    for (i = 0; i < NRTKINDS; i++)
+        free (rp->refs[i]);
+    free (rp);
+    nroutes--;
+}
+
+/* append slot/prop to the malloced refs[].
+ */
+static void
+pushRef (RouteRef **refs, int *nrefs, int slot, int prop)
+{
+    *refs = (RouteRef *) realloc (*refs, (*nrefs+1)*sizeof(RouteRef));
+    (*refs)[*nrefs].slot = slot;
+    (*refs)[*nrefs].prop = prop;
+    (*nrefs)++;
+}
+
+/* remove all entries for slot from refs[], order is not kept.
+ */
+static void
+pullRef (RouteRef *refs, int *nrefs, int slot)
+{
+    int i;
 
-    return (l);
+    for (i = 0; i < *nrefs; )
+        if (refs[i].slot == slot)
+            refs[i] = refs[--(*nrefs)];
+        else
+            i++;
 }
 
-/* print root as content in Msg mp.
+/* print root as content in Msg mp, sized by newXMLMsg().
  */
 static void
 setMsgXMLEle (Msg *mp, XMLEle *root)
 {
-    /* want cl to only count content, but need room for final \0 */
-    mp->cl = sprlXMLEle (root, 0);
-    if (mp->cl < sizeof(mp->buf))
-        mp->cp = mp->buf;
-    else
-        mp->cp = malloc (mp->cl+1);
+    allocMsgBuf (mp);
     sprXMLEle (mp->cp, root, 0);
 }
 
@@ -1747,50 +3303,173 @@ setMsgStr (Msg *mp, char *str)
 {
     /* want cl to only count content, but need room for final \0 */
     mp->cl = strlen (str);
-    if (mp->cl < sizeof(mp->buf))
-        mp->cp = mp->buf;
-    else
-        mp->cp = malloc (mp->cl+1);
+    allocMsgBuf (mp);
     strcpy (mp->cp, str);
 }
 
+/* hand the raw element gathered in fr to Msg mp as its content.
+ */
+static void
+setMsgFrame (Msg *mp, DvrFrame *fr)
+{
+    mp->cl = fr->nraw;
+    mp->cp = fr->raw;
+    mp->pool = -1;
+    fr->raw = NULL;
+    fr->nraw = fr->mraw = 0;
+}
+
+/* give mp->cp room for mp->cl bytes plus \0, from the smallest size class
+ * that fits or from malloc if larger than any class.
+ */
+static void
+allocMsgBuf (Msg *mp)
+{
+    int i;
+
+    for (i = 0; i < NMSGPOOLS; i++) {
+        if (mp->cl < msgpoolsz[i]) {
+            MsgPool *pp = &msgpool[i];
+            mp->cp = pp->nfree > 0 ? pp->free[--pp->nfree] : malloc (msgpoolsz[i]);
+            mp->pool = i;
+            return;
+        }
+    }
+
+    mp->cp = malloc (mp->cl+1);
+    mp->pool = -1;
+}
+
 /* return pointer to one new nulled Msg
  */
 static Msg *
 newMsg (void)
 {
-    return ((Msg *) calloc (1, sizeof(Msg)));
+    Msg *mp = (Msg *) calloc (1, sizeof(Msg));
+
+    mp->pool = -1;
+    return (mp);
+}
+
+/* return pointer to one new Msg that will hold root once printed.
+ * cl is known up front so queues can account for it, but the content is only
+ * set later by setMsgXMLEle() iff anyone cares. set*Vector updates other than
+ * BLOBs are keyed so a congested client may drop them once stale.
+ */
+static Msg *
+newXMLMsg (XMLEle *root)
+{
+    Msg *mp = newMsg();
+    const char *tag = tagXMLEle (root);
+
+    /* want cl to only count content, but need room for final \0 */
+    mp->cl = sprlXMLEle (root, 0);
+
+    if (!strncmp (tag, "set", 3) && strcmp (tag, "setBLOBVector")) {
+        strncpy (mp->dev, findXMLAttValu (root, "device"), MAXINDIDEVICE-1);
+        strncpy (mp->name, findXMLAttValu (root, "name"), MAXINDINAME-1);
+        mp->key = msgKey (root);
+    }
+
+    return (mp);
 }
 
-/* free Msg mp and everything it contains */
+/* free Msg mp and everything it contains.
+ * pooled content goes back to its size class unless that is full.
+ */
 static void
 freeMsg (Msg *mp)
 {
-    if (mp->cp && mp->cp != mp->buf)
+    if (mp->cp && mp->pool >= 0 && msgpool[mp->pool].nfree < MAXPOOLED)
+        msgpool[mp->pool].free[msgpool[mp->pool].nfree++] = mp->cp;
+    else
         free (mp->cp);
+    free (mp->key);
     free (mp);
 }
 
-/* write the next chunk of the current message in the queue to the given
- * client. pop message from queue when complete and free the message if we are
- * the last one to use it. shut down this client if trouble.
- * N.B. we assume we will never be called with cp->msgq empty.
- * return 0 if ok else -1 if had to shut down.
+/* fill iov with the unsent part of the first Msg on q and as many whole
+ * Msgs after it as fit in MAXIOV entries and MAXWSIZ bytes.
+ * return number of iov entries used.
  */
 static int
-sendClientMsg (ClInfo *cp)
+gatherMsgQ (FQ *q, unsigned int nsent, struct iovec iov[MAXIOV])
 {
-    ssize_t nsend, nw;
-    Msg *mp;
+    size_t total = 0;
+    int i, n = nFQ(q);
+
+    for (i = 0; i < n && i < MAXIOV && total < MAXWSIZ; i++) {
+        Msg *mp = (Msg *) peekiFQ (q, i);
+        size_t off = i == 0 ? nsent : 0;
+        size_t len = mp->cl - off;
+
+        /* never more than MAXWSIZ to reduce blocking */
+        if (total + len > MAXWSIZ)
+            len = MAXWSIZ - total;
+        iov[i].iov_base = mp->cp + off;
+        iov[i].iov_len = len;
+        total += len;
+    }
+
+    return (i);
+}
+
+/* account for nw more bytes written from the front of q, *nsent of the
+ * first Msg having gone before. pop each completed Msg, take it off *qbytes
+ * and pass it to retire.
+ */
+static void
+consumeMsgQ (FQ *q, unsigned int *nsent, unsigned long *qbytes, size_t nw,
+    void (*retire)(Msg *mp, void *arg), void *arg)
+{
+    while (nw > 0) {
+        Msg *mp = (Msg *) peekFQ (q);
+        size_t left = mp->cl - *nsent;
+
+        if (nw < left) {
+            *nsent += nw;
+            return;
+        }
+
+        nw -= left;
+        *nsent = 0;
+        *qbytes -= mp->cl;
+        popFQ (q);
+        (*retire) (mp, arg);
+    }
+}
+
+/* retire Msg mp for one of its consumers, free it if that was the last.
+ */
+static void
+releaseMsg (Msg *mp, void *arg)
+{
+    (void) arg;
 
-    /* get current message */
-    mp = (Msg *) peekFQ (cp->msgq);
+    if (--mp->count == 0)
+        freeMsg (mp);
+}
 
-    /* send next chunk, never more than MAXWSIZ to reduce blocking */
-    nsend = mp->cl - cp->nsent;
-    if (nsend > MAXWSIZ)
-        nsend = MAXWSIZ;
-    nw = write (cp->s, &mp->cp[cp->nsent], nsend);
+/* write as much of the messages queued for the given client as one writev
+ * takes. pop each message completed and free it if we are the last one to
+ * use it. shut down this client if trouble.
+ * N.B. we assume we will never be called with cp->msgq empty.
+ * return 1 if ok, 0 if the socket would block, else -1 if had to shut down.
+ */
+static int
+sendClientMsg (ClInfo *cp)
+{
+    struct iovec iov[MAXIOV];
+    ssize_t nw;
+    int niov;
+
+    /* gather the current message and those queued behind it */
+    niov = gatherMsgQ (cp->msgq, cp->nsent, iov);
+    nw = writev (cp->s, iov, niov);
+    if (nw < 0 && errno == EINTR)
+        return (1);
+    if (nw < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return (0);
 
     /* shut down if trouble */
     if (nw <= 0) {
@@ -1806,48 +3485,44 @@ sendClientMsg (ClInfo *cp)
 
     /* trace */
     if (verbose > 2) {
-        fprintf(stderr, "%s: Client %d: sending msg copy %d nq %d:\n%.*s\n",
-                indi_tstamp(NULL), cp->s, mp->count, nFQ(cp->msgq),
-                (int)nw, &mp->cp[cp->nsent]);
+        fprintf(stderr, "%s: Client %d: sending %d bytes of %d msgs nq %d:\n%.*s\n",
+                indi_tstamp(NULL), cp->s, (int)nw, niov, nFQ(cp->msgq),
+                (int)iov[0].iov_len, (char *)iov[0].iov_base);
     } else if (verbose > 1) {
         fprintf(stderr, "%s: Client %d: sending %.50s\n", indi_tstamp(NULL),
-                            cp->s, &mp->cp[cp->nsent]);
+                            cp->s, (char *)iov[0].iov_base);
     }
 
-    /* update amount sent. when complete: free message if we are the last
-     * to use it and pop from our queue.
-     */
-    cp->nsent += nw;
-    if (cp->nsent == mp->cl) {
-        if (--mp->count == 0)
-        freeMsg (mp);
-        popFQ (cp->msgq);
-        cp->nsent = 0;
-    }
+    /* update amount sent, retiring each message completed */
+    consumeMsgQ (cp->msgq, &cp->nsent, &cp->qbytes, nw, releaseMsg, NULL);
 
-    return (0);
+    /* drained enough to forget about congestion */
+    if (cp->qbytes < lowater)
+        cp->compactat = hiwater;
+
+    return (1);
 }
 
-/* write the next chunk of the current message in the queue to the given
- * driver. pop message from queue when complete and free the message if we are
- * the last one to use it. restart this driver if touble.
+/* write as much of the messages queued for the given driver as one writev
+ * takes. pop each message completed and free it if we are the last one to
+ * use it. restart this driver if touble.
  * N.B. we assume we will never be called with dp->msgq empty.
- * return 0 if ok else -1 if had to shut down.
+ * return 1 if ok, 0 if the pipe would block, else -1 if had to shut down.
  */
 static int
 sendDriverMsg (DvrInfo *dp)
 {
-    ssize_t nsend, nw;
-    Msg *mp;
-
-    /* get current message */
-    mp = (Msg *) peekFQ (dp->msgq);
-
-    /* send next chunk, never more than MAXWSIZ to reduce blocking */
-    nsend = mp->cl - dp->nsent;
-    if (nsend > MAXWSIZ)
-        nsend = MAXWSIZ;
-    nw = write (dp->wfd, &mp->cp[dp->nsent], nsend);
+    struct iovec iov[MAXIOV];
+    ssize_t nw;
+    int niov;
+
+    /* gather the current message and those queued behind it */
+    niov = gatherMsgQ (dp->msgq, dp->nsent, iov);
+    nw = writev (dp->wfd, iov, niov);
+    if (nw < 0 && errno == EINTR)
+        return (1);
+    if (nw < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return (0);
 
     /* restart if trouble */
     if (nw <= 0) {
@@ -1863,26 +3538,76 @@ sendDriverMsg (DvrInfo *dp)
 
     /* trace */
     if (verbose > 2) {
-        fprintf(stderr, "%s: Driver %s: sending msg copy %d nq %d:\n%.*s\n",
-                indi_tstamp(NULL), dp->name, mp->count, nFQ(dp->msgq),
-                (int)nw, &mp->cp[dp->nsent]);
+        fprintf(stderr, "%s: Driver %s: sending %d bytes of %d msgs nq %d:\n%.*s\n",
+                indi_tstamp(NULL), dp->name, (int)nw, niov, nFQ(dp->msgq),
+                (int)iov[0].iov_len, (char *)iov[0].iov_base);
     } else if (verbose > 1) {
         fprintf(stderr, "%s: Driver %s: sending %.50s\n", indi_tstamp(NULL),
-                        dp->name, &mp->cp[dp->nsent]);
+                        dp->name, (char *)iov[0].iov_base);
     }
 
-    /* update amount sent. when complete: free message if we are the last
-     * to use it and pop from our queue.
+    /* update amount sent, retiring each message completed */
+    consumeMsgQ (dp->msgq, &dp->nsent, &dp->qbytes, nw, releaseMsg, NULL);
+
+    return (1);
+}
+
+/* put Msg mp on the queue of client cp and count its bytes.
+ * past the high watermark, stale updates are dropped every lowater bytes
+ * until the client drains below the low watermark again.
+ * with epoll, a queue going from empty to busy re-arms the client so the
+ * edge-triggered writer hears about it. clients written by an I/O worker
+ * have it do all this instead.
+ */
+static void
+pushClMsg (ClInfo *cp, Msg *mp)
+{
+#ifdef WITH_EPOLL
+    /* stage it for our worker, qbytes counts it until it comes back.
+     * N.B. Msgs are queued before their content is filled in, so they are
+     *   only handed over at the end of the batch by kickWorkers().
      */
-    dp->nsent += nw;
-    if (dp->nsent == mp->cl) {
-        if (--mp->count == 0)
-        freeMsg (mp);
-        popFQ (dp->msgq);
-        dp->nsent = 0;
+    if (cp->worker >= 0) {
+        pushFQ (cp->msgq, mp);
+        cp->qbytes += mp->cl;
+        if (nFQ(cp->msgq) == 1) {
+            if (nstaged == mstaged)
+                staged = (int *) realloc (staged, (mstaged += 64)*sizeof(int));
+            staged[nstaged++] = cp - clinfo;
+        }
+        return;
+    }
+#endif
+    pushFQ (cp->msgq, mp);
+    cp->qbytes += mp->cl;
+    if (cp->qbytes > cp->compactat) {
+        int ndrop = compactMsgQ (cp->msgq, cp->nsent, &cp->qbytes, releaseMsg,
+                                                                        NULL);
+        if (verbose && ndrop > 0)
+            fprintf (stderr, "%s: Client %d: %lu bytes behind, dropped %d stale updates\n",
+                            indi_tstamp(NULL), cp->s, cp->qbytes, ndrop);
+        cp->compactat = cp->qbytes + lowater;
+        if (cp->compactat < hiwater)
+            cp->compactat = hiwater;
     }
+#ifdef WITH_EPOLL
+    if (nFQ(cp->msgq) == 1)
+        watchClient (cp, EPOLL_CTL_MOD);
+#endif
+}
 
-    return (0);
+/* put Msg mp on the queue of driver dp and count its bytes, re-arming its
+ * writer as above.
+ */
+static void
+pushDvrMsg (DvrInfo *dp, Msg *mp)
+{
+    pushFQ (dp->msgq, mp);
+    dp->qbytes += mp->cl;
+#ifdef WITH_EPOLL
+    if (nFQ(dp->msgq) == 1)
+        watchDvr (dp, EPOLL_CTL_MOD);
+#endif
 }
 
 /* return 0 if cp may be interested in dev/name else -1
@@ -1890,19 +3615,28 @@ sendDriverMsg (DvrInfo *dp)
 static int
 findClDevice (ClInfo *cp, const char *dev, const char *name)
 {
-    int i;
-
         if (cp->allprops || !dev[0])
         return (0);
-        for (i = 0; i < cp->nprops; i++)
-        {
-            Property *pp = &cp->props[i];
-            if (!strcmp (pp->dev, dev) && (!pp->name[0] || !strcmp(pp->name, name)))
+        if (findClProp (cp, dev, name) || (name[0] && findClProp (cp, dev, "")))
         return (0);
-    }
     return (-1);
 }
 
+/* return cp's Property for exactly dev/name, else NULL.
+ */
+static Property *
+findClProp (ClInfo *cp, const char *dev, const char *name)
+{
+    Route *rp = findRoute (dev, name, 0);
+    int slot = cp - clinfo;
+    int i;
+
+    for (i = 0; rp && i < rp->nrefs[RT_CL]; i++)
+        if (rp->refs[RT_CL][i].slot == slot)
+            return (&cp->props[rp->refs[RT_CL][i].prop]);
+    return (NULL);
+}
+
 /* add the given device and property to the devs[] list of client if new.
  */
 static void
@@ -1910,16 +3644,11 @@ addClDevice (ClInfo *cp, const char *dev, const char *name, int isblob)
 {
     Property *pp;
     //char *ip;
-        int i=0;
 
         if (isblob)
         {
-            for (i = 0; i < cp->nprops; i++)
-            {
-                Property *pp = &cp->props[i];
-                if (!strcmp (pp->dev, dev) && (name==NULL || !strcmp(pp->name, name)))
-                    return;
-            }
+            if (findClProp (cp, dev, name))
+                return;
         }
     /* no dups */
         else if (!findClDevice (cp, dev, name))
@@ -1941,11 +3670,14 @@ addClDevice (ClInfo *cp, const char *dev, const char *name, int isblob)
         strncpy (pp->dev, dev, MAXINDIDEVICE);
         strncpy (pp->name, name, MAXINDINAME);
         pp->blob = B_NEVER;
+
+    /* index it for q2Clients() */
+    addRouteRef (pp->dev, pp->name, RT_CL, cp - clinfo, cp->nprops-1);
 }
 
 
-/* block to accept a new client arriving on lsocket.
- * return private nonblocking socket or exit.
+/* accept a new client arriving on lsocket.
+ * return private socket, -1 if none is pending, or exit.
  */
 static int
 newClSocket ()
@@ -1958,6 +3690,9 @@ newClSocket ()
     cli_len = sizeof(cli_socket);
     cli_fd = accept (lsocket, (struct sockaddr *)&cli_socket, &cli_len);
     if(cli_fd < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ||
+                                                    errno == ECONNABORTED)
+            return (-1);
         fprintf (stderr, "accept: %s\n", strerror(errno));
         Bye();
     }
@@ -2056,11 +3791,11 @@ static char *
 indi_tstamp (char *s)
 {
     static char sbuf[64];
-    struct tm *tp;
+    struct tm tm, *tp;
     time_t t;
 
     time (&t);
-    tp = gmtime (&t);
+    tp = gmtime_r (&t, &tm);
     if (!s)
         s = sbuf;
     strftime (s, sizeof(sbuf), "%Y-%m-%dT%H:%M:%S", tp);
@@ -0,0 +1,407 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+/* Software binning of 8, 16 and 32 bit frames.
+ *
+ * Each output row is made in three passes over one row of 32 bit sums:
+ *   add up the by input rows of the bin column by column,
+ *   add up each bx columns of that in place,
+ *   then scale and saturate the sums into the output pixel type.
+ * The passes run 4 to 16 pixels at a time with SSE2 where there is one, and
+ *   scaling is a multiply by a fixed point reciprocal rather than a divide.
+ *   32 bit frames use 64 bit sums, one pixel at a time.
+ * Large frames are split by output rows across several threads.
+ */
+
+/** \file binning.c
+    \brief Software binning of image frames.
+
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binning.h"
+#include "fanout.h"
+
+#if defined(__SSE2__)
+#define	BIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#define	MINSPLIT	(1<<20)		/* fewest input pixels worth a second thread */
+#define	MINROWS		16		/* fewest output rows given to a thread */
+
+/* how sums become output pixels: v = sum/div, as a shift or a multiply when
+ * exact, then saturated at max.
+ */
+typedef struct {
+    uint32_t div;			/* divisor, 1 for none */
+    int shift;				/* or shift right by this if div is 2^shift */
+    uint32_t mul;			/* or take the high 32 bits of sum*mul if not 0 */
+    uint64_t max;			/* largest output pixel */
+} Scale;
+
+/* the share of one thread */
+typedef struct {
+    const unsigned char *in;		/* first input row */
+    unsigned char *out;			/* first output row */
+    int w, bpp, bx, by;			/* as given to binImage() */
+    int ow, nrows;			/* output pixels per row, rows to do */
+    Scale sc;
+    void *acc;				/* w sums, 32 or 64 bit */
+} BinJob;
+
+static void setScale (Scale *sp, int bpp, int n, int mode);
+static void *binRows (void *arg);
+static void vsum8 (uint32_t *acc, const uint8_t *row, int n, int first);
+static void vsum16 (uint32_t *acc, const uint16_t *row, int n, int first);
+static void hsum32 (uint32_t *acc, int ow, int bx);
+static void store8 (uint8_t *out, const uint32_t *acc, int n, const Scale *sp);
+static void store16 (uint16_t *out, const uint32_t *acc, int n, const Scale *sp);
+static void binRow32 (uint32_t *out, const uint32_t *in, uint64_t *acc, int w, int ow, int bx, int by, const Scale *sp);
+
+int binImage(const void *in, void *out, int w, int h, int bpp, int bx, int by, int mode)
+{
+    BinJob jobs[FANOUT_MAXTHREADS];
+    int ow, oh, bytes, accbytes, nt, rows, i;
+    size_t inrow, outrow;
+    Scale sc;
+    char *acc;
+
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || bx < 1 || by < 1 || w < 0 || h < 0)
+        return (-1);
+
+    bytes = bpp/8;
+    ow = w/bx;
+    oh = h/by;
+    if (ow == 0 || oh == 0)
+        return (0);
+    setScale (&sc, bpp, bx*by, mode);
+
+    /* how many threads, each with at least MINROWS rows */
+    nt = fanOutThreads();
+    if ((size_t)w*h < MINSPLIT)
+        nt = 1;
+    if (nt > oh/MINROWS)
+        nt = oh/MINROWS;
+    if (nt < 1)
+        nt = 1;
+
+    accbytes = (w*(bpp == 32 ? 8 : 4) + 63) & ~63;
+    acc = (char *) malloc ((size_t)nt*accbytes);
+    if (!acc)
+        return (-1);
+
+    inrow = (size_t)w*bytes*by;
+    outrow = (size_t)ow*bytes;
+    rows = (oh + nt - 1)/nt;
+    for (i = 0; i < nt; i++) {
+        BinJob *jp = &jobs[i];
+        int y0 = i*rows;
+
+        jp->in = (const unsigned char *)in + y0*inrow;
+        jp->out = (unsigned char *)out + y0*outrow;
+        jp->w = w;
+        jp->bpp = bpp;
+        jp->bx = bx;
+        jp->by = by;
+        jp->ow = ow;
+        jp->nrows = oh - y0 < rows ? oh - y0 : rows;
+        jp->sc = sc;
+        jp->acc = acc + (size_t)i*accbytes;
+    }
+
+    fanOut (binRows, jobs, sizeof(BinJob), nt);
+
+    free (acc);
+    return ((int)(oh*outrow));
+}
+
+/* fill *sp to make sums of n pixels of bpp bits into pixels according to mode */
+static void
+setScale (Scale *sp, int bpp, int n, int mode)
+{
+    uint64_t maxpix = bpp == 8 ? 0xff : bpp == 16 ? 0xffff : 0xffffffff;
+    uint32_t d = 1;
+
+    switch (mode) {
+    case BIN_AVERAGE:
+        d = n;
+        break;
+    case BIN_AUTO:
+        if (bpp == 8 && n > 1)
+            d = n/2;
+        break;
+    default:
+        break;
+    }
+
+    memset (sp, 0, sizeof(*sp));
+    sp->div = d;
+    sp->max = maxpix;
+    while ((1u << sp->shift) < d)
+        sp->shift++;
+    if ((1u << sp->shift) != d) {
+        sp->shift = 0;
+        /* ceil(2^32/d) gives exact quotients as long as sum*d < 2^32 */
+        if (bpp < 32 && maxpix*n*d < ((uint64_t)1 << 32))
+            sp->mul = (uint32_t)((((uint64_t)1 << 32) + d - 1)/d);
+    }
+}
+
+/* bin the rows of one BinJob */
+static void *
+binRows (void *arg)
+{
+    BinJob *jp = (BinJob *)arg;
+    int bytes = jp->bpp/8;
+    size_t inrow = (size_t)jp->w*bytes;
+    int n = jp->ow*jp->bx;		/* input pixels used per row */
+    int y, k;
+
+    for (y = 0; y < jp->nrows; y++) {
+        const unsigned char *in = jp->in + y*inrow*jp->by;
+        unsigned char *out = jp->out + (size_t)y*jp->ow*bytes;
+        uint32_t *acc = (uint32_t *)jp->acc;
+
+        switch (jp->bpp) {
+        case 8:
+            for (k = 0; k < jp->by; k++)
+                vsum8 (acc, in + k*inrow, n, k == 0);
+            hsum32 (acc, jp->ow, jp->bx);
+            store8 (out, acc, jp->ow, &jp->sc);
+            break;
+        case 16:
+            for (k = 0; k < jp->by; k++)
+                vsum16 (acc, (const uint16_t *)(in + k*inrow), n, k == 0);
+            hsum32 (acc, jp->ow, jp->bx);
+            store16 ((uint16_t *)out, acc, jp->ow, &jp->sc);
+            break;
+        case 32:
+            binRow32 ((uint32_t *)out, (const uint32_t *)in, (uint64_t *)jp->acc,
+                                        jp->w, jp->ow, jp->bx, jp->by, &jp->sc);
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/* set or add the n pixels of row into acc */
+static void
+vsum8 (uint32_t *acc, const uint8_t *row, int n, int first)
+{
+    int i = 0;
+
+#if defined(BIN_SSE2)
+    const __m128i z = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)(row + i));
+        __m128i lo = _mm_unpacklo_epi8 (v, z);
+        __m128i hi = _mm_unpackhi_epi8 (v, z);
+        __m128i a0 = _mm_unpacklo_epi16 (lo, z);
+        __m128i a1 = _mm_unpackhi_epi16 (lo, z);
+        __m128i a2 = _mm_unpacklo_epi16 (hi, z);
+        __m128i a3 = _mm_unpackhi_epi16 (hi, z);
+        __m128i *ap = (__m128i *)(acc + i);
+        if (!first) {
+            a0 = _mm_add_epi32 (a0, _mm_loadu_si128 (ap));
+            a1 = _mm_add_epi32 (a1, _mm_loadu_si128 (ap+1));
+            a2 = _mm_add_epi32 (a2, _mm_loadu_si128 (ap+2));
+            a3 = _mm_add_epi32 (a3, _mm_loadu_si128 (ap+3));
+        }
+        _mm_storeu_si128 (ap, a0);
+        _mm_storeu_si128 (ap+1, a1);
+        _mm_storeu_si128 (ap+2, a2);
+        _mm_storeu_si128 (ap+3, a3);
+    }
+#endif
+
+    if (first)
+        for (; i < n; i++)
+            acc[i] = row[i];
+    else
+        for (; i < n; i++)
+            acc[i] += row[i];
+}
+
+/* set or add the n pixels of row into acc */
+static void
+vsum16 (uint32_t *acc, const uint16_t *row, int n, int first)
+{
+    int i = 0;
+
+#if defined(BIN_SSE2)
+    const __m128i z = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)(row + i));
+        __m128i a0 = _mm_unpacklo_epi16 (v, z);
+        __m128i a1 = _mm_unpackhi_epi16 (v, z);
+        __m128i *ap = (__m128i *)(acc + i);
+        if (!first) {
+            a0 = _mm_add_epi32 (a0, _mm_loadu_si128 (ap));
+            a1 = _mm_add_epi32 (a1, _mm_loadu_si128 (ap+1));
+        }
+        _mm_storeu_si128 (ap, a0);
+        _mm_storeu_si128 (ap+1, a1);
+    }
+#endif
+
+    if (first)
+        for (; i < n; i++)
+            acc[i] = row[i];
+    else
+        for (; i < n; i++)
+            acc[i] += row[i];
+}
+
+/* replace the ow*bx column sums in acc with the ow sums of each bx of them */
+static void
+hsum32 (uint32_t *acc, int ow, int bx)
+{
+    int i, j;
+
+    /* pairs at a time while bx is even */
+    for (; bx % 2 == 0; bx /= 2) {
+        int n = ow*bx/2;		/* sums after this pass */
+        i = 0;
+#if defined(BIN_SSE2)
+        for (; i + 4 <= n; i += 4) {
+            __m128 a = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *)(acc + 2*i)));
+            __m128 b = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *)(acc + 2*i + 4)));
+            __m128i ev = _mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE(2,0,2,0)));
+            __m128i od = _mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE(3,1,3,1)));
+            _mm_storeu_si128 ((__m128i *)(acc + i), _mm_add_epi32 (ev, od));
+        }
+#endif
+        for (; i < n; i++)
+            acc[i] = acc[2*i] + acc[2*i+1];
+    }
+
+    /* then any odd factor left one at a time */
+    if (bx > 1)
+        for (i = 0; i < ow; i++) {
+            uint32_t s = 0;
+            for (j = 0; j < bx; j++)
+                s += acc[i*bx + j];
+            acc[i] = s;
+        }
+}
+
+/* scale one sum */
+static uint64_t
+scale (uint64_t s, const Scale *sp)
+{
+    if (sp->mul)
+        s = (s*sp->mul) >> 32;
+    else if (sp->shift)
+        s >>= sp->shift;
+    else if (sp->div > 1)
+        s /= sp->div;
+    return (s > sp->max ? sp->max : s);
+}
+
+#if defined(BIN_SSE2)
+/* scale 4 sums, leaving them at most 2^31 so packing saturates them right */
+static __m128i
+scale128 (__m128i s, const Scale *sp)
+{
+    if (sp->mul) {
+        __m128i m = _mm_set1_epi32 ((int)sp->mul);
+        __m128i ev = _mm_mul_epu32 (s, m);
+        __m128i od = _mm_mul_epu32 (_mm_srli_epi64 (s, 32), m);
+        s = _mm_or_si128 (_mm_srli_epi64 (ev, 32),
+                          _mm_and_si128 (od, _mm_set_epi32 (-1, 0, -1, 0)));
+    } else if (sp->shift)
+        s = _mm_srli_epi32 (s, sp->shift);
+    return (s);
+}
+#endif
+
+/* scale and saturate n sums of acc into 8 bit pixels */
+static void
+store8 (uint8_t *out, const uint32_t *acc, int n, const Scale *sp)
+{
+    int i = 0;
+
+#if defined(BIN_SSE2)
+    if (sp->mul || sp->shift || sp->div == 1)
+        for (; i + 16 <= n; i += 16) {
+            const __m128i *ap = (const __m128i *)(acc + i);
+            __m128i a0 = scale128 (_mm_loadu_si128 (ap), sp);
+            __m128i a1 = scale128 (_mm_loadu_si128 (ap+1), sp);
+            __m128i a2 = scale128 (_mm_loadu_si128 (ap+2), sp);
+            __m128i a3 = scale128 (_mm_loadu_si128 (ap+3), sp);
+            __m128i lo = _mm_packs_epi32 (a0, a1);
+            __m128i hi = _mm_packs_epi32 (a2, a3);
+            _mm_storeu_si128 ((__m128i *)(out + i), _mm_packus_epi16 (lo, hi));
+        }
+#endif
+
+    for (; i < n; i++)
+        out[i] = (uint8_t) scale (acc[i], sp);
+}
+
+/* scale and saturate n sums of acc into 16 bit pixels */
+static void
+store16 (uint16_t *out, const uint32_t *acc, int n, const Scale *sp)
+{
+    int i = 0;
+
+#if defined(BIN_SSE2)
+    if (sp->mul || sp->shift || sp->div == 1) {
+        const __m128i bias = _mm_set1_epi32 (0x8000);
+        const __m128i flip = _mm_set1_epi16 ((short)0x8000);
+        for (; i + 8 <= n; i += 8) {
+            const __m128i *ap = (const __m128i *)(acc + i);
+            /* bias down so signed saturation lands at 65535 once flipped back */
+            __m128i a0 = _mm_sub_epi32 (scale128 (_mm_loadu_si128 (ap), sp), bias);
+            __m128i a1 = _mm_sub_epi32 (scale128 (_mm_loadu_si128 (ap+1), sp), bias);
+            __m128i v = _mm_xor_si128 (_mm_packs_epi32 (a0, a1), flip);
+            _mm_storeu_si128 ((__m128i *)(out + i), v);
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+        out[i] = (uint16_t) scale (acc[i], sp);
+}
+
+/* bin one output row of 32 bit pixels at in, w wide, into out */
+static void
+binRow32 (uint32_t *out, const uint32_t *in, uint64_t *acc, int w, int ow, int bx, int by, const Scale *sp)
+{
+    int n = ow*bx;
+    int i, j, k;
+
+    for (i = 0; i < n; i++)
+        acc[i] = in[i];
+    for (k = 1; k < by; k++)
+        for (i = 0; i < n; i++)
+            acc[i] += in[(size_t)k*w + i];
+
+    for (i = 0; i < ow; i++) {
+        uint64_t s = 0;
+        for (j = 0; j < bx; j++)
+            s += acc[i*bx + j];
+        out[i] = (uint32_t) scale (s, sp);
+    }
+}
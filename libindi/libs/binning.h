@@ -0,0 +1,59 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef BINNING_H
+#define BINNING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup binning Binning Functions: Software binning of image frames
+ */
+/*@{*/
+
+/** \brief How the pixels of a bin are combined. */
+typedef enum {
+    BIN_AUTO,       /*!< 8 bit: sum divided by half the pixels in a bin. 16 and 32 bit: sum. */
+    BIN_SUM,        /*!< Sum, saturated at the largest pixel value */
+    BIN_AVERAGE     /*!< Mean, rounded down */
+} BIN_MODE;
+
+/** \brief Bin a frame of unsigned pixels.
+    \param in frame of w x h pixels, row by row.
+    \param out binned frame of (w/bx) x (h/by) pixels. Pixels past the last whole bin of each row and column are left out. out may not overlap in.
+    \param w frame width in pixels.
+    \param h frame height in pixels.
+    \param bpp bits per pixel, 8, 16 or 32.
+    \param bx horizontal binning factor.
+    \param by vertical binning factor.
+    \param mode one of BIN_MODE.
+    \return number of bytes written to out, or -1 if bpp, bx or by is not supported.
+ */
+extern int binImage(const void *in, void *out, int w, int h, int bpp, int bx, int by, int mode);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
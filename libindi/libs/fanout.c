@@ -0,0 +1,69 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+/** \file fanout.c
+    \brief Splitting work on a frame across threads.
+
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include "fanout.h"
+
+static int nthreads;			/* 0 for one per CPU */
+
+void fanOut(void *(*fn)(void *), void *args, size_t step, int n)
+{
+    pthread_t tids[FANOUT_MAXTHREADS];
+    int started[FANOUT_MAXTHREADS];
+    int i;
+
+    if (n > FANOUT_MAXTHREADS)
+        n = FANOUT_MAXTHREADS;
+
+    /* others take the later arguments, we take the first */
+    for (i = 1; i < n; i++) {
+        void *arg = (char *)args + i*step;
+        started[i] = pthread_create (&tids[i], NULL, fn, arg) == 0;
+        if (!started[i])
+            fn (arg);
+    }
+    if (n > 0)
+        fn (args);
+    for (i = 1; i < n; i++)
+        if (started[i])
+            pthread_join (tids[i], NULL);
+}
+
+int fanOutThreads(void)
+{
+    long n = nthreads;
+
+    if (n <= 0)
+        n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    return (n > FANOUT_MAXTHREADS ? FANOUT_MAXTHREADS : (int)n);
+}
+
+void fanOutSetThreads(int n)
+{
+    nthreads = n < 0 ? 0 : n;
+}
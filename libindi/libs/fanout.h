@@ -0,0 +1,63 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup fanout Fan Out Functions: Splitting work on a frame across threads
+ */
+/*@{*/
+
+/** \brief Most threads fanOut() ever runs at once. */
+#define FANOUT_MAXTHREADS   16
+
+/** \brief Run fn on each of n arguments at once and wait for them all: the first on the calling thread, each other on a
+    thread of its own. One whose thread can not be started is run on the calling thread instead.
+    \param fn function to run.
+    \param args first argument.
+    \param step bytes from one argument to the next, or 0 to give all of them args.
+    \param n number of arguments, at most FANOUT_MAXTHREADS.
+ */
+extern void fanOut(void *(*fn)(void *), void *args, size_t step, int n);
+
+/** \brief How many threads binImage(), imageMinMax(), imageStats() and zblockCompress() may split large work across.
+    \return the number given to fanOutSetThreads(), else one per CPU, and never more than FANOUT_MAXTHREADS.
+ */
+extern int fanOutThreads(void);
+
+/** \brief Set how many threads binImage(), imageMinMax(), imageStats() and zblockCompress() may split large work across.
+    \param n number of threads, 0 for one per CPU.
+ */
+extern void fanOutSetThreads(int n);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
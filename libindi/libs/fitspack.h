@@ -0,0 +1,70 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef FITSPACK_H
+#define FITSPACK_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup fitspack FITS Packing Functions: Lay out a FITS file directly in memory
+ */
+/*@{*/
+
+/** \brief Bytes in a FITS block. Headers and data units are padded to a whole number of them. */
+#define FITS_BLOCK  2880
+
+/** \brief Bytes in a FITS header card. */
+#define FITS_CARD   80
+
+/** \brief Round up to a whole number of FITS blocks.
+    \param n bytes.
+    \return n rounded up to a multiple of FITS_BLOCK.
+ */
+extern size_t fitsPadded(size_t n);
+
+/** \brief Write a FITS header from its cards.
+    \param out fitsPadded((ncards+1)*FITS_CARD) bytes.
+    \param cards ncards cards of FITS_CARD chars each, not ending with END.
+    \param ncards number of cards.
+    \return bytes written to out: the cards, an END card, and spaces to the end of the block.
+ */
+extern size_t fitsPackHeader(char *out, const char *cards, int ncards);
+
+/** \brief Convert unsigned native pixels to FITS data: big endian, less BZERO for 16 and 32 bit pixels, then zeros to the end of the block.
+    \param out fitsPadded(n*bpp/8) bytes, may not overlap in.
+    \param in n unsigned pixels.
+    \param n number of pixels.
+    \param bpp bits per pixel, 8, 16 or 32, written as BITPIX 8, 16 with BZERO 32768 or 32 with BZERO 2147483648.
+    \return bytes written to out, or 0 if bpp is not supported.
+ */
+extern size_t fitsPackData(void *out, const void *in, size_t n, int bpp);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,540 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+/* Statistics of 8, 16 and 32 bit frames.
+ *
+ * 8 and 16 bit frames are read once, into a histogram with a count for
+ *   every possible pixel value. Min, max, mean, standard deviation, median
+ *   and any coarser histogram then all follow exactly from those 256 or
+ *   65536 counts rather than from the pixels. Each thread counts into two
+ *   or four interleaved histograms so runs of equal pixels, as in dark and
+ *   flat frames, do not stall on incrementing the same count.
+ * 32 bit frames are read once for min, max and sums, then once more into a
+ *   65536 count histogram over [min, max] if a median or histogram is wanted.
+ * Min and max alone run 8 or 16 pixels at a time with SSE2 where there is one.
+ * Large frames are split evenly across several threads.
+ */
+
+/** \file imagestats.c
+    \brief Statistics of image frames.
+
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fanout.h"
+#include "imagestats.h"
+
+#if defined(__SSE2__)
+#define	STATS_SSE2
+#include <emmintrin.h>
+#endif
+
+#define	MINSPLIT	(1<<20)		/* fewest pixels worth a second thread */
+#define	NFINE		65536		/* counts in the histogram of a 32 bit frame */
+
+/* what a thread does with its share of the pixels */
+typedef enum {
+    DO_MINMAX,				/* find lo and hi */
+    DO_COUNT,				/* count every value into hist */
+    DO_SUMS,				/* find lo, hi, s and ss */
+    DO_COUNT32				/* count (v-lo)>>shift into hist */
+} JobKind;
+
+/* the share of one thread */
+typedef struct {
+    JobKind kind;
+    const void *in;			/* first pixel */
+    size_t n;				/* pixels to do */
+    int bpp;
+    uint32_t lo, hi;			/* min and max found, or given for DO_COUNT32 */
+    int shift;				/* DO_COUNT32 bin width is 1<<shift */
+    uint32_t ref;			/* DO_SUMS sums are of pixel - ref */
+    double s, ss;			/* DO_SUMS sum and sum of squares */
+    uint32_t *hist;			/* DO_COUNT and DO_COUNT32 counts */
+} StatsJob;
+
+static int runJobs (StatsJob *jobs, JobKind kind, const void *in, size_t n, int bpp, int nhist);
+static void *runJob (void *arg);
+static void minMax8 (StatsJob *jp);
+static void minMax16 (StatsJob *jp);
+static void minMax32 (StatsJob *jp);
+static void count8 (StatsJob *jp);
+static void count16 (StatsJob *jp);
+static void count32 (StatsJob *jp);
+static void sums32 (StatsJob *jp);
+static uint64_t *mergeHist (StatsJob *jobs, int nt, int nhist);
+static double rankValue (const uint64_t *hist, int nhist, uint64_t k);
+static void coarseHist (const uint64_t *hist, int nhist, uint32_t lo, int shift, ImageStats *sp);
+
+int imageMinMax(const void *in, size_t n, int bpp, double *min, double *max)
+{
+    StatsJob jobs[FANOUT_MAXTHREADS];
+    uint32_t lo, hi;
+    int nt, i;
+
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || n == 0)
+        return (-1);
+
+    nt = runJobs (jobs, DO_MINMAX, in, n, bpp, 0);
+    lo = jobs[0].lo;
+    hi = jobs[0].hi;
+    for (i = 1; i < nt; i++) {
+        if (jobs[i].lo < lo)
+            lo = jobs[i].lo;
+        if (jobs[i].hi > hi)
+            hi = jobs[i].hi;
+    }
+
+    *min = lo;
+    *max = hi;
+    return (0);
+}
+
+int imageStats(const void *in, size_t n, int bpp, int median, ImageStats *sp)
+{
+    StatsJob jobs[FANOUT_MAXTHREADS];
+    uint64_t *hist;
+    int nt, i, v;
+
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || n == 0)
+        return (-1);
+
+    if (bpp < 32) {
+        int nhist = 1 << bpp;
+        double s = 0, ss = 0;
+
+        nt = runJobs (jobs, DO_COUNT, in, n, bpp, nhist);
+        if (nt < 0)
+            return (-1);
+        hist = mergeHist (jobs, nt, nhist);
+        if (!hist)
+            return (-1);
+
+        for (v = 0; hist[v] == 0; v++)
+            continue;
+        sp->min = v;
+        for (v = nhist-1; hist[v] == 0; v--)
+            continue;
+        sp->max = v;
+
+        for (v = (int)sp->min; v <= (int)sp->max; v++)
+            s += (double)hist[v]*v;
+        sp->mean = s/n;
+        for (v = (int)sp->min; v <= (int)sp->max; v++)
+            ss += hist[v]*(v - sp->mean)*(v - sp->mean);
+        sp->stddev = sqrt (ss/n);
+
+        if (median)
+            sp->median = (rankValue (hist, nhist, (n-1)/2) + rankValue (hist, nhist, n/2))/2;
+        coarseHist (hist, nhist, 0, 0, sp);
+        free (hist);
+        return (0);
+    }
+
+    /* 32 bit: min, max and sums, relative to the first pixel to keep the
+     * squares small in flat frames
+     */
+    {
+        uint32_t lo, hi, range;
+        double s = 0, ss = 0, mean;
+        int shift, nhist;
+
+        nt = runJobs (jobs, DO_SUMS, in, n, bpp, 0);
+        lo = jobs[0].lo;
+        hi = jobs[0].hi;
+        for (i = 0; i < nt; i++) {
+            if (jobs[i].lo < lo)
+                lo = jobs[i].lo;
+            if (jobs[i].hi > hi)
+                hi = jobs[i].hi;
+            s += jobs[i].s;
+            ss += jobs[i].ss;
+        }
+        mean = s/n;
+        sp->min = lo;
+        sp->max = hi;
+        sp->mean = mean + jobs[0].ref;
+        sp->stddev = ss/n > mean*mean ? sqrt (ss/n - mean*mean) : 0;
+
+        if (!median && !sp->hist)
+            return (0);
+
+        /* then a histogram over [lo, hi] with bins 1<<shift wide */
+        range = hi - lo;
+        for (shift = 0; (range >> shift) >= NFINE; shift++)
+            continue;
+        nhist = (int)(range >> shift) + 1;
+        for (i = 0; i < FANOUT_MAXTHREADS; i++) {
+            jobs[i].lo = lo;
+            jobs[i].shift = shift;
+        }
+        nt = runJobs (jobs, DO_COUNT32, in, n, bpp, nhist);
+        if (nt < 0)
+            return (-1);
+        hist = mergeHist (jobs, nt, nhist);
+        if (!hist)
+            return (-1);
+
+        if (median) {
+            double m = (rankValue (hist, nhist, (n-1)/2) + rankValue (hist, nhist, n/2))/2;
+            /* bins wider than 1 report their middle */
+            sp->median = lo + m*((uint64_t)1 << shift) + (((uint64_t)1 << shift) - 1)/2.0;
+            if (sp->median > hi)
+                sp->median = hi;
+        }
+        coarseHist (hist, nhist, lo, shift, sp);
+        free (hist);
+        return (0);
+    }
+}
+
+/* split n pixels at in among threads to do kind, each with nhist counts if
+ * any, and wait for them all. jobs already hold lo and shift for DO_COUNT32.
+ * return number of jobs used, or -1 if no memory for their counts.
+ */
+static int
+runJobs (StatsJob *jobs, JobKind kind, const void *in, size_t n, int bpp, int nhist)
+{
+    size_t share;
+    int bytes = bpp/8;
+    int nt, i;
+
+    nt = fanOutThreads();
+    if (n < MINSPLIT)
+        nt = 1;
+
+    /* shares a multiple of 64 pixels so SIMD loads stay aligned alike */
+    share = ((n + nt - 1)/nt + 63) & ~(size_t)63;
+    for (i = 0; i < nt; i++) {
+        StatsJob *jp = &jobs[i];
+        size_t first = i*share;
+
+        if (first >= n)
+            break;
+        jp->kind = kind;
+        jp->in = (const unsigned char *)in + first*bytes;
+        jp->n = n - first < share ? n - first : share;
+        jp->bpp = bpp;
+        jp->ref = bpp == 32 ? *(const uint32_t *)in : 0;
+        jp->s = jp->ss = 0;
+        jp->hist = NULL;
+        if (nhist > 0) {
+            /* DO_COUNT keeps interleaved copies, added up in runJob */
+            int ncopies = kind == DO_COUNT ? (bpp == 8 ? 4 : 2) : 1;
+            jp->hist = (uint32_t *) calloc ((size_t)ncopies*nhist, sizeof(uint32_t));
+            if (!jp->hist) {
+                while (--i >= 0)
+                    free (jobs[i].hist);
+                return (-1);
+            }
+        }
+    }
+    nt = i;
+
+    fanOut (runJob, jobs, sizeof(StatsJob), nt);
+
+    return (nt);
+}
+
+/* do one StatsJob */
+static void *
+runJob (void *arg)
+{
+    StatsJob *jp = (StatsJob *)arg;
+
+    switch (jp->kind) {
+    case DO_MINMAX:
+        if (jp->bpp == 8)
+            minMax8 (jp);
+        else if (jp->bpp == 16)
+            minMax16 (jp);
+        else
+            minMax32 (jp);
+        break;
+    case DO_COUNT:
+        if (jp->bpp == 8)
+            count8 (jp);
+        else
+            count16 (jp);
+        break;
+    case DO_SUMS:
+        sums32 (jp);
+        break;
+    case DO_COUNT32:
+        count32 (jp);
+        break;
+    }
+
+    return (NULL);
+}
+
+static void
+minMax8 (StatsJob *jp)
+{
+    const uint8_t *p = (const uint8_t *)jp->in;
+    uint8_t lo = p[0], hi = p[0];
+    size_t i = 0;
+
+#if defined(STATS_SSE2)
+    if (jp->n >= 16) {
+        __m128i vlo = _mm_loadu_si128 ((const __m128i *)p);
+        __m128i vhi = vlo;
+        uint8_t l[16], h[16];
+        int k;
+        for (i = 16; i + 16 <= jp->n; i += 16) {
+            __m128i v = _mm_loadu_si128 ((const __m128i *)(p + i));
+            vlo = _mm_min_epu8 (vlo, v);
+            vhi = _mm_max_epu8 (vhi, v);
+        }
+        _mm_storeu_si128 ((__m128i *)l, vlo);
+        _mm_storeu_si128 ((__m128i *)h, vhi);
+        for (k = 0; k < 16; k++) {
+            if (l[k] < lo)
+                lo = l[k];
+            if (h[k] > hi)
+                hi = h[k];
+        }
+    }
+#endif
+
+    for (; i < jp->n; i++) {
+        if (p[i] < lo)
+            lo = p[i];
+        if (p[i] > hi)
+            hi = p[i];
+    }
+
+    jp->lo = lo;
+    jp->hi = hi;
+}
+
+static void
+minMax16 (StatsJob *jp)
+{
+    const uint16_t *p = (const uint16_t *)jp->in;
+    uint16_t lo = p[0], hi = p[0];
+    size_t i = 0;
+
+#if defined(STATS_SSE2)
+    if (jp->n >= 8) {
+        /* SSE2 has only signed 16 bit min and max, so flip the top bit */
+        const __m128i flip = _mm_set1_epi16 ((short)0x8000);
+        __m128i vlo = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)p), flip);
+        __m128i vhi = vlo;
+        uint16_t l[8], h[8];
+        int k;
+        for (i = 8; i + 8 <= jp->n; i += 8) {
+            __m128i v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)(p + i)), flip);
+            vlo = _mm_min_epi16 (vlo, v);
+            vhi = _mm_max_epi16 (vhi, v);
+        }
+        _mm_storeu_si128 ((__m128i *)l, _mm_xor_si128 (vlo, flip));
+        _mm_storeu_si128 ((__m128i *)h, _mm_xor_si128 (vhi, flip));
+        for (k = 0; k < 8; k++) {
+            if (l[k] < lo)
+                lo = l[k];
+            if (h[k] > hi)
+                hi = h[k];
+        }
+    }
+#endif
+
+    for (; i < jp->n; i++) {
+        if (p[i] < lo)
+            lo = p[i];
+        if (p[i] > hi)
+            hi = p[i];
+    }
+
+    jp->lo = lo;
+    jp->hi = hi;
+}
+
+static void
+minMax32 (StatsJob *jp)
+{
+    const uint32_t *p = (const uint32_t *)jp->in;
+    uint32_t lo = p[0], hi = p[0];
+    size_t i;
+
+    for (i = 0; i < jp->n; i++) {
+        uint32_t v = p[i];
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+
+    jp->lo = lo;
+    jp->hi = hi;
+}
+
+/* count 8 bit pixels into four interleaved histograms, then add them up */
+static void
+count8 (StatsJob *jp)
+{
+    const uint8_t *p = (const uint8_t *)jp->in;
+    uint32_t *h0 = jp->hist, *h1 = h0 + 256, *h2 = h1 + 256, *h3 = h2 + 256;
+    size_t i = 0;
+    int v;
+
+    for (; i + 4 <= jp->n; i += 4) {
+        h0[p[i]]++;
+        h1[p[i+1]]++;
+        h2[p[i+2]]++;
+        h3[p[i+3]]++;
+    }
+    for (; i < jp->n; i++)
+        h0[p[i]]++;
+
+    for (v = 0; v < 256; v++)
+        h0[v] += h1[v] + h2[v] + h3[v];
+}
+
+/* count 16 bit pixels into two interleaved histograms, then add them up */
+static void
+count16 (StatsJob *jp)
+{
+    const uint16_t *p = (const uint16_t *)jp->in;
+    uint32_t *h0 = jp->hist, *h1 = h0 + 65536;
+    size_t i = 0;
+    int v;
+
+    for (; i + 4 <= jp->n; i += 4) {
+        h0[p[i]]++;
+        h1[p[i+1]]++;
+        h0[p[i+2]]++;
+        h1[p[i+3]]++;
+    }
+    for (; i < jp->n; i++)
+        h0[p[i]]++;
+
+    for (v = 0; v < 65536; v++)
+        h0[v] += h1[v];
+}
+
+/* count 32 bit pixels into bins of (v-lo)>>shift */
+static void
+count32 (StatsJob *jp)
+{
+    const uint32_t *p = (const uint32_t *)jp->in;
+    uint32_t lo = jp->lo;
+    int shift = jp->shift;
+    size_t i;
+
+    for (i = 0; i < jp->n; i++)
+        jp->hist[(p[i] - lo) >> shift]++;
+}
+
+/* min, max, and sums of 32 bit pixels less ref, two lanes at a time to
+ * shorten the chains of dependent adds
+ */
+static void
+sums32 (StatsJob *jp)
+{
+    const uint32_t *p = (const uint32_t *)jp->in;
+    uint32_t lo = p[0], hi = p[0];
+    double ref = jp->ref;
+    double s0 = 0, s1 = 0, ss0 = 0, ss1 = 0;
+    size_t i = 0;
+
+    for (; i + 2 <= jp->n; i += 2) {
+        uint32_t a = p[i], b = p[i+1];
+        double da = a - ref, db = b - ref;
+        lo = a < lo ? a : lo;
+        hi = a > hi ? a : hi;
+        lo = b < lo ? b : lo;
+        hi = b > hi ? b : hi;
+        s0 += da;
+        s1 += db;
+        ss0 += da*da;
+        ss1 += db*db;
+    }
+    for (; i < jp->n; i++) {
+        double d = p[i] - ref;
+        lo = p[i] < lo ? p[i] : lo;
+        hi = p[i] > hi ? p[i] : hi;
+        s0 += d;
+        ss0 += d*d;
+    }
+
+    jp->lo = lo;
+    jp->hi = hi;
+    jp->s = s0 + s1;
+    jp->ss = ss0 + ss1;
+}
+
+/* add up and free the nhist counts of each of nt jobs.
+ * return malloced total, or NULL if no memory.
+ */
+static uint64_t *
+mergeHist (StatsJob *jobs, int nt, int nhist)
+{
+    uint64_t *hist = (uint64_t *) calloc (nhist, sizeof(uint64_t));
+    int i, v;
+
+    for (i = 0; i < nt; i++) {
+        if (hist)
+            for (v = 0; v < nhist; v++)
+                hist[v] += jobs[i].hist[v];
+        free (jobs[i].hist);
+    }
+
+    return (hist);
+}
+
+/* return the index of the bin holding the k'th smallest pixel, from 0 */
+static double
+rankValue (const uint64_t *hist, int nhist, uint64_t k)
+{
+    uint64_t seen = 0;
+    int v;
+
+    for (v = 0; v < nhist - 1; v++) {
+        seen += hist[v];
+        if (seen > k)
+            break;
+    }
+
+    return (v);
+}
+
+/* spread the nhist counts of a histogram with bins 1<<shift wide from lo
+ * over sp->nbins bins covering [sp->min, sp->max].
+ */
+static void
+coarseHist (const uint64_t *hist, int nhist, uint32_t lo, int shift, ImageStats *sp)
+{
+    uint32_t min = (uint32_t)sp->min;
+    uint64_t width = (uint64_t)((uint32_t)sp->max - min) + 1;
+    int v;
+
+    if (!sp->hist || sp->nbins <= 0)
+        return;
+
+    memset (sp->hist, 0, sp->nbins*sizeof(unsigned int));
+    for (v = 0; v < nhist; v++) {
+        uint64_t value = lo + ((uint64_t)v << shift);
+        if (hist[v] == 0 || value < min)
+            continue;
+        sp->hist[(value - min)*sp->nbins/width] += (unsigned int)hist[v];
+    }
+}
@@ -0,0 +1,72 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef IMAGESTATS_H
+#define IMAGESTATS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup imagestats Image Statistics Functions: Frame statistics computed in one pass over the pixels
+ */
+/*@{*/
+
+/** \brief Statistics of a frame. */
+typedef struct {
+    double min;             /*!< Smallest pixel */
+    double max;             /*!< Largest pixel */
+    double mean;            /*!< Mean pixel */
+    double stddev;          /*!< Population standard deviation of the pixels */
+    double median;          /*!< Median pixel, if asked for. Exact for 8 and 16 bit pixels, to within (max-min)/65536 for 32 bit */
+    unsigned int *hist;     /*!< If not NULL, filled with nbins counts of the pixels evenly spread over [min, max] */
+    int nbins;              /*!< Number of counts in hist */
+} ImageStats;
+
+/** \brief Find the smallest and largest pixel of a frame.
+    \param in n unsigned pixels.
+    \param n number of pixels.
+    \param bpp bits per pixel, 8, 16 or 32.
+    \param min set to the smallest pixel.
+    \param max set to the largest pixel.
+    \return 0 if ok, -1 if bpp is not supported or n is 0.
+ */
+extern int imageMinMax(const void *in, size_t n, int bpp, double *min, double *max);
+
+/** \brief Compute the statistics of a frame.
+    \param in n unsigned pixels.
+    \param n number of pixels.
+    \param bpp bits per pixel, 8, 16 or 32.
+    \param median whether to find the median. For 32 bit pixels this takes a second pass, as does a histogram.
+    \param sp statistics to fill. Set sp->hist and sp->nbins beforehand, sp->hist to NULL for no histogram.
+    \return 0 if ok, -1 if bpp is not supported, n is 0 or memory ran out.
+ */
+extern int imageStats(const void *in, size_t n, int bpp, int median, ImageStats *sp);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,6 +28,8 @@
 #include <locale.h>
 #include <pthread.h>
 
+#include <algorithm>
+
 #include "baseclient.h"
 #include "basedevice.h"
 #include "indicom.h"
@@ -35,6 +37,7 @@
 #include <errno.h>
 
 #define MAXINDIBUF 49152
+#define MAXQUEUEDBLOBS  2       /* setBLOBVectors of the same BLOBs kept waiting for a device, older ones are dropped */
 
 INDI::BaseClient::BaseClient()
 {
@@ -47,6 +50,14 @@ INDI::BaseClient::BaseClient()
     timeout_sec=3;
     timeout_us=0;
 
+    asyncDispatch = false;
+    asyncDecodeThreads = asyncCallbackThreads = 2;
+    decodePending = callbacksRunning = 0;
+    asyncStop = asyncDiscard = false;
+    pthread_mutex_init(&asyncLock, NULL);
+    pthread_cond_init(&decodeCond, NULL);
+    pthread_cond_init(&callbackCond, NULL);
+    pthread_mutex_init(&devicesLock, NULL);
 }
 
 INDI::BaseClient::~BaseClient()
@@ -55,6 +66,10 @@ INDI::BaseClient::~BaseClient()
     cDevices.clear();
     while(!blobModes.empty()) delete blobModes.back(), blobModes.pop_back();
     blobModes.clear();
+    pthread_cond_destroy(&decodeCond);
+    pthread_cond_destroy(&callbackCond);
+    pthread_mutex_destroy(&asyncLock);
+    pthread_mutex_destroy(&devicesLock);
 }
 
 
@@ -65,6 +80,13 @@ void INDI::BaseClient::setServer(const char * hostname, unsigned int port)
 
 }
 
+void INDI::BaseClient::setAsyncDispatch(bool enable, int decodeThreads, int callbackThreads)
+{
+    asyncDispatch = enable;
+    asyncDecodeThreads = decodeThreads > 0 ? decodeThreads : 1;
+    asyncCallbackThreads = callbackThreads > 0 ? callbackThreads : 1;
+}
+
 void INDI::BaseClient::watchDevice(const char * deviceName)
 {
     cDeviceNames.push_back(deviceName);
@@ -214,6 +236,10 @@ bool INDI::BaseClient::disconnectServer()
 
         if (svrwfp != NULL)
             fclose(svrwfp);
+
+    // Let the listener, and any callback threads, finish before the devices go
+    pthread_join(listen_thread, NULL);
+
     svrwfp = NULL;
 
     while(!cDevices.empty()) delete cDevices.back(), cDevices.pop_back();
@@ -223,8 +249,6 @@ bool INDI::BaseClient::disconnectServer()
 
     cDeviceNames.clear();
 
-    pthread_join(listen_thread, NULL);
-
     return true;
 }
 
@@ -288,12 +312,19 @@ void INDI::BaseClient::setDriverConnection(bool status, const char *deviceName)
 
 INDI::BaseDevice * INDI::BaseClient::getDevice(const char * deviceName)
 {
+    INDI::BaseDevice *dp = NULL;
+
+    pthread_mutex_lock(&devicesLock);
     vector<INDI::BaseDevice *>::const_iterator devi;
     for ( devi = cDevices.begin(); devi != cDevices.end(); ++devi)
         if (!strcmp(deviceName, (*devi)->getDeviceName()))
-            return (*devi);
+        {
+            dp = *devi;
+            break;
+        }
+    pthread_mutex_unlock(&devicesLock);
 
-    return NULL;
+    return dp;
 }
 
 void * INDI::BaseClient::listenHelper(void *context)
@@ -314,6 +345,8 @@ void INDI::BaseClient::listenINDI()
     XMLEle **nodes;
     XMLEle *root;
     int inode=0;
+
+    bool async = asyncDispatch && startAsyncDispatch();
     
     char *orig = setlocale(LC_NUMERIC,"C");
     if (cDeviceNames.empty())
@@ -348,6 +381,7 @@ void INDI::BaseClient::listenINDI()
 
 
     lillp = newLilXML();
+    arenaLilXML(lillp, 1);
 
     /* read from server, exit if find all requested properties */
     while (sConnected)
@@ -390,6 +424,8 @@ void INDI::BaseClient::listenINDI()
             nodes=parseXMLChunk(lillp, buffer, n, msg);
 
             if (!nodes) {
+                if (async)
+                    stopAsyncDispatch(false);
                 if (msg[0])
                 {
                     fprintf (stderr, "Bad XML from %s/%d: %s\n%s\n", cServer.c_str(), cPort, msg, buffer);
@@ -403,6 +439,14 @@ void INDI::BaseClient::listenINDI()
                 if (verbose)
                     prXMLEle(stderr, root, 0);
 
+                // Hand it over to be decoded and dispatched in turn
+                if (async)
+                {
+                    queueCommand(root);
+                    inode++; root=nodes[inode];
+                    continue;
+                }
+
                 if ( (err_code = dispatchCommand(root, msg)) < 0)
                 {
                     // Silenty ignore property duplication errors
@@ -425,6 +469,10 @@ void INDI::BaseClient::listenINDI()
 
     delLilXML(lillp);
 
+    // Notify what is already received of a lost server, drop it if we disconnected
+    if (async)
+        stopAsyncDispatch(sConnected == false);
+
     serverDisconnected( (sConnected == false) ? 0 : -1);
     sConnected = false;
 
@@ -432,7 +480,7 @@ void INDI::BaseClient::listenINDI()
 
 }
 
-int INDI::BaseClient::dispatchCommand(XMLEle *root, char * errmsg)
+int INDI::BaseClient::dispatchCommand(XMLEle *root, char * errmsg, IBLOB *decoded)
 {
     if  (!strcmp (tagXMLEle(root), "message"))
         return messageCmd(root, errmsg);
@@ -467,7 +515,7 @@ int INDI::BaseClient::dispatchCommand(XMLEle *root, char * errmsg)
              !strcmp (tagXMLEle(root), "setSwitchVector") ||
              !strcmp (tagXMLEle(root), "setLightVector") ||
              !strcmp (tagXMLEle(root), "setBLOBVector"))
-        return dp->setValue(root, errmsg);
+        return dp->setValue(root, errmsg, decoded);
 
     return INDI_DISPATCH_ERROR;
 }
@@ -507,40 +555,37 @@ int INDI::BaseClient::delPropertyCmd (XMLEle *root, char * errmsg)
 
 int INDI::BaseClient::deleteDevice( const char * devName, char * errmsg )
 {
-    std::vector<INDI::BaseDevice *>::iterator devicei;
+    INDI::BaseDevice *dp = findDev(devName, errmsg);
 
-    for (devicei =cDevices.begin(); devicei != cDevices.end();)
-    {
+    if (dp == NULL)
+        return INDI_DEVICE_NOT_FOUND;
 
-        if (!strcmp(devName, (*devicei)->getDeviceName()))
+    removeDevice(dp);
+
+    pthread_mutex_lock(&devicesLock);
+    std::vector<INDI::BaseDevice *>::iterator devicei;
+    for (devicei =cDevices.begin(); devicei != cDevices.end(); ++devicei)
+    {
+        if (*devicei == dp)
         {
-            removeDevice(*devicei);
-            delete *devicei;
-            devicei = cDevices.erase(devicei);
-            return 0;
+            cDevices.erase(devicei);
+            break;
         }
-        else
-            ++devicei;
     }
+    pthread_mutex_unlock(&devicesLock);
 
-    snprintf(errmsg, MAXRBUF, "Device %s not found", devName);
-    return INDI_DEVICE_NOT_FOUND;
+    delete dp;
+    return 0;
 }
 
 INDI::BaseDevice * INDI::BaseClient::findDev( const char * devName, char * errmsg )
 {
+    INDI::BaseDevice *dp = getDevice(devName);
 
-    std::vector<INDI::BaseDevice *>::const_iterator devicei;
-
-    for (devicei = cDevices.begin(); devicei != cDevices.end(); devicei++)
-    {
-        if (!strcmp(devName, (*devicei)->getDeviceName()))
-            return (*devicei);
-
-    }
+    if (dp == NULL)
+        snprintf(errmsg, MAXRBUF, "Device %s not found", devName);
 
-    snprintf(errmsg, MAXRBUF, "Device %s not found", devName);
-    return NULL;
+    return dp;
 }
 
 /* add new device */
@@ -564,7 +609,9 @@ INDI::BaseDevice * INDI::BaseClient::addDevice (XMLEle *dep, char * errmsg)
     dp->setMediator(this);
     dp->setDeviceName(device_name);
 
+    pthread_mutex_lock(&devicesLock);
     cDevices.push_back(dp);
+    pthread_mutex_unlock(&devicesLock);
 
     newDevice(dp);
 
@@ -625,6 +672,9 @@ void INDI::BaseClient::sendNewText (ITextVectorProperty *tvp)
 {
     tvp->s = IPS_BUSY;
 
+    // Keep the command whole when sent from several threads
+    flockfile(svrwfp);
+
     fprintf(svrwfp, "<newTextVector\n");
     fprintf(svrwfp, "  device='%s'\n", tvp->device);
     fprintf(svrwfp, "  name='%s'\n>", tvp->name);
@@ -639,6 +689,7 @@ void INDI::BaseClient::sendNewText (ITextVectorProperty *tvp)
     fprintf(svrwfp, "</newTextVector>\n");
 
     fflush(svrwfp);
+    funlockfile(svrwfp);
 }
 
 void INDI::BaseClient::sendNewText (const char * deviceName, const char * propertyName, const char* elementName, const char *text)
@@ -649,12 +700,13 @@ void INDI::BaseClient::sendNewText (const char * deviceName, const char * proper
     if (drv == NULL)
         return;
 
-    ITextVectorProperty *tvp = drv->getText(propertyName);
+    INDI::Property *pp = drv->getProperty(propertyName, INDI_TEXT);
+    ITextVectorProperty *tvp = pp ? pp->getText() : NULL;
 
     if (tvp == NULL)
         return;
 
-    IText * tp = IUFindText(tvp, elementName);
+    IText * tp = pp->findText(elementName);
 
     if (tp == NULL)
         return;
@@ -670,6 +722,8 @@ void INDI::BaseClient::sendNewNumber (INumberVectorProperty *nvp)
 
     nvp->s = IPS_BUSY;
 
+    flockfile(svrwfp);
+
     fprintf(svrwfp, "<newNumberVector\n");
     fprintf(svrwfp, "  device='%s'\n", nvp->device);
     fprintf(svrwfp, "  name='%s'\n>", nvp->name);
@@ -684,6 +738,7 @@ void INDI::BaseClient::sendNewNumber (INumberVectorProperty *nvp)
     fprintf(svrwfp, "</newNumberVector>\n");
 
     fflush(svrwfp);
+    funlockfile(svrwfp);
 
     setlocale(LC_NUMERIC,orig);
 }
@@ -695,12 +750,13 @@ void INDI::BaseClient::sendNewNumber (const char *deviceName, const char *proper
     if (drv == NULL)
         return;
 
-    INumberVectorProperty *nvp = drv->getNumber(propertyName);
+    INDI::Property *pp = drv->getProperty(propertyName, INDI_NUMBER);
+    INumberVectorProperty *nvp = pp ? pp->getNumber() : NULL;
 
     if (nvp == NULL)
         return;
 
-    INumber * np = IUFindNumber(nvp, elementName);
+    INumber * np = pp->findNumber(elementName);
 
     if (np == NULL)
         return;
@@ -716,6 +772,8 @@ void INDI::BaseClient::sendNewSwitch (ISwitchVectorProperty *svp)
     svp->s = IPS_BUSY;
     ISwitch *onSwitch = IUFindOnSwitch(svp);
 
+    flockfile(svrwfp);
+
     fprintf(svrwfp, "<newSwitchVector\n");
 
     fprintf(svrwfp, "  device='%s'\n", svp->device);
@@ -743,6 +801,7 @@ void INDI::BaseClient::sendNewSwitch (ISwitchVectorProperty *svp)
     fprintf(svrwfp, "</newSwitchVector>\n");
 
     fflush(svrwfp);
+    funlockfile(svrwfp);
 }
 
 void INDI::BaseClient::sendNewSwitch (const char *deviceName, const char *propertyName, const char *elementName)
@@ -752,12 +811,13 @@ void INDI::BaseClient::sendNewSwitch (const char *deviceName, const char *proper
     if (drv == NULL)
         return;
 
-    ISwitchVectorProperty *svp = drv->getSwitch(propertyName);
+    INDI::Property *pp = drv->getProperty(propertyName, INDI_SWITCH);
+    ISwitchVectorProperty *svp = pp ? pp->getSwitch() : NULL;
 
     if (svp == NULL)
         return;
 
-    ISwitch * sp = IUFindSwitch(svp, elementName);
+    ISwitch * sp = pp->findSwitch(elementName);
 
     if (sp == NULL)
         return;
@@ -770,6 +830,9 @@ void INDI::BaseClient::sendNewSwitch (const char *deviceName, const char *proper
 
 void INDI::BaseClient::startBlob( const char *devName, const char *propName, const char *timestamp)
 {
+    // Held until finishBlob(), so the BLOBs go out whole
+    flockfile(svrwfp);
+
     fprintf(svrwfp, "<newBLOBVector\n");
     fprintf(svrwfp, "  device='%s'\n", devName);
     fprintf(svrwfp, "  name='%s'\n", propName);
@@ -793,6 +856,7 @@ void INDI::BaseClient::finishBlob()
 {
     fprintf(svrwfp, "</newBLOBVector>\n");
     fflush(svrwfp);
+    funlockfile(svrwfp);
 
 }
 
@@ -868,3 +932,286 @@ INDI::BaseClient::BLOBMode *INDI::BaseClient::findBLOBMode(string device, string
     return NULL;
 }
 
+
+// Start the decode and callback threads. Returns false, to dispatch on the listener thread, if either pool has none.
+bool INDI::BaseClient::startAsyncDispatch()
+{
+    int nDecode=0, nCallback=0;
+
+    asyncStop = asyncDiscard = false;
+    decodePending = callbacksRunning = 0;
+
+    for (int i=0; i < asyncDecodeThreads + asyncCallbackThreads; i++)
+    {
+        pthread_t tid;
+        bool decoder = (i < asyncDecodeThreads);
+
+        if (pthread_create(&tid, NULL, decoder ? decodeHelper : callbackHelper, this) != 0)
+        {
+            perror("thread");
+            continue;
+        }
+
+        asyncThreads.push_back(tid);
+        if (decoder)
+            nDecode++;
+        else
+            nCallback++;
+    }
+
+    if (nDecode == 0 || nCallback == 0)
+    {
+        stopAsyncDispatch(true);
+        return false;
+    }
+
+    return true;
+}
+
+// Stop the decode and callback threads, once they have dispatched all queued commands or, if discard, as soon as they are idle
+void INDI::BaseClient::stopAsyncDispatch(bool discard)
+{
+    pthread_mutex_lock(&asyncLock);
+    asyncStop = true;
+    if (discard)
+    {
+        asyncDiscard = true;
+        decodePending -= decodeQueue.size();
+        decodeQueue.clear();
+        for (unsigned int i=0; i < readyQueues.size(); i++)
+            readyQueues[i]->scheduled = false;
+        readyQueues.clear();
+    }
+    pthread_cond_broadcast(&decodeCond);
+    pthread_cond_broadcast(&callbackCond);
+    pthread_mutex_unlock(&asyncLock);
+
+    for (unsigned int i=0; i < asyncThreads.size(); i++)
+        pthread_join(asyncThreads[i], NULL);
+    asyncThreads.clear();
+
+    // Only those discarded are left
+    map<string, DeviceQueue *>::iterator dqi;
+    for (dqi = deviceQueues.begin(); dqi != deviceQueues.end(); ++dqi)
+    {
+        DeviceQueue *dq = dqi->second;
+        while (!dq->commands.empty())
+            deleteCommand(dq->commands.front()), dq->commands.pop_front();
+        delete dq;
+    }
+    deviceQueues.clear();
+}
+
+// Queue a command received from the server behind the others of its device. Takes over root.
+void INDI::BaseClient::queueCommand(XMLEle *root)
+{
+    AsyncCommand *cmd = new AsyncCommand();
+    cmd->root = root;
+    cmd->ready = strcmp(tagXMLEle(root), "setBLOBVector") != 0;
+    cmd->decoding = false;
+    cmd->errCode = 0;
+
+    if (cmd->ready == false)
+    {
+        cmd->blobKey = findXMLAttValu(root, "name");
+        for (XMLEle *ep = nextXMLEle(root, 1); ep != NULL; ep = nextXMLEle(root, 0))
+            if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
+                cmd->blobKey += string("\n") + findXMLAttValu(ep, "name");
+    }
+
+    pthread_mutex_lock(&asyncLock);
+
+    DeviceQueue *&dq = deviceQueues[findXMLAttValu(root, "device")];
+    if (dq == NULL)
+    {
+        dq = new DeviceQueue();
+        dq->running = false;
+        dq->scheduled = false;
+    }
+
+    if (cmd->ready == false)
+        dropSuperseded(dq, cmd);
+
+    dq->commands.push_back(cmd);
+
+    if (cmd->ready)
+        scheduleQueue(dq);
+    else
+    {
+        decodeQueue.push_back(cmd);
+        decodePending++;
+        pthread_cond_signal(&decodeCond);
+    }
+
+    pthread_mutex_unlock(&asyncLock);
+}
+
+// Offer dq to the callback threads if its oldest command may be dispatched. Call with asyncLock held.
+void INDI::BaseClient::scheduleQueue(DeviceQueue *dq)
+{
+    if (asyncDiscard || dq->running || dq->scheduled || dq->commands.empty() || dq->commands.front()->ready == false)
+        return;
+
+    dq->scheduled = true;
+    readyQueues.push_back(dq);
+    pthread_cond_signal(&callbackCond);
+}
+
+// Make room for cmd, a setBLOBVector, by dropping the oldest of those it supersedes once MAXQUEUEDBLOBS of them wait in dq.
+// Those being decoded are left, so at most the decode threads more than that may wait. Call with asyncLock held.
+void INDI::BaseClient::dropSuperseded(DeviceQueue *dq, AsyncCommand *cmd)
+{
+    deque<AsyncCommand *>::iterator oldest = dq->commands.end();
+    int waiting = 0;
+
+    for (deque<AsyncCommand *>::iterator ci = dq->commands.begin(); ci != dq->commands.end(); ++ci)
+    {
+        if ((*ci)->blobKey != cmd->blobKey)
+            continue;
+        waiting++;
+        if ((*ci)->decoding == false && oldest == dq->commands.end())
+            oldest = ci;
+    }
+
+    if (waiting < MAXQUEUEDBLOBS || oldest == dq->commands.end())
+        return;
+
+    AsyncCommand *old = *oldest;
+    if (old->ready == false)
+    {
+        decodeQueue.erase(find(decodeQueue.begin(), decodeQueue.end(), old));
+        decodePending--;
+    }
+
+    bool front = (oldest == dq->commands.begin());
+    dq->commands.erase(oldest);
+    deleteCommand(old);
+
+    // It may have been the one that made dq ready
+    if (front && dq->scheduled && (dq->commands.empty() || dq->commands.front()->ready == false))
+    {
+        readyQueues.erase(find(readyQueues.begin(), readyQueues.end(), dq));
+        dq->scheduled = false;
+    }
+}
+
+void INDI::BaseClient::deleteCommand(AsyncCommand *cmd)
+{
+    for (unsigned int i=0; i < cmd->blobs.size(); i++)
+        free(cmd->blobs[i].blob);
+    delXMLEle(cmd->root);
+    delete cmd;
+}
+
+void * INDI::BaseClient::decodeHelper(void *context)
+{
+    (static_cast<INDI::BaseClient *> (context))->decodeThread();
+    return NULL;
+}
+
+// Decode the BLOBs of queued commands oldest first. Once told to stop, finish those queued then return.
+void INDI::BaseClient::decodeThread()
+{
+    char msg[MAXRBUF];
+
+    pthread_mutex_lock(&asyncLock);
+
+    while (true)
+    {
+        while (decodeQueue.empty() && asyncStop == false)
+            pthread_cond_wait(&decodeCond, &asyncLock);
+
+        if (decodeQueue.empty())
+            break;
+
+        AsyncCommand *cmd = decodeQueue.front();
+        decodeQueue.pop_front();
+        cmd->decoding = true;
+        pthread_mutex_unlock(&asyncLock);
+
+        for (XMLEle *ep = nextXMLEle(cmd->root, 1); ep != NULL; ep = nextXMLEle(cmd->root, 0))
+        {
+            if (strcmp(tagXMLEle(ep), "oneBLOB"))
+                continue;
+
+            IBLOB blob;
+            memset(&blob, 0, sizeof(blob));
+            if (INDI::BaseDevice::decodeBLOB(ep, &blob, msg) < 0)
+            {
+                free(blob.blob);
+                cmd->errCode = -1;
+                cmd->errmsg = msg;
+                break;
+            }
+            cmd->blobs.push_back(blob);
+        }
+
+        pthread_mutex_lock(&asyncLock);
+        cmd->ready = true;
+        cmd->decoding = false;
+        decodePending--;
+        scheduleQueue(deviceQueues[findXMLAttValu(cmd->root, "device")]);
+        pthread_cond_broadcast(&callbackCond);
+    }
+
+    pthread_mutex_unlock(&asyncLock);
+}
+
+void * INDI::BaseClient::callbackHelper(void *context)
+{
+    (static_cast<INDI::BaseClient *> (context))->callbackThread();
+    return NULL;
+}
+
+// Dispatch the oldest command of each ready device in turn, no two of one device at once.
+// Once told to stop, return when nothing is ready, running or left to decode.
+void INDI::BaseClient::callbackThread()
+{
+    char msg[MAXRBUF];
+    int err_code=0;
+
+    pthread_mutex_lock(&asyncLock);
+
+    while (true)
+    {
+        while (readyQueues.empty() && (asyncStop == false || decodePending > 0 || callbacksRunning > 0))
+            pthread_cond_wait(&callbackCond, &asyncLock);
+
+        if (readyQueues.empty())
+            break;
+
+        DeviceQueue *dq = readyQueues.front();
+        readyQueues.pop_front();
+        dq->scheduled = false;
+        AsyncCommand *cmd = dq->commands.front();
+        dq->commands.pop_front();
+        dq->running = true;
+        callbacksRunning++;
+        pthread_mutex_unlock(&asyncLock);
+
+        if (cmd->errCode < 0)
+        {
+            err_code = cmd->errCode;
+            strncpy(msg, cmd->errmsg.c_str(), MAXRBUF);
+        }
+        else
+            err_code = dispatchCommand(cmd->root, msg, cmd->blobs.empty() ? NULL : &cmd->blobs[0]);
+
+        if (err_code < 0 && err_code != INDI_PROPERTY_DUPLICATED)
+        {
+            IDLog("Dispatch command error(%d): %s\n", err_code, msg);
+            prXMLEle (stderr, cmd->root, 0);
+        }
+
+        deleteCommand(cmd);
+
+        pthread_mutex_lock(&asyncLock);
+        dq->running = false;
+        callbacksRunning--;
+        scheduleQueue(dq);
+        if (asyncStop)
+            pthread_cond_broadcast(&callbackCond);
+    }
+
+    pthread_mutex_unlock(&asyncLock);
+}
@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <map>
+#include <deque>
 #include <string>
 
 #include <pthread.h>
@@ -177,10 +178,33 @@ public:
      */
     void setConnectionTimeout(uint32_t seconds, uint32_t microseconds) { timeout_sec = seconds; timeout_us = microseconds;}
 
+    /**
+     * @brief setAsyncDispatch Decode BLOBs and run notifications on threads of their own rather than on the thread
+     * listening to the server. By default everything received is parsed, decoded and notified on that one thread, so a slow
+     * newBLOB() holds up updates from all devices. In async mode BLOBs are base64 decoded and inflated by a pool of
+     * decode threads while the listener reads on, and notifications are run by a pool of callback threads. Each device's
+     * notifications still arrive one at a time in the order the server sent them, waiting for any BLOB ahead of them to be
+     * decoded, but other devices carry on meanwhile. If a device's newBLOB() falls behind, only the latest few of each of its
+     * BLOBs wait for it and older ones still waiting are dropped. Must be set before connectServer().
+     * @param enable If true, dispatch asynchronously.
+     * @param decodeThreads number of threads decoding BLOBs.
+     * @param callbackThreads number of threads running notifications, and so the most devices notified at once.
+     * @note In async mode notifications come from several threads, though never two at once for one device. Do not call
+     * disconnectServer() from a notification.
+     */
+    void setAsyncDispatch(bool enable, int decodeThreads = 2, int callbackThreads = 2);
+
+    /**
+     * @brief isAsyncDispatch Is client in async dispatch mode?
+     * @return True if BLOBs are decoded and notifications run off the listener thread.
+     */
+    bool isAsyncDispatch() const { return asyncDispatch; }
+
 protected:
 
-    /** \brief Dispatch command received from INDI server to respective devices handled by the client */
-    int dispatchCommand(XMLEle *root, char* errmsg);
+    /** \brief Dispatch command received from INDI server to respective devices handled by the client
+        \param decoded if not NULL, the BLOBs of a setBLOBVector command already decoded, one per oneBLOB element */
+    int dispatchCommand(XMLEle *root, char* errmsg, IBLOB *decoded = NULL);
 
     /** \brief Remove device */
     int deleteDevice( const char * devName, char * errmsg );
@@ -216,6 +240,55 @@ private:
     */
     void setDriverConnection(bool status, const char *deviceName);
 
+    // A command received in async mode, dispatched in turn with the others of its device
+    typedef struct
+    {
+        XMLEle *root;
+        vector<IBLOB> blobs;            // oneBLOBs of a setBLOBVector, decoded ahead of dispatch
+        string blobKey;                 // property and oneBLOB names of a setBLOBVector, to find those it supersedes
+        bool ready;                     // nothing left to decode
+        bool decoding;                  // a decode thread has it
+        int errCode;                    // decoding failed if < 0
+        string errmsg;
+    } AsyncCommand;
+
+    // Commands of one device, oldest first
+    typedef struct
+    {
+        deque<AsyncCommand *> commands;
+        bool running;                   // a callback thread is dispatching one of them
+        bool scheduled;                 // in readyQueues
+    } DeviceQueue;
+
+    bool startAsyncDispatch();
+    void stopAsyncDispatch(bool discard);
+    void queueCommand(XMLEle *root);
+    void scheduleQueue(DeviceQueue *dq);
+    void dropSuperseded(DeviceQueue *dq, AsyncCommand *cmd);
+    void deleteCommand(AsyncCommand *cmd);
+
+    // Decode threads, decode BLOBs from decodeQueue oldest first
+    static void * decodeHelper(void *context);
+    void decodeThread();
+    // Callback threads, each dispatches the oldest command of a device from readyQueues
+    static void * callbackHelper(void *context);
+    void callbackThread();
+
+    bool asyncDispatch;
+    int asyncDecodeThreads, asyncCallbackThreads;
+    vector<pthread_t> asyncThreads;
+    map<string, DeviceQueue *> deviceQueues;    // by device name, "" for commands without one
+    deque<DeviceQueue *> readyQueues;           // queues whose oldest command is ready and not running
+    deque<AsyncCommand *> decodeQueue;
+    int decodePending;                          // commands queued or being decoded
+    int callbacksRunning;
+    bool asyncStop, asyncDiscard;
+    pthread_mutex_t asyncLock;                  // guards all of the above
+    pthread_cond_t decodeCond;                  // signalled when a BLOB is queued, and to stop
+    pthread_cond_t callbackCond;                // signalled when a queue is ready or a decode is done, and to stop
+
+    pthread_mutex_t devicesLock;                // guards cDevices against callback threads of different devices
+
     pthread_t listen_thread;
 
     FILE *svrwfp;			/* FILE * to talk to server */
@@ -18,6 +18,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <unordered_map>
 #include <errno.h>
 #include <zlib.h>
 #include <locale.h>
@@ -28,6 +30,7 @@
 #include "basedevice.h"
 #include "indicom.h"
 #include "base64.h"
+#include "zblock.h"
 #include "indiproperty.h"
 
 #ifndef _WIN32
@@ -43,9 +46,20 @@
 
 using namespace std;
 
+/* every property of each name, in pAll order. stale once pAll may have been
+ * changed behind our back, then rebuilt before it is next used.
+ */
+struct INDI::BaseDevice::PropertyIndex
+{
+    std::unordered_map<std::string, std::vector<INDI::Property *> > byName;
+    bool stale;
+};
+
 INDI::BaseDevice::BaseDevice()
 {
     mediator = NULL;
+    pIndex = new PropertyIndex;
+    pIndex->stale = false;
     lp = newLilXML();
     deviceID = new char[MAXINDIDEVICE];
     memset(deviceID, 0, MAXINDIDEVICE);
@@ -64,6 +78,7 @@ INDI::BaseDevice::~BaseDevice()
 {
     delLilXML (lp);
     while(!pAll.empty()) { delete pAll.back(), pAll.pop_back(); }
+    delete pIndex;
     messageLog.clear();
 
     delete[] deviceID;
@@ -116,346 +131,105 @@ IBLOBVectorProperty * INDI::BaseDevice::getBLOB(const char *name)
 
 IPState INDI::BaseDevice::getPropertyState(const char *name)
 {
-    IPState state = IPS_IDLE;
-    INDI_PROPERTY_TYPE pType;
-    void *pPtr;
-
-    INumberVectorProperty *nvp;
-    ITextVectorProperty *tvp;
-    ISwitchVectorProperty *svp;
-    ILightVectorProperty *lvp;
-    IBLOBVectorProperty *bvp;
-
-    std::vector<INDI::Property *>::iterator orderi = pAll.begin();
-
-    for (; orderi != pAll.end(); ++orderi)
-    {
-        pType       = (*orderi)->getType();
-        pPtr        = (*orderi)->getProperty();
-
-        switch (pType)
-        {
-        case INDI_NUMBER:
-            nvp = static_cast<INumberVectorProperty *>(pPtr);
-            if (nvp == NULL)
-                continue;
-            if (!strcmp(name, nvp->name))
-                return nvp->s;
-            break;
-        case INDI_SWITCH:
-            svp = static_cast<ISwitchVectorProperty *>(pPtr);
-            if (svp == NULL)
-                continue;
-            if (!strcmp(name, svp->name))
-                return svp->s;
-            break;
-        case INDI_TEXT:
-            tvp = static_cast<ITextVectorProperty *>(pPtr);
-            if (tvp == NULL)
-                continue;
-            if (!strcmp(name, tvp->name))
-                return tvp->s;
-            break;
-        case INDI_LIGHT:
-            lvp = static_cast<ILightVectorProperty *>(pPtr);
-            if (lvp == NULL)
-                continue;
-            if (!strcmp(name, lvp->name))
-                return lvp->s;
-            break;
-        case INDI_BLOB:
-            bvp = static_cast<IBLOBVectorProperty *>(pPtr);
-            if (bvp == NULL)
-                continue;
-            if (!strcmp(name, bvp->name))
-                return bvp->s;
-            break;
-         default:
-            break;
-        }
-    }
-
-    return state;
+    INDI::Property *pp = findProperty(name, INDI_UNKNOWN, false);
 
+    return (pp ? pp->getState() : IPS_IDLE);
 }
 
 IPerm INDI::BaseDevice::getPropertyPermission(const char *name)
 {
-    IPerm perm = IP_RO;
-
-    INDI_PROPERTY_TYPE pType;
-    void *pPtr;
-
-    INumberVectorProperty *nvp;
-    ITextVectorProperty *tvp;
-    ISwitchVectorProperty *svp;
-    IBLOBVectorProperty *bvp;
+    INDI::Property *pp = findProperty(name, INDI_UNKNOWN, false);
 
-    std::vector<INDI::Property *>::iterator orderi = pAll.begin();
+    return (pp ? pp->getPermission() : IP_RO);
+}
 
-    for (; orderi != pAll.end(); ++orderi)
-    {
-        pType       = (*orderi)->getType();
-        pPtr        = (*orderi)->getProperty();
+void * INDI::BaseDevice::getRawProperty(const char *name, INDI_PROPERTY_TYPE type)
+{
+    INDI::Property *pp = findProperty(name, type, true);
 
-        switch (pType)
-        {
-        case INDI_NUMBER:
-            nvp = static_cast<INumberVectorProperty *>(pPtr);
-            if (nvp == NULL)
-                continue;
-            if (!strcmp(name, nvp->name))
-                return nvp->p;
-            break;
-        case INDI_SWITCH:
-            svp = static_cast<ISwitchVectorProperty *>(pPtr);
-            if (svp == NULL)
-                continue;
-            if (!strcmp(name, svp->name))
-                return svp->p;
-            break;
-        case INDI_TEXT:
-            tvp = static_cast<ITextVectorProperty *>(pPtr);
-            if (tvp == NULL)
-                continue;
-            if (!strcmp(name, tvp->name))
-                return tvp->p;
-            break;
-        case INDI_BLOB:
-            bvp = static_cast<IBLOBVectorProperty *>(pPtr);
-            if (bvp == NULL)
-                continue;
-            if (!strcmp(name, bvp->name))
-                return bvp->p;
-            break;
-         default:
-            break;
-        }
-    }
+    return (pp ? pp->getProperty() : NULL);
+}
 
-    return perm;
+INDI::Property * INDI::BaseDevice::getProperty(const char *name, INDI_PROPERTY_TYPE type)
+{
+    return findProperty(name, type, true);
+}
 
+std::vector<INDI::Property *> * INDI::BaseDevice::getProperties()
+{
+    pIndex->stale = true;
+    return &pAll;
 }
 
-void * INDI::BaseDevice::getRawProperty(const char *name, INDI_PROPERTY_TYPE type)
+/* return the first property in pAll of the given name and type, any type if
+ * INDI_UNKNOWN, skipping unregistered ones if registered, else NULL.
+ * only those of the same name are searched, in pAll order.
+ */
+INDI::Property * INDI::BaseDevice::findProperty(const char *name, INDI_PROPERTY_TYPE type, bool registered)
 {
-    INDI_PROPERTY_TYPE pType;
-    void *pPtr;
-    bool pRegistered = false;
+    if (name == NULL)
+        return NULL;
 
-    std::vector<INDI::Property *>::iterator orderi = pAll.begin();
+    if (pIndex->stale)
+        indexProperties();
 
-    INumberVectorProperty *nvp;
-    ITextVectorProperty *tvp;
-    ISwitchVectorProperty *svp;
-    ILightVectorProperty *lvp;
-    IBLOBVectorProperty *bvp;
+    std::unordered_map<std::string, std::vector<INDI::Property *> >::const_iterator it = pIndex->byName.find(name);
+    if (it == pIndex->byName.end())
+        return NULL;
 
-    for (; orderi != pAll.end(); ++orderi)
+    std::vector<INDI::Property *>::const_iterator orderi;
+    for (orderi = it->second.begin(); orderi != it->second.end(); ++orderi)
     {
-        pType       = (*orderi)->getType();
-        pPtr        = (*orderi)->getProperty();
-        pRegistered = (*orderi)->getRegistered();
-
-        if (type != INDI_UNKNOWN && pType != type)
+        if (type != INDI_UNKNOWN && (*orderi)->getType() != type)
             continue;
-
-        switch (pType)
-        {
-        case INDI_NUMBER:
-            nvp = static_cast<INumberVectorProperty *>(pPtr);
-            if (nvp == NULL)
-                continue;
-
-            if (!strcmp(name, nvp->name) && pRegistered)
-                return pPtr;
-             break;
-        case INDI_TEXT:
-             tvp = static_cast<ITextVectorProperty *>(pPtr);
-             if (tvp == NULL)
-                 continue;
-
-             if (!strcmp(name, tvp->name)  && pRegistered)
-                return pPtr;
-             break;
-        case INDI_SWITCH:
-             svp = static_cast<ISwitchVectorProperty *>(pPtr);
-             if (svp == NULL)
-                 continue;
-
-             //IDLog("Switch %s and aux value is now %d\n", svp->name, regStatus );
-             if (!strcmp(name, svp->name) && pRegistered)
-                 return pPtr;
-             break;
-        case INDI_LIGHT:
-             lvp = static_cast<ILightVectorProperty *>(pPtr);
-             if (lvp == NULL)
-                 continue;
-
-             if (!strcmp(name, lvp->name)  && pRegistered)
-                 return pPtr;
-             break;
-        case INDI_BLOB:
-             bvp = static_cast<IBLOBVectorProperty *>(pPtr);
-             if (bvp == NULL)
-                 continue;
-
-             if (!strcmp(name, bvp->name) && pRegistered)
-                 return pPtr;
-             break;
-        }
-
+        if (registered && !(*orderi)->getRegistered())
+            continue;
+        return *orderi;
     }
 
     return NULL;
 }
 
-INDI::Property * INDI::BaseDevice::getProperty(const char *name, INDI_PROPERTY_TYPE type)
+/* add a complete property to pAll and the indexes */
+void INDI::BaseDevice::appendProperty(INDI::Property *pp)
 {
-    INDI_PROPERTY_TYPE pType;
-    void *pPtr;
-    bool pRegistered = false;
+    pp->indexElements();
+    pAll.push_back(pp);
 
-    std::vector<INDI::Property *>::iterator orderi;
+    if (pp->getName() != NULL && !pIndex->stale)
+        pIndex->byName[pp->getName()].push_back(pp);
+}
 
-    INumberVectorProperty *nvp;
-    ITextVectorProperty *tvp;
-    ISwitchVectorProperty *svp;
-    ILightVectorProperty *lvp;
-    IBLOBVectorProperty *bvp;
+/* rebuild pIndex from pAll */
+void INDI::BaseDevice::indexProperties()
+{
+    std::vector<INDI::Property *>::iterator orderi;
 
+    pIndex->byName.clear();
     for (orderi = pAll.begin(); orderi != pAll.end(); ++orderi)
-    {
-        pType       = (*orderi)->getType();
-        pPtr        = (*orderi)->getProperty();
-        pRegistered = (*orderi)->getRegistered();
-
-        if (type != INDI_UNKNOWN && pType != type)
-            continue;
+        if ((*orderi)->getName() != NULL)
+            pIndex->byName[(*orderi)->getName()].push_back(*orderi);
 
-        switch (pType)
-        {
-        case INDI_NUMBER:
-            nvp = static_cast<INumberVectorProperty *>(pPtr);
-            if (nvp == NULL)
-                continue;
-
-            if (!strcmp(name, nvp->name) && pRegistered)
-                return *orderi;
-             break;
-        case INDI_TEXT:
-             tvp = static_cast<ITextVectorProperty *>(pPtr);
-             if (tvp == NULL)
-                 continue;
-
-             if (!strcmp(name, tvp->name)  && pRegistered)
-                return *orderi;
-             break;
-        case INDI_SWITCH:
-             svp = static_cast<ISwitchVectorProperty *>(pPtr);
-             if (svp == NULL)
-                 continue;
-
-             //IDLog("Switch %s and aux value is now %d\n", svp->name, regStatus );
-             if (!strcmp(name, svp->name) && pRegistered)
-                 return *orderi;
-             break;
-        case INDI_LIGHT:
-             lvp = static_cast<ILightVectorProperty *>(pPtr);
-             if (lvp == NULL)
-                 continue;
-
-             if (!strcmp(name, lvp->name)  && pRegistered)
-                 return *orderi;
-             break;
-        case INDI_BLOB:
-             bvp = static_cast<IBLOBVectorProperty *>(pPtr);
-             if (bvp == NULL)
-                 continue;
-
-             if (!strcmp(name, bvp->name) && pRegistered)
-                 return *orderi;
-             break;
-        }
-
-    }
-
-    return NULL;
+    pIndex->stale = false;
 }
 
 int INDI::BaseDevice::removeProperty(const char *name, char *errmsg)
 {    
-    std::vector<INDI::Property *>::iterator orderi;
+    INDI::Property *pp = findProperty(name, INDI_UNKNOWN, false);
 
-    INDI_PROPERTY_TYPE pType;
-    void *pPtr;
-
-    INumberVectorProperty *nvp;
-    ITextVectorProperty *tvp;
-    ISwitchVectorProperty *svp;
-    ILightVectorProperty *lvp;
-    IBLOBVectorProperty *bvp;
-
-    for (orderi = pAll.begin(); orderi != pAll.end(); ++orderi)
+    if (pp != NULL)
     {
-        pType       = (*orderi)->getType();
-        pPtr        = (*orderi)->getProperty();
+        std::vector<INDI::Property *> &named = pIndex->byName[name];
 
-        switch (pType)
-        {
-        case INDI_NUMBER:
-            nvp = static_cast<INumberVectorProperty *>(pPtr);
-            if (!strcmp(name, nvp->name))
-            {
-                (*orderi)->setRegistered(false);
-                delete *orderi;
-                orderi = pAll.erase(orderi);
+        named.erase(std::find(named.begin(), named.end(), pp));
+        if (named.empty())
+            pIndex->byName.erase(name);
+        pAll.erase(std::find(pAll.begin(), pAll.end(), pp));
 
-                 return 0;
-             }
-             break;
-        case INDI_TEXT:
-             tvp = static_cast<ITextVectorProperty *>(pPtr);
-             if (!strcmp(name, tvp->name))
-             {
-                  (*orderi)->setRegistered(false);
-                 delete *orderi;
-                 orderi = pAll.erase(orderi);
-
-                  return 0;
-              }
-             break;
-        case INDI_SWITCH:
-             svp = static_cast<ISwitchVectorProperty *>(pPtr);
-             if (!strcmp(name, svp->name))
-             {
-                 (*orderi)->setRegistered(false);
-                 delete *orderi;
-                 orderi = pAll.erase(orderi);
-                  return 0;
-              }
-             break;
-        case INDI_LIGHT:
-             lvp = static_cast<ILightVectorProperty *>(pPtr);
-             if (!strcmp(name, lvp->name))
-             {
-                 (*orderi)->setRegistered(false);
-                 delete *orderi;
-                 orderi = pAll.erase(orderi);
-                 return 0;
-              }
-             break;
-        case INDI_BLOB:
-             bvp = static_cast<IBLOBVectorProperty *>(pPtr);
-             if (!strcmp(name, bvp->name))
-             {
-                 (*orderi)->setRegistered(false);
-                 delete *orderi;
-                 orderi = pAll.erase(orderi);
-                 return 0;
-              }
-             break;
-        }
+        pp->setRegistered(false);
+        delete pp;
+
+        return 0;
     }
 
     snprintf(errmsg, MAXRBUF, "Error: Property %s not found in device %s.", name, deviceID);
@@ -630,7 +404,7 @@ int INDI::BaseDevice::buildProp(XMLEle *root, char *errmsg)
         indiProp->setDynamic(true);
         indiProp->setType(INDI_NUMBER);
 
-        pAll.push_back(indiProp);
+        appendProperty(indiProp);
 
         //IDLog("Adding number property %s to list.\n", nvp->name);
         if (mediator)
@@ -695,7 +469,7 @@ int INDI::BaseDevice::buildProp(XMLEle *root, char *errmsg)
             indiProp->setDynamic(true);
             indiProp->setType(INDI_SWITCH);
 
-            pAll.push_back(indiProp);
+            appendProperty(indiProp);
             //IDLog("Adding Switch property %s to list.\n", svp->name);
             if (mediator)
                 mediator->newProperty(indiProp);
@@ -756,7 +530,7 @@ else if (!strcmp (rtag, "defTextVector"))
         indiProp->setDynamic(true);
         indiProp->setType(INDI_TEXT);
 
-        pAll.push_back(indiProp);
+        appendProperty(indiProp);
 
         //IDLog("Adding Text property %s to list with initial value of %s.\n", tvp->name, tvp->tp[0].text);
         if (mediator)
@@ -814,7 +588,7 @@ else if (!strcmp (rtag, "defLightVector"))
         indiProp->setDynamic(true);
         indiProp->setType(INDI_LIGHT);
 
-        pAll.push_back(indiProp);
+        appendProperty(indiProp);
 
         //IDLog("Adding Light property %s to list.\n", lvp->name);
         if (mediator)
@@ -881,7 +655,7 @@ else if (!strcmp (rtag, "defBLOBVector"))
         indiProp->setDynamic(true);
         indiProp->setType(INDI_BLOB);
 
-        pAll.push_back(indiProp);
+        appendProperty(indiProp);
         //IDLog("Adding BLOB property %s to list.\n", bvp->name);
         if (mediator)
             mediator->newProperty(indiProp);
@@ -915,7 +689,7 @@ bool INDI::BaseDevice::isConnected()
 /*
  * return 0 if ok else -1 with reason in errmsg
  */
-int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
+int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg, IBLOB *decoded)
 {
     XMLAtt *ap;
     XMLEle *ep;
@@ -965,7 +739,8 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
 
     if (!strcmp(rtag, "setNumberVector"))
     {
-        INumberVectorProperty *nvp = getNumber(name);
+        INDI::Property *pp = getProperty(name, INDI_NUMBER);
+        INumberVectorProperty *nvp = pp ? pp->getNumber() : NULL;
         if (nvp == NULL)
         {
             snprintf(errmsg, MAXRBUF, "INDI: Could not find property %s in %s", name, deviceID);
@@ -982,7 +757,7 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
         
        for (ep = nextXMLEle (root, 1); ep != NULL; ep = nextXMLEle (root, 0))
         {
-           INumber *np =  IUFindNumber(nvp, findXMLAttValu(ep, "name"));
+           INumber *np =  pp->findNumber(findXMLAttValu(ep, "name"));
            if (!np)
                continue;
 
@@ -1004,7 +779,8 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
     }
     else if (!strcmp(rtag, "setTextVector"))
     {
-        ITextVectorProperty *tvp = getText(name);
+        INDI::Property *pp = getProperty(name, INDI_TEXT);
+        ITextVectorProperty *tvp = pp ? pp->getText() : NULL;
         if (tvp == NULL)
             return -1;
 
@@ -1016,7 +792,7 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
 
        for (ep = nextXMLEle (root, 1); ep != NULL; ep = nextXMLEle (root, 0))
         {
-           IText *tp =  IUFindText(tvp, findXMLAttValu(ep, "name"));
+           IText *tp =  pp->findText(findXMLAttValu(ep, "name"));
            if (!tp)
                continue;
 
@@ -1031,7 +807,8 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
     else if (!strcmp(rtag, "setSwitchVector"))
     {
         ISState swState;
-        ISwitchVectorProperty *svp = getSwitch(name);
+        INDI::Property *pp = getProperty(name, INDI_SWITCH);
+        ISwitchVectorProperty *svp = pp ? pp->getSwitch() : NULL;
         if (svp == NULL)
             return -1;
 
@@ -1043,7 +820,7 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
 
        for (ep = nextXMLEle (root, 1); ep != NULL; ep = nextXMLEle (root, 0))
         {
-           ISwitch *sp =  IUFindSwitch(svp, findXMLAttValu(ep, "name"));
+           ISwitch *sp =  pp->findSwitch(findXMLAttValu(ep, "name"));
            if (!sp)
                continue;
 
@@ -1059,7 +836,8 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
     else if (!strcmp(rtag, "setLightVector"))
     {
         IPState lState;
-        ILightVectorProperty *lvp = getLight(name);
+        INDI::Property *pp = getProperty(name, INDI_LIGHT);
+        ILightVectorProperty *lvp = pp ? pp->getLight() : NULL;
         if (lvp == NULL)
             return -1;
 
@@ -1068,7 +846,7 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
 
        for (ep = nextXMLEle (root, 1); ep != NULL; ep = nextXMLEle (root, 0))
         {
-           ILight *lp =  IUFindLight(lvp, findXMLAttValu(ep, "name"));
+           ILight *lp =  pp->findLight(findXMLAttValu(ep, "name"));
            if (!lp)
                continue;
 
@@ -1094,94 +872,146 @@ int INDI::BaseDevice::setValue (XMLEle *root, char * errmsg)
         if (timeoutSet)
             bvp->timeout = timeout;
 
-        return setBLOB(bvp, root, errmsg);
+        return setBLOB(bvp, root, errmsg, decoded);
     }
 
     snprintf(errmsg, MAXRBUF, "INDI: <%s> Unable to process tag", tagXMLEle(root));
     return -1;
 }
 
-/* Set BLOB vector. Process incoming data stream
+/* Set BLOB vector. Process incoming data stream, or take the BLOBs decoded
+ * ahead of time, one per oneBLOB element, from decoded if it is not NULL.
  * Return 0 if okay, -1 if error
 */
-int INDI::BaseDevice::setBLOB(IBLOBVectorProperty *bvp, XMLEle * root, char * errmsg)
+int INDI::BaseDevice::setBLOB(IBLOBVectorProperty *bvp, XMLEle * root, char * errmsg, IBLOB *decoded)
 {   
     IBLOB *blobEL;
-    unsigned char * dataBuffer=NULL;
     XMLEle *ep;
-    int n=0, r=0;
-    uLongf dataSize=0;
+    int n=0;
+
+    INDI::Property *pp = getProperty(bvp->name, INDI_BLOB);
+    if (pp && pp->getProperty() != bvp)
+        pp = NULL;
 
     /* pull out each name/BLOB pair, decode */
     for (n = 0, ep = nextXMLEle(root,1); ep; ep = nextXMLEle(root,0))
     {
         if (strcmp (tagXMLEle(ep), "oneBLOB") == 0)
         {
-            XMLAtt *na = findXMLAtt (ep, "name");
-
-            blobEL = IUFindBLOB(bvp, findXMLAttValu (ep, "name"));
+            blobEL = pp ? pp->findBLOB(findXMLAttValu (ep, "name")) : IUFindBLOB(bvp, findXMLAttValu (ep, "name"));
 
-            XMLAtt *fa = findXMLAtt (ep, "format");
-            XMLAtt *sa = findXMLAtt (ep, "size");
-            if (na && fa && sa)
+            if (decoded)
             {
-
-                blobEL->size = atoi(valuXMLAtt(sa));
+                IBLOB *dp = &decoded[n++];
+                if (blobEL == NULL)
+                    continue;
 
                 /* Blob size = 0 when only state changes */
-                if (blobEL->size == 0)
+                if (dp->size > 0)
                 {
-                    if (mediator)
-                       mediator->newBLOB(blobEL);
-                    continue;
+                    free(blobEL->blob);
+                    blobEL->blob = dp->blob;
+                    blobEL->bloblen = dp->bloblen;
+                    strncpy(blobEL->format, dp->format, MAXINDIBLOBFMT);
+                    dp->blob = NULL;
                 }
-
-                 int bloblen = pcdatalenXMLEle(ep);
-                 blobEL->blob = (unsigned char *) realloc (blobEL->blob, 3*bloblen/4);
-                 blobEL->bloblen = from64tobits_fast( static_cast<char *> (blobEL->blob), pcdataXMLEle(ep), bloblen);
-
-                 strncpy(blobEL->format, valuXMLAtt(fa), MAXINDIFORMAT);
-
-                    if (strstr(blobEL->format, ".z"))
-                    {
-                        blobEL->format[strlen(blobEL->format)-2] = '\0';
-                        dataSize = blobEL->size * sizeof(unsigned char);
-                        dataBuffer = (unsigned char *) malloc(dataSize);
-
-                        if (dataBuffer == NULL)
-                        {
-                                strncpy(errmsg, "Unable to allocate memory for data buffer", MAXRBUF);
-                                return (-1);
-                        }
-
-                        r = uncompress(dataBuffer, &dataSize, static_cast<unsigned char *> (blobEL->blob), (uLong) blobEL->bloblen);
-                        if (r != Z_OK)
-                        {
-                            snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s compression error: %d", blobEL->bvp->device, blobEL->bvp->name, blobEL->name, r);
-                            free (dataBuffer);
-                            return -1;
-                        }
-                        blobEL->size = dataSize;
-                        free(blobEL->blob);
-                        blobEL->blob = dataBuffer;
-                    }
-
-                    if (mediator)
-                        mediator->newBLOB(blobEL);
-                }
-            else
+                blobEL->size = dp->size;
+            }
+            else if (blobEL == NULL || decodeBLOB(ep, blobEL, errmsg) < 0)
             {
-                snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s No valid members.", blobEL->bvp->device, blobEL->bvp->name, blobEL->name);
+                if (blobEL == NULL)
+                    snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s No valid members.", bvp->device, bvp->name, findXMLAttValu (ep, "name"));
                 return -1;
             }
 
-           }
+            if (mediator)
+                mediator->newBLOB(blobEL);
+        }
     }
 
     return 0;
 
 }
 
+/* Decode one oneBLOB element into bp: its size, and unless that is 0, its
+ * format and data, inflated if the format says it is compressed. bp->blob is
+ * reallocated to fit, so it must be NULL or malloced.
+ * Return 0 if okay, -1 if error
+ */
+int INDI::BaseDevice::decodeBLOB(XMLEle *ep, IBLOB *bp, char *errmsg)
+{
+    unsigned char * dataBuffer=NULL;
+    uLongf dataSize=0;
+    int r=0;
+
+    XMLAtt *na = findXMLAtt (ep, "name");
+    XMLAtt *fa = findXMLAtt (ep, "format");
+    XMLAtt *sa = findXMLAtt (ep, "size");
+    if (!na || !fa || !sa)
+    {
+        XMLEle *pp = parentXMLEle(ep);
+        snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s No valid members.", findXMLAttValu(pp, "device"), findXMLAttValu(pp, "name"), findXMLAttValu(ep, "name"));
+        return -1;
+    }
+
+    bp->size = atoi(valuXMLAtt(sa));
+
+    /* Blob size = 0 when only state changes */
+    if (bp->size == 0)
+        return 0;
+
+    int bloblen = pcdatalenXMLEle(ep);
+    bp->blob = (unsigned char *) realloc (bp->blob, 3*bloblen/4);
+    bp->bloblen = from64tobits_fast( static_cast<char *> (bp->blob), pcdataXMLEle(ep), bloblen);
+
+    strncpy(bp->format, valuXMLAtt(fa), MAXINDIFORMAT);
+
+    // .sz is compressed after a byte shuffle of 16 bit pixels
+    size_t formatLen = strlen(bp->format);
+    bool shuffled = (formatLen > 3 && !strcmp(bp->format + formatLen - 3, ".sz"));
+
+    if (shuffled || strstr(bp->format, ".z"))
+    {
+        bp->format[formatLen - (shuffled ? 3 : 2)] = '\0';
+        dataSize = bp->size * sizeof(unsigned char);
+        dataBuffer = (unsigned char *) malloc(dataSize);
+
+        if (dataBuffer == NULL)
+        {
+            strncpy(errmsg, "Unable to allocate memory for data buffer", MAXRBUF);
+            return (-1);
+        }
+
+        r = uncompress(dataBuffer, &dataSize, static_cast<unsigned char *> (bp->blob), (uLong) bp->bloblen);
+        if (r != Z_OK)
+        {
+            XMLEle *pp = parentXMLEle(ep);
+            snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s compression error: %d", findXMLAttValu(pp, "device"), findXMLAttValu(pp, "name"), valuXMLAtt(na), r);
+            free (dataBuffer);
+            return -1;
+        }
+        if (shuffled)
+        {
+            // Undo the byte shuffle into a buffer of its own
+            unsigned char *plain = (unsigned char *) malloc(dataSize);
+            if (plain == NULL)
+            {
+                strncpy(errmsg, "Unable to allocate memory for data buffer", MAXRBUF);
+                free (dataBuffer);
+                return -1;
+            }
+            zblockUnshuffle(plain, dataBuffer, dataSize, 2);
+            free(dataBuffer);
+            dataBuffer = plain;
+        }
+        bp->size = dataSize;
+        free(bp->blob);
+        bp->blob = dataBuffer;
+    }
+
+    return 0;
+}
+
 void INDI::BaseDevice::setDeviceName(const char *dev)
 {
     strncpy(deviceID, dev, MAXINDINAME);
@@ -1272,7 +1102,7 @@ void INDI::BaseDevice::registerProperty(void *p, INDI_PROPERTY_TYPE type)
         pContainer->setProperty(p);
         pContainer->setType(type);
 
-        pAll.push_back(pContainer);
+        appendProperty(pContainer);
 
     }
     else if (type == INDI_TEXT)
@@ -1289,7 +1119,7 @@ void INDI::BaseDevice::registerProperty(void *p, INDI_PROPERTY_TYPE type)
        pContainer->setProperty(p);
        pContainer->setType(type);
 
-       pAll.push_back(pContainer);
+       appendProperty(pContainer);
 
 
    }
@@ -1307,7 +1137,7 @@ void INDI::BaseDevice::registerProperty(void *p, INDI_PROPERTY_TYPE type)
        pContainer->setProperty(p);
        pContainer->setType(type);
 
-       pAll.push_back(pContainer);
+       appendProperty(pContainer);
 
     }
     else if (type == INDI_LIGHT)
@@ -1324,7 +1154,7 @@ void INDI::BaseDevice::registerProperty(void *p, INDI_PROPERTY_TYPE type)
        pContainer->setProperty(p);
        pContainer->setType(type);
 
-       pAll.push_back(pContainer);
+       appendProperty(pContainer);
    }
     else if (type == INDI_BLOB)
     {
@@ -1340,7 +1170,7 @@ void INDI::BaseDevice::registerProperty(void *p, INDI_PROPERTY_TYPE type)
        pContainer->setProperty(p);
        pContainer->setType(type);
 
-       pAll.push_back(pContainer);
+       appendProperty(pContainer);
 
     }
 
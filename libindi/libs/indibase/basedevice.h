@@ -120,8 +120,9 @@ public:
     INDI::Property * getProperty(const char *name, INDI_PROPERTY_TYPE type = INDI_UNKNOWN);
 
     /** \brief Return a list of all properties in the device.
+        Since the caller may change the list, the next property lookup rebuilds the index of properties by name first.
     */
-    std::vector<INDI::Property *> * getProperties() { return &pAll; }
+    std::vector<INDI::Property *> * getProperties();
 
     /** \brief Build driver properties from a skeleton file.
         \param filename full path name of the file.
@@ -196,10 +197,17 @@ protected:
       \return 0 if parsing is successful, -1 otherwise and errmsg is set */
     int buildProp(XMLEle *root, char *errmsg);
 
-    /** \brief handle SetXXX commands from client */
-    int setValue (XMLEle *root, char * errmsg);
-    /** \brief Parse and store BLOB in the respective vector */
-    int setBLOB(IBLOBVectorProperty *pp, XMLEle * root, char * errmsg);
+    /** \brief handle SetXXX commands from client
+      \param decoded if not NULL, the BLOBs of a setBLOBVector already decoded by decodeBLOB(), one per oneBLOB element */
+    int setValue (XMLEle *root, char * errmsg, IBLOB *decoded = NULL);
+    /** \brief Parse and store BLOB in the respective vector, or store those in \e decoded if it is not NULL. Their data is moved, not copied. */
+    int setBLOB(IBLOBVectorProperty *pp, XMLEle * root, char * errmsg, IBLOB *decoded = NULL);
+    /** \brief Decode one oneBLOB element, base64 and any compression, without touching any property.
+      \param ep oneBLOB element.
+      \param bp set to its size, and unless that is 0 its format and data. bp->blob must be NULL or malloced, it is reallocated to fit.
+      \param errmsg buffer to store error message in if decoding fails.
+      \return 0 if decoding is successful, -1 otherwise and errmsg is set */
+    static int decodeBLOB(XMLEle *ep, IBLOB *bp, char *errmsg);
 
 private:
 
@@ -207,6 +215,14 @@ private:
 
     std::vector<INDI::Property *> pAll;
 
+    // Properties in pAll by name, defined in basedevice.cpp
+    struct PropertyIndex;
+    PropertyIndex *pIndex;
+
+    INDI::Property * findProperty(const char *name, INDI_PROPERTY_TYPE type, bool registered);
+    void appendProperty(INDI::Property *pp);
+    void indexProperties();
+
     LilXML *lp;
 
     std::vector<std::string> messageLog;
@@ -57,6 +57,7 @@ INDI::DefaultDevice::DefaultDevice()
     pDebug = false;
     pSimulation = false;
     isInit = false;
+    defaultConfigSaved = false;
 
     majorVersion = 1;
     minorVersion = 0;
@@ -84,7 +85,12 @@ bool INDI::DefaultDevice::loadConfig(bool silent, const char *property)
             DEBUGF(INDI::Logger::DBG_ERROR, "Error loading user configuration. %s. To save user configuration, click Save under the Configuration property in the Options tab. ", errmsg);
    }
 
-   IUSaveDefaultConfig(NULL, NULL, deviceID);
+   // Drivers load their config a property at a time, only look for the default once
+   if (defaultConfigSaved == false)
+   {
+       IUSaveDefaultConfig(NULL, NULL, deviceID);
+       defaultConfigSaved = true;
+   }
 
    return pResult;
 }
@@ -146,15 +152,18 @@ bool INDI::DefaultDevice::saveConfig(bool silent)
 {
     //std::vector<orderPtr>::iterator orderi;
     char errmsg[MAXRBUF];
+    char *data = NULL;
+    size_t len = 0;
 
     FILE *fp = NULL;
 
-    fp = IUGetConfigFP(NULL, deviceID, errmsg);
+    // Build the file in memory, IUWriteConfig() writes it whole and caches it
+    fp = open_memstream(&data, &len);
 
     if (fp == NULL)
     {
         if (silent == false)
-            DEBUGF(INDI::Logger::DBG_ERROR, "Error saving configuration. %s", errmsg);
+            DEBUGF(INDI::Logger::DBG_ERROR, "Error saving configuration. %s", strerror(errno));
         return false;
     }
 
@@ -166,6 +175,16 @@ bool INDI::DefaultDevice::saveConfig(bool silent)
 
     fclose(fp);
 
+    if (IUWriteConfig(NULL, deviceID, data, len, errmsg) < 0)
+    {
+        free(data);
+        if (silent == false)
+            DEBUGF(INDI::Logger::DBG_ERROR, "Error saving configuration. %s", errmsg);
+        return false;
+    }
+
+    free(data);
+
     IUSaveDefaultConfig(NULL, NULL, deviceID);
 
     DEBUG(INDI::Logger::DBG_DEBUG, "Configuration successfully saved.");
@@ -723,3 +742,28 @@ void INDI::DefaultDevice::defineBLOB(IBLOBVectorProperty *bvp)
     registerProperty(bvp, INDI_BLOB);
     IDDefBLOB(bvp, NULL);
 }
+
+void INDI::DefaultDevice::setPublishPolicy(INumberVectorProperty *nvp, bool skipUnchanged, double minInterval, double deadband)
+{
+    IDSetPublishPolicy(nvp, skipUnchanged, minInterval, deadband);
+}
+
+void INDI::DefaultDevice::setPublishPolicy(ITextVectorProperty *tvp, bool skipUnchanged, double minInterval)
+{
+    IDSetPublishPolicy(tvp, skipUnchanged, minInterval, 0);
+}
+
+void INDI::DefaultDevice::setPublishPolicy(ISwitchVectorProperty *svp, bool skipUnchanged, double minInterval)
+{
+    IDSetPublishPolicy(svp, skipUnchanged, minInterval, 0);
+}
+
+void INDI::DefaultDevice::setPublishPolicy(ILightVectorProperty *lvp, bool skipUnchanged, double minInterval)
+{
+    IDSetPublishPolicy(lvp, skipUnchanged, minInterval, 0);
+}
+
+void INDI::DefaultDevice::setPublishDeadband(INumberVectorProperty *nvp, const char *name, double deadband)
+{
+    IDSetPublishDeadband(nvp, name, deadband);
+}
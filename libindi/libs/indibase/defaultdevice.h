@@ -143,6 +143,31 @@ public:
     */
     void defineBLOB(IBLOBVectorProperty *bvp);
 
+    /** \brief Publish updates of a number vector only when they matter, rather than on every IDSetNumber. Updates
+               with a message or a new state always go out at once. See IDSetPublishPolicy().
+         \param nvp The number vector property
+         \param skipUnchanged If true, drop updates in which no element changed by more than its deadband.
+         \param minInterval Least seconds between updates sent. Those sooner are held and the latest is sent when the interval is up.
+         \param deadband A change in an element of no more than this counts as unchanged.
+    */
+    void setPublishPolicy(INumberVectorProperty *nvp, bool skipUnchanged, double minInterval=0, double deadband=0);
+
+    /** \brief Publish updates of a text vector only when they matter. See setPublishPolicy(INumberVectorProperty*,bool,double,double). */
+    void setPublishPolicy(ITextVectorProperty *tvp, bool skipUnchanged, double minInterval=0);
+
+    /** \brief Publish updates of a switch vector only when they matter. See setPublishPolicy(INumberVectorProperty*,bool,double,double). */
+    void setPublishPolicy(ISwitchVectorProperty *svp, bool skipUnchanged, double minInterval=0);
+
+    /** \brief Publish updates of a light vector only when they matter. See setPublishPolicy(INumberVectorProperty*,bool,double,double). */
+    void setPublishPolicy(ILightVectorProperty *lvp, bool skipUnchanged, double minInterval=0);
+
+    /** \brief Give one element of a number vector its own deadband, once it has a publish policy.
+         \param nvp The number vector property
+         \param name Name of the element
+         \param deadband A change in the element of no more than this counts as unchanged.
+    */
+    void setPublishDeadband(INumberVectorProperty *nvp, const char *name, double deadband);
+
 
     /** \brief Delete a property and unregister it. It will also be deleted from all clients.
         \param propertyName name of property to be deleted.
@@ -357,6 +382,7 @@ protected:
 private:
 
     bool isInit;
+    bool defaultConfigSaved;
     bool pDebug;
     bool pSimulation;    
 
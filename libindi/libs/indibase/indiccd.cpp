@@ -23,6 +23,8 @@
 *******************************************************************************/
 
 #include "indiccd.h"
+#include "zblock.h"
+#include "fitspack.h"
 
 #include <string.h>
 #include <time.h>
@@ -31,6 +33,8 @@
 #include <zlib.h>
 #include <errno.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <atomic>
 
 #include <libnova.h>
 #include <fitsio.h>
@@ -48,6 +52,19 @@ const char *GUIDE_CONTROL_TAB   = "Guider Control";
 const char *RAPIDGUIDE_TAB      = "Rapid Guide";
 const char *ASTROMETRY_TAB      = "Astrometry";
 
+// Images that may wait for the upload thread before ExposureComplete() blocks
+static const unsigned int UPLOAD_QUEUE_DEPTH = 2;
+// Image buffers kept for reuse, one for each queued image and one being encoded
+static const unsigned int IMAGE_POOL_DEPTH = UPLOAD_QUEUE_DEPTH + 1;
+
+// Milliseconds since t0
+static double msSince(const struct timeval *t0)
+{
+    struct timeval t1;
+    gettimeofday(&t1, NULL);
+    return (t1.tv_sec - t0->tv_sec) * 1000.0 + (t1.tv_usec - t0->tv_usec) / 1000.0;
+}
+
 // Create dir recursively
 static int _mkdir(const char *dir, mode_t mode)
 {
@@ -84,9 +101,17 @@ CCDChip::CCDChip()
     BPP = 8;
     BinX = BinY = 1;
     NAxis = 2;
+    BinMode = BIN_AUTO;
 
     BinFrame = NULL;
 
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.hist = StatsHistogram;
+    Stats.nbins = CCD_HISTOGRAM_BINS;
+    StatsValid = false;
+
+    Ring = NULL;
+
     strncpy(imageExtention, "fits", MAXINDIBLOBFMT);
 
     FrameType=LIGHT_FRAME;
@@ -99,6 +124,7 @@ CCDChip::~CCDChip()
     RawFrameSize=0;
     RawFrame=NULL;
     free (BinFrame);
+    setFrameRing(0);
 }
 
 void CCDChip::setFrameType(CCD_FRAME type)
@@ -130,6 +156,8 @@ void CCDChip::setResolution(int x, int y)
 
 void CCDChip::setFrame(int subx, int suby, int subw, int subh)
 {
+    drainFrameRing();
+
     SubX = subx;
     SubY = suby;
     SubW = subw;
@@ -145,6 +173,8 @@ void CCDChip::setFrame(int subx, int suby, int subw, int subh)
 
 void CCDChip::setBin(int hor, int ver)
 {
+    drainFrameRing();
+
     BinX = hor;
     BinY = ver;
 
@@ -198,6 +228,8 @@ void CCDChip::setPixelSize(float x, float y)
 
 void CCDChip::setBPP(int bbp)
 {
+    drainFrameRing();
+
     BPP = bbp;
 
     ImagePixelSizeN[5].value = BPP;
@@ -205,13 +237,40 @@ void CCDChip::setBPP(int bbp)
     IDSetNumber(&ImagePixelSizeNP, NULL);
 }
 
+// Head counts frames committed, tail frames released, so head-tail slots are in use.
+// Only the capture thread changes slots and their sizes, and only while none are in use.
+struct CCDChip::FrameRing
+{
+    uint8_t **frames;
+    int *size;
+    int slots;
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+};
+
 void CCDChip::setFrameBufferSize(int nbuf, bool allocMem)
 {
     if (nbuf == RawFrameSize)
         return;
 
+    drainFrameRing();
+
     RawFrameSize = nbuf;
 
+    // Nothing is in flight after the drain, so the slots may move under the processing thread
+    if (Ring)
+    {
+        for (int i=0; i < Ring->slots; i++)
+        {
+            uint8_t *frame = (uint8_t *) realloc(Ring->frames[i], nbuf > 0 ? nbuf : 1);
+            if (frame == NULL)
+                break;
+            Ring->frames[i] = frame;
+            Ring->size[i] = nbuf;
+        }
+    }
+
     if (allocMem == false)
         return;
 
@@ -221,6 +280,107 @@ void CCDChip::setFrameBufferSize(int nbuf, bool allocMem)
         BinFrame = (uint8_t *) realloc(BinFrame, nbuf * sizeof(uint8_t));
 }
 
+bool CCDChip::setFrameRing(int slots)
+{
+    if (Ring)
+    {
+        for (int i=0; i < Ring->slots; i++)
+            free(Ring->frames[i]);
+        free(Ring->frames);
+        free(Ring->size);
+        delete Ring;
+        Ring = NULL;
+    }
+
+    if (slots <= 0)
+        return true;
+
+    Ring = new FrameRing;
+    Ring->frames = (uint8_t **) calloc(slots, sizeof(uint8_t *));
+    Ring->size = (int *) calloc(slots, sizeof(int));
+    Ring->slots = 0;
+    Ring->head = Ring->tail = Ring->dropped = 0;
+    if (Ring->frames == NULL || Ring->size == NULL)
+    {
+        setFrameRing(0);
+        return false;
+    }
+
+    for (; Ring->slots < slots; Ring->slots++)
+    {
+        Ring->frames[Ring->slots] = (uint8_t *) malloc(RawFrameSize > 0 ? RawFrameSize : 1);
+        if (Ring->frames[Ring->slots] == NULL)
+        {
+            setFrameRing(0);
+            return false;
+        }
+        Ring->size[Ring->slots] = RawFrameSize;
+    }
+
+    return true;
+}
+
+int CCDChip::getFrameRingSlots()
+{
+    return Ring ? Ring->slots : 0;
+}
+
+uint32_t CCDChip::getDroppedFrames()
+{
+    return Ring ? Ring->dropped.load() : 0;
+}
+
+// Wait for the processing thread to release every frame captured with the current settings
+void CCDChip::drainFrameRing()
+{
+    if (Ring == NULL)
+        return;
+
+    while (Ring->tail.load(std::memory_order_acquire) != Ring->head.load(std::memory_order_relaxed))
+        usleep(1000);
+}
+
+uint8_t * CCDChip::getFillSlot()
+{
+    if (Ring == NULL)
+        return NULL;
+
+    uint32_t head = Ring->head.load(std::memory_order_relaxed);
+    int slot = head % Ring->slots;
+
+    // A slot left short by a failed resize can not take the frame either
+    if (head - Ring->tail.load(std::memory_order_acquire) >= (uint32_t) Ring->slots || Ring->size[slot] < RawFrameSize)
+    {
+        Ring->dropped++;
+        return NULL;
+    }
+
+    return Ring->frames[slot];
+}
+
+void CCDChip::commitFillSlot()
+{
+    Ring->head.store(Ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint8_t * CCDChip::getReadySlot()
+{
+    if (Ring == NULL)
+        return NULL;
+
+    uint32_t tail = Ring->tail.load(std::memory_order_relaxed);
+
+    if (tail == Ring->head.load(std::memory_order_acquire))
+        return NULL;
+
+    return Ring->frames[tail % Ring->slots];
+}
+
+void CCDChip::releaseReadySlot()
+{
+    Ring->tail.store(Ring->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
 void CCDChip::setExposureLeft(double duration)
 {
     ImageExposureN[0].value = duration;
@@ -282,80 +442,77 @@ void CCDChip::setImageExtension(const char *ext)
 
 void CCDChip::binFrame()
 {
-    if (BinX == 1)
+    if (BinX == 1 && BinY == 1)
         return;
 
     // Jasem: Keep full frame shadow in memory to enhance performance and just swap frame pointers after operation is complete
     if (BinFrame == NULL)
         BinFrame = (uint8_t*) malloc(RawFrameSize);
 
-    memset(BinFrame, 0, RawFrameSize);
+    int nbytes = binFrame(RawFrame, BinFrame);
+    if (nbytes < 0)
+        return;
+
+    if (nbytes < RawFrameSize)
+        memset(BinFrame + nbytes, 0, RawFrameSize - nbytes);
 
-    switch (getBPP())
-    {
-    case 8:
+    // Swap frame pointers
+    uint8_t *rawFramePointer = RawFrame;
+    RawFrame = BinFrame;
+    // We just memset it next time we use it
+    BinFrame = rawFramePointer;
+}
+
+int CCDChip::binFrame(const uint8_t *in, uint8_t *out)
+{
+    // Color frames are binned one plane at a time
+    int planes = (NAxis == 3) ? 3 : 1;
+    int planeSize = SubW * SubH * (getBPP()/8);
+    int nbytes = 0;
+
+    for (int i=0; i < planes; i++)
     {
-        uint8_t *bin_buf = BinFrame;
-        uint8_t val;
-        // Try to average pixels since in 8bit they get saturated pretty quickly
-        double factor = (BinX*BinX)/2;
-        double accumulator=0;
-        for (int i=0; i < SubH; i+= BinX)
-            for (int j=0; j < SubW; j+= BinX)
-            {
-                accumulator=0;
-                for (int k=0; k < BinX; k++)
-                {
-                    for (int l=0; l < BinX; l++)
-                    {
-                        accumulator += *(RawFrame + j + (i+k) * SubW + l);
-                    }
-                }
-
-                accumulator /= factor;
-                if (accumulator > UINT8_MAX)
-                    *bin_buf = UINT8_MAX;
-                else
-                    *bin_buf  += static_cast<uint8_t>(accumulator);
-                bin_buf++;
-            }
+        int n = binImage(in + i*planeSize, out + nbytes, SubW, SubH, getBPP(), BinX, BinY, BinMode);
+        if (n < 0)
+            return -1;
+        nbytes += n;
     }
-    break;
 
-    case 16:
+    return nbytes;
+}
+
+bool CCDChip::computeStats()
+{
+    StatsValid = false;
+
+    if (StatsS[0].s != ISS_ON)
+        return false;
+
+    // Statistics of the frame as it is sent, all planes together
+    size_t npixels = (size_t) (SubW/BinX) * (SubH/BinY) * (NAxis == 3 ? 3 : 1);
+
+    if (imageStats(RawFrame, npixels, BPP, 1, &Stats) < 0)
     {
-        uint16_t *bin_buf = (uint16_t*) BinFrame;
-        uint16_t *RawFrame16 = (uint16_t*) RawFrame;
-        uint16_t val;
-        for (int i=0; i < SubH; i+= BinX)
-            for (int j=0; j < SubW; j+= BinX)
-            {
-                for (int k=0; k < BinX; k++)
-                {
-                    for (int l=0; l < BinX; l++)
-                    {
-                        val = *(RawFrame16 + j + (i+k) * SubW + l);
-                        if (val + *bin_buf > UINT16_MAX)
-                            *bin_buf = UINT16_MAX;
-                        else
-                            *bin_buf  += val;
-                    }
-                }
-                bin_buf++;
-            }
+        StatsNP.s = IPS_ALERT;
+        IDSetNumber(&StatsNP, NULL);
+        return false;
     }
-    break;
 
-    default:
-        return;
+    StatsN[STATS_MIN].value    = Stats.min;
+    StatsN[STATS_MAX].value    = Stats.max;
+    StatsN[STATS_MEAN].value   = Stats.mean;
+    StatsN[STATS_STDDEV].value = Stats.stddev;
+    StatsN[STATS_MEDIAN].value = Stats.median;
+    StatsNP.s = IPS_OK;
+    IDSetNumber(&StatsNP, NULL);
 
-    }
+    for (int i=0; i < CCD_HISTOGRAM_BINS; i++)
+        HistogramN[i].value = StatsHistogram[i];
+    HistogramNP.s = IPS_OK;
+    IDSetNumber(&HistogramNP, NULL);
 
-    // Swap frame pointers
-    uint8_t *rawFramePointer = RawFrame;
-    RawFrame = BinFrame;
-    // We just memset it next time we use it
-    BinFrame = rawFramePointer;
+    StatsValid = true;
+    return true;
 }
 
 INDI::CCD::CCD()
@@ -386,10 +543,20 @@ INDI::CCD::CCD()
     Aperture=FocalLength=-1;
 
     streamer = NULL;
+
+    uploadRunning = false;
+    uploadStop = false;
+    pthread_mutex_init(&uploadLock, NULL);
+    pthread_cond_init(&uploadCond, NULL);
 }
 
 INDI::CCD::~CCD()
 {
+    stopUploadThread();
+    for (unsigned int i=0; i < imagePool.size(); i++)
+        free(imagePool[i].first);
+    pthread_cond_destroy(&uploadCond);
+    pthread_mutex_destroy(&uploadLock);
     delete (streamer);
 }
 
@@ -499,6 +666,12 @@ bool INDI::CCD::initProperties()
     IUFillNumber(&PrimaryCCD.RapidGuideDataN[2],"GUIDESTAR_FIT","Guide star fit","%5.2f",0,1024,0,0);
     IUFillNumberVector(&PrimaryCCD.RapidGuideDataNP,PrimaryCCD.RapidGuideDataN,3,getDeviceName(),"CCD_RAPID_GUIDE_DATA","Rapid Guide Data",RAPIDGUIDE_TAB,IP_RO,60,IPS_IDLE);
 
+    /**********************************************/
+    /********* Primary Chip Statistics  ***********/
+    /**********************************************/
+
+    initStatsProperties(&PrimaryCCD, "CCD");
+
     /**********************************************/
     /***************** Guide Chip *****************/
     /**********************************************/
@@ -560,6 +733,12 @@ bool INDI::CCD::initProperties()
     IUFillNumber(&GuideCCD.RapidGuideDataN[2],"GUIDESTAR_FIT","Guide star fit","%5.2f",0,1024,0,0);
     IUFillNumberVector(&GuideCCD.RapidGuideDataNP,GuideCCD.RapidGuideDataN,3,getDeviceName(),"GUIDER_RAPID_GUIDE_DATA","Rapid Guide Data",RAPIDGUIDE_TAB,IP_RO,60,IPS_IDLE);
 
+    /**********************************************/
+    /********* Guider Chip Statistics  ************/
+    /**********************************************/
+
+    initStatsProperties(&GuideCCD, "GUIDER");
+
     /**********************************************/
     /************** Upload Settings ***************/
     /**********************************************/
@@ -570,6 +749,16 @@ bool INDI::CCD::initProperties()
     IUFillSwitch(&UploadS[2], "UPLOAD_BOTH", "Both", ISS_OFF);
     IUFillSwitchVector(&UploadSP, UploadS, 3, getDeviceName(), "UPLOAD_MODE", "Upload", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
 
+    // Compression speed and filter, for both chips
+    IUFillSwitch(&CompressionLevelS[0], "FAST", "Fast", ISS_OFF);
+    IUFillSwitch(&CompressionLevelS[1], "DEFAULT", "Default", ISS_ON);
+    IUFillSwitch(&CompressionLevelS[2], "BEST", "Best", ISS_OFF);
+    IUFillSwitchVector(&CompressionLevelSP, CompressionLevelS, 3, getDeviceName(), "CCD_COMPRESSION_LEVEL", "Compression", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    IUFillSwitch(&CompressionFilterS[0], "NONE", "None", ISS_ON);
+    IUFillSwitch(&CompressionFilterS[1], "BYTE_SHUFFLE", "Byte shuffle", ISS_OFF);
+    IUFillSwitchVector(&CompressionFilterSP, CompressionFilterS, 2, getDeviceName(), "CCD_COMPRESSION_FILTER", "Filter", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
     // Upload Settings
     IUFillText(&UploadSettingsT[0],"UPLOAD_DIR","Dir","");
     IUFillText(&UploadSettingsT[1],"UPLOAD_PREFIX","Prefix","IMAGE_XXX");
@@ -579,6 +768,14 @@ bool INDI::CCD::initProperties()
     IUFillText(&FileNameT[0],"FILE_PATH","Path","");
     IUFillTextVector(&FileNameTP,FileNameT,1,getDeviceName(),"CCD_FILE_PATH","Filename",IMAGE_INFO_TAB,IP_RO,60,IPS_IDLE);
 
+    // Upload Pipeline Timing
+    IUFillNumber(&PipelineN[PIPELINE_ENCODE],"ENCODE","Encode (ms)","%.1f",0,1e6,0,0);
+    IUFillNumber(&PipelineN[PIPELINE_COMPRESS],"COMPRESS","Compress (ms)","%.1f",0,1e6,0,0);
+    IUFillNumber(&PipelineN[PIPELINE_SAVE],"SAVE","Save (ms)","%.1f",0,1e6,0,0);
+    IUFillNumber(&PipelineN[PIPELINE_SEND],"SEND","Send (ms)","%.1f",0,1e6,0,0);
+    IUFillNumber(&PipelineN[PIPELINE_QUEUED],"QUEUED","Queued","%.0f",0,UPLOAD_QUEUE_DEPTH,0,0);
+    IUFillNumberVector(&PipelineNP,PipelineN,5,getDeviceName(),"CCD_PIPELINE_TIMING","Pipeline",IMAGE_INFO_TAB,IP_RO,60,IPS_IDLE);
+
     /**********************************************/
     /**************** Astrometry ******************/
     /**********************************************/
@@ -644,9 +841,40 @@ bool INDI::CCD::initProperties()
     return true;
 }
 
+void INDI::CCD::initStatsProperties(CCDChip *chip, const char *prefix)
+{
+    char name[MAXINDINAME], label[MAXINDILABEL];
+
+    IUFillSwitch(&chip->StatsS[0], "ENABLE", "Enable", ISS_OFF);
+    IUFillSwitch(&chip->StatsS[1], "DISABLE", "Disable", ISS_ON);
+    snprintf(name, MAXINDINAME, "%s_STATISTICS", prefix);
+    IUFillSwitchVector(&chip->StatsSP, chip->StatsS, 2, getDeviceName(), name, chip == &PrimaryCCD ? "Statistics" : "Guider Statistics", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    IUFillNumber(&chip->StatsN[CCDChip::STATS_MIN],"MIN","Min","%.0f",0,0,0,0);
+    IUFillNumber(&chip->StatsN[CCDChip::STATS_MAX],"MAX","Max","%.0f",0,0,0,0);
+    IUFillNumber(&chip->StatsN[CCDChip::STATS_MEAN],"MEAN","Mean","%.2f",0,0,0,0);
+    IUFillNumber(&chip->StatsN[CCDChip::STATS_STDDEV],"STDDEV","Std Dev","%.2f",0,0,0,0);
+    IUFillNumber(&chip->StatsN[CCDChip::STATS_MEDIAN],"MEDIAN","Median","%.1f",0,0,0,0);
+    snprintf(name, MAXINDINAME, "%s_STATISTICS_DATA", prefix);
+    IUFillNumberVector(&chip->StatsNP, chip->StatsN, 5, getDeviceName(), name, "Statistics", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Bins are spread evenly between MIN and MAX of the same frame
+    for (int i=0; i < CCD_HISTOGRAM_BINS; i++)
+    {
+        snprintf(name, MAXINDINAME, "BIN_%d", i);
+        snprintf(label, MAXINDILABEL, "Bin %d", i);
+        IUFillNumber(&chip->HistogramN[i], name, label, "%.0f", 0, 0, 0, 0);
+    }
+    snprintf(name, MAXINDINAME, "%s_HISTOGRAM", prefix);
+    IUFillNumberVector(&chip->HistogramNP, chip->HistogramN, CCD_HISTOGRAM_BINS, getDeviceName(), name, "Histogram", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+}
+
 void INDI::CCD::ISGetProperties (const char *dev)
 {
+    // FileNameTP may be updated by the upload thread meanwhile
+    pthread_mutex_lock(&uploadLock);
     DefaultDevice::ISGetProperties(dev);
+    pthread_mutex_unlock(&uploadLock);
 
     defineText(&ActiveDeviceTP);
     loadConfig(true, "ACTIVE_DEVICES");
@@ -734,17 +962,39 @@ bool INDI::CCD::updateProperties()
           defineSwitch(&GuideCCD.RapidGuideSetupSP);
           defineNumber(&GuideCCD.RapidGuideDataNP);
         }
+
+        defineSwitch(&PrimaryCCD.StatsSP);
+        if (PrimaryCCD.StatsS[0].s == ISS_ON)
+        {
+            defineNumber(&PrimaryCCD.StatsNP);
+            defineNumber(&PrimaryCCD.HistogramNP);
+        }
+        if (HasGuideHead())
+        {
+            defineSwitch(&GuideCCD.StatsSP);
+            if (GuideCCD.StatsS[0].s == ISS_ON)
+            {
+                defineNumber(&GuideCCD.StatsNP);
+                defineNumber(&GuideCCD.HistogramNP);
+            }
+        }
         defineSwitch(&SolverSP);
         defineText(&SolverSettingsTP);
         defineSwitch(&WorldCoordSP);
         defineSwitch(&UploadSP);
+        defineSwitch(&CompressionLevelSP);
+        defineSwitch(&CompressionFilterSP);
 
         if (UploadSettingsT[0].text == NULL)
             IUSaveText(&UploadSettingsT[0], getenv("HOME"));
         defineText(&UploadSettingsTP);
+        defineNumber(&PipelineNP);
     }
     else
     {
+        // Images still queued go out before their properties are deleted, and no thread outlives the connection
+        stopUploadThread();
+
         deleteProperty(PrimaryCCD.ImageFrameNP.name);
         deleteProperty(PrimaryCCD.ImagePixelSizeNP.name);
 
@@ -781,6 +1031,18 @@ bool INDI::CCD::updateProperties()
               deleteProperty(GuideCCD.RapidGuideSetupSP.name);
               deleteProperty(GuideCCD.RapidGuideDataNP.name);
             }
+            deleteProperty(GuideCCD.StatsSP.name);
+            if (GuideCCD.StatsS[0].s == ISS_ON)
+            {
+                deleteProperty(GuideCCD.StatsNP.name);
+                deleteProperty(GuideCCD.HistogramNP.name);
+            }
+        }
+        deleteProperty(PrimaryCCD.StatsSP.name);
+        if (PrimaryCCD.StatsS[0].s == ISS_ON)
+        {
+            deleteProperty(PrimaryCCD.StatsNP.name);
+            deleteProperty(PrimaryCCD.HistogramNP.name);
         }
         if (HasCooler())
             deleteProperty(TemperatureNP.name);
@@ -807,7 +1069,10 @@ bool INDI::CCD::updateProperties()
         }
         deleteProperty(WorldCoordSP.name);
         deleteProperty(UploadSP.name);
+        deleteProperty(CompressionLevelSP.name);
+        deleteProperty(CompressionFilterSP.name);
         deleteProperty(UploadSettingsTP.name);
+        deleteProperty(PipelineNP.name);
     }
 
     // Streamer
@@ -1231,6 +1496,22 @@ bool INDI::CCD::ISNewSwitch (const char *dev, const char *name, ISState *states,
 {
     if(strcmp(dev,getDeviceName())==0)
     {
+        if (!strcmp(name, CompressionLevelSP.name))
+        {
+            IUUpdateSwitch(&CompressionLevelSP, states, names, n);
+            CompressionLevelSP.s = IPS_OK;
+            IDSetSwitch(&CompressionLevelSP, NULL);
+            return true;
+        }
+
+        if (!strcmp(name, CompressionFilterSP.name))
+        {
+            IUUpdateSwitch(&CompressionFilterSP, states, names, n);
+            CompressionFilterSP.s = IPS_OK;
+            IDSetSwitch(&CompressionFilterSP, NULL);
+            return true;
+        }
+
         if (!strcmp(name, UploadSP.name))
         {
             int prevMode = IUFindOnSwitchIndex(&UploadSP);
@@ -1247,12 +1528,16 @@ bool INDI::CCD::ISNewSwitch (const char *dev, const char *name, ISState *states,
             else if (UploadS[1].s == ISS_ON)
             {
                 DEBUG(INDI::Logger::DBG_SESSION, "Upload settings set to local only.");
+                pthread_mutex_lock(&uploadLock);
                 defineText(&FileNameTP);
+                pthread_mutex_unlock(&uploadLock);
             }
             else
             {
                 DEBUG(INDI::Logger::DBG_SESSION, "Upload settings set to client and local.");
+                pthread_mutex_lock(&uploadLock);
                 defineText(&FileNameTP);
+                pthread_mutex_unlock(&uploadLock);
             }
             return true;
         }
@@ -1509,6 +1794,31 @@ bool INDI::CCD::ISNewSwitch (const char *dev, const char *name, ISState *states,
             return true;
         }
 
+        // Frame statistics Enable/Disable
+        if (strcmp(name, PrimaryCCD.StatsSP.name)==0 || strcmp(name, GuideCCD.StatsSP.name)==0)
+        {
+            CCDChip *chip = (strcmp(name, PrimaryCCD.StatsSP.name)==0) ? &PrimaryCCD : &GuideCCD;
+            bool wasEnabled = (chip->StatsS[0].s == ISS_ON);
+
+            IUUpdateSwitch(&chip->StatsSP, states, names, n);
+            chip->StatsSP.s=IPS_OK;
+
+            if (chip->StatsS[0].s == ISS_ON && !wasEnabled)
+            {
+                defineNumber(&chip->StatsNP);
+                defineNumber(&chip->HistogramNP);
+            }
+            else if (chip->StatsS[0].s == ISS_OFF && wasEnabled)
+            {
+                deleteProperty(chip->StatsNP.name);
+                deleteProperty(chip->HistogramNP.name);
+                chip->StatsValid = false;
+            }
+
+            IDSetSwitch(&chip->StatsSP,NULL);
+            return true;
+        }
+
         // Primary CCD Rapid Guide Setup
         if (strcmp(name, PrimaryCCD.RapidGuideSetupSP.name)==0)
         {
@@ -1682,8 +1992,20 @@ void INDI::CCD::addFITSKeywords(fitsfile *fptr, CCDChip *targetChip)
         fits_update_key_s(fptr, TSTRING, "FILTER", filter, "Filter", &status);
     }
 
+    const ImageStats *stats = targetChip->getStats();
+    if (stats)
+    {
+        double mean = stats->mean, stddev = stats->stddev, median = stats->median;
+        double min_val = stats->min, max_val = stats->max;
+
+        fits_update_key_s(fptr, TDOUBLE, "DATAMIN", &min_val, "Minimum value", &status);
+        fits_update_key_s(fptr, TDOUBLE, "DATAMAX", &max_val, "Maximum value", &status);
+        fits_update_key_s(fptr, TDOUBLE, "DATAMEAN", &mean, "Mean value", &status);
+        fits_update_key_s(fptr, TDOUBLE, "DATASTD", &stddev, "Standard deviation", &status);
+        fits_update_key_s(fptr, TDOUBLE, "DATAMED", &median, "Median value", &status);
+    }
 #ifdef WITH_MINMAX
-    if (targetChip->getNAxis() == 2)
+    else if (targetChip->getNAxis() == 2)
     {
         double min_val, max_val;
         getMinMax(&min_val, &max_val, targetChip);
@@ -1814,6 +2136,9 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
     bool autoLoop = false;
     bool sendData = false;
 
+    // Before any marker is drawn into the frame
+    targetChip->computeStats();
+
     if (RapidGuideEnabled && targetChip == &PrimaryCCD && (PrimaryCCD.getBPP() == 16 || PrimaryCCD.getBPP() == 8))
     {
       autoLoop = AutoLoop;
@@ -2061,12 +2386,33 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
 
     if (sendImage || saveImage || useSolver)
     {
+      UploadJob *job = new UploadJob();
+      struct timeval t0;
+
+      gettimeofday(&t0, NULL);
+      job->targetChip = targetChip;
+      strncpy(job->ext, targetChip->getImageExtension(), MAXINDIBLOBFMT);
+      job->sendImage = sendImage;
+      job->saveImage = saveImage;
+      job->useSolver = useSolver;
+      job->uploadDir = UploadSettingsT[0].text ? UploadSettingsT[0].text : "";
+      job->uploadPrefix = UploadSettingsT[1].text ? UploadSettingsT[1].text : "";
+      if (targetChip->SendCompressed)
+      {
+          static const int levels[] = { 1, 6, 9 };
+          int index = IUFindOnSwitchIndex(&CompressionLevelSP);
+          job->compressLevel = levels[index < 0 ? 1 : index];
+      }
+      else
+          job->compressLevel = 0;
+      // Only 16 bit pixels gain from shuffling their bytes
+      job->shuffle = (CompressionFilterS[1].s == ISS_ON && targetChip->getBPP() == 16);
+
       if (!strcmp(targetChip->getImageExtension(), "fits"))
       {
           void *memptr;
           size_t memsize;
           int img_type=0;
-          int byte_type=0;
           int status=0;
           long naxis=targetChip->getNAxis();
           long naxes[naxis];
@@ -2082,25 +2428,23 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
           switch (targetChip->getBPP())
           {
               case 8:
-                  byte_type = TBYTE;
                   img_type  = BYTE_IMG;
                   bit_depth = "8 bits per pixel";
                   break;
 
               case 16:
-                  byte_type = TUSHORT;
                   img_type = USHORT_IMG;
                   bit_depth = "16 bits per pixel";
                   break;
 
               case 32:
-                  byte_type = TULONG;
                   img_type = ULONG_IMG;
                   bit_depth = "32 bits per pixel";
                   break;
 
                default:
                   DEBUGF(Logger::DBG_ERROR, "Unsupported bits per pixel value %d", targetChip->getBPP() );
+                  delete job;
                   return false;
                   break;
           }
@@ -2115,7 +2459,8 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
           /*DEBUGF(Logger::DBG_DEBUG, "Exposure complete. Image Depth: %s. Width: %d Height: %d nelements: %d", bit_depth.c_str(), naxes[0],
                   naxes[1], nelements);*/
 
-          //  Now we have to send fits format data to the client
+          // cfitsio formats the header so addFITSKeywords() and its overrides keep working, but only the header. The file is
+          // laid out here in one buffer of its exact size, and the pixels converted into it in one pass.
           memsize=5760;
           memptr=malloc(memsize);
           if(!memptr)
@@ -2123,13 +2468,15 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
               DEBUGF(INDI::Logger::DBG_ERROR, "Error: failed to allocate memory: %lu",(unsigned long)memsize);
           }
 
-          fits_create_memfile(&fptr,&memptr,&memsize,2880,realloc,&status);                    
+          fits_create_memfile(&fptr,&memptr,&memsize,2880,realloc,&status);
 
           if(status)
           {
             fits_report_error(stderr, status);  /* print out any error messages */
             fits_get_errstatus(status, error_status);
             DEBUGF(INDI::Logger::DBG_ERROR, "FITS Error: %s", error_status);
+            free(memptr);
+            delete job;
             return false;
           }
 
@@ -2140,32 +2487,73 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
             fits_report_error(stderr, status);  /* print out any error messages */
             fits_get_errstatus(status, error_status);
             DEBUGF(INDI::Logger::DBG_ERROR, "FITS Error: %s", error_status);
+            fits_close_file(fptr,&status);
+            free(memptr);
+            delete job;
             return false;
           }
 
           addFITSKeywords(fptr, targetChip);
 
-          fits_write_img(fptr,byte_type,1,nelements,targetChip->getFrameBuffer(),&status);
+          char *cards=NULL;
+          int ncards=0;
+          fits_hdr2str(fptr, 0, NULL, 0, &cards, &ncards, &status);
+
+          // Empty the data unit so closing does not zero fill a whole image into the memfile
+          long noaxes[3] = { 0, 0, 0 };
+          int closeStatus=0;
+          fits_resize_img(fptr, img_type, naxis, noaxes, &closeStatus);
+          fits_close_file(fptr,&closeStatus);
+          free(memptr);
 
           if (status)
           {
             fits_report_error(stderr, status);  /* print out any error messages */
             fits_get_errstatus(status, error_status);
             DEBUGF(INDI::Logger::DBG_ERROR, "FITS Error: %s", error_status);
+            free(cards);
+            delete job;
             return false;
           }
 
-          fits_close_file(fptr,&status);
+          // Some cfitsio versions count the END card, fitsPackHeader() adds its own
+          if (ncards > 0 && !strncmp(cards + (ncards-1) * FITS_CARD, "END     ", 8))
+              ncards--;
 
-          uploadFile(targetChip, memptr, memsize, sendImage, saveImage, useSolver);
+          size_t headerBytes = fitsPadded((ncards + 1) * FITS_CARD);
+          size_t dataBytes   = fitsPadded((size_t) nelements * (targetChip->getBPP()/8));
 
-          free(memptr);
+          job->data = getImageBuffer(headerBytes + dataBytes, &job->dataCapacity);
+          if (job->data == NULL)
+          {
+              DEBUG(INDI::Logger::DBG_ERROR, "Error: failed to allocate memory for the image");
+              free(cards);
+              delete job;
+              return false;
+          }
+
+          fitsPackHeader(static_cast<char *>(job->data), cards, ncards);
+          fitsPackData(static_cast<char *>(job->data) + headerBytes, targetChip->getFrameBuffer(), nelements, targetChip->getBPP());
+          free(cards);
+
+          job->totalBytes = headerBytes + dataBytes;
       }
       else
       {
-          uploadFile(targetChip, targetChip->getFrameBuffer(), targetChip->getFrameBufferSize(), sendImage, saveImage);
+          job->data = getImageBuffer(targetChip->getFrameBufferSize(), &job->dataCapacity);
+          if (job->data == NULL)
+          {
+              DEBUG(INDI::Logger::DBG_ERROR, "Error: failed to allocate memory for the image");
+              delete job;
+              return false;
+          }
+          memcpy(job->data, targetChip->getFrameBuffer(), targetChip->getFrameBufferSize());
+          job->totalBytes = targetChip->getFrameBufferSize();
+          job->useSolver = false;
       }
 
+      job->ms[PIPELINE_ENCODE] = msSince(&t0);
+      queueUpload(job);
 
     }
 
@@ -2207,35 +2595,40 @@ bool INDI::CCD::ExposureComplete(CCDChip *targetChip)
     return true;
 }
 
-bool INDI::CCD::uploadFile(CCDChip * targetChip, const void *fitsData, size_t totalBytes, bool sendImage, bool saveImage, bool useSolver)
+bool INDI::CCD::uploadFile(UploadJob *job)
 {
+    CCDChip *targetChip = job->targetChip;
+    const void *fitsData = job->data;
+    size_t totalBytes = job->totalBytes;
+    struct timeval t0;
     unsigned char *compressedData = NULL;
-    uLongf compressedBytes=0;
+    size_t compressedBytes=0;
 
-    DEBUGF(INDI::Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendImage? %s, saveImage? %s, useSolver? %s", targetChip->getImageExtension(), totalBytes,
-           sendImage ? "Yes" : "No", saveImage ? "Yes": "No", useSolver ? "Yes" : "No");
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendImage? %s, saveImage? %s, useSolver? %s", job->ext, totalBytes,
+           job->sendImage ? "Yes" : "No", job->saveImage ? "Yes": "No", job->useSolver ? "Yes" : "No");
 
-    if (saveImage)
+    if (job->saveImage)
     {
+        gettimeofday(&t0, NULL);
         targetChip->FitsB.blob=(unsigned char *)fitsData;
         targetChip->FitsB.bloblen=totalBytes;
-        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, ".%s", targetChip->getImageExtension());
+        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, ".%s", job->ext);
 
         FILE *fp = NULL;
         char imageFileName[MAXRBUF];
 
-        if (useSolver)
+        if (job->useSolver)
         {
             strncpy(imageFileName, "/tmp/ccdsolver.fits", MAXRBUF);
         }
         else
         {
-            std::string prefix = UploadSettingsT[1].text;
-            int maxIndex = getFileIndex(UploadSettingsT[0].text, UploadSettingsT[1].text, targetChip->FitsB.format);
+            std::string prefix = job->uploadPrefix;
+            int maxIndex = getFileIndex(job->uploadDir.c_str(), job->uploadPrefix.c_str(), targetChip->FitsB.format);
 
             if (maxIndex < 0)
             {
-                DEBUGF(INDI::Logger::DBG_ERROR, "Error iterating directory %s. %s", UploadSettingsT[0].text, strerror(errno));
+                DEBUGF(INDI::Logger::DBG_ERROR, "Error iterating directory %s. %s", job->uploadDir.c_str(), strerror(errno));
                 return false;
             }
 
@@ -2247,7 +2640,7 @@ bool INDI::CCD::uploadFile(CCDChip * targetChip, const void *fitsData, size_t to
                 prefix.replace(prefix.find("XXX"), std::string::npos, prefixIndex);
             }
 
-            snprintf(imageFileName, MAXRBUF, "%s/%s%s", UploadSettingsT[0].text, prefix.c_str(), targetChip->FitsB.format);
+            snprintf(imageFileName, MAXRBUF, "%s/%s%s", job->uploadDir.c_str(), prefix.c_str(), targetChip->FitsB.format);
         }
 
         fp = fopen(imageFileName, "w");
@@ -2262,11 +2655,14 @@ bool INDI::CCD::uploadFile(CCDChip * targetChip, const void *fitsData, size_t to
             n = fwrite( (static_cast<char *>(targetChip->FitsB.blob) + nr), 1, targetChip->FitsB.bloblen - nr, fp);
 
         fclose(fp);
+        job->ms[PIPELINE_SAVE] = msSince(&t0);
 
-        // Save image file path
+        // Save image file path. The main thread sends FileNameTP too, so only touch it under uploadLock.
+        pthread_mutex_lock(&uploadLock);
         IUSaveText(&FileNameT[0], imageFileName);
+        pthread_mutex_unlock(&uploadLock);
 
-        if (useSolver)
+        if (job->useSolver)
         {
             pthread_mutex_lock(&lock);
             SolverSP.s = IPS_BUSY;
@@ -2279,54 +2675,49 @@ bool INDI::CCD::uploadFile(CCDChip * targetChip, const void *fitsData, size_t to
             if (result != 0)
             {
                 SolverSP.s = IPS_ALERT;
-                DEBUGF(INDI::Logger::DBG_SESSION, "Failed to create solver thread: %s", strerror(errno));
+                DEBUGF(INDI::Logger::DBG_SESSION, "Failed to create solver thread: %s", strerror(result));
                 IDSetSwitch(&SolverSP, NULL);
             }
         }
         else
         {
             DEBUGF(INDI::Logger::DBG_SESSION, "Image saved to %s", imageFileName);
+            pthread_mutex_lock(&uploadLock);
             FileNameTP.s = IPS_OK;
             IDSetText(&FileNameTP, NULL);
+            pthread_mutex_unlock(&uploadLock);
         }
     }
 
-    if (targetChip->SendCompressed)
+    gettimeofday(&t0, NULL);
+    if (job->compressLevel > 0)
     {
-        compressedBytes = sizeof(char) * totalBytes + totalBytes / 64 + 16 + 3;
-        compressedData = (unsigned char *) malloc (compressedBytes);
-
-        if (fitsData == NULL || compressedData == NULL)
-        {
-            if (compressedData)
-                free(compressedData);
-            DEBUG(INDI::Logger::DBG_ERROR, "Error: Ran out of memory compressing image");
-            return false;
-        }
-
-        int r = compress2(compressedData, &compressedBytes, (const Bytef*)fitsData, totalBytes, 9);
-        if (r != Z_OK)
+        if (fitsData == NULL || compressImage(fitsData, totalBytes, job->compressLevel, job->shuffle, &compressedData, &compressedBytes) == false)
         {
-            /* this should NEVER happen */
             DEBUG(INDI::Logger::DBG_ERROR, "Error: Failed to compress image");
             return false;
         }
 
         targetChip->FitsB.blob=compressedData;
         targetChip->FitsB.bloblen=compressedBytes;
-        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, ".%s.z", targetChip->getImageExtension());
+        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, job->shuffle ? ".%s.sz" : ".%s.z", job->ext);
+        job->ms[PIPELINE_COMPRESS] = msSince(&t0);
     } else
     {
         targetChip->FitsB.blob=(unsigned char *)fitsData;
         targetChip->FitsB.bloblen=totalBytes;
-        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, ".%s", targetChip->getImageExtension());
+        snprintf(targetChip->FitsB.format, MAXINDIBLOBFMT, ".%s", job->ext);
     }
 
     targetChip->FitsB.size = totalBytes;
     targetChip->FitsBP.s=IPS_OK;
 
-    if (sendImage)
+    if (job->sendImage)
+    {
+        gettimeofday(&t0, NULL);
         IDSetBLOB(&targetChip->FitsBP,NULL);
+        job->ms[PIPELINE_SEND] = msSince(&t0);
+    }
 
     if (compressedData)
         free (compressedData);
@@ -2336,6 +2727,159 @@ bool INDI::CCD::uploadFile(CCDChip * targetChip, const void *fitsData, size_t to
     return true;
 }
 
+bool INDI::CCD::compressImage(const void *data, size_t size, int level, bool shuffle, unsigned char **compressed, size_t *compressedSize)
+{
+    unsigned char *shuffled = NULL;
+
+    if (shuffle)
+    {
+        shuffled = (unsigned char *) malloc(size);
+        if (shuffled == NULL)
+        {
+            DEBUG(INDI::Logger::DBG_ERROR, "Error: Ran out of memory compressing image");
+            return false;
+        }
+        zblockShuffle(shuffled, data, size, 2);
+        data = shuffled;
+    }
+
+    int r = zblockCompress(data, size, level, compressed, compressedSize);
+
+    free(shuffled);
+    return (r == 0);
+}
+
+void INDI::CCD::queueUpload(UploadJob *job)
+{
+    pthread_mutex_lock(&uploadLock);
+
+    if (uploadRunning == false)
+    {
+        uploadStop = false;
+        int result = pthread_create(&uploadThreadID, NULL, &INDI::CCD::uploadThreadHelper, this);
+        if (result != 0)
+        {
+            // Upload it here then
+            pthread_mutex_unlock(&uploadLock);
+            DEBUGF(INDI::Logger::DBG_WARNING, "Failed to create upload thread: %s", strerror(result));
+            uploadFile(job);
+            releaseImageBuffer(job->data, job->dataCapacity);
+            delete job;
+            return;
+        }
+        uploadRunning = true;
+    }
+
+    while (uploadQueue.size() >= UPLOAD_QUEUE_DEPTH)
+        pthread_cond_wait(&uploadCond, &uploadLock);
+
+    uploadQueue.push_back(job);
+    pthread_cond_broadcast(&uploadCond);
+    pthread_mutex_unlock(&uploadLock);
+}
+
+void *INDI::CCD::getImageBuffer(size_t size, size_t *capacity)
+{
+    int best = -1;
+
+    // Smallest pooled buffer that fits
+    pthread_mutex_lock(&uploadLock);
+    for (unsigned int i=0; i < imagePool.size(); i++)
+        if (imagePool[i].second >= size && (best < 0 || imagePool[i].second < imagePool[best].second))
+            best = i;
+    if (best >= 0)
+    {
+        void *buffer = imagePool[best].first;
+        *capacity = imagePool[best].second;
+        imagePool.erase(imagePool.begin() + best);
+        pthread_mutex_unlock(&uploadLock);
+        return buffer;
+    }
+    pthread_mutex_unlock(&uploadLock);
+
+    *capacity = size;
+    return malloc(size);
+}
+
+void INDI::CCD::releaseImageBuffer(void *buffer, size_t capacity)
+{
+    if (buffer == NULL)
+        return;
+
+    pthread_mutex_lock(&uploadLock);
+    imagePool.push_back(std::make_pair(buffer, capacity));
+    if (imagePool.size() > IMAGE_POOL_DEPTH)
+    {
+        // Drop the smallest, the one least likely to fit the next frame
+        int smallest = 0;
+        for (unsigned int i=1; i < imagePool.size(); i++)
+            if (imagePool[i].second < imagePool[smallest].second)
+                smallest = i;
+        free(imagePool[smallest].first);
+        imagePool.erase(imagePool.begin() + smallest);
+    }
+    pthread_mutex_unlock(&uploadLock);
+}
+
+void INDI::CCD::stopUploadThread()
+{
+    pthread_mutex_lock(&uploadLock);
+    if (uploadRunning == false)
+    {
+        pthread_mutex_unlock(&uploadLock);
+        return;
+    }
+    uploadStop = true;
+    pthread_cond_broadcast(&uploadCond);
+    pthread_mutex_unlock(&uploadLock);
+
+    pthread_join(uploadThreadID, NULL);
+
+    pthread_mutex_lock(&uploadLock);
+    uploadRunning = false;
+    pthread_mutex_unlock(&uploadLock);
+}
+
+void * INDI::CCD::uploadThreadHelper(void *context)
+{
+    (static_cast<INDI::CCD *> (context))->uploadThread();
+    return NULL;
+}
+
+// Upload queued images oldest first. Once told to stop, finish those queued then return.
+void INDI::CCD::uploadThread()
+{
+    pthread_mutex_lock(&uploadLock);
+
+    while (true)
+    {
+        while (uploadQueue.empty() && uploadStop == false)
+            pthread_cond_wait(&uploadCond, &uploadLock);
+
+        if (uploadQueue.empty())
+            break;
+
+        UploadJob *job = uploadQueue.front();
+        uploadQueue.pop_front();
+        pthread_cond_broadcast(&uploadCond);
+        pthread_mutex_unlock(&uploadLock);
+
+        if (uploadFile(job) == false)
+            DEBUG(INDI::Logger::DBG_WARNING, "Image upload failed.");
+        releaseImageBuffer(job->data, job->dataCapacity);
+
+        pthread_mutex_lock(&uploadLock);
+        for (int i=0; i < PIPELINE_QUEUED; i++)
+            PipelineN[i].value = job->ms[i];
+        PipelineN[PIPELINE_QUEUED].value = uploadQueue.size();
+        PipelineNP.s = IPS_OK;
+        IDSetNumber(&PipelineNP, NULL);
+        delete job;
+    }
+
+    pthread_mutex_unlock(&uploadLock);
+}
+
 void INDI::CCD::SetCCDParams(int x,int y,int bpp,float xf,float yf)
 {
     PrimaryCCD.setResolution(x, y);
@@ -2364,13 +2908,19 @@ bool INDI::CCD::saveConfigItems(FILE *fp)
 
     IUSaveConfigText(fp, &ActiveDeviceTP);
     IUSaveConfigSwitch(fp, &UploadSP);
+    IUSaveConfigSwitch(fp, &CompressionLevelSP);
+    IUSaveConfigSwitch(fp, &CompressionFilterSP);
     IUSaveConfigText(fp, &UploadSettingsTP);
     IUSaveConfigSwitch(fp, &TelescopeTypeSP);
 
     IUSaveConfigSwitch(fp, &PrimaryCCD.CompressSP);
+    IUSaveConfigSwitch(fp, &PrimaryCCD.StatsSP);
 
     if (HasGuideHead())
+    {
         IUSaveConfigSwitch(fp, &GuideCCD.CompressSP);
+        IUSaveConfigSwitch(fp, &GuideCCD.StatsSP);
+    }
 
     if (CanSubFrame())
         IUSaveConfigNumber(fp, &PrimaryCCD.ImageFrameNP);
@@ -2416,66 +2966,10 @@ IPState INDI::CCD::GuideWest(float ms)
 
 void INDI::CCD::getMinMax(double *min, double *max, CCDChip *targetChip)
 {
-    int ind=0, i, j;
-    int imageHeight = targetChip->getSubH() / targetChip->getBinY();
-    int imageWidth  = targetChip->getSubW() / targetChip->getBinX();
-    double lmin, lmax;
-
-    switch (targetChip->getBPP())
-    {
-        case 8:
-        {
-            unsigned char *imageBuffer = (unsigned char *) targetChip->getFrameBuffer();
-            lmin = lmax = imageBuffer[0];
-
+    size_t npixels = (size_t) (targetChip->getSubW() / targetChip->getBinX()) * (targetChip->getSubH() / targetChip->getBinY());
 
-            for (i= 0; i < imageHeight ; i++)
-                for (j= 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin) lmin = imageBuffer[ind];
-                    else if (imageBuffer[ind] > lmax) lmax = imageBuffer[ind];
-                }
-
-        }
-        break;
-
-        case 16:
-        {
-            unsigned short *imageBuffer = (unsigned short* ) targetChip->getFrameBuffer();
-            lmin = lmax = imageBuffer[0];
-
-            for (i= 0; i < imageHeight ; i++)
-                for (j= 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin) lmin = imageBuffer[ind];
-                     else if (imageBuffer[ind] > lmax) lmax = imageBuffer[ind];
-                }
-
-        }
-        break;
-
-        case 32:
-        {
-            unsigned int *imageBuffer = (unsigned int* ) targetChip->getFrameBuffer();
-            lmin = lmax = imageBuffer[0];
-
-            for (i= 0; i < imageHeight ; i++)
-                for (j= 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin) lmin = imageBuffer[ind];
-                    else if (imageBuffer[ind] > lmax) lmax = imageBuffer[ind];
-
-                }
-
-        }
-        break;
-
-    }
-        *min = lmin;
-        *max = lmax;
+    if (imageMinMax(targetChip->getFrameBuffer(), npixels, targetChip->getBPP(), min, max) < 0)
+        *min = *max = 0;
 }
 
 int INDI::CCD::getFileIndex(const char *dir, const char *prefix, const char *ext)
@@ -28,15 +28,20 @@
 
 #include <fitsio.h>
 #include <string.h>
+#include <deque>
 
 #include "defaultdevice.h"
 #include "indiguiderinterface.h"
+#include "binning.h"
+#include "imagestats.h"
 
 extern const char *IMAGE_SETTINGS_TAB;
 extern const char *IMAGE_INFO_TAB;
 extern const char *GUIDE_HEAD_TAB;
 extern const char *RAPIDGUIDE_TAB;
 
+#define CCD_HISTOGRAM_BINS  32      /* bins of the published frame histogram */
+
 class StreamRecorder;
 
 /**
@@ -54,6 +59,7 @@ public:
     typedef enum { FRAME_X, FRAME_Y, FRAME_W, FRAME_H} CCD_FRAME_INDEX;
     typedef enum { BIN_W, BIN_H} CCD_BIN_INDEX;
     typedef enum { CCD_MAX_X, CCD_MAX_Y, CCD_PIXEL_SIZE, CCD_PIXEL_SIZE_X, CCD_PIXEL_SIZE_Y, CCD_BITSPERPIXEL} CCD_INFO_INDEX;
+    typedef enum { STATS_MIN, STATS_MAX, STATS_MEAN, STATS_STDDEV, STATS_MEDIAN} CCD_STATS_INDEX;
 
     /**
      * @brief getXRes Get the horizontal resolution in pixels of the CCD Chip.
@@ -313,6 +319,80 @@ public:
      */
     void binFrame();
 
+    /**
+     * @brief binFrame Perform software binning of a frame other than the chip frame buffer, using the current frame and binning settings.
+     * Pixels past the last whole bin of each row and column are dropped, so the binned frame is (SubW/BinX) x (SubH/BinY) pixels.
+     * @param in unbinned frame of SubW x SubH pixels, three planes of them if NAxis is 3.
+     * @param out binned frame, at least as large as the binned size of in.
+     * @return number of bytes written to out, or -1 if the pixel depth is not supported.
+     */
+    int binFrame(const uint8_t *in, uint8_t *out);
+
+    /**
+     * @brief setBinMode Set how software binning combines the pixels of a bin.
+     * @param mode one of BIN_MODE. BIN_AUTO, the default, averages 8 bit pixels over half the bin and sums deeper ones.
+     */
+    void setBinMode(int mode) { BinMode = mode; }
+
+    /**
+     * @return How software binning combines the pixels of a bin.
+     */
+    int getBinMode() { return BinMode; }
+
+    /**
+     * @brief computeStats Compute min, max, mean, standard deviation, median and histogram of the frame buffer in one pass, if enabled by the client.
+     * @return true if statistics were computed, false if they are disabled or the pixel depth is not supported.
+     */
+    bool computeStats();
+
+    /**
+     * @return Statistics of the last frame computeStats() ran on, or NULL if there are none.
+     */
+    const ImageStats *getStats() { return StatsValid ? &Stats : NULL; }
+
+    /**
+     * @brief setFrameRing Allocate a ring of frame buffers, each as large as the frame buffer, to hand frames from one capture thread to one
+     * processing thread without locking. The capture thread fills slots with getFillSlot() and commitFillSlot() while the processing thread
+     * empties the oldest ones with getReadySlot() and releaseReadySlot(). The ring must not be resized while either side is using it.
+     * Changing the frame, binning, depth or frame buffer size waits until the processing thread has released every committed slot, then
+     * resizes the slots, so do that from the capture thread or with capture stopped, and never from the processing thread.
+     * @param slots number of frame buffers in the ring, or 0 to free it.
+     * @return True if the ring was allocated, false otherwise.
+     */
+    bool setFrameRing(int slots);
+
+    /**
+     * @return number of frame buffers in the ring, 0 if there is no ring.
+     */
+    int getFrameRingSlots();
+
+    /**
+     * @brief getFillSlot Get the frame buffer the next frame is to be captured into. The same slot is returned until it is committed.
+     * @return free frame buffer, or NULL if all slots still await processing. Each NULL return counts as a dropped frame.
+     */
+    uint8_t *getFillSlot();
+
+    /**
+     * @brief commitFillSlot Hand the slot returned by getFillSlot() over to the processing thread.
+     */
+    void commitFillSlot();
+
+    /**
+     * @brief getReadySlot Get the oldest committed frame. The same slot is returned until it is released.
+     * @return oldest frame awaiting processing, or NULL if there is none.
+     */
+    uint8_t *getReadySlot();
+
+    /**
+     * @brief releaseReadySlot Return the slot returned by getReadySlot() to the capture thread.
+     */
+    void releaseReadySlot();
+
+    /**
+     * @return number of frames dropped because the ring was full since it was allocated.
+     */
+    uint32_t getDroppedFrames();
+
 private:
 
     int XRes;   //  native resolution of the ccd
@@ -323,6 +403,7 @@ private:
     int SubH;   //  UNBINNED height of the subframe
     int BinX;   //  Binning requested in the x direction
     int BinY;   //  Binning requested in the Y direction
+    int BinMode;    //  How software binning combines pixels
     int NAxis;  //  # of Axis
     float PixelSizex;   //  pixel size in microns, x direction
     float PixelSizey;   //  pixel size in microns, y direction
@@ -339,6 +420,15 @@ private:
     int lastRapidY;
     char imageExtention[MAXINDIBLOBFMT];
 
+    ImageStats Stats;
+    unsigned int StatsHistogram[CCD_HISTOGRAM_BINS];
+    bool StatsValid;
+
+    // Frame ring, defined in indiccd.cpp. NULL if there is none.
+    struct FrameRing;
+    FrameRing *Ring;
+    void drainFrameRing();
+
     INumberVectorProperty ImageExposureNP;
     INumber ImageExposureN[1];
 
@@ -375,6 +465,15 @@ private:
     ISwitch                 ResetS[1];
     ISwitchVectorProperty   ResetSP;
 
+    ISwitch StatsS[2];
+    ISwitchVectorProperty StatsSP;
+
+    INumber StatsN[5];
+    INumberVectorProperty StatsNP;
+
+    INumber HistogramN[CCD_HISTOGRAM_BINS];
+    INumberVectorProperty HistogramNP;
+
     friend class INDI::CCD;
     friend class StreamRecoder;
 
@@ -518,9 +617,17 @@ class INDI::CCD : public INDI::DefaultDevice, INDI::GuiderInterface
         /** \brief Uploads target Chip exposed buffer as FITS to the client. Dervied classes should class this functon when an exposure is complete.
          * @param targetChip chip that contains upload image data
              \note This function is not implemented in INDI::CCD, it must be implemented in the child class
+             \note The FITS file is encoded before this returns, so the frame buffer may be reused for the next exposure right away. Compressing,
+             saving and sending it are queued to a background thread. If too many images are still waiting for that, this blocks until one is done.
         */
         virtual bool ExposureComplete(CCDChip *targetChip);
 
+        /** \brief Finish the images queued by ExposureComplete() and stop the upload thread. It starts again with the next image.
+             \note INDI::CCD calls this on disconnect and when destroyed. By then a derived class is gone, so one whose destructor
+             frees what its images use, or whose overridden functions the upload may call, should call this first in its own destructor.
+        */
+        void stopUploadThread();
+
         /** \brief Abort ongoing exposure
             \return true is abort is successful, false otherwise.
             \note This function is not implemented in INDI::CCD, it must be implemented in the child class
@@ -692,6 +799,20 @@ class INDI::CCD : public INDI::DefaultDevice, INDI::GuiderInterface
          */
         virtual bool saveConfigItems(FILE *fp);
 
+        /**
+         * @brief compressImage Compress an image before it is sent to the client. The default splits the image into blocks compressed by
+         * several threads at once into one zlib stream, which clients decode with uncompress(). Override to plug in another compressor whose
+         * output clients can still decode.
+         * @param data image to compress.
+         * @param size bytes at data.
+         * @param level zlib compression level, 1 fastest to 9 smallest.
+         * @param shuffle byte shuffle 16 bit pixels before compressing. Clients undo it for BLOBs whose format ends in .sz rather than .z
+         * @param compressed set to a malloced buffer holding the compressed image, freed by the caller.
+         * @param compressedSize set to bytes at compressed.
+         * @return True if successful, false otherwise
+         */
+        virtual bool compressImage(const void *data, size_t size, int level, bool shuffle, unsigned char **compressed, size_t *compressedSize);
+
         void GuideComplete(INDI_EQ_AXIS axis);                
 
         double RA, Dec;
@@ -766,16 +887,61 @@ class INDI::CCD : public INDI::DefaultDevice, INDI::GuiderInterface
         ISwitch UploadS[3];
         ISwitchVectorProperty UploadSP;
 
+        ISwitch CompressionLevelS[3];
+        ISwitchVectorProperty CompressionLevelSP;
+
+        ISwitch CompressionFilterS[2];
+        ISwitchVectorProperty CompressionFilterSP;
+
         IText   UploadSettingsT[2];
         ITextVectorProperty UploadSettingsTP;
 
+        // Time spent on the last image in each stage of the upload pipeline
+        INumber PipelineN[5];
+        INumberVectorProperty PipelineNP;
+
      private:
         uint32_t capability;
 
         bool ValidCCDRotation;
 
-        bool uploadFile(CCDChip * targetChip, const void *fitsData, size_t totalBytes, bool sendImage, bool saveImage, bool useSolver=false);
+        typedef enum { PIPELINE_ENCODE, PIPELINE_COMPRESS, PIPELINE_SAVE, PIPELINE_SEND, PIPELINE_QUEUED } PIPELINE_INDEX;
+
+        // An encoded image and all uploadFile() needs to know about it, so it does not depend on settings changed since
+        typedef struct
+        {
+            CCDChip *targetChip;
+            void *data;                         // FITS file or raw frame, from getImageBuffer()
+            size_t dataCapacity;                // bytes allocated at data
+            size_t totalBytes;
+            char ext[MAXINDIBLOBFMT];
+            bool sendImage, saveImage, useSolver;
+            int compressLevel;                  // zlib level, 0 to send uncompressed
+            bool shuffle;                       // byte shuffle before compressing
+            std::string uploadDir, uploadPrefix;
+            double ms[PIPELINE_QUEUED];         // milliseconds spent in each stage
+        } UploadJob;
+
+        bool uploadFile(UploadJob *job);
+        void queueUpload(UploadJob *job);
+
+        // Upload thread, uploads jobs from uploadQueue oldest first
+        static void * uploadThreadHelper(void *context);
+        void uploadThread();
+        std::deque<UploadJob *> uploadQueue;
+        pthread_t uploadThreadID;
+        pthread_mutex_t uploadLock;         // guards the queue, imagePool and FileNameTP, which the upload thread sets
+        pthread_cond_t uploadCond;          // signalled when a job is queued or done, and to stop
+        bool uploadRunning;
+        bool uploadStop;
+
+        // Image buffers kept for the next exposures, so large frames are not freed and faulted in again each time
+        void *getImageBuffer(size_t size, size_t *capacity);
+        void releaseImageBuffer(void *buffer, size_t capacity);
+        std::vector<std::pair<void *, size_t> > imagePool;    // guarded by uploadLock
+
         void getMinMax(double *min, double *max, CCDChip *targetChip);
+        void initStatsProperties(CCDChip *chip, const char *prefix);
         int getFileIndex(const char *dir, const char *prefix, const char *ext);
         
         // Run solver thread
@@ -24,12 +24,51 @@
 #include <dirent.h>
 #include <limits.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
+#include <atomic>
 #include <iostream>
 
+// Messages the log file may fall behind by. A power of 2.
+#define LOG_QUEUE_SIZE      4096
+// Longest the writer waits before writing what has been queued
+#define LOG_WRITE_MS        100
+// The writer is woken early once this many messages are queued
+#define LOG_WAKE_BATCH      256
+
 namespace INDI
 {
 
+/*
+ * Messages for the log file are queued in a bounded ring and written by one writer thread, so logging costs a
+ * driver a copy of the message rather than a write and a flush. Any thread may queue without taking a lock. Each
+ * slot has a sequence number: a slot is free for the producer that claimed position pos when it reads pos, and ready
+ * for the writer when it reads pos+1. The writer hands the slot back for the next lap by setting it to
+ * pos+LOG_QUEUE_SIZE. When the ring is full messages are dropped and counted rather than blocking the driver.
+ * Errors and warnings are written out before print() returns, along with everything queued before them, so they
+ * survive a crash that follows. Other messages may still be queued for up to LOG_WRITE_MS when the driver dies.
+ * If the writer thread can not be started, every message is written synchronously as it comes.
+ */
+typedef struct
+{
+    std::atomic<unsigned int> seq;
+    unsigned int level;
+    struct timeval time;            // since the logger started
+    char device[MAXINDIDEVICE];
+    char msg[257];
+} LogRecord;
+
+static LogRecord logQueue[LOG_QUEUE_SIZE];
+static std::atomic<unsigned int> logHead;      // next position to claim
+static unsigned int logTail;                    // next position to write, writer only
+static std::atomic<unsigned int> logDropped;
+
+static pthread_mutex_t sinkLock = PTHREAD_MUTEX_INITIALIZER;   // guards the log file and logTail
+static pthread_cond_t sinkCond = PTHREAD_COND_INITIALIZER;     // signalled to wake the writer
+static pthread_t writerThread;
+static bool writerRunning = false;
+static bool writerStop = false;
+
 
 char Logger::Tags[Logger::nlevels][MAXINDINAME]=
 {
@@ -336,6 +375,11 @@ void Logger::configure (const std::string&	outputFile,
 		fileVerbosityLevel_ = fileVerbosityLevel;
 		screenVerbosityLevel_ = screenVerbosityLevel;
 		rememberscreenlevel_= screenVerbosityLevel_;
+		// The writer may be using the old stream
+		pthread_mutex_lock(&sinkLock);
+		if (configuration_&file_on)
+			drainQueue();
+
 		// Close the old stream, if needed
 		if (configuration_&file_on)
 			out_.close();
@@ -368,6 +412,23 @@ void Logger::configure (const std::string&	outputFile,
 			out_.open(logFile_.c_str(), std::ios::app);
         }
 
+		pthread_mutex_unlock(&sinkLock);
+
+        if ((configuration&file_on) && writerRunning == false)
+        {
+            for (unsigned int i=0; i < LOG_QUEUE_SIZE; i++)
+                logQueue[i].seq.store(i, std::memory_order_relaxed);
+            logHead.store(0, std::memory_order_relaxed);
+            logTail = 0;
+
+            writerStop = false;
+            if (pthread_create(&writerThread, NULL, &Logger::writerHelper, this) == 0)
+            {
+                writerRunning = true;
+                atexit(&Logger::stopWriter);
+            }
+        }
+
 		configuration_ = configuration;
 		configured_ = true;
 
@@ -444,9 +505,12 @@ void Logger::print(const char *devicename,
   bool filelog = (verbosityLevel & fileVerbosityLevel_) != 0;
   bool screenlog = (verbosityLevel & screenVerbosityLevel_) != 0;
 
+  // Nothing to do unless it goes somewhere
+  if (configured_ && !((configuration_&file_on) && filelog) && !((configuration_&screen_on) && screenlog))
+      return;
+
   va_list ap;
   char msg[257];
-  char usec[7];
 
   msg[256]='\0';
   va_start(ap, message);
@@ -460,24 +524,162 @@ void Logger::print(const char *devicename,
 			return;
 	}
 	struct timeval currentTime, resTime;
-	usec[6]='\0';
 	gettimeofday(&currentTime, NULL);
 	timersub(&currentTime, &initialTime_, &resTime);
-	snprintf(usec, 7, "%06ld", resTime.tv_usec);
-	Logger::lock();
 
-    if ((configuration_&file_on) && filelog)
+    if ((configuration_&file_on) && filelog && writerRunning == false)
     {
-       if (nDevices == 1)
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) <<"."<<(usec) << " sec"<< "\t: " << msg << std::endl;
-       else
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) <<"."<<(usec) << " sec"<< "\t: [" << devicename << "] " << msg << std::endl;
+        pthread_mutex_lock(&sinkLock);
+        writeLine(verbosityLevel, resTime, devicename, msg);
+        if (out_.is_open())
+            out_.flush();
+        pthread_mutex_unlock(&sinkLock);
+    }
+    else if ((configuration_&file_on) && filelog)
+    {
+        // Claim a slot, unless the writer is a whole lap behind
+        unsigned int pos = logHead.load(std::memory_order_relaxed);
+        LogRecord *rp = NULL;
+
+        while (true)
+        {
+            rp = &logQueue[pos & (LOG_QUEUE_SIZE-1)];
+            int lag = (int) (rp->seq.load(std::memory_order_acquire) - pos);
+
+            if (lag == 0)
+            {
+                if (logHead.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (lag < 0)
+            {
+                rp = NULL;
+                logDropped++;
+                break;
+            }
+            else
+                pos = logHead.load(std::memory_order_relaxed);
+        }
+
+        if (rp)
+        {
+            rp->level = verbosityLevel;
+            rp->time = resTime;
+            strncpy(rp->device, devicename ? devicename : "", MAXINDIDEVICE);
+            rp->device[MAXINDIDEVICE-1] = '\0';
+            memcpy(rp->msg, msg, sizeof(msg));
+            rp->seq.store(pos+1, std::memory_order_release);
+        }
+
+        // Errors and warnings are on disk before we return in case the driver is about to die
+        if (verbosityLevel == DBG_ERROR || verbosityLevel == DBG_WARNING)
+            flush();
+        else if (rp && (pos % LOG_WAKE_BATCH) == 0)
+        {
+            pthread_mutex_lock(&sinkLock);
+            pthread_cond_signal(&sinkCond);
+            pthread_mutex_unlock(&sinkLock);
+        }
     }
 
 	if ((configuration_&screen_on) && screenlog)
+	{
+	  Logger::lock();
 	  IDMessage(devicename, "%s", msg);
+	  Logger::unlock();
+	}
+}
 
-	Logger::unlock();
+void Logger::flush()
+{
+    pthread_mutex_lock(&sinkLock);
+    drainQueue();
+    pthread_mutex_unlock(&sinkLock);
+}
+
+void Logger::writeLine(unsigned int level, const struct timeval &time, const char *device, const char *msg)
+{
+    char usec[7];
+
+    if (!out_.is_open())
+        return;
+
+    snprintf(usec, 7, "%06ld", (long) time.tv_usec);
+    if (nDevices == 1)
+        out_ << Tags[rank(level)] << "\t" << (time.tv_sec) <<"."<<(usec) << " sec"<< "\t: " << msg << '\n';
+    else
+        out_ << Tags[rank(level)] << "\t" << (time.tv_sec) <<"."<<(usec) << " sec"<< "\t: [" << (device ? device : "") << "] " << msg << '\n';
+}
+
+int Logger::drainQueue()
+{
+    int n=0;
+
+    while (true)
+    {
+        LogRecord *rp = &logQueue[logTail & (LOG_QUEUE_SIZE-1)];
+
+        if (rp->seq.load(std::memory_order_acquire) != logTail+1)
+            break;
+
+        writeLine(rp->level, rp->time, rp->device, rp->msg);
+
+        rp->seq.store(logTail + LOG_QUEUE_SIZE, std::memory_order_release);
+        logTail++;
+        n++;
+    }
+
+    unsigned int dropped = logDropped.exchange(0);
+    if (dropped > 0 && out_.is_open())
+        out_ << Tags[rank(DBG_WARNING)] << "\t" << dropped << " log messages dropped, the log file fell behind" << '\n';
+
+    if ((n > 0 || dropped > 0) && out_.is_open())
+        out_.flush();
+
+    return n;
+}
+
+void *Logger::writerHelper(void *context)
+{
+    (static_cast<Logger *> (context))->writerLoop();
+    return NULL;
+}
+
+// Write queued messages in batches, waiting up to LOG_WRITE_MS for more. Once told to stop, write those left and return.
+void Logger::writerLoop()
+{
+    pthread_mutex_lock(&sinkLock);
+
+    while (writerStop == false)
+    {
+        if (drainQueue() > 0)
+            continue;
+
+        struct timeval now;
+        struct timespec until;
+        gettimeofday(&now, NULL);
+        until.tv_sec  = now.tv_sec + (now.tv_usec + LOG_WRITE_MS*1000) / 1000000;
+        until.tv_nsec = ((now.tv_usec + LOG_WRITE_MS*1000) % 1000000) * 1000;
+        pthread_cond_timedwait(&sinkCond, &sinkLock, &until);
+    }
+
+    drainQueue();
+    pthread_mutex_unlock(&sinkLock);
+}
+
+// At exit, so what is queued reaches the file
+void Logger::stopWriter()
+{
+    if (writerRunning == false)
+        return;
+
+    pthread_mutex_lock(&sinkLock);
+    writerStop = true;
+    pthread_cond_signal(&sinkCond);
+    pthread_mutex_unlock(&sinkLock);
+
+    pthread_join(writerThread, NULL);
+    writerRunning = false;
 }
 
 }
@@ -59,10 +59,18 @@
 			__debug_stream__.str()); \
 	}
 */
-#define DEBUG(priority, msg) INDI::Logger::getInstance().print(getDeviceName(), priority, __FILE__, __LINE__,msg)
-#define DEBUGF(priority, msg, ...) INDI::Logger::getInstance().print(getDeviceName(), priority, __FILE__, __LINE__, msg, __VA_ARGS__)
-#define DEBUGDEVICE(device, priority, msg) INDI::Logger::getInstance().print(device, priority, __FILE__, __LINE__, msg)
-#define DEBUGFDEVICE(device, priority, msg, ...) INDI::Logger::getInstance().print(device, priority, __FILE__, __LINE__,  msg, __VA_ARGS__)
+/*
+ * The message and its arguments are only evaluated if the level is enabled, so a disabled DEBUG costs a test of a few
+ * bits. The priority is evaluated twice.
+ */
+#define DEBUG(priority, msg) (INDI::Logger::isEnabled(priority) ? \
+    INDI::Logger::getInstance().print(getDeviceName(), priority, __FILE__, __LINE__,msg) : (void)0)
+#define DEBUGF(priority, msg, ...) (INDI::Logger::isEnabled(priority) ? \
+    INDI::Logger::getInstance().print(getDeviceName(), priority, __FILE__, __LINE__, msg, __VA_ARGS__) : (void)0)
+#define DEBUGDEVICE(device, priority, msg) (INDI::Logger::isEnabled(priority) ? \
+    INDI::Logger::getInstance().print(device, priority, __FILE__, __LINE__, msg) : (void)0)
+#define DEBUGFDEVICE(device, priority, msg, ...) (INDI::Logger::isEnabled(priority) ? \
+    INDI::Logger::getInstance().print(device, priority, __FILE__, __LINE__,  msg, __VA_ARGS__) : (void)0)
 
 namespace  INDI
 {
@@ -169,6 +177,25 @@ class Logger
          */
         inline static void unlock();
 
+        /**
+         * \brief Write the messages queued for the log file and flush it if there were any.
+         * Called with the sink lock held.
+         * @return number of messages written.
+         */
+        int drainQueue();
+
+        /**
+         * \brief Write one message to the log file, without flushing it. Called with the sink lock held.
+         */
+        void writeLine(unsigned int level, const struct timeval &time, const char *device, const char *msg);
+
+        /**
+         * \brief Log file writer thread, drains the queue as messages arrive until told to stop.
+         */
+        static void *writerHelper(void *context);
+        void writerLoop();
+        static void stopWriter();
+
         static INDI::DefaultDevice *parentDevice;
 
  public:
@@ -206,6 +233,26 @@ class Logger
      */
     int addDebugLevel(const char *debugLevelName, const char *LoggingLevelName);
 
+    /**
+     * @brief Is logging at a level going anywhere?
+     * @param verbosityLevel debug level.
+     * @return true if a message at this level would reach the log file or the client, or the logger is not configured
+     * yet and so prints every message.
+     */
+    static bool isEnabled(unsigned int verbosityLevel)
+    {
+        return (m_ == 0 || m_->configured_ == false ||
+                ((configuration_ & file_on) && (verbosityLevel & fileVerbosityLevel_)) ||
+                ((configuration_ & screen_on) && (verbosityLevel & screenVerbosityLevel_)));
+    }
+
+    /**
+     * @brief Write out any messages still queued for the log file and flush it.
+     * Messages to the log file are queued and written in batches by a thread of their own, so a driver may call this
+     * before it does anything that might lose them.
+     */
+    void flush();
+
     void print(const char *devicename,
      const unsigned int		verbosityLevel,
      const std::string&	sourceFile,
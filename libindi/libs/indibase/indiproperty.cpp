@@ -20,17 +20,33 @@
 #include <stdlib.h>
 #endif
 
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
 #include "basedevice.h"
 #include "indicom.h"
 #include "base64.h"
 #include "indiproperty.h"
 
+// Vectors with fewer elements are searched faster than hashed
+#define MIN_INDEXED_ELEMENTS    8
+
+// Elements by name, valid while the element array and count are still array and count
+struct INDI::Property::ElementIndex
+{
+    std::unordered_map<std::string, int> byName;
+    const void *array;
+    int count;
+};
+
 INDI::Property::Property()
 {
     pPtr = NULL;
     pRegistered = false;
     pDynamic = false;
     pType = INDI_UNKNOWN;
+    eIndex = NULL;
 }
 
 INDI::Property::~Property()
@@ -93,6 +109,8 @@ INDI::Property::~Property()
             break;
         }
     }
+
+    delete eIndex;
 }
 
 void INDI::Property::setProperty(void *p)
@@ -392,3 +410,146 @@ IBLOBVectorProperty   *INDI::Property::getBLOB()
 
 }
 
+void INDI::Property::getElements(const void **array, int *count) const
+{
+    *array = NULL;
+    *count = 0;
+
+    if (pPtr == NULL)
+        return;
+
+    switch (pType)
+    {
+    case INDI_NUMBER:
+        *array = ((INumberVectorProperty *) pPtr)->np;
+        *count = ((INumberVectorProperty *) pPtr)->nnp;
+        break;
+
+    case INDI_TEXT:
+        *array = ((ITextVectorProperty *) pPtr)->tp;
+        *count = ((ITextVectorProperty *) pPtr)->ntp;
+        break;
+
+    case INDI_SWITCH:
+        *array = ((ISwitchVectorProperty *) pPtr)->sp;
+        *count = ((ISwitchVectorProperty *) pPtr)->nsp;
+        break;
+
+    case INDI_LIGHT:
+        *array = ((ILightVectorProperty *) pPtr)->lp;
+        *count = ((ILightVectorProperty *) pPtr)->nlp;
+        break;
+
+    case INDI_BLOB:
+        *array = ((IBLOBVectorProperty *) pPtr)->bp;
+        *count = ((IBLOBVectorProperty *) pPtr)->nbp;
+        break;
+
+    case INDI_UNKNOWN:
+        break;
+    }
+}
+
+const char * INDI::Property::elementName(int i) const
+{
+    switch (pType)
+    {
+    case INDI_NUMBER:
+        return ((INumberVectorProperty *) pPtr)->np[i].name;
+
+    case INDI_TEXT:
+        return ((ITextVectorProperty *) pPtr)->tp[i].name;
+
+    case INDI_SWITCH:
+        return ((ISwitchVectorProperty *) pPtr)->sp[i].name;
+
+    case INDI_LIGHT:
+        return ((ILightVectorProperty *) pPtr)->lp[i].name;
+
+    case INDI_BLOB:
+        return ((IBLOBVectorProperty *) pPtr)->bp[i].name;
+
+    case INDI_UNKNOWN:
+        break;
+    }
+
+    return NULL;
+}
+
+void INDI::Property::indexElements()
+{
+    const void *array;
+    int count;
+
+    getElements(&array, &count);
+
+    delete eIndex;
+    eIndex = NULL;
+
+    if (array == NULL || count < MIN_INDEXED_ELEMENTS)
+        return;
+
+    eIndex = new ElementIndex;
+
+    // The first of any elements of the same name wins, as with a linear search
+    for (int i=0; i < count; i++)
+        eIndex->byName.insert(std::make_pair(std::string(elementName(i)), i));
+
+    eIndex->array = array;
+    eIndex->count = count;
+}
+
+int INDI::Property::findElement(const char *name) const
+{
+    const void *array;
+    int count;
+
+    getElements(&array, &count);
+
+    if (array == NULL || name == NULL)
+        return -1;
+
+    if (eIndex && array == eIndex->array && count == eIndex->count)
+    {
+        std::unordered_map<std::string, int>::const_iterator it = eIndex->byName.find(name);
+        if (it != eIndex->byName.end() && !strcmp(elementName(it->second), name))
+            return it->second;
+    }
+
+    // Not indexed, changed since, or no such element
+    for (int i=0; i < count; i++)
+        if (!strcmp(elementName(i), name))
+            return i;
+
+    return -1;
+}
+
+INumber * INDI::Property::findNumber(const char *name) const
+{
+    int i = (pType == INDI_NUMBER) ? findElement(name) : -1;
+    return (i < 0) ? NULL : &((INumberVectorProperty *) pPtr)->np[i];
+}
+
+IText * INDI::Property::findText(const char *name) const
+{
+    int i = (pType == INDI_TEXT) ? findElement(name) : -1;
+    return (i < 0) ? NULL : &((ITextVectorProperty *) pPtr)->tp[i];
+}
+
+ISwitch * INDI::Property::findSwitch(const char *name) const
+{
+    int i = (pType == INDI_SWITCH) ? findElement(name) : -1;
+    return (i < 0) ? NULL : &((ISwitchVectorProperty *) pPtr)->sp[i];
+}
+
+ILight * INDI::Property::findLight(const char *name) const
+{
+    int i = (pType == INDI_LIGHT) ? findElement(name) : -1;
+    return (i < 0) ? NULL : &((ILightVectorProperty *) pPtr)->lp[i];
+}
+
+IBLOB * INDI::Property::findBLOB(const char *name) const
+{
+    int i = (pType == INDI_BLOB) ? findElement(name) : -1;
+    return (i < 0) ? NULL : &((IBLOBVectorProperty *) pPtr)->bp[i];
+}
@@ -59,12 +59,38 @@ public:
     ILightVectorProperty  *getLight();
     IBLOBVectorProperty   *getBLOB();
 
+    /** \brief Index the elements of the property by name for findElement(). Called once the property is complete.
+        The index only speeds up lookups. If the element array changes afterwards they search linearly until indexed again.
+    */
+    void indexElements();
+
+    /** \return index of the element called \e name, or -1 if there is none. */
+    int findElement(const char *name) const;
+
+    // Elements by name, NULL if there is none or the property is of another type
+    INumber *findNumber(const char *name) const;
+    IText   *findText(const char *name) const;
+    ISwitch *findSwitch(const char *name) const;
+    ILight  *findLight(const char *name) const;
+    IBLOB   *findBLOB(const char *name) const;
+
 private:
+    const char *elementName(int i) const;
+    void getElements(const void **array, int *count) const;
+
     void *pPtr;
     BaseDevice *dp;
     INDI_PROPERTY_TYPE pType;
     bool pRegistered;
     bool pDynamic;
+
+    // Element index built by indexElements(), defined in indiproperty.cpp. NULL if not indexed.
+    struct ElementIndex;
+    ElementIndex *eIndex;
+
+    // Not copyable, eIndex is owned
+    Property(const Property &);
+    Property &operator=(const Property &);
 };
 
 } // namespace INDI
@@ -22,6 +22,7 @@
 #include "indiusbdevice.h"
 
 #include <string.h>
+#include <sys/time.h>
 
 #ifdef NO_ERROR_NAME
 const char * LIBUSB_CALL libusb_error_name(int errcode)
@@ -39,6 +40,7 @@ INDI::USBDevice::USBDevice() {
 	usb_handle=NULL;
 	OutputEndpoint=0;
 	InputEndpoint=0;
+	AbortRead=0;
 
   if (ctx == NULL) {
     int rc = libusb_init(&ctx);
@@ -165,6 +167,165 @@ int INDI::USBDevice::ReadBulk(unsigned char *buf, int count, int timeout) {
 	return rc < 0 ? rc : transferred;
 }
 
+#define ASYNC_CHUNK   (256*1024)
+#define ASYNC_DEPTH   4
+#define ASYNC_MAXDEPTH 32
+
+/* one ReadBulkAsync(), shared by its transfers */
+struct AsyncRead {
+  unsigned char *buf;
+  int count;
+  int chunk;
+  int next;             /* offset of the next chunk to submit */
+  int done;             /* bytes in place at the start of buf */
+  int inflight;
+  int rc;               /* first error, or 0 */
+  bool stop;            /* submit no more, cancel those in flight */
+};
+
+/* a transfer is back: count it and send it for the next chunk, if any.
+ * transfers on one endpoint complete in order, so buf fills from the start.
+ * once stopped, those after are cancelled: their being cancelled, or timing
+ * out first, is no error.
+ */
+static void LIBUSB_CALL asyncReadDone(struct libusb_transfer *transfer) {
+  AsyncRead *ar = (AsyncRead *)transfer->user_data;
+
+  ar->inflight--;
+  if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+    if (!ar->stop)
+      ar->done += transfer->actual_length;
+    /* a short one ends the read, anything after it would be misplaced */
+    if (transfer->actual_length < transfer->length)
+      ar->stop = true;
+  } else if (ar->stop && (transfer->status == LIBUSB_TRANSFER_CANCELLED || transfer->status == LIBUSB_TRANSFER_TIMED_OUT)) {
+    /* one of those after the end */
+  } else {
+    if (ar->rc == 0) {
+      switch (transfer->status) {
+        case LIBUSB_TRANSFER_TIMED_OUT: ar->rc = LIBUSB_ERROR_TIMEOUT; break;
+        case LIBUSB_TRANSFER_STALL: ar->rc = LIBUSB_ERROR_PIPE; break;
+        case LIBUSB_TRANSFER_NO_DEVICE: ar->rc = LIBUSB_ERROR_NO_DEVICE; break;
+        case LIBUSB_TRANSFER_OVERFLOW: ar->rc = LIBUSB_ERROR_OVERFLOW; break;
+        case LIBUSB_TRANSFER_CANCELLED: ar->rc = LIBUSB_ERROR_INTERRUPTED; break;
+        default: ar->rc = LIBUSB_ERROR_IO; break;
+      }
+    }
+    ar->stop = true;
+  }
+
+  if (ar->stop || ar->next >= ar->count)
+    return;
+
+  int size = ar->count - ar->next < ar->chunk ? ar->count - ar->next : ar->chunk;
+  transfer->buffer = ar->buf + ar->next;
+  transfer->length = size;
+  int rc = libusb_submit_transfer(transfer);
+  if (rc < 0) {
+    fprintf(stderr, "USBDevice: libusb_submit_transfer -> %s\n", libusb_error_name(rc));
+    if (ar->rc == 0)
+      ar->rc = rc;
+    ar->stop = true;
+    return;
+  }
+  ar->next += size;
+  ar->inflight++;
+}
+
+int INDI::USBDevice::ReadBulkAsync(libusb_context *context, libusb_device_handle *handle, unsigned char endpoint, unsigned char *buf, int count,
+                                   int chunk, int depth, int timeout, USBReadProgress progress, void *userdata, volatile int *abort) {
+  struct libusb_transfer *transfers[ASYNC_MAXDEPTH];
+  AsyncRead ar;
+  int reported = 0;
+  int n;
+
+  if (chunk <= 0)
+    chunk = ASYNC_CHUNK;
+  if (depth <= 0)
+    depth = ASYNC_DEPTH;
+  if (depth > ASYNC_MAXDEPTH)
+    depth = ASYNC_MAXDEPTH;
+
+  if (abort && *abort)
+    return LIBUSB_ERROR_INTERRUPTED;
+
+  memset(&ar, 0, sizeof(ar));
+  ar.buf = buf;
+  ar.count = count;
+  ar.chunk = chunk;
+
+  /* fill the pipe */
+  for (n = 0; n < depth && ar.next < count; n++) {
+    int size = count - ar.next < chunk ? count - ar.next : chunk;
+    transfers[n] = libusb_alloc_transfer(0);
+    if (transfers[n] == NULL) {
+      ar.rc = LIBUSB_ERROR_NO_MEM;
+      break;
+    }
+    libusb_fill_bulk_transfer(transfers[n], handle, endpoint, buf + ar.next, size, asyncReadDone, &ar, timeout);
+    int rc = libusb_submit_transfer(transfers[n]);
+    if (rc < 0) {
+      fprintf(stderr, "USBDevice: libusb_submit_transfer -> %s\n", libusb_error_name(rc));
+      libusb_free_transfer(transfers[n]);
+      ar.rc = rc;
+      break;
+    }
+    ar.next += size;
+    ar.inflight++;
+  }
+  if (ar.rc != 0)
+    ar.stop = true;
+
+  /* run the callbacks until all are back, cancelling the rest once stopped by a short read, an error or abort */
+  bool cancelled = false;
+  while (ar.inflight > 0) {
+    struct timeval tv = { 0, 100000 };
+    int rc = libusb_handle_events_timeout_completed(context, &tv, NULL);
+    if (rc < 0 && rc != LIBUSB_ERROR_INTERRUPTED && ar.rc == 0) {
+      fprintf(stderr, "USBDevice: libusb_handle_events -> %s\n", libusb_error_name(rc));
+      ar.rc = rc;
+      ar.stop = true;
+    }
+
+    if (!ar.stop && ar.done > reported && progress) {
+      reported = ar.done;
+      if (!progress(ar.done, count, userdata) && ar.rc == 0)
+        ar.rc = LIBUSB_ERROR_INTERRUPTED;
+    }
+    if (abort && *abort && ar.rc == 0)
+      ar.rc = LIBUSB_ERROR_INTERRUPTED;
+
+    if ((ar.stop || ar.rc != 0) && !cancelled) {
+      ar.stop = true;
+      for (int i = 0; i < n; i++)
+        libusb_cancel_transfer(transfers[i]);
+      cancelled = true;
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+    libusb_free_transfer(transfers[i]);
+
+  if (ar.rc == 0 && progress && ar.done > reported)
+    progress(ar.done, count, userdata);
+
+  if (ar.rc < 0 && ar.rc != LIBUSB_ERROR_INTERRUPTED)
+    fprintf(stderr, "USBDevice: bulk read -> %s\n", libusb_error_name(ar.rc));
+
+  return ar.rc < 0 ? ar.rc : ar.done;
+}
+
+int INDI::USBDevice::ReadBulkAsync(unsigned char *buf, int count, int chunk, int depth, int timeout, USBReadProgress progress, void *userdata) {
+  int rc = ReadBulkAsync(ctx, usb_handle, InputEndpoint, buf, count, chunk, depth, timeout, progress, userdata, &AbortRead);
+  /* an abort asked for before the read began is for it, not the next */
+  AbortRead = 0;
+  return rc;
+}
+
+void INDI::USBDevice::AbortReadBulk() {
+  AbortRead = 1;
+}
+
 int INDI::USBDevice::WriteBulk(unsigned char *buf,int count,int timeout) {
   int transferred;
 	int rc = libusb_bulk_transfer(usb_handle, OutputEndpoint, buf, count, &transferred, timeout);
@@ -37,6 +37,14 @@
 
 #include "indibase.h"
 
+/** \brief Called as ReadBulkAsync() fills its buffer.
+    \param done bytes read so far.
+    \param total bytes asked for.
+    \param userdata as passed to ReadBulkAsync().
+    \return true to go on, false to cancel the read.
+*/
+typedef bool (*USBReadProgress)(int done, int total, void *userdata);
+
 /**
  * \class INDI::USBDevice
    \brief Class to provide general functionality of a generic USB device.
@@ -59,11 +67,42 @@ protected:
 
 	libusb_device *FindDevice(int,int,int);
 
+	volatile int AbortRead;
+
 public:
 	int WriteInterrupt(unsigned char *, int, int);
 	int ReadInterrupt(unsigned char *, int, int);
   int WriteBulk(unsigned char *buf, int nbytes, int timeout);
   int ReadBulk(unsigned char *buf, int nbytes, int timeout);
+
+  /** \brief Read nbytes from the input endpoint into buf, keeping several transfers in flight so the bus is never idle.
+      \param buf buffer for the whole frame.
+      \param nbytes bytes to read.
+      \param chunk bytes per transfer, or 0 for the default of 256 KiB.
+      \param depth transfers in flight, or 0 for the default of 4.
+      \param timeout milliseconds each transfer may take.
+      \param progress if not NULL, called from the reading thread each time more data has arrived.
+      \param userdata passed to progress.
+      \return bytes read, fewer than nbytes if the device ended the read early, or a negative libusb error:
+      LIBUSB_ERROR_INTERRUPTED if cancelled by progress or AbortReadBulk().
+  */
+  int ReadBulkAsync(unsigned char *buf, int nbytes, int chunk=0, int depth=0, int timeout=5000, USBReadProgress progress=NULL, void *userdata=NULL);
+
+  /** \brief Cancel a ReadBulkAsync() in progress, or the next one to start, from any thread.
+      It only asks for the cancel and returns at once. The read returns LIBUSB_ERROR_INTERRUPTED once its transfers are back.
+  */
+  void AbortReadBulk();
+
+  /** \brief ReadBulkAsync() for drivers with a libusb handle of their own.
+      \param context libusb context handle was opened in, NULL for the default one.
+      \param handle device handle.
+      \param endpoint bulk input endpoint.
+      \param abort if not NULL, the read is cancelled as soon as it is set non-zero.
+      \note The other parameters and the return value are as for ReadBulkAsync().
+  */
+  static int ReadBulkAsync(libusb_context *context, libusb_device_handle *handle, unsigned char endpoint, unsigned char *buf, int nbytes,
+                           int chunk, int depth, int timeout, USBReadProgress progress, void *userdata, volatile int *abort);
+
   int ControlMessage(unsigned char request_type, unsigned char request, unsigned int value, unsigned int index, unsigned char *data, unsigned char len);
 	int FindEndpoints();
 	int Open();
@@ -72,9 +72,18 @@
 #endif
 
 #define MAXRBUF         2048
+#define TTY_BUFSIZE     512
 
 int tty_debug = 0;
 
+/* Bytes read from a terminal ahead of the caller, see tty_reader_new() */
+struct _TTYReader
+{
+    int fd;
+    char buf[TTY_BUFSIZE];
+    int start, end;         /* unread bytes are buf[start..end) */
+};
+
 #ifndef _WIN32
 int extractISOTime(const char *timestr, struct ln_date *iso_date)
 {
@@ -473,6 +482,178 @@ int tty_read_section(int fd, char *buf, char stop_char, int timeout, int *nbytes
  #endif
 }
 
+int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read)
+{
+    #ifdef _WIN32
+    return TTY_ERRNO;
+    #else
+
+    if (fd == -1)
+           return TTY_ERRNO;
+
+ int bytesRead = 0;
+ int err = TTY_OK;
+ *nbytes_read = 0;
+
+ if (nsize <= 0)
+     return TTY_PARAM_ERROR;
+
+ if (tty_debug)
+     IDLog("%s: Request to read until stop char '%c' with %d timeout for fd %d\n", __FUNCTION__, stop_char, timeout, fd);
+
+ while (*nbytes_read < nsize)
+ {
+         if ( (err = tty_timeout(fd, timeout)) )
+           return err;
+
+         bytesRead = read(fd, buf+*nbytes_read, 1);
+
+         /* readable yet nothing there: the other end has gone */
+         if (bytesRead <= 0)
+            return TTY_READ_ERROR;
+
+         if (tty_debug)
+                IDLog("%s: buffer[%d]=%#X (%c)\n", __FUNCTION__, (*nbytes_read), (unsigned char) buf[*nbytes_read], buf[*nbytes_read]);
+
+         if (buf[(*nbytes_read)++] == stop_char)
+           return TTY_OK;
+ }
+
+ return TTY_OVERFLOW;
+
+ #endif
+}
+
+TTYReader *tty_reader_new(int fd)
+{
+    TTYReader *tr;
+
+    if (fd == -1 || (tr = (TTYReader *) calloc(1, sizeof(TTYReader))) == NULL)
+        return NULL;
+
+    tr->fd = fd;
+    return tr;
+}
+
+void tty_reader_free(TTYReader *tr)
+{
+    free(tr);
+}
+
+int tty_reader_section(TTYReader *tr, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read)
+{
+    #ifdef _WIN32
+    return TTY_ERRNO;
+    #else
+
+ int err = TTY_OK;
+ *nbytes_read = 0;
+
+ if (tr == NULL || nsize <= 0)
+     return TTY_PARAM_ERROR;
+
+ if (tty_debug)
+     IDLog("%s: Request to read until stop char '%c' with %d timeout for fd %d\n", __FUNCTION__, stop_char, timeout, tr->fd);
+
+ for (;;)
+ {
+         /* refill with whatever has arrived once all read ahead is handed over */
+         if (tr->start == tr->end)
+         {
+             int bytesRead;
+
+             if ( (err = tty_timeout(tr->fd, timeout)) )
+               return err;
+
+             bytesRead = read(tr->fd, tr->buf, TTY_BUFSIZE);
+             if (bytesRead <= 0)
+               return TTY_READ_ERROR;
+
+             tr->start = 0;
+             tr->end = bytesRead;
+         }
+
+         /* hand over what we have up to the stop char, or as much as fits */
+         char *read_char = tr->buf + tr->start;
+         int n = tr->end - tr->start;
+         if (n > nsize - *nbytes_read)
+             n = nsize - *nbytes_read;
+         char *stop = (char *) memchr(read_char, stop_char, n);
+         if (stop)
+             n = stop - read_char + 1;
+
+         memcpy(buf + *nbytes_read, read_char, n);
+         tr->start += n;
+
+         if (tty_debug)
+         {
+             int i=0;
+             for (i=*nbytes_read; i < *nbytes_read + n; i++)
+                IDLog("%s: buffer[%d]=%#X (%c)\n", __FUNCTION__, i, (unsigned char) buf[i], buf[i]);
+         }
+
+         *nbytes_read += n;
+
+        if (stop)
+         return TTY_OK;
+
+        if (*nbytes_read == nsize)
+         return TTY_OVERFLOW;
+  }
+
+ #endif
+}
+
+int tty_reader_read(TTYReader *tr, char *buf, int nbytes, int timeout, int *nbytes_read)
+{
+    #ifdef _WIN32
+    return TTY_ERRNO;
+    #else
+
+    int n, err;
+
+    *nbytes_read = 0;
+
+    if (tr == NULL || nbytes <= 0)
+        return TTY_PARAM_ERROR;
+
+    /* what was read ahead goes first */
+    n = tr->end - tr->start < nbytes ? tr->end - tr->start : nbytes;
+    memcpy(buf, tr->buf + tr->start, n);
+    tr->start += n;
+
+    if (n == nbytes)
+    {
+        *nbytes_read = n;
+        return TTY_OK;
+    }
+
+    err = tty_read(tr->fd, buf + n, nbytes - n, timeout, nbytes_read);
+    *nbytes_read += n;
+    return err;
+
+    #endif
+}
+
+int tty_reader_flush(TTYReader *tr)
+{
+    #ifdef _WIN32
+    return TTY_ERRNO;
+    #else
+
+    if (tr == NULL)
+        return TTY_PARAM_ERROR;
+
+    tr->start = tr->end = 0;
+
+    if (tcflush(tr->fd, TCIFLUSH) != 0)
+        return TTY_ERRNO;
+
+    return TTY_OK;
+
+    #endif
+}
+
 #if defined(BSD) && !defined(__GNU__)
 // BSD - OSX version
 int tty_connect(const char *device, int bit_rate, int word_size, int parity, int stop_bits, int *fd)
@@ -1019,6 +1200,10 @@ void tty_error_msg(int err_code, char *err_msg, int err_msg_len)
 		strncpy(err_msg, error_string, err_msg_len);
 		break;
 
+	case TTY_OVERFLOW:
+		strncpy(err_msg, "Read overflow error", err_msg_len);
+		break;
+
 	default:
 		strncpy(err_msg, "Error: unrecognized error code", err_msg_len);
 		break;
@@ -51,8 +51,11 @@ extern const char * SolarSystem[];
 
 struct ln_date;
 
+/* Buffered terminal reader, see tty_reader_new() */
+typedef struct _TTYReader TTYReader;
+
 /* TTY Error Codes */
-enum TTY_ERROR { TTY_OK=0, TTY_READ_ERROR=-1, TTY_WRITE_ERROR=-2, TTY_SELECT_ERROR=-3, TTY_TIME_OUT=-4, TTY_PORT_FAILURE=-5, TTY_PARAM_ERROR=-6, TTY_ERRNO = -7};
+enum TTY_ERROR { TTY_OK=0, TTY_READ_ERROR=-1, TTY_WRITE_ERROR=-2, TTY_SELECT_ERROR=-3, TTY_TIME_OUT=-4, TTY_PORT_FAILURE=-5, TTY_PARAM_ERROR=-6, TTY_ERRNO = -7, TTY_OVERFLOW = -8};
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,6 +88,49 @@ int tty_read(int fd, char *buf, int nbytes, int timeout, int *nbytes_read);
 
 int tty_read_section(int fd, char *buf, char stop_char, int timeout, int *nbytes_read);
 
+/** \brief read buffer from terminal with a delimiter, reading no more than the buffer holds
+    \param fd file descriptor
+    \param buf pointer to store data.
+    \param nsize size of \e buf in bytes.
+    \param stop_char if the function encounters \e stop_char then it stops reading and returns the buffer.
+    \param timeout number of seconds to wait for terminal before a timeout error is issued.
+    \param nbytes_read the number of bytes read.
+    \return On success, it returns TTY_OK. If \e buf fills up before \e stop_char arrives it returns TTY_OVERFLOW
+    with \e nsize bytes read, and the rest of the frame is left unread. Otherwise, a TTY_ERROR code.
+    \note Like tty_read_section(), nothing past \e stop_char is read from \e fd.
+*/
+int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read);
+
+/** \brief Make a reader that reads \e fd in blocks of whatever has arrived rather than byte by byte.
+    Bytes that arrive after a stop char are kept in the reader for its next read. Use one only when every read on \e fd
+    goes through it: tty_read(), tty_read_section() and tcflush() do not see what it has read ahead, so use
+    tty_reader_read() and tty_reader_flush() instead. A reader is not shared between threads.
+    \param fd file descriptor
+    \return new reader, free it with tty_reader_free(), or NULL if out of memory.
+*/
+TTYReader *tty_reader_new(int fd);
+
+/** \brief Free a reader made by tty_reader_new(). The fd is left open. */
+void tty_reader_free(TTYReader *tr);
+
+/** \brief tty_nread_section() through a reader, reading ahead as much as has arrived.
+    \param tr reader from tty_reader_new()
+    \return as tty_nread_section(). On TTY_OVERFLOW the rest of the frame is kept for the next read.
+*/
+int tty_reader_section(TTYReader *tr, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read);
+
+/** \brief tty_read() through a reader, handing over what it has read ahead first.
+    \param tr reader from tty_reader_new()
+    \return as tty_read().
+*/
+int tty_reader_read(TTYReader *tr, char *buf, int nbytes, int timeout, int *nbytes_read);
+
+/** \brief Discard input: what the reader has read ahead and whatever the terminal has received but not yet been read.
+    \param tr reader from tty_reader_new()
+    \return On success, it returns TTY_OK, otherwise, a TTY_ERROR code.
+*/
+int tty_reader_flush(TTYReader *tr);
+
 
 /** \brief Writes a buffer to fd.
     \param fd file descriptor
@@ -22,6 +22,11 @@
  * only handles elements, attributes and pcdata content.
  * <! ... > and <? ... > are silently ignored.
  * pcdata is collected into one string, sans leading whitespace first line.
+ * parseXMLChunk() copies runs of pcdata, attribute value and name chars in
+ *   bulk, found a block of bytes at a time, rather than one by one.
+ * a parser set with arenaLilXML() builds each document in one arena of a few
+ *   large blocks, with tag and attribute names from the INDI vocabulary
+ *   pointing at static strings, and deleting the root frees it all at once.
  *
  * #define MAIN_TST to create standalone test program
  */
@@ -40,13 +45,43 @@
 
 #include "lilxml.h"
 
-/* used to efficiently manage growing malloced string space */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define	SCANBLK	16			/* bytes tested at once */
+#endif
+
+typedef struct _XMLArena XMLArena;
+
+/* used to efficiently manage growing malloced string space.
+ * sm == 0 with s set means s is static, eg an interned name.
+ */
 typedef struct {
     char *s;				/* malloced memory for string */
     int sl;				/* string length, sans trailing \0 */
     int sm;				/* total malloced bytes */
+    XMLArena *ar;			/* arena s comes from, else NULL */
 } String;
 #define	MINMEM	64			/* starting string length */
+#define	MINARENA 16			/* starting string length in arena */
+
+/* blocks one document is built in, with the first one inline.
+ * Strings of ARENABIG or more, such as BLOBs, each get a block of their own
+ * so they can grow with realloc.
+ */
+typedef struct _ArenaBlock {
+    struct _ArenaBlock *next;		/* older blocks */
+    struct _ArenaBlock *prev;		/* newer blocks */
+} ArenaBlock;
+struct _XMLArena {
+    char *top;				/* next free byte in current block */
+    char *end;				/* end of current block */
+    ArenaBlock *blocks;			/* malloced blocks after the first */
+    size_t nextsz;			/* size of the next block */
+    XMLEle *root;			/* document root, deleting it frees us */
+};
+#define	ARENASZ	4096			/* bytes in first block */
+#define	ARENAAL	8			/* arena allocation alignment */
+#define	ARENABIG 65536			/* min String with a block of its own */
 
 static int oneXMLchar (LilXML *lp, int c, char ynot[]);
 static void initParser(LilXML *lp);
@@ -54,14 +89,27 @@ static void pushXMLEle(LilXML *lp);
 static void popXMLEle(LilXML *lp);
 static void resetEndTag(LilXML *lp);
 static XMLAtt *growAtt(XMLEle *e);
-static XMLEle *growEle(XMLEle *pe);
+static XMLEle *growEle(XMLEle *pe, XMLArena *ar);
+static void *growList (XMLArena *ar, void *list, int n, int size);
 static void freeAtt (XMLAtt *a);
+static void freeForeign (XMLEle *ep);
 static int isTokenChar (int start, int c);
+static int bulkXMLchars (LilXML *lp, const char *p, int n);
+static int scanText (const char *p, int n, int d, int noctl);
+static int scanToken (const char *p, int n);
+static int scanSpace (const char *p, int n);
 static void growString (String *sp, int c);
 static void appendString (String *sp, const char *str);
+static void appendBytes (String *sp, const char *p, int n);
+static void sizeString (String *sp, int n);
+static void internString (String *sp);
 static void freeString (String *sp);
-static void newString (String *sp);
+static void newString (String *sp, XMLArena *ar);
 static void *moremem (void *old, int n);
+static XMLArena *newArena (void);
+static void *arenaAlloc (XMLArena *ar, int n);
+static void freeArena (XMLArena *ar);
+static ArenaBlock *linkBlock (XMLArena *ar, ArenaBlock *bp, ArenaBlock *old);
 
 typedef enum  {
     LOOK4START = 0,			/* looking for first element start */
@@ -92,6 +140,7 @@ struct _LilXML {
     int lastc;				/* last char (just used wiht skipping)*/
     int skipping;			/* in comment or declaration */
     int inblob;                         /* in oneBLOB element */
+    int arena;				/* build each document in an arena */
 };
 
 /* internal representation of a (possibly nested) XML element */
@@ -106,6 +155,7 @@ struct _xml_ele {
     int eit;				/* used to iterate over el[] */
     String pcdata;			/* character data in this element */
     int pcdata_hasent;			/* 1 if pcdata contains an entity char*/
+    XMLArena *ar;			/* arena we live in, else NULL */
 };
 
 /* internal representation of an attribute */
@@ -119,6 +169,22 @@ struct _xml_att {
  */
 static char entities[] = "&<>'\"";
 
+/* tag and attribute names arena documents share rather than copy.
+ * N.B. must stay sorted for internString()
+ */
+static const char *vocab[] = {
+    "BLOB", "defBLOB", "defBLOBVector", "defLight", "defLightVector",
+    "defNumber", "defNumberVector", "defSwitch", "defSwitchVector", "defText",
+    "defTextVector", "delProperty", "device", "enableBLOB", "enclen",
+    "format", "getProperties", "group", "label", "max", "message", "min",
+    "name", "newBLOBVector", "newNumberVector", "newSwitchVector",
+    "newTextVector", "oneBLOB", "oneLight", "oneNumber", "oneSwitch",
+    "oneText", "perm", "rule", "setBLOBVector", "setLightVector",
+    "setNumberVector", "setSwitchVector", "setTextVector", "size", "state",
+    "step", "timeout", "timestamp", "version",
+};
+#define	NVOCAB	((int)(sizeof(vocab)/sizeof(vocab[0])))
+
 /* default memory managers, override with lilxmlMalloc() */
 static void *(*mymalloc)(size_t size) = malloc;
 static void *(*myrealloc)(void *ptr, size_t size) = realloc;
@@ -151,11 +217,21 @@ newLilXML ()
 void
 delLilXML (LilXML *lp)
 {
-        delXMLEle (lp->ce);
+        initParser (lp);
         freeString (&lp->endtag);
         (*myfree) (lp);
 }
 
+/* build each document lp parses from now on in an arena, or not.
+ * all of a document is freed at once when its root is deleted, so no part
+ * of it may outlive delXMLEle() of the root.
+ */
+void
+arenaLilXML (LilXML *lp, int on)
+{
+        lp->arena = on;
+}
+
 /* delete ep and all its children and remove from parent's list if known */
 void
 delXMLEle (XMLEle *ep)
@@ -166,6 +242,25 @@ delXMLEle (XMLEle *ep)
         if (!ep)
             return;
 
+        /* in an arena, just unlink unless it is the whole document */
+        if (ep->ar) {
+            if (ep->pe) {
+                XMLEle *pe = ep->pe;
+                for (i = 0; i < pe->nel; i++) {
+                    if (pe->el[i] == ep) {
+                        memmove (&pe->el[i], &pe->el[i+1],
+                                              (--pe->nel-i)*sizeof(XMLEle*));
+                        break;
+                    }
+                }
+            }
+            if (ep->ar->root == ep) {
+                freeForeign (ep);
+                freeArena (ep->ar);
+            }
+            return;
+        }
+
         /* delete all parts of ep */
         freeString (&ep->tag);
         freeString (&ep->pcdata);
@@ -222,8 +317,7 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[]) {
     #ifdef WITH_MEMCHR
     char *ltpos=memchr(buf, '<', size);
     if (!ltpos) {
-      lp->ce->pcdata.s=(char *)moremem(lp->ce->pcdata.s, lp->ce->pcdata.sm+size);
-      lp->ce->pcdata.sm+=size;
+      sizeString(&lp->ce->pcdata, lp->ce->pcdata.sm+size);
       memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
       lp->ce->pcdata.sl += size;
       return nodes;
@@ -244,8 +338,7 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[]) {
 	      blen += (blen/72) + 1; // add room for those '\n'
 	    else
 	      blen += (blen/72);
-	    lp->ce->pcdata.s=(char *)moremem(lp->ce->pcdata.s, blen);
-	    lp->ce->pcdata.sm=blen;  // or always set sm
+	    sizeString(&lp->ce->pcdata, blen);
 	    //}
 	  if (size < blen - lp->ce->pcdata.sl) {
 	    memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
@@ -258,8 +351,7 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[]) {
     #ifdef WITH_MEMCHR
 	char *ltpos=memchr(buf, '<', size);
 	if (!ltpos) {
-	  lp->ce->pcdata.s=(char *)moremem(lp->ce->pcdata.s, lp->ce->pcdata.sm+size);
-	  lp->ce->pcdata.sm+=size;
+	  sizeString(&lp->ce->pcdata, lp->ce->pcdata.sm+size);
 	  memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
 	  lp->ce->pcdata.sl += size;
 	  lp->inblob=1;
@@ -272,6 +364,14 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[]) {
   }
   while (curr - buf <size) {
     char newc=*curr;
+    int nrun;
+
+    /* add runs that can not change state all at once */
+    if (!lp->skipping && lp->lastc != '<' &&
+                    (nrun = bulkXMLchars (lp, curr, size - (curr-buf))) > 0) {
+      curr += nrun; continue;
+    }
+
     /* EOF? */
     if (newc == 0) {
       sprintf (ynot, "Line %d: early XML EOF", lp->ln);
@@ -610,7 +710,7 @@ readXMLFile (FILE *fp, LilXML *lp, char ynot[])
 XMLEle *
 addXMLEle (XMLEle *parent, const char *tag)
 {
-        XMLEle *ep = growEle (parent);
+        XMLEle *ep = growEle (parent, parent ? parent->ar : NULL);
         appendString (&ep->tag, tag);
         return (ep);
 }
@@ -621,7 +721,7 @@ addXMLEle (XMLEle *parent, const char *tag)
 void
 appXMLEle (XMLEle *ep, XMLEle *newep)
 {
-        ep->el = (XMLEle **) moremem (ep->el, (ep->nel+1)*sizeof(XMLEle *));
+        ep->el = (XMLEle **) growList (ep->ar, ep->el, ep->nel, sizeof(XMLEle *));
         ep->el[ep->nel++] = newep;
 }
 
@@ -900,9 +1000,12 @@ oneXMLchar (LilXML *lp, int c, char ynot[])
             break;
 
         case INTAG:			/* reading tag */
-            if (isTokenChar (0, c))
+            if (isTokenChar (0, c)) {
                 growString (&lp->ce->tag, c);
-            else if (c == '>')
+                break;
+            }
+            internString (&lp->ce->tag);
+            if (c == '>')
                 lp->cs = LOOK4CON;
             else if (c == '/')
                 lp->cs = SAWSLASH;
@@ -941,9 +1044,10 @@ oneXMLchar (LilXML *lp, int c, char ynot[])
         case INATTRN:			/* reading attr name */
             if (isTokenChar (0, c))
                 growString (&lp->ce->at[lp->ce->nat-1]->name, c);
-            else if (isspace(c) || c == '=')
+            else if (isspace(c) || c == '=') {
+                internString (&lp->ce->at[lp->ce->nat-1]->name);
                 lp->cs = LOOK4ATTRV;
-            else {
+            } else {
                 sprintf (ynot, "Line %d: Bogus attr name char: %c", lp->ln,c);
                 return (-1);
             }
@@ -962,7 +1066,7 @@ oneXMLchar (LilXML *lp, int c, char ynot[])
 
         case INATTRV:			/* in attr value */
             if (c == '&') {
-                newString (&lp->entity);
+                newString (&lp->entity, NULL);
                 growString (&lp->entity, c);
                 lp->cs = ENTINATTRV;
             } else if (c == lp->delim)
@@ -996,7 +1100,7 @@ oneXMLchar (LilXML *lp, int c, char ynot[])
 
         case INCON:			/* reading content */
             if (c == '&') {
-                newString (&lp->entity);
+                newString (&lp->entity, NULL);
                 growString (&lp->entity, c);
                 lp->cs = ENTINCON;
             } else if (c == '<') {
@@ -1073,16 +1177,172 @@ oneXMLchar (LilXML *lp, int c, char ynot[])
         return (0);
 }
 
+/* add the longest run starting at p, of at most n chars, that oneXMLchar()
+ * would just append to the string being built, to that string, or skip
+ * the longest run of whitespace it would ignore.
+ * return number of chars used, 0 if p[0] needs oneXMLchar().
+ */
+static int
+bulkXMLchars (LilXML *lp, const char *p, int n)
+{
+        String *sp = NULL;
+        const char *nl;
+        int nrun;
+
+        switch (lp->cs) {
+        case LOOK4TAG:
+        case LOOK4ATTRN:
+        case LOOK4ATTRV:
+        case LOOK4CON:
+        case LOOK4CLOSETAG:
+            nrun = scanSpace (p, n);
+            break;
+        case INCON:
+            sp = &lp->ce->pcdata;
+            nrun = scanText (p, n, '&', 0);
+            break;
+        case INATTRV:
+            sp = &lp->ce->at[lp->ce->nat-1]->valu;
+            nrun = scanText (p, n, lp->delim, 1);
+            break;
+        case INTAG:
+            sp = &lp->ce->tag;
+            nrun = scanToken (p, n);
+            break;
+        case INATTRN:
+            sp = &lp->ce->at[lp->ce->nat-1]->name;
+            nrun = scanToken (p, n);
+            break;
+        case INCLOSETAG:
+            sp = &lp->endtag;
+            nrun = scanToken (p, n);
+            break;
+        default:
+            return (0);
+        }
+
+        if (nrun == 0)
+            return (0);
+
+        if (sp)
+            appendBytes (sp, p, nrun);
+        for (nl = p; (nl = memchr (nl, '\n', p+nrun-nl)) != NULL; nl++)
+            lp->ln++;
+        lp->lastc = p[nrun-1];
+        return (nrun);
+}
+
+/* return number of leading chars of p, up to n, other than '<', '&', d or
+ * '\0', and also no other control chars if noctl.
+ */
+static int
+scanText (const char *p, int n, int d, int noctl)
+{
+        int i = 0;
+
+#if defined(SCANBLK)
+        const __m128i lt = _mm_set1_epi8 ('<');
+        const __m128i amp = _mm_set1_epi8 ('&');
+        const __m128i dc = _mm_set1_epi8 ((char)d);
+        const __m128i ctl = _mm_set1_epi8 (noctl ? 0x1f : 0);
+        const __m128i del = _mm_set1_epi8 (noctl ? 0x7f : 0);
+
+        for (; i + SCANBLK <= n; i += SCANBLK) {
+            __m128i x = _mm_loadu_si128 ((const __m128i *)(p+i));
+            __m128i stop = _mm_or_si128 (
+                        _mm_or_si128 (_mm_cmpeq_epi8 (x, lt),
+                                      _mm_cmpeq_epi8 (x, amp)),
+                        _mm_or_si128 (_mm_cmpeq_epi8 (x, dc),
+                                      _mm_cmpeq_epi8 (x, del)));
+            /* x <= ctl unsigned, which catches '\0' when !noctl too */
+            stop = _mm_or_si128 (stop,
+                        _mm_cmpeq_epi8 (_mm_min_epu8 (x, ctl), x));
+            int m = _mm_movemask_epi8 (stop);
+            if (m)
+                return (i + __builtin_ctz (m));
+        }
+#endif
+
+        for (; i < n; i++) {
+            unsigned char c = (unsigned char)p[i];
+            if (c == '<' || c == '&' || c == (unsigned char)d || c == '\0' ||
+                                        (noctl && (c < 0x20 || c == 0x7f)))
+                break;
+        }
+        return (i);
+}
+
+/* return number of leading chars of p, up to n, that may follow the first
+ * char of a name, ie letters, digits and '_'.
+ */
+static int
+scanToken (const char *p, int n)
+{
+        int i = 0;
+
+#if defined(SCANBLK)
+        const __m128i lc = _mm_set1_epi8 (0x20);
+        const __m128i a = _mm_set1_epi8 ('a');
+        const __m128i zero = _mm_set1_epi8 ('0');
+        const __m128i us = _mm_set1_epi8 ('_');
+        const __m128i n26 = _mm_set1_epi8 (25);
+        const __m128i n10 = _mm_set1_epi8 (9);
+
+        for (; i + SCANBLK <= n; i += SCANBLK) {
+            __m128i x = _mm_loadu_si128 ((const __m128i *)(p+i));
+            /* in range iff offset from start of range is small, unsigned */
+            __m128i al = _mm_sub_epi8 (_mm_or_si128 (x, lc), a);
+            __m128i dg = _mm_sub_epi8 (x, zero);
+            __m128i ok = _mm_or_si128 (
+                        _mm_cmpeq_epi8 (_mm_min_epu8 (al, n26), al),
+                        _mm_or_si128 (_mm_cmpeq_epi8 (_mm_min_epu8 (dg, n10), dg),
+                                      _mm_cmpeq_epi8 (x, us)));
+            int m = _mm_movemask_epi8 (ok) ^ 0xffff;
+            if (m)
+                return (i + __builtin_ctz (m));
+        }
+#endif
+
+        for (; i < n; i++) {
+            unsigned char c = (unsigned char)p[i];
+            if (!((c|0x20) >= 'a' && (c|0x20) <= 'z') &&
+                                            !(c >= '0' && c <= '9') && c != '_')
+                break;
+        }
+        return (i);
+}
+
+/* return number of leading chars of p, up to n, that are ' ', '\t', '\n' or
+ * '\r'. runs are short, so no blocks here.
+ */
+static int
+scanSpace (const char *p, int n)
+{
+        int i;
+
+        for (i = 0; i < n; i++)
+            if (p[i] != ' ' && p[i] != '\n' && p[i] != '\t' && p[i] != '\r')
+                break;
+        return (i);
+}
+
 /* set up for a fresh start again */
 static void
 initParser(LilXML *lp)
 {
+        int arena = lp->arena;
+
+        /* discard all of any partial document */
+        while (lp->ce && lp->ce->pe)
+            lp->ce = lp->ce->pe;
         delXMLEle (lp->ce);
         freeString (&lp->endtag);
+        freeString (&lp->entity);
         memset (lp, 0, sizeof(*lp));
-        newString (&lp->endtag);
+        newString (&lp->endtag, NULL);
         lp->cs = LOOK4START;
         lp->ln = 1;
+        lp->arena = arena;
 }
 
 /* start a new XMLEle.
@@ -1093,7 +1353,15 @@ initParser(LilXML *lp)
 static void
 pushXMLEle(LilXML *lp)
 {
-        lp->ce = growEle (lp->ce);
+        XMLArena *ar = NULL;
+
+        if (lp->ce)
+            ar = lp->ce->ar;
+        else if (lp->arena)
+            ar = newArena();
+        lp->ce = growEle (lp->ce, ar);
+        if (ar && !ar->root)
+            ar->root = lp->ce;
         resetEndTag(lp);
 }
 
@@ -1107,19 +1375,27 @@ popXMLEle(LilXML *lp)
         resetEndTag(lp);
 }
 
-/* return one new XMLEle, added to the given element if given */
+/* return one new XMLEle in arena ar, if any, added to the given element if
+ * given.
+ */
 static XMLEle *
-growEle (XMLEle *pe)
+growEle (XMLEle *pe, XMLArena *ar)
 {
-        XMLEle *newe = (XMLEle *) moremem (NULL, sizeof(XMLEle));
+        XMLEle *newe;
+
+        if (ar)
+            newe = (XMLEle *) arenaAlloc (ar, sizeof(XMLEle));
+        else
+            newe = (XMLEle *) moremem (NULL, sizeof(XMLEle));
 
         memset (newe, 0, sizeof(XMLEle));
-        newString (&newe->tag);
-        newString (&newe->pcdata);
+        newString (&newe->tag, ar);
+        newString (&newe->pcdata, ar);
         newe->pe = pe;
+        newe->ar = ar;
 
         if (pe) {
-            pe->el = (XMLEle **) moremem (pe->el, (pe->nel+1)*sizeof(XMLEle *));
+            pe->el = (XMLEle **) growList (pe->ar, pe->el, pe->nel, sizeof(XMLEle *));
             pe->el[pe->nel++] = newe;
         }
 
@@ -1130,36 +1406,83 @@ growEle (XMLEle *pe)
 static XMLAtt *
 growAtt(XMLEle *ep)
 {
-        XMLAtt *newa = (XMLAtt *) moremem (NULL, sizeof(XMLAtt));
+        XMLAtt *newa;
+
+        if (ep->ar)
+            newa = (XMLAtt *) arenaAlloc (ep->ar, sizeof(XMLAtt));
+        else
+            newa = (XMLAtt *) moremem (NULL, sizeof(XMLAtt));
 
         memset (newa, 0, sizeof(*newa));
-        newString(&newa->name);
-        newString(&newa->valu);
+        newString(&newa->name, ep->ar);
+        newString(&newa->valu, ep->ar);
         newa->ce = ep;
 
-        ep->at = (XMLAtt **) moremem (ep->at, (ep->nat+1)*sizeof(XMLAtt *));
+        ep->at = (XMLAtt **) growList (ep->ar, ep->at, ep->nat, sizeof(XMLAtt *));
         ep->at[ep->nat++] = newa;
 
         return (newa);
 }
 
+/* return list, of n entries each size bytes, with room for one more.
+ * in an arena the room doubles each time n reaches a power of 2.
+ */
+static void *
+growList (XMLArena *ar, void *list, int n, int size)
+{
+        void *newl;
+
+        if (!ar)
+            return (moremem (list, (n+1)*size));
+        if (n > 0 && (n < 4 || (n & (n-1))))
+            return (list);
+
+        newl = arenaAlloc (ar, (n < 4 ? 4 : 2*n)*size);
+        if (n > 0)
+            memcpy (newl, list, n*size);
+        return (newl);
+}
+
 /* free a and all it holds */
 static void
 freeAtt (XMLAtt *a)
 {
-        if (!a)
+        if (!a || a->ce->ar)
             return;
         freeString (&a->name);
         freeString (&a->valu);
         (*myfree)(a);
 }
 
-/* reset endtag */
+/* delete all elements below arena element ep that do not live in its arena,
+ * ie those added with appXMLEle().
+ */
+static void
+freeForeign (XMLEle *ep)
+{
+        int i;
+
+        for (i = 0; i < ep->nel; i++) {
+            XMLEle *cp = ep->el[i];
+
+            if (cp->ar == ep->ar)
+                freeForeign (cp);
+            else {
+                cp->pe = NULL;
+                delXMLEle (cp);
+            }
+        }
+}
+
+/* reset endtag, keeping its memory */
 static void
 resetEndTag(LilXML *lp)
 {
-        freeString (&lp->endtag);
-        newString (&lp->endtag);
+        if (lp->endtag.sm) {
+            lp->endtag.sl = 0;
+            lp->endtag.s[0] = '\0';
+        } else
+            newString (&lp->endtag, NULL);
 }
 
 /* 1 if c is a valid token character, else 0.
@@ -1179,9 +1502,9 @@ growString (String *sp, int c)
 
         if (l > sp->sm) {
             if (!sp->s)
-                newString (sp);
-            else
-                sp->s = (char *) moremem (sp->s, sp->sm *= 2);
+                newString (sp, sp->ar);
+            if (l > sp->sm)
+                sizeString (sp, sp->sm ? 2*sp->sm : (sp->ar ? MINARENA : MINMEM));
         }
         sp->s[--l] = '\0';
         sp->s[--l] = (char)c;
@@ -1197,29 +1520,135 @@ appendString (String *sp, const char *str)
 
         if (l > sp->sm) {
             if (!sp->s)
-                newString (sp);
+                newString (sp, sp->ar);
             if (l > sp->sm)
-                sp->s = (char *) moremem (sp->s, (sp->sm = l));
+                sizeString (sp, l);
         }
         strcpy (&sp->s[sp->sl], str);
         sp->sl += strl;
 }
 
-/* init a String with a malloced string containing just \0 */
+/* append the n chars at p to the String storage at *sp */
+static void
+appendBytes (String *sp, const char *p, int n)
+{
+        int l = sp->sl + n + 1;		/* need room for '\0' */
+
+        if (l > sp->sm) {
+            int m = sp->sm ? 2*sp->sm : (sp->ar ? MINARENA : MINMEM);
+            sizeString (sp, m > l ? m : l);
+        }
+        memcpy (&sp->s[sp->sl], p, n);
+        sp->sl += n;
+        sp->s[sp->sl] = '\0';
+}
+
+/* make room for at least n bytes in *sp, keeping its contents.
+ * in an arena the newest String grows in place, others move.
+ */
+static void
+sizeString (String *sp, int n)
+{
+        char *news;
+
+        if (n <= sp->sm)
+            return;
+
+        if (sp->ar && n >= ARENABIG) {
+            XMLArena *ar = sp->ar;
+            ArenaBlock *bp;
+
+            if (sp->sm >= ARENABIG) {
+                bp = (ArenaBlock *)sp->s - 1;
+                bp = linkBlock (ar, (ArenaBlock *) moremem (bp,
+                                                sizeof(ArenaBlock) + n), bp);
+                sp->s = (char *)(bp + 1);
+                sp->sm = n;
+                return;
+            }
+            bp = linkBlock (ar, (ArenaBlock *) moremem (NULL,
+                                                sizeof(ArenaBlock) + n), NULL);
+            news = (char *)(bp + 1);
+        } else if (sp->ar) {
+            XMLArena *ar = sp->ar;
+            int rn = (n + ARENAAL-1) & ~(ARENAAL-1);
+
+            if (sp->sm && sp->s + sp->sm == ar->top && sp->s + rn <= ar->end) {
+                ar->top = sp->s + rn;
+                sp->sm = rn;
+                return;
+            }
+            news = (char *) arenaAlloc (ar, rn);
+            n = rn;
+        } else if (sp->sm) {
+            sp->s = (char *) moremem (sp->s, (sp->sm = n));
+            return;
+        } else
+            news = (char *) moremem (NULL, n);
+
+        /* copy from old or static */
+        if (sp->s)
+            memcpy (news, sp->s, sp->sl);
+        news[sp->sl] = '\0';
+        sp->s = news;
+        sp->sm = n;
+}
+
+/* point an arena String at the static copy of its value if it is in the
+ * INDI vocabulary, giving back its space if it was the newest allocation.
+ */
 static void
-newString(String *sp)
+internString (String *sp)
 {
+        XMLArena *ar = sp->ar;
+        int lo = 0, hi = NVOCAB-1;
+
+        if (!ar || !sp->sm)
+            return;
+
+        while (lo <= hi) {
+            int mid = (lo + hi)/2;
+            int c = strcmp (sp->s, vocab[mid]);
+
+            if (c == 0) {
+                if (sp->s + sp->sm == ar->top)
+                    ar->top = sp->s;
+                sp->s = (char *) vocab[mid];
+                sp->sm = 0;
+                return;
+            }
+            if (c < 0)
+                hi = mid - 1;
+            else
+                lo = mid + 1;
+        }
+}
+
+/* init a String with a malloced string containing just \0.
+ * in arena ar it starts as a static "" and gets space as it grows.
+ */
+static void
+newString(String *sp, XMLArena *ar)
+{
+        sp->ar = ar;
+        sp->sl = 0;
+        if (ar) {
+            sp->s = (char *)"";
+            sp->sm = 0;
+            return;
+        }
         sp->s = (char *)moremem(NULL, MINMEM);
         sp->sm = MINMEM;
         *sp->s = '\0';
-        sp->sl = 0;
 }
 
-/* free memory used by the given String */
+/* free memory used by the given String.
+ * it stays with its arena, if any, in case it grows again.
+ */
 static void
 freeString (String *sp)
 {
-        if (sp->s)
+        if (sp->s && sp->sm && !sp->ar)
             (*myfree) (sp->s);
         sp->s = NULL;
         sp->sl = 0;
@@ -1233,6 +1662,78 @@ moremem (void *old, int n)
         return (old ? (*myrealloc)(old, n) : (*mymalloc)(n));
 }
 
+/* return a new empty arena, its first block allocated along with it */
+static XMLArena *
+newArena (void)
+{
+        XMLArena *ar = (XMLArena *) moremem (NULL, sizeof(XMLArena) + ARENASZ);
+
+        memset (ar, 0, sizeof(*ar));
+        ar->top = (char *)(ar + 1);
+        ar->end = ar->top + ARENASZ;
+        ar->nextsz = 4*ARENASZ;
+        return (ar);
+}
+
+/* return n bytes from arena ar, adding a block if the current one is full.
+ */
+static void *
+arenaAlloc (XMLArena *ar, int n)
+{
+        void *p;
+
+        n = (n + ARENAAL-1) & ~(ARENAAL-1);
+        if (ar->top + n > ar->end) {
+            size_t bsz = ar->nextsz;
+            ArenaBlock *bp;
+
+            if (bsz < (size_t)n)
+                bsz = n;
+            bp = linkBlock (ar, (ArenaBlock *) moremem (NULL,
+                                    sizeof(ArenaBlock) + ARENAAL + bsz), NULL);
+            ar->top = (char *)bp + ((sizeof(ArenaBlock) + ARENAAL-1) & ~(ARENAAL-1));
+            ar->end = ar->top + bsz;
+            ar->nextsz *= 2;
+        }
+
+        p = ar->top;
+        ar->top += n;
+        return (p);
+}
+
+/* put block bp in ar's list, in place of old if it moved there with
+ * realloc, else as the newest. return bp.
+ */
+static ArenaBlock *
+linkBlock (XMLArena *ar, ArenaBlock *bp, ArenaBlock *old)
+{
+        if (!old) {
+            bp->prev = NULL;
+            bp->next = ar->blocks;
+        } else if (bp == old)
+            return (bp);
+
+        if (bp->next)
+            bp->next->prev = bp;
+        if (bp->prev)
+            bp->prev->next = bp;
+        else
+            ar->blocks = bp;
+        return (bp);
+}
+
+/* free arena ar and everything in it */
+static void
+freeArena (XMLArena *ar)
+{
+        while (ar->blocks) {
+            ArenaBlock *bp = ar->blocks;
+            ar->blocks = bp->next;
+            (*myfree) (bp);
+        }
+        (*myfree) (ar);
+}
+
 #if defined(MAIN_TST)
 int
 main (int ac, char *av[])
@@ -88,6 +88,13 @@ extern LilXML *newLilXML(void);
 */
 extern void delLilXML (LilXML *lp);
 
+/** \brief Build each document parsed by a lilxml parser in one arena, or not.
+    \param lp a pointer to a lilxml parser.
+    \param on 1 to parse into an arena, 0 to allocate every node and string on its own (the default).
+    \note The root element returned by the parser owns the arena: deleting it with delXMLEle() frees the whole document at once, so no part of it may be used after that. Deleting a child only unlinks it.
+*/
+extern void arenaLilXML (LilXML *lp, int on);
+
 /** \brief Delete an XML element.
     \return a pointer to the XML Element to be deleted.
 */
@@ -0,0 +1,349 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+/* Build a protocol message in memory and send it with one write.
+ *
+ * Each thread has one buffer, kept between messages so it is only ever
+ *   grown, unless a huge message made it bigger than KEEPSIZE.
+ * Numbers must be written with '.' whatever locale the driver runs in.
+ *   Rather than switching the whole process with setlocale(), which races
+ *   with every other thread, formatting is done with the thread switched
+ *   to a C locale of its own by uselocale().
+ * Doubles are written in the fewest digits that read back the same. Whole
+ *   numbers are written directly. Others from MINFAST to MAXFAST are scaled
+ *   by an exact power of ten to 15, 16 then 17 digits, keeping the product
+ *   exact as hi + lo with fma(), and the nearest integer to it is taken as
+ *   soon as it lies within half an ulp of the value, so reads back the same.
+ *   Anything else falls back to the first of %.15g, %.16g and %.17g that
+ *   strtod() turns back into the same value.
+ */
+
+/** \file outbuf.c
+    \brief Build a protocol message in memory and send it with one write.
+
+*/
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+#include "outbuf.h"
+
+#define	MINSIZE		4096		/* first allocation */
+#define	KEEPSIZE	(256*1024)	/* most kept between messages */
+#define	MINFAST		1e-5		/* putShortest() range */
+#define	MAXFAST		1e15
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;		/* each thread's OutBuf */
+static locale_t clocale;		/* C locale for formatting */
+
+static void init (void);
+static void freeBuf (void *arg);
+static int grow (OutBuf *ob, size_t n);
+static void putInt (OutBuf *ob, long long v);
+static int putShortest (OutBuf *ob, double v);
+
+OutBuf *outBufGet(void)
+{
+    OutBuf *ob;
+
+    pthread_once (&once, init);
+    ob = (OutBuf *) pthread_getspecific (key);
+    if (!ob) {
+        ob = (OutBuf *) calloc (1, sizeof(OutBuf));
+        if (!ob)
+            return (NULL);
+        pthread_setspecific (key, ob);
+    }
+
+    ob->len = 0;
+    return (ob);
+}
+
+void outBufPuts(OutBuf *ob, const char *s)
+{
+    size_t n = strlen (s);
+
+    if (!ob || grow (ob, n) < 0)
+        return;
+    memcpy (ob->buf + ob->len, s, n);
+    ob->len += n;
+}
+
+void outBufPrintf(OutBuf *ob, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start (ap, fmt);
+    outBufVPrintf (ob, fmt, ap);
+    va_end (ap);
+}
+
+void outBufVPrintf(OutBuf *ob, const char *fmt, va_list ap)
+{
+    va_list aq;
+    int n;
+
+    if (!ob)
+        return;
+
+    locale_t old = clocale ? uselocale (clocale) : (locale_t)0;
+
+    /* usually fits in what is left, else grow to fit and go again */
+    va_copy (aq, ap);
+    n = vsnprintf (ob->buf ? ob->buf + ob->len : NULL, ob->size - ob->len, fmt, aq);
+    va_end (aq);
+    if (n >= 0 && (size_t)n >= ob->size - ob->len) {
+        if (grow (ob, n) == 0) {
+            va_copy (aq, ap);
+            n = vsnprintf (ob->buf + ob->len, ob->size - ob->len, fmt, aq);
+            va_end (aq);
+        } else
+            n = -1;
+    }
+    if (n > 0)
+        ob->len += n;
+
+    if (old)
+        uselocale (old);
+}
+
+void outBufDouble(OutBuf *ob, double v)
+{
+    char s[32];
+    int prec;
+
+    if (!ob)
+        return;
+
+    if (isfinite (v) && fabs (v) < 1e15 && v == (double)(long long)v && !(v == 0 && signbit (v))) {
+        putInt (ob, (long long)v);
+        return;
+    }
+
+    if (putShortest (ob, v) == 0)
+        return;
+
+    /* far out of range, or too close to call */
+    locale_t old = clocale ? uselocale (clocale) : (locale_t)0;
+    for (prec = 15; prec < 17; prec++) {
+        snprintf (s, sizeof(s), "%.*g", prec, v);
+        if (strtod (s, NULL) == v || !isfinite (v))
+            break;
+    }
+    if (prec == 17)
+        snprintf (s, sizeof(s), "%.17g", v);
+    if (old)
+        uselocale (old);
+
+    outBufPuts (ob, s);
+}
+
+void outBufTimestamp(OutBuf *ob)
+{
+    time_t t = time (NULL);
+    struct tm tm;
+    char ts[32];
+
+    gmtime_r (&t, &tm);
+    strftime (ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+    outBufPuts (ob, ts);
+}
+
+int outBufWrite(OutBuf *ob, int fd)
+{
+    if (!ob)
+        return (-1);
+
+    const char *p = ob->buf;
+    size_t n = ob->len;
+
+    while (n > 0) {
+        ssize_t nw = write (fd, p, n);
+        if (nw < 0 && errno == EINTR)
+            continue;
+        if (nw <= 0)
+            break;
+        p += nw;
+        n -= nw;
+    }
+
+    ob->len = 0;
+    if (ob->size > KEEPSIZE) {
+        free (ob->buf);
+        ob->buf = NULL;
+        ob->size = 0;
+    }
+
+    return (n > 0 ? -1 : 0);
+}
+
+/* make the key and the C locale, once */
+static void
+init (void)
+{
+    pthread_key_create (&key, freeBuf);
+    clocale = newlocale (LC_ALL_MASK, "C", (locale_t)0);
+}
+
+/* free a thread's OutBuf as it exits */
+static void
+freeBuf (void *arg)
+{
+    OutBuf *ob = (OutBuf *)arg;
+
+    free (ob->buf);
+    free (ob);
+}
+
+/* make room for n more bytes and a trailing nul, return 0 or -1 */
+static int
+grow (OutBuf *ob, size_t n)
+{
+    size_t size = ob->size ? ob->size : MINSIZE;
+    char *buf;
+
+    if (ob->len + n < ob->size)
+        return (0);
+    while (size <= ob->len + n)
+        size *= 2;
+    buf = (char *) realloc (ob->buf, size);
+    if (!buf)
+        return (-1);
+    ob->buf = buf;
+    ob->size = size;
+    return (0);
+}
+
+/* append v in decimal */
+static void
+putInt (OutBuf *ob, long long v)
+{
+    char s[24], *p = s + sizeof(s);
+    unsigned long long u = v < 0 ? -(unsigned long long)v : (unsigned long long)v;
+
+    do
+        *--p = (char)('0' + u % 10);
+    while ((u /= 10) > 0);
+    if (v < 0)
+        *--p = '-';
+
+    if (grow (ob, s + sizeof(s) - p) < 0)
+        return;
+    memcpy (ob->buf + ob->len, p, s + sizeof(s) - p);
+    ob->len += s + sizeof(s) - p;
+}
+
+/* append v, MINFAST <= |v| < MAXFAST, in the fewest digits that read back
+ * as v. return 0 if done, -1 if v is out of range or a candidate is too
+ * close to the edge of its rounding interval to decide.
+ */
+static int
+putShortest (OutBuf *ob, double v)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    double a = fabs (v), halfulp;
+    unsigned long long r = 0;
+    char s[40], *p = s;
+    int e10, exp2, nd, i, point;
+
+    if (!(a >= MINFAST && a < MAXFAST))
+        return (-1);
+
+    /* 10^e10 <= a < 10^(e10+1) */
+    for (e10 = 14; e10 > -5 && (e10 >= 0 ? a < pow10[e10] : a*pow10[-e10] < 1); e10--)
+        continue;
+
+    frexp (a, &exp2);
+    halfulp = ldexp (0.5, exp2 - 53);
+
+    for (nd = 15; nd <= 17; nd++) {
+        double ps = pow10[nd - 1 - e10];	/* exact, at most 1e21 */
+        double hi = a*ps, lo = fma (a, ps, -hi), fl = floor (hi), diff, half;
+
+        /* nearest integer to hi + lo, then how far it is from it */
+        r = (unsigned long long)fl + (hi - fl + lo >= 0.5) - (hi - fl + lo < -0.5);
+        diff = (double)(long long)(r - (unsigned long long)fl) - (hi - fl) - lo;
+        half = halfulp*ps;
+
+        /* below a power of 2 the next double down is only half as far */
+        if (diff < 0) {
+            diff = -diff;
+            if (frexp (a, &i) == 0.5)
+                half /= 2;
+        }
+        if (diff < half*(1 - 1e-9))
+            break;
+        if (diff < half*(1 + 1e-9))
+            return (-1);
+    }
+    if (nd > 17)
+        return (-1);
+
+    /* r has nd digits, or nd+1 if it rounded up to a power of 10 */
+    if (r >= (unsigned long long)pow10[nd]) {
+        r /= 10;
+        e10++;
+    }
+    while (r % 10 == 0) {
+        r /= 10;
+        nd--;
+    }
+
+    /* digits of r with the point after digit e10+1 */
+    if (v < 0)
+        *p++ = '-';
+    point = e10 + 1;
+    if (point <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = point; i < 0; i++)
+            *p++ = '0';
+    }
+    for (i = nd - 1; i >= 0; i--) {
+        p[i + (point > 0 && i >= point)] = (char)('0' + r % 10);
+        r /= 10;
+    }
+    if (point > 0 && point < nd) {
+        p[point] = '.';
+        p++;
+    }
+    p += nd;
+    for (i = nd; i < point; i++)
+        *p++ = '0';
+    *p = '\0';
+
+    outBufPuts (ob, s);
+    return (0);
+}
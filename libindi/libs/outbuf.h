@@ -0,0 +1,93 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup outbuf Output Buffer Functions: Build a protocol message in memory and send it with one write
+ */
+/*@{*/
+
+/** \brief A growable message buffer. */
+typedef struct
+{
+    char *buf;          /**< the message so far */
+    size_t len;         /**< bytes in buf */
+    size_t size;        /**< bytes allocated at buf */
+} OutBuf;
+
+/** \brief Return the calling thread's buffer, emptied.
+    \return the buffer, owned by the thread and freed when it exits, or NULL if out of memory. The other
+    functions take NULL as a buffer that holds nothing.
+ */
+extern OutBuf *outBufGet(void);
+
+/** \brief Append a string.
+    \param ob buffer.
+    \param s string to append.
+ */
+extern void outBufPuts(OutBuf *ob, const char *s);
+
+/** \brief Append printf formatted text, always in the C locale whatever LC_NUMERIC is set to.
+    \param ob buffer.
+    \param fmt printf format.
+ */
+extern void outBufPrintf(OutBuf *ob, const char *fmt, ...);
+
+/** \brief Append vprintf formatted text, always in the C locale.
+    \param ob buffer.
+    \param fmt printf format.
+    \param ap arguments, left unused so the caller may va_end() it.
+ */
+extern void outBufVPrintf(OutBuf *ob, const char *fmt, va_list ap);
+
+/** \brief Append the shortest decimal form of a double that reads back as the same value, with '.' as decimal point.
+    \param ob buffer.
+    \param v value.
+ */
+extern void outBufDouble(OutBuf *ob, double v);
+
+/** \brief Append the current UTC time as INDI timestamps are written, e.g. 2016-05-03T12:34:56.
+    \param ob buffer.
+ */
+extern void outBufTimestamp(OutBuf *ob);
+
+/** \brief Write the whole buffer to fd and empty it.
+    \param ob buffer.
+    \param fd file descriptor.
+    \return 0 if all was written, else -1.
+ */
+extern int outBufWrite(OutBuf *ob, int fd);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
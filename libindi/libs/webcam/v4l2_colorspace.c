@@ -1,5 +1,11 @@
 #include "v4l2_colorspace.h"
 #include <math.h>
+#include <string.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 unsigned char lutrangey8[256];
 unsigned short lutrangey10[1024];
@@ -10,51 +16,124 @@ unsigned short lutrangecbcr10[1024];
 unsigned short lutrangecbcr12[4096];
 unsigned short lutrangecbcr16[65536];
 
+/* Y8 / 255 through each transfer function, as linearize() computes it,
+   in float and scaled to 16 bits */
+#define TRANSFER_SMPTE240M 0
+#define TRANSFER_SRGB 1
+#define TRANSFER_REC709 2
+float lutlinear8[3][256];
+unsigned short lutlinear16[3][256];
+
+static float transfer(unsigned int curve, float v) {
+  switch (curve) {
+  case TRANSFER_SMPTE240M:
+    // This is the transfer function for SMPTE 240M
+    return (v < 0.0913) ? v / 4.0 : pow((v + 0.1115) / 1.1115, 1.0 / 0.45);
+  case TRANSFER_SRGB:
+    // This is used for sRGB as specified by the IEC FDIS 61966-2-1 standard
+    return (v < -0.04045) ? -pow((-v + 0.055) / 1.055, 2.4) :
+      ((v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4));
+  case TRANSFER_REC709:
+  default:
+    return (v <= -0.081) ? -pow((v - 0.099) / -1.099, 1.0 / 0.45) :
+      ((v < 0.081) ? v / 4.5 : pow((v + 0.099) / 1.099, 1.0 / 0.45));
+  }
+}
+
+static unsigned int transferCurve(struct v4l2_format *fmt) {
+  switch (fmt->fmt.pix.colorspace) {
+  case V4L2_COLORSPACE_SMPTE240M:
+    // Old obsolete HDTV standard. Replaced by REC 709.
+    return TRANSFER_SMPTE240M;
+  case V4L2_COLORSPACE_SRGB:
+    return TRANSFER_SRGB;
+    //case V4L2_COLORSPACE_ADOBERGB:
+    //r = pow(r, 2.19921875);
+    //break;
+  case V4L2_COLORSPACE_REC709:
+    //case V4L2_COLORSPACE_BT2020:
+  default:
+    // All others use the transfer function specified by REC 709
+    return TRANSFER_REC709;
+  }
+}
+
 void initColorSpace() {
-  unsigned int i;
+  unsigned int i, c;
 
   for (i=0; i < 256; i++) {
-    lutrangey8[i] = (unsigned char)((255.0 / 219.0) * (i - 16));
+    lutrangey8[i] = (i < 16) ? 0 : (unsigned char)((255.0 / 219.0) * (i - 16));
     if (i > 235) lutrangey8[i] = 255;
     lutrangecbcr8[i] = (unsigned char)((255.0 / 224.0) * i);
   }
+
+  for (c=0; c < 3; c++)
+    for (i=0; i < 256; i++) {
+      float v = i / 255.0;
+      lutlinear8[c][i] = transfer(c, v);
+      lutlinear16[c][i] = (unsigned short)(lutlinear8[c][i] * 65535.0);
+    }
 }
 
 void rangeY8(unsigned char *buf, unsigned int len) {
   unsigned int i;
   unsigned char *s=buf;
-  for (i=0; i < len; i++) {
-    *s++ = lutrangey8[*s];
+  for (i=0; i + 4 <= len; i+=4, s+=4) {
+    unsigned char a = lutrangey8[s[0]], b = lutrangey8[s[1]], c = lutrangey8[s[2]], d = lutrangey8[s[3]];
+    s[0] = a; s[1] = b; s[2] = c; s[3] = d;
   }
+  for (; i < len; i++, s++)
+    *s = lutrangey8[*s];
 }
 
 void linearize(float *buf, unsigned int len, struct v4l2_format *fmt) {
-  unsigned int i;
+  unsigned int i, curve=transferCurve(fmt);
   float *src=buf;
-  switch (fmt->fmt.pix.colorspace) {
-  case V4L2_COLORSPACE_SMPTE240M:
-    // Old obsolete HDTV standard. Replaced by REC 709.
-    // This is the transfer function for SMPTE 240M
-    for (i = 0; i < len; i++)
-      *src++ = (*src < 0.0913) ? *src / 4.0 : pow((*src + 0.1115) / 1.1115, 1.0 / 0.45);
-    break;
-  case V4L2_COLORSPACE_SRGB:
-    // This is used for sRGB as specified by the IEC FDIS 61966-2-1 standard
-    for (i = 0; i < len; i++)
-      *src++ = (*src < -0.04045) ? -pow((-*src + 0.055) / 1.055, 2.4) : 
-	((*src <= 0.04045) ? *src / 12.92 : pow((*src + 0.055) / 1.055, 2.4));
-    break;
-    //case V4L2_COLORSPACE_ADOBERGB:
-    //r = pow(r, 2.19921875);
-    //break;
-  case V4L2_COLORSPACE_REC709:
-    //case V4L2_COLORSPACE_BT2020:
-  default:
-    // All others use the transfer function specified by REC 709
-    for (i = 0; i < len; i++)
-      *src++ = (*src <= -0.081) ? -pow((*src - 0.099) / -1.099, 1.0 / 0.45) : 
-	((*src < 0.081) ? *src / 4.5 : pow((*src + 0.099) / 1.099, 1.0 / 0.45));
+  for (i = 0; i < len; i++, src++)
+    *src = transfer(curve, *src);
+}
+
+void linearizeY8(unsigned char *src, float *dest, unsigned int len, struct v4l2_format *fmt) {
+  const float *lut = lutlinear8[transferCurve(fmt)];
+  unsigned int i;
+  for (i=0; i + 4 <= len; i+=4, src+=4, dest+=4) {
+    float a = lut[src[0]], b = lut[src[1]], c = lut[src[2]], d = lut[src[3]];
+    dest[0] = a; dest[1] = b; dest[2] = c; dest[3] = d;
+  }
+  for (; i < len; i++)
+    *dest++ = lut[*src++];
+}
+
+void linearizeY8to16(unsigned char *src, unsigned short *dest, unsigned int len, struct v4l2_format *fmt) {
+  const unsigned short *lut = lutlinear16[transferCurve(fmt)];
+  unsigned int i;
+  for (i=0; i + 4 <= len; i+=4, src+=4, dest+=4) {
+    unsigned short a = lut[src[0]], b = lut[src[1]], c = lut[src[2]], d = lut[src[3]];
+    dest[0] = a; dest[1] = b; dest[2] = c; dest[3] = d;
+  }
+  for (; i < len; i++)
+    *dest++ = lut[*src++];
+}
+
+void stackLinear(float *dest, const float *src, unsigned int len) {
+  unsigned int i=0;
+#if defined(__SSE__)
+  for (; i + 8 <= len; i+=8) {
+    __m128 a = _mm_add_ps(_mm_loadu_ps(dest + i), _mm_loadu_ps(src + i));
+    __m128 b = _mm_add_ps(_mm_loadu_ps(dest + i + 4), _mm_loadu_ps(src + i + 4));
+    _mm_storeu_ps(dest + i, a);
+    _mm_storeu_ps(dest + i + 4, b);
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; i + 8 <= len; i+=8) {
+    float32x4_t a = vaddq_f32(vld1q_f32(dest + i), vld1q_f32(src + i));
+    float32x4_t b = vaddq_f32(vld1q_f32(dest + i + 4), vld1q_f32(src + i + 4));
+    vst1q_f32(dest + i, a);
+    vst1q_f32(dest + i + 4, b);
   }
+#endif
+  for (; i < len; i++)
+    dest[i] += src[i];
 }
 
 const char * getColorSpaceName(struct v4l2_format *fmt) {
@@ -29,6 +29,11 @@ const char * getQuantizationName(struct v4l2_format *fmt);
 
 void rangeY8(unsigned char *buf, unsigned int len);
 void linearize(float *buf, unsigned int len, struct v4l2_format *fmt);
+/* linearize(Y8 / 255.0) through tables built by initColorSpace(), to float or scaled to 16 bits */
+void linearizeY8(unsigned char *src, float *dest, unsigned int len, struct v4l2_format *fmt);
+void linearizeY8to16(unsigned char *src, unsigned short *dest, unsigned int len, struct v4l2_format *fmt);
+/* dest[i] += src[i], four or eight at a time where the CPU can */
+void stackLinear(float *dest, const float *src, unsigned int len);
 
 #ifdef __cplusplus
 }
@@ -503,16 +503,10 @@ void V4L2_Builtin_Decoder::allocBuffers()
 
 void V4L2_Builtin_Decoder::makeLinearY()
 {
-  unsigned char *src=YBuf;
-  float *dest;
-  unsigned int i;
   if (!linearBuffer) {
     linearBuffer = new float[(bufwidth * bufheight)];
   }
-  dest=linearBuffer;
-  for (i=0; i < bufwidth * bufheight; i++)
-    *dest++ = (*src++) / 255.0;
-  linearize(linearBuffer, bufwidth * bufheight, &fmt);
+  linearizeY8(YBuf, linearBuffer, bufwidth * bufheight, &fmt);
 
 }
 void V4L2_Builtin_Decoder::makeY()
@@ -547,16 +541,9 @@ unsigned char * V4L2_Builtin_Decoder::getY()
   if (doQuantization && getQuantization(&fmt) == QUANTIZATION_LIM_RANGE)
     rangeY8(YBuf, (bufwidth * bufheight));
   if (doLinearization) {
-    unsigned int i;
-    float *src;
-    unsigned short *dest;
     if (!yuyvBuffer)
       yuyvBuffer=new unsigned char[(bufwidth * bufheight) * 2];
-    makeLinearY();
-    src=linearBuffer;
-    dest=(unsigned short *)yuyvBuffer;
-    for (i=0; i < bufwidth * bufheight; i++)
-      *dest++ = (unsigned short)(*src++ * 65535.0);
+    linearizeY8to16(YBuf, (unsigned short *)yuyvBuffer, bufwidth * bufheight, &fmt);
     return yuyvBuffer;
   }
   return YBuf;
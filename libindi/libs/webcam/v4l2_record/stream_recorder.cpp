@@ -30,6 +30,9 @@
 
 const char *STREAM_TAB          = "Streaming";
 
+/* Frames that may await upload before newer ones are dropped */
+static const int STREAM_RING_SLOTS = 4;
+
 StreamRecorder::StreamRecorder(INDI::CCD *mainCCD)
 {
    ccd = mainCCD;
@@ -38,6 +41,12 @@ StreamRecorder::StreamRecorder(INDI::CCD *mainCCD)
    is_recording = false;
 
    compressedFrame = (uint8_t* ) malloc(1);
+   binnedFrame = NULL;
+   binnedFrameSize = 0;
+
+   upload_running = false;
+   upload_stop = false;
+   sem_init(&upload_sem, 0, 0);
 
    // Timer
    // now use BSD setimer to avoi librt dependency
@@ -66,8 +75,11 @@ StreamRecorder::StreamRecorder(INDI::CCD *mainCCD)
 
 StreamRecorder::~StreamRecorder()
 {
+    stopUploadThread();
+    sem_destroy(&upload_sem);
     delete (v4l2_record);
     free(compressedFrame);
+    free(binnedFrame);
 }
 
 bool StreamRecorder::initProperties()
@@ -132,8 +144,14 @@ bool StreamRecorder::updateProperties()
 {
     if (ccd->isConnected())
     {
-      imageBP=ccd->getBLOB("CCD1");
-      imageB=imageBP->bp;
+      IBLOBVectorProperty *ccdBP=ccd->getBLOB("CCD1");
+      imageBP=*ccdBP;
+      imageB=ccdBP->bp[0];
+      imageB.blob=NULL;
+      imageB.bloblen=imageB.size=0;
+      imageB.bvp=&imageBP;
+      imageBP.bp=&imageB;
+      imageBP.nbp=1;
 
       ccd->defineSwitch(&StreamSP);
       ccd->defineNumber(&StreamOptionsNP);
@@ -194,7 +212,7 @@ void StreamRecorder::newFrame(unsigned char *buffer)
       streamframeCount++;
       if (streamframeCount >= StreamOptionsN[0].value)
       {
-        uploadStream(buffer);
+        queueStream(buffer);
         streamframeCount = 0;
       }
     }
@@ -221,33 +239,54 @@ bool StreamRecorder::setPixelFormat(uint32_t format)
     return true;
 }
 
+/* Hand buffer over to the upload thread. The driver may have captured straight into PrimaryCCD.getFillSlot(), else it is copied there.
+ * If the uploads can not keep up and all slots still await one, the frame is dropped so capture never waits on them.
+ */
+bool StreamRecorder::queueStream(uint8_t *buffer)
+{
+    uint8_t *slot = ccd->PrimaryCCD.getFillSlot();
+
+    if (slot == NULL)
+        return false;
+
+    if (slot != buffer)
+        memcpy(slot, buffer, ccd->PrimaryCCD.getFrameBufferSize());
+
+    ccd->PrimaryCCD.commitFillSlot();
+    sem_post(&upload_sem);
+    return true;
+}
+
 bool StreamRecorder::uploadStream(uint8_t *buffer)
 {
     int ret=0;
     uLongf compressedBytes = 0;
-    uLong totalBytes = ccd->PrimaryCCD.getFrameBufferSize() / (ccd->PrimaryCCD.getBinX()*ccd->PrimaryCCD.getBinY());
+    uLong totalBytes = ccd->PrimaryCCD.getFrameBufferSize();
+    uint8_t *frame = buffer;
 
-    //if (ccd->PrimaryCCD.getNAxis() == 2)
-        memcpy(ccd->PrimaryCCD.getFrameBuffer(), buffer, ccd->PrimaryCCD.getFrameBufferSize());
-    /*else
+    /* Bin into our own buffer, the chip frame buffer belongs to exposures. The frame may have grown since the last one, the capture
+     * thread only resizes the ring once we are done with every slot but only we touch binnedFrame. */
+    if (ccd->PrimaryCCD.getBinX() > 1 || ccd->PrimaryCCD.getBinY() > 1)
     {
-      uint8_t *src, *dest;
-     // Binning not supported in color images for now
-     src = buffer;
-     dest = ccd->PrimaryCCD.getFrameBuffer();
-     uint8_t *red = dest;
-     uint8_t *green = dest + ccd->PrimaryCCD.getSubW() * ccd->PrimaryCCD.getSubH() * (ccd->PrimaryCCD.getBPP() / 8);
-     uint8_t *blue = dest +  ccd->PrimaryCCD.getSubW() * ccd->PrimaryCCD.getSubH() * (ccd->PrimaryCCD.getBPP() / 8) * 2;
-
-     for (int i=0; i <  ccd->PrimaryCCD.getFrameBufferSize(); i+=4)
-     {
-         *(blue++) = *(src+i);
-         *(green++) = *(src+i+1);
-         *(red++) = *(src+i+2);
-     }
-   }*/
+        int frameSize = ccd->PrimaryCCD.getFrameBufferSize();
+        if (frameSize > binnedFrameSize)
+        {
+            uint8_t *grown = (uint8_t *) realloc(binnedFrame, frameSize);
+            if (grown != NULL)
+            {
+                binnedFrame = grown;
+                binnedFrameSize = frameSize;
+            }
+        }
 
-    ccd->PrimaryCCD.binFrame();
+        /* Send what binFrame() wrote, it drops partial bins. If it fails, send the frame unbinned. */
+        int nbytes = frameSize <= binnedFrameSize ? ccd->PrimaryCCD.binFrame(buffer, binnedFrame) : -1;
+        if (nbytes > 0)
+        {
+            frame = binnedFrame;
+            totalBytes = nbytes;
+        }
+    }
 
     /* Do we want to compress ? */
      if (ccd->PrimaryCCD.isCompressed())
@@ -256,7 +295,7 @@ bool StreamRecorder::uploadStream(uint8_t *buffer)
         compressedFrame = (uint8_t *) realloc (compressedFrame, sizeof(uint8_t) * totalBytes + totalBytes / 64 + 16 + 3);
         compressedBytes = sizeof(uint8_t) * totalBytes + totalBytes / 64 + 16 + 3;
 
-        ret = compress2(compressedFrame, &compressedBytes, ccd->PrimaryCCD.getFrameBuffer(), totalBytes, 4);
+        ret = compress2(compressedFrame, &compressedBytes, frame, totalBytes, 4);
         if (ret != Z_OK)
         {
              /* this should NEVER happen */
@@ -265,25 +304,91 @@ bool StreamRecorder::uploadStream(uint8_t *buffer)
          }
 
         /* #3.A Send it compressed */
-        imageB->blob = compressedFrame;
-        imageB->bloblen = compressedBytes;
-        imageB->size = totalBytes;
-        strcpy(imageB->format, ".stream.z");
+        imageB.blob = compressedFrame;
+        imageB.bloblen = compressedBytes;
+        imageB.size = totalBytes;
+        strcpy(imageB.format, ".stream.z");
       }
       else
       {
         /* #3.B Send it uncompressed */
-         imageB->blob = ccd->PrimaryCCD.getFrameBuffer();
-         imageB->bloblen = totalBytes;
-         imageB->size = totalBytes;
-         strcpy(imageB->format, ".stream");
+         imageB.blob = frame;
+         imageB.bloblen = totalBytes;
+         imageB.size = totalBytes;
+         strcpy(imageB.format, ".stream");
       }
 
-    imageBP->s = IPS_OK;
-    IDSetBLOB (imageBP, NULL);
+    imageBP.s = IPS_OK;
+    IDSetBLOB (&imageBP, NULL);
+    return true;
+}
+
+void * StreamRecorder::uploadThreadHelper(void *context)
+{
+    (static_cast<StreamRecorder *> (context))->uploadThread();
+    return NULL;
+}
+
+/* Upload frames from the ring, oldest first, until told to stop */
+void StreamRecorder::uploadThread()
+{
+    while (true)
+    {
+        if (sem_wait(&upload_sem) < 0)
+            continue;
+
+        if (upload_stop)
+            break;
+
+        uint8_t *frame = ccd->PrimaryCCD.getReadySlot();
+        if (frame == NULL)
+            continue;
+
+        uploadStream(frame);
+        ccd->PrimaryCCD.releaseReadySlot();
+    }
+}
+
+bool StreamRecorder::startUploadThread()
+{
+    if (upload_running)
+        return true;
+
+    if (ccd->PrimaryCCD.setFrameRing(STREAM_RING_SLOTS) == false)
+    {
+        DEBUG(INDI::Logger::DBG_ERROR, "Not enough memory for the stream frame buffers.");
+        return false;
+    }
+
+    while (sem_trywait(&upload_sem) == 0)
+        ;
+    upload_stop = false;
+    if (pthread_create(&upload_thread, NULL, &StreamRecorder::uploadThreadHelper, this) != 0)
+    {
+        DEBUG(INDI::Logger::DBG_ERROR, "Failed to start the stream upload thread.");
+        ccd->PrimaryCCD.setFrameRing(0);
+        return false;
+    }
+
+    upload_running = true;
     return true;
 }
 
+void StreamRecorder::stopUploadThread()
+{
+    if (!upload_running)
+        return;
+
+    upload_stop = true;
+    sem_post(&upload_sem);
+    pthread_join(upload_thread, NULL);
+    upload_running = false;
+
+    if (ccd->PrimaryCCD.getDroppedFrames() > 0)
+        DEBUGF(INDI::Logger::DBG_WARNING, "%u stream frames were dropped because the upload could not keep up.", ccd->PrimaryCCD.getDroppedFrames());
+    ccd->PrimaryCCD.setFrameRing(0);
+}
+
 void StreamRecorder::recordStream(double deltams, unsigned char *buffer)
 {
   if (!is_recording)
@@ -625,8 +730,9 @@ bool StreamRecorder::setStream(bool enable)
 
             getitimer(ITIMER_REAL, &tframe1);
             mssum=0; framecountsec=0;
-            if (ccd->StartStreaming() == false)
+            if (startUploadThread() == false || ccd->StartStreaming() == false)
             {
+                stopUploadThread();
                 IUResetSwitch(&StreamSP);
                 StreamS[1].s = ISS_ON;
                 StreamSP.s = IPS_ALERT;
@@ -659,6 +765,7 @@ bool StreamRecorder::setStream(bool enable)
                 }
             }
 
+            stopUploadThread();
             IUResetSwitch(&StreamSP);
             StreamS[1].s = ISS_ON;
             is_streaming=false;
@@ -24,6 +24,8 @@
 #define STREAM_RECORDER_H
 
 #include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <string>
 #include <map>
 
@@ -54,7 +56,9 @@ public:
     virtual bool updateProperties();
 
     /**
-     * @brief newFrame CCD drivers calls this function when a new frame is received.
+     * @brief newFrame CCD drivers calls this function when a new frame is received. Frames to upload are queued to the upload thread
+     * through the PrimaryCCD frame ring, so buffer may be reused as soon as this returns. Drivers may capture straight into
+     * PrimaryCCD.getFillSlot() and pass that as buffer to spare a copy.
      */
     void newFrame(unsigned char *buffer);
 
@@ -87,8 +91,15 @@ private:
     bool startRecording();
     bool stopRecording();
 
+    bool queueStream(uint8_t *buffer);
     bool uploadStream(uint8_t *buffer);
 
+    /* Upload thread, fed frames through the PrimaryCCD frame ring */
+    static void *uploadThreadHelper(void *context);
+    void uploadThread();
+    bool startUploadThread();
+    void stopUploadThread();
+
     /* Stream switch */
     ISwitch StreamS[2];
     ISwitchVectorProperty StreamSP;
@@ -117,9 +128,9 @@ private:
     INumber RecordOptionsN[2];
     INumberVectorProperty RecordOptionsNP;
 
-    /* BLOBs */
-    IBLOBVectorProperty *imageBP;
-    IBLOB *imageB;
+    /* BLOBs: our own copy of CCD1, as the CCD upload thread fills in the original meanwhile */
+    IBLOBVectorProperty imageBP;
+    IBLOB imageB;
 
     bool is_streaming;
     bool is_recording;
@@ -129,6 +140,14 @@ private:
     double recordDuration;
 
     uint8_t *compressedFrame;
+    uint8_t *binnedFrame;           /* only used by the upload thread */
+    int binnedFrameSize;
+
+    // Upload thread
+    pthread_t upload_thread;
+    sem_t upload_sem;               /* posted once per frame queued, and to stop */
+    bool upload_running;
+    volatile bool upload_stop;
 
     // Record frames
     V4L2_Record *v4l2_record;
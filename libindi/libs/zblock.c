@@ -0,0 +1,259 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+/* Parallel zlib compression of large buffers.
+ *
+ * The input is cut into BLOCKSIZE blocks which threads take in turn and
+ *   each deflate as a raw stream of their own, ending all but the last with
+ *   a sync flush so it stops on a byte boundary without marking the end.
+ *   Laid end to end these blocks are one valid deflate stream, since no block
+ *   refers back into another. A zlib header in front and the adler32 of the
+ *   whole input, combined from those of the blocks, behind make it a zlib
+ *   stream any uncompress() decodes.
+ * Blocks are deflated straight into their own part of one buffer sized for
+ *   the worst case, then slid down to close the gaps.
+ */
+
+/** \file zblock.c
+    \brief Parallel zlib compression and byte shuffling.
+
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "fanout.h"
+#include "zblock.h"
+
+#if defined(__SSE2__)
+#define	ZBLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+#define	BLOCKSIZE	(1<<20)		/* input bytes per block */
+#define	HDRLEN		2		/* zlib header bytes */
+#define	TRLLEN		4		/* zlib adler32 trailer bytes */
+
+/* one block */
+typedef struct {
+    const unsigned char *in;		/* input */
+    size_t n;				/* input bytes */
+    unsigned char *out;			/* where to deflate it */
+    size_t room;			/* bytes at out */
+    size_t outn;			/* bytes deflated */
+    uLong adler;			/* adler32 of input */
+    int last;				/* last block of the stream */
+    int ok;				/* deflated ok */
+} ZBlock;
+
+/* what the threads share */
+typedef struct {
+    ZBlock *blocks;
+    int nblocks;
+    int next;				/* next block to take */
+    int level;
+    pthread_mutex_t lock;		/* guards next */
+} ZJob;
+
+static void *worker (void *arg);
+static void deflateBlock (ZBlock *bp, int level);
+
+int zblockCompress(const void *in, size_t n, int level, unsigned char **out, size_t *outn)
+{
+    ZBlock *blocks;
+    ZJob job;
+    unsigned char *buf, *op;
+    size_t room = HDRLEN + TRLLEN, off;
+    uLong adler;
+    int nblocks, nt, i, ok = 1;
+
+    if (level < 1 || level > 9)
+        level = Z_DEFAULT_COMPRESSION;
+
+    nblocks = n > 0 ? (int)((n + BLOCKSIZE - 1)/BLOCKSIZE) : 1;
+    blocks = (ZBlock *) calloc (nblocks, sizeof(ZBlock));
+    if (!blocks)
+        return (-1);
+    for (i = 0; i < nblocks; i++) {
+        ZBlock *bp = &blocks[i];
+        bp->in = (const unsigned char *)in + (size_t)i*BLOCKSIZE;
+        bp->n = n - (size_t)i*BLOCKSIZE < BLOCKSIZE ? n - (size_t)i*BLOCKSIZE : BLOCKSIZE;
+        bp->room = compressBound (bp->n) + 16;	/* and sync flush marker */
+        bp->last = i == nblocks - 1;
+        room += bp->room;
+    }
+
+    buf = (unsigned char *) malloc (room);
+    if (!buf) {
+        free (blocks);
+        return (-1);
+    }
+    for (i = 0, off = HDRLEN; i < nblocks; off += blocks[i++].room)
+        blocks[i].out = buf + off;
+
+    job.blocks = blocks;
+    job.nblocks = nblocks;
+    job.next = 0;
+    job.level = level;
+    pthread_mutex_init (&job.lock, NULL);
+
+    nt = fanOutThreads();
+    if (nt > nblocks)
+        nt = nblocks;
+
+    /* all take blocks from the one job, we work too */
+    fanOut (worker, &job, 0, nt);
+    pthread_mutex_destroy (&job.lock);
+
+    /* header, blocks slid together, then adler32 of it all */
+    buf[0] = 0x78;
+    buf[1] = level == 1 ? 0x01 : level >= 7 ? 0xda : 0x9c;
+    op = buf + HDRLEN;
+    adler = adler32 (0L, Z_NULL, 0);
+    for (i = 0; i < nblocks; i++) {
+        ZBlock *bp = &blocks[i];
+        ok &= bp->ok;
+        if (bp->out != op)
+            memmove (op, bp->out, bp->outn);
+        op += bp->outn;
+        adler = adler32_combine (adler, bp->adler, (z_off_t)bp->n);
+    }
+    *op++ = (unsigned char)(adler >> 24);
+    *op++ = (unsigned char)(adler >> 16);
+    *op++ = (unsigned char)(adler >> 8);
+    *op++ = (unsigned char)adler;
+
+    free (blocks);
+    if (!ok) {
+        free (buf);
+        return (-1);
+    }
+
+    *out = buf;
+    *outn = op - buf;
+    return (0);
+}
+
+void zblockShuffle(void *out, const void *in, size_t n, int elsize)
+{
+    const unsigned char *ip = (const unsigned char *)in;
+    unsigned char *op = (unsigned char *)out;
+    size_t nel = elsize > 0 ? n/elsize : 0;
+    size_t i = 0;
+    int b;
+
+    if (elsize <= 1) {
+        memcpy (out, in, n);
+        return;
+    }
+
+#if defined(ZBLOCK_SSE2)
+    if (elsize == 2) {
+        const __m128i lomask = _mm_set1_epi16 (0x00ff);
+        for (; i + 16 <= nel; i += 16) {
+            __m128i a = _mm_loadu_si128 ((const __m128i *)(ip + 2*i));
+            __m128i c = _mm_loadu_si128 ((const __m128i *)(ip + 2*i + 16));
+            __m128i lo = _mm_packus_epi16 (_mm_and_si128 (a, lomask), _mm_and_si128 (c, lomask));
+            __m128i hi = _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (c, 8));
+            _mm_storeu_si128 ((__m128i *)(op + i), lo);
+            _mm_storeu_si128 ((__m128i *)(op + nel + i), hi);
+        }
+    }
+#endif
+
+    for (; i < nel; i++)
+        for (b = 0; b < elsize; b++)
+            op[b*nel + i] = ip[i*elsize + b];
+    memcpy (op + nel*elsize, ip + nel*elsize, n - nel*elsize);
+}
+
+void zblockUnshuffle(void *out, const void *in, size_t n, int elsize)
+{
+    const unsigned char *ip = (const unsigned char *)in;
+    unsigned char *op = (unsigned char *)out;
+    size_t nel = elsize > 0 ? n/elsize : 0;
+    size_t i = 0;
+    int b;
+
+    if (elsize <= 1) {
+        memcpy (out, in, n);
+        return;
+    }
+
+#if defined(ZBLOCK_SSE2)
+    if (elsize == 2) {
+        for (; i + 16 <= nel; i += 16) {
+            __m128i lo = _mm_loadu_si128 ((const __m128i *)(ip + i));
+            __m128i hi = _mm_loadu_si128 ((const __m128i *)(ip + nel + i));
+            _mm_storeu_si128 ((__m128i *)(op + 2*i), _mm_unpacklo_epi8 (lo, hi));
+            _mm_storeu_si128 ((__m128i *)(op + 2*i + 16), _mm_unpackhi_epi8 (lo, hi));
+        }
+    }
+#endif
+
+    for (; i < nel; i++)
+        for (b = 0; b < elsize; b++)
+            op[i*elsize + b] = ip[b*nel + i];
+    memcpy (op + nel*elsize, ip + nel*elsize, n - nel*elsize);
+}
+
+/* deflate blocks of a ZJob until none are left */
+static void *
+worker (void *arg)
+{
+    ZJob *jp = (ZJob *)arg;
+
+    for (;;) {
+        int i;
+
+        pthread_mutex_lock (&jp->lock);
+        i = jp->next++;
+        pthread_mutex_unlock (&jp->lock);
+        if (i >= jp->nblocks)
+            break;
+        deflateBlock (&jp->blocks[i], jp->level);
+    }
+
+    return (NULL);
+}
+
+/* deflate one block as raw deflate data, ending on a byte boundary */
+static void
+deflateBlock (ZBlock *bp, int level)
+{
+    z_stream strm;
+    int r;
+
+    bp->adler = adler32 (adler32 (0L, Z_NULL, 0), bp->in, (uInt)bp->n);
+
+    memset (&strm, 0, sizeof(strm));
+    if (deflateInit2 (&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+    strm.next_in = (Bytef *)bp->in;
+    strm.avail_in = (uInt)bp->n;
+    strm.next_out = bp->out;
+    strm.avail_out = (uInt)bp->room;
+    r = deflate (&strm, bp->last ? Z_FINISH : Z_SYNC_FLUSH);
+    bp->ok = bp->last ? r == Z_STREAM_END : (r == Z_OK && strm.avail_in == 0);
+    bp->outn = bp->room - strm.avail_out;
+    deflateEnd (&strm);
+}
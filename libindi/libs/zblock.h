@@ -0,0 +1,70 @@
+#if 0
+    INDI
+    Copyright (C) 2026 INDI developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#endif
+
+#ifndef ZBLOCK_H
+#define ZBLOCK_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup zblock Block Compression Functions: zlib compression of large buffers in parallel blocks
+ */
+/*@{*/
+
+/** \brief Compress a buffer into one zlib stream, as compress2() does, but in blocks compressed by several threads at once.
+    Each block starts afresh, so the ratio is a little worse than compress2() at the same level, but the result is an
+    ordinary zlib stream that uncompress() decodes.
+    \param in bytes to compress.
+    \param n number of bytes at in.
+    \param level zlib compression level, 1 fastest to 9 smallest.
+    \param out set to a malloced buffer holding the stream, to be freed by the caller.
+    \param outn set to number of bytes at *out.
+    \return 0 if ok, -1 if out of memory or zlib failed.
+ */
+extern int zblockCompress(const void *in, size_t n, int level, unsigned char **out, size_t *outn);
+
+/** \brief Byte shuffle: gather byte 0 of every elsize byte element, then byte 1, and so on. Shuffled 16 bit pixels
+    compress better since their high bytes change slowly. Bytes past the last whole element are copied as they are.
+    \param out n bytes, may not overlap in.
+    \param in n bytes.
+    \param n number of bytes.
+    \param elsize bytes per element.
+ */
+extern void zblockShuffle(void *out, const void *in, size_t n, int elsize);
+
+/** \brief Undo zblockShuffle().
+    \param out n bytes, may not overlap in.
+    \param in n shuffled bytes.
+    \param n number of bytes.
+    \param elsize bytes per element given to zblockShuffle().
+ */
+extern void zblockUnshuffle(void *out, const void *in, size_t n, int elsize);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/* Stands in for a driver around indidriver.c in the tests: the globals
+ * indidrivermain.c defines, and IS functions recording what they are given.
+ */
+
+#include <string.h>
+
+#include "indidevapi.h"
+#include "indidriver.h"
+
+#include "indidriver_shim.h"
+
+ROSC *propCache;
+int nPropCache;
+int verbose;
+char *me = (char *) "test";
+LilXML *clixml;
+
+char shimDevice[MAXINDIDEVICE];
+char shimName[MAXINDINAME];
+double shimValues[8];
+int shimNValues;
+int shimNewNumbers;
+
+void
+ISGetProperties (const char *dev)
+{
+    (void) dev;
+}
+
+void
+ISNewNumber (const char *dev, const char *name, double *values, char *names[], int n)
+{
+    (void) names;
+    strncpy (shimDevice, dev, MAXINDIDEVICE-1);
+    strncpy (shimName, name, MAXINDINAME-1);
+    shimNValues = n < 8 ? n : 8;
+    memcpy (shimValues, values, shimNValues * sizeof(double));
+    shimNewNumbers++;
+}
+
+void
+ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n)
+{
+    (void) dev; (void) name; (void) states; (void) names; (void) n;
+}
+
+void
+ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n)
+{
+    (void) dev; (void) name; (void) texts; (void) names; (void) n;
+}
+
+void
+ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[], char *names[], int n)
+{
+    (void) dev; (void) name; (void) sizes; (void) blobsizes; (void) blobs; (void) formats; (void) names; (void) n;
+}
+
+void
+ISSnoopDevice (XMLEle *root)
+{
+    (void) root;
+}
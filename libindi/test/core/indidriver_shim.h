@@ -0,0 +1,21 @@
+#ifndef INDIDRIVER_SHIM_H
+#define INDIDRIVER_SHIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "indiapi.h"
+
+/* what the last ISNewNumber() was given */
+extern char shimDevice[MAXINDIDEVICE];
+extern char shimName[MAXINDINAME];
+extern double shimValues[8];
+extern int shimNValues;
+extern int shimNewNumbers;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/* Builds indiserver.c into the tests, its main() renamed, and gives them
+ * access to its static queue functions.
+ */
+
+#define main indiserver_main
+#include "indiserver.c"
+#undef main
+
+#include "indiserver_shim.h"
+
+static int nretired;
+
+static void
+retireMsg (Msg *mp, void *arg)
+{
+    (void) arg;
+    nretired++;
+    freeMsg (mp);
+}
+
+/* return a new queued Msg for the xml element in str, as read from a driver */
+void *
+shimXMLMsg (const char *str)
+{
+    LilXML *lp = newLilXML();
+    char err[1024];
+    XMLEle *root = NULL;
+    Msg *mp;
+
+    for (; *str && !root; str++)
+        root = readXMLEle (lp, *str, err);
+    delLilXML (lp);
+    if (!root)
+        return (NULL);
+
+    mp = newXMLMsg (root);
+    setMsgXMLEle (mp, root);
+    mp->count = 1;
+    delXMLEle (root);
+    return (mp);
+}
+
+/* return the content of Msg mp */
+const char *
+shimMsgContent (void *mp)
+{
+    return (((Msg *)mp)->cp);
+}
+
+/* compact q as for a congested client with nsent bytes of its first Msg
+ * written, return number dropped.
+ */
+int
+shimCompact (FQ *q, unsigned int nsent)
+{
+    unsigned long qbytes = 0;
+    int i;
+
+    for (i = 0; i < nFQ(q); i++)
+        qbytes += ((Msg *) peekiFQ (q, i))->cl;
+    nretired = 0;
+    i = compactMsgQ (q, nsent, &qbytes, retireMsg, NULL);
+    return (i == nretired ? i : -1);
+}
+
+/* free every Msg on q and q */
+void
+shimFreeQ (FQ *q)
+{
+    Msg *mp;
+
+    while ((mp = (Msg *) popFQ (q)) != NULL)
+        freeMsg (mp);
+    delFQ (q);
+}
+
+/* feed s to the closing tag match of a root element tag, as framed from a
+ * driver. return the offset just past the '>' closing it, or -1.
+ */
+int
+shimCloseTagEnd (const char *tag, const char *s)
+{
+    DvrFrame fr;
+    int i;
+
+    memset (&fr, 0, sizeof(fr));
+    fr.ntag = snprintf (fr.tag, sizeof(fr.tag), "<%s", tag);
+    for (i = 0; s[i]; i++)
+        if (matchCloseTag (&fr, s[i]))
+            return (i+1);
+    return (-1);
+}
@@ -0,0 +1,22 @@
+#ifndef INDISERVER_SHIM_H
+#define INDISERVER_SHIM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "fq.h"
+
+extern void *shimXMLMsg (const char *str);
+extern const char *shimMsgContent (void *mp);
+extern int shimCompact (FQ *q, unsigned int nsent);
+extern void shimFreeQ (FQ *q);
+extern int shimCloseTagEnd (const char *tag, const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
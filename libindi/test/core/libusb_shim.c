@@ -0,0 +1,281 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/* Stands in for libusb in the tests: one simulated device whose bulk IN
+ * endpoint has shimUsbAvailable more bytes to send, each shimUsbByte() of
+ * its position in the stream, then nothing, so transfers still waiting for
+ * data time out. Transfers complete in the order submitted, from
+ * libusb_handle_events_timeout_completed() in the calling thread. Only what
+ * INDI::USBDevice uses is here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#include "libusb_shim.h"
+
+#define	MAXPENDING	64
+
+typedef struct
+{
+    struct libusb_transfer *t;
+    double due;                         /* time out then, secs */
+    int cancelled;
+} Pending;
+
+static Pending pending[MAXPENDING];    /* submitted, oldest first */
+static int npending;
+
+long shimUsbAvailable;
+long shimUsbPos;
+int shimUsbCancels;
+
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}
+
+unsigned char
+shimUsbByte (long pos)
+{
+    return ((unsigned char)(pos*7 + pos/251));
+}
+
+/* take pending[i] off the list and give it back with status */
+static void
+complete (int i, enum libusb_transfer_status status)
+{
+    struct libusb_transfer *t = pending[i].t;
+
+    memmove (&pending[i], &pending[i+1], (npending - i - 1)*sizeof(Pending));
+    npending--;
+    t->status = status;
+    t->callback (t);
+}
+
+struct libusb_transfer *
+libusb_alloc_transfer (int iso_packets)
+{
+    (void) iso_packets;
+    return ((struct libusb_transfer *) calloc (1, sizeof(struct libusb_transfer)));
+}
+
+void
+libusb_free_transfer (struct libusb_transfer *t)
+{
+    free (t);
+}
+
+int
+libusb_submit_transfer (struct libusb_transfer *t)
+{
+    if (npending == MAXPENDING)
+        return (LIBUSB_ERROR_NO_MEM);
+    t->actual_length = 0;
+    pending[npending].t = t;
+    pending[npending].due = t->timeout ? now() + t->timeout/1000.0 : 1e30;
+    pending[npending].cancelled = 0;
+    npending++;
+    return (0);
+}
+
+int
+libusb_cancel_transfer (struct libusb_transfer *t)
+{
+    int i;
+
+    for (i = 0; i < npending; i++)
+        if (pending[i].t == t && !pending[i].cancelled) {
+            pending[i].cancelled = 1;
+            shimUsbCancels++;
+            return (0);
+        }
+    return (LIBUSB_ERROR_NOT_FOUND);
+}
+
+int
+libusb_handle_events_timeout_completed (libusb_context *ctx, struct timeval *tv, int *completed)
+{
+    double wait = tv->tv_sec + tv->tv_usec*1e-6;
+    int i;
+
+    (void) ctx;
+    (void) completed;
+
+    for (i = 0; i < npending; i++)
+        if (pending[i].cancelled) {
+            complete (i, LIBUSB_TRANSFER_CANCELLED);
+            return (0);
+        }
+
+    if (npending == 0)
+        return (0);
+
+    if (shimUsbAvailable > 0) {
+        struct libusb_transfer *t = pending[0].t;
+        long n = shimUsbAvailable < t->length ? shimUsbAvailable : t->length;
+        long j;
+
+        for (j = 0; j < n; j++)
+            t->buffer[j] = shimUsbByte (shimUsbPos + j);
+        shimUsbPos += n;
+        shimUsbAvailable -= n;
+        t->actual_length = n;
+        complete (0, LIBUSB_TRANSFER_COMPLETED);
+        return (0);
+    }
+
+    /* nothing to send: wait for the first to time out */
+    if (pending[0].due <= now()) {
+        complete (0, LIBUSB_TRANSFER_TIMED_OUT);
+        return (0);
+    }
+    if (pending[0].due - now() < wait)
+        wait = pending[0].due - now();
+    usleep ((useconds_t)(wait*1e6));
+    return (0);
+}
+
+int
+libusb_bulk_transfer (libusb_device_handle *h, unsigned char ep, unsigned char *buf, int len, int *transferred, unsigned int timeout)
+{
+    int i;
+
+    (void) h; (void) ep; (void) timeout;
+    *transferred = len < shimUsbAvailable ? len : (int)shimUsbAvailable;
+    for (i = 0; i < *transferred; i++)
+        buf[i] = shimUsbByte (shimUsbPos + i);
+    shimUsbPos += *transferred;
+    shimUsbAvailable -= *transferred;
+    return (0);
+}
+
+const char *
+libusb_error_name (int errcode)
+{
+    static char buffer[30];
+
+    snprintf (buffer, sizeof(buffer), "error %d", errcode);
+    return (buffer);
+}
+
+int
+libusb_init (libusb_context **ctx)
+{
+    *ctx = NULL;
+    return (0);
+}
+
+void
+libusb_exit (libusb_context *ctx)
+{
+    (void) ctx;
+}
+
+ssize_t
+libusb_get_device_list (libusb_context *ctx, libusb_device ***list)
+{
+    (void) ctx;
+    *list = NULL;
+    return (0);
+}
+
+void
+libusb_free_device_list (libusb_device **list, int unref_devices)
+{
+    (void) list; (void) unref_devices;
+}
+
+int
+libusb_get_device_descriptor (libusb_device *dev, struct libusb_device_descriptor *desc)
+{
+    (void) dev; (void) desc;
+    return (LIBUSB_ERROR_IO);
+}
+
+libusb_device *
+libusb_ref_device (libusb_device *dev)
+{
+    return (dev);
+}
+
+int
+libusb_open (libusb_device *dev, libusb_device_handle **handle)
+{
+    (void) dev; (void) handle;
+    return (LIBUSB_ERROR_IO);
+}
+
+void
+libusb_close (libusb_device_handle *handle)
+{
+    (void) handle;
+}
+
+int
+libusb_kernel_driver_active (libusb_device_handle *handle, int interface_number)
+{
+    (void) handle; (void) interface_number;
+    return (0);
+}
+
+int
+libusb_detach_kernel_driver (libusb_device_handle *handle, int interface_number)
+{
+    (void) handle; (void) interface_number;
+    return (0);
+}
+
+int
+libusb_claim_interface (libusb_device_handle *handle, int interface_number)
+{
+    (void) handle; (void) interface_number;
+    return (0);
+}
+
+int
+libusb_get_config_descriptor (libusb_device *dev, uint8_t config_index, struct libusb_config_descriptor **config)
+{
+    (void) dev; (void) config_index; (void) config;
+    return (LIBUSB_ERROR_IO);
+}
+
+int
+libusb_interrupt_transfer (libusb_device_handle *handle, unsigned char endpoint, unsigned char *data, int length,
+    int *transferred, unsigned int timeout)
+{
+    (void) handle; (void) endpoint; (void) data; (void) length; (void) timeout;
+    *transferred = 0;
+    return (LIBUSB_ERROR_IO);
+}
+
+int
+libusb_control_transfer (libusb_device_handle *handle, uint8_t request_type, uint8_t request, uint16_t value, uint16_t index,
+    unsigned char *data, uint16_t length, unsigned int timeout)
+{
+    (void) handle; (void) request_type; (void) request; (void) value; (void) index; (void) data; (void) length; (void) timeout;
+    return (LIBUSB_ERROR_IO);
+}
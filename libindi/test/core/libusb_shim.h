@@ -0,0 +1,20 @@
+#ifndef LIBUSB_SHIM_H
+#define LIBUSB_SHIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the simulated device: bytes it has left to send, and sent so far */
+extern long shimUsbAvailable;
+extern long shimUsbPos;
+extern int shimUsbCancels;
+
+/* the byte at pos in what the device sends */
+extern unsigned char shimUsbByte (long pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -73,3 +73,122 @@ TEST(CORE_BASE64, Test_from64tobits_fast)
 
 	free(p_outbuf);
 }
+
+/* fill buf with len bytes of noise, the same for the same seed */
+static void fill_random(unsigned char *buf, int len, unsigned int seed)
+{
+	srand(seed);
+	for (int i = 0; i < len; i++)
+		buf[i] = (unsigned char)rand();
+}
+
+TEST(CORE_BASE64, Test_kernels_match_lut)
+{
+	const char *kernels[] = { "ssse3", "avx2", "neon" };
+	const int maxlen = 100000;
+	unsigned char *raw = (unsigned char*)malloc(maxlen);
+	unsigned char *ref = (unsigned char*)malloc(4*maxlen/3+4);
+	unsigned char *enc = (unsigned char*)malloc(4*maxlen/3+4);
+	char *refdec = (char*)malloc(maxlen+3);
+	char *dec = (char*)malloc(maxlen+3);
+	ASSERT_TRUE(raw && ref && enc && refdec && dec);
+
+	for (int k = 0; k < 3; k++) {
+		if (base64SetKernel(kernels[k]) < 0)
+			continue;
+		for (int len = 0; len < 400; len += (len < 300 ? 1 : 37)) {
+			int n = len < 300 ? len : maxlen - len;
+			fill_random(raw, n, len);
+
+			ASSERT_EQ(0, base64SetKernel("lut"));
+			int reflen = to64frombits(ref, raw, n);
+			/* some bad chars too, which must decode as the LUT does */
+			for (int i = 0; len % 2 && i < reflen/50; i++)
+				ref[(i*7919) % reflen] = (unsigned char)(i*13 + 11);
+			int refdeclen = from64tobits_fast(refdec, (const char*)ref, reflen);
+
+			ASSERT_EQ(0, base64SetKernel(kernels[k]));
+			if (len % 2 == 0) {
+				ASSERT_EQ(reflen, to64frombits(enc, raw, n));
+				ASSERT_EQ(0, memcmp(ref, enc, reflen+1));
+			}
+			ASSERT_EQ(refdeclen, from64tobits_fast(dec, (const char*)ref, reflen));
+			ASSERT_EQ(0, memcmp(refdec, dec, refdeclen));
+		}
+	}
+	base64SetKernel("lut");
+
+	free(raw); free(ref); free(enc); free(refdec); free(dec);
+}
+
+TEST(CORE_BASE64, Test_from64tobits_fast_lines)
+{
+	const int len = 1000;
+	unsigned char raw[len], enc[4*len/3+4];
+	char lines[4*len/3+4*len/3/72+4], dec[len+3];
+	int enclen, nlines = 0;
+
+	fill_random(raw, len, 1);
+	enclen = to64frombits(enc, raw, len);
+	for (int i = 0; i < enclen; i++) {
+		lines[nlines++] = enc[i];
+		if (i % 72 == 71)
+			lines[nlines++] = '\n';
+	}
+
+	ASSERT_EQ(len, from64tobits_fast(dec, lines, nlines));
+	ASSERT_EQ(0, memcmp(raw, dec, len));
+}
+
+TEST(CORE_BASE64, Test_stream_chunks)
+{
+	const int len = 5000;
+	unsigned char raw[len], enc[4*len/3+4], out[4*len/3+4*len/3/72+16];
+	char dec[len+3];
+	base64_stream st;
+	int enclen, n = 0, ndec = 0;
+
+	fill_random(raw, len, 2);
+	enclen = to64frombits(enc, raw, len);
+
+	/* lines as IDSetBLOB() writes them, from chunks of every size */
+	to64init(&st, 72);
+	for (int i = 0, c = 1; i < len; i += c, c = c % 97 + 1)
+		n += to64update(&st, out + n, raw + i, (len - i < c ? len - i : c));
+	n += to64finish(&st, out + n);
+	ASSERT_EQ(enclen + (enclen+71)/72, n);
+	for (int i = 0; i < enclen; i++)
+		ASSERT_EQ(enc[i], out[i + i/72]);
+	ASSERT_EQ('\n', out[n-1]);
+
+	from64init(&st);
+	for (int i = 0, c = 1; i < n; i += c, c = c % 89 + 1) {
+		int r = from64update(&st, dec + ndec, (const char*)out + i, (n - i < c ? n - i : c));
+		ASSERT_GE(r, 0);
+		ndec += r;
+	}
+	ASSERT_EQ(0, from64finish(&st));
+	ASSERT_EQ(len, ndec);
+	ASSERT_EQ(0, memcmp(raw, dec, len));
+}
+
+TEST(CORE_BASE64, Test_stream_bad_input)
+{
+	base64_stream st;
+	char dec[16];
+
+	from64init(&st);
+	ASSERT_EQ(-1, from64update(&st, dec, "Rk9P*", 5));
+
+	from64init(&st);
+	ASSERT_EQ(-1, from64update(&st, dec, "Rg==Rg==", 8));
+
+	from64init(&st);
+	ASSERT_EQ(2, from64update(&st, dec, "Rk8=\n", 5));
+	ASSERT_EQ(0, from64finish(&st));
+	ASSERT_EQ(0, memcmp("FO", dec, 2));
+
+	from64init(&st);
+	ASSERT_EQ(3, from64update(&st, dec, "Rk9PQk", 6));
+	ASSERT_EQ(-1, from64finish(&st));
+}
@@ -0,0 +1,200 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+#include "baseclient.h"
+#include "basedevice.h"
+
+#define NSETS   10
+
+// Records what it is told, and holds up newBLOB() while told to
+class TestClient : public INDI::BaseClient
+{
+  public:
+    TestClient() : holdBLOBs(true), blobsEntered(0), mountNumbers(0), camTemps(0)
+    {
+        pthread_mutex_init(&lock, NULL);
+        pthread_cond_init(&cond, NULL);
+    }
+
+    ~TestClient()
+    {
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&lock);
+    }
+
+    // Wait up to seconds for *count to reach n
+    bool waitFor(int *count, int n, int seconds)
+    {
+        bool reached;
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += seconds;
+        pthread_mutex_lock(&lock);
+        while (*count < n && pthread_cond_timedwait(&cond, &lock, &ts) == 0)
+            ;
+        reached = (*count >= n);
+        pthread_mutex_unlock(&lock);
+        return reached;
+    }
+
+    void release()
+    {
+        pthread_mutex_lock(&lock);
+        holdBLOBs = false;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool holdBLOBs;
+    int blobsEntered, mountNumbers, camTemps;
+    std::vector<int> camEvents;         // set numbers of the Cam BLOBs and temperatures, in the order notified
+    std::vector<int> camBLOBs;
+
+  protected:
+    virtual void newDevice(INDI::BaseDevice *) {}
+    virtual void removeDevice(INDI::BaseDevice *) {}
+    virtual void newProperty(INDI::Property *) {}
+    virtual void removeProperty(INDI::Property *) {}
+    virtual void newSwitch(ISwitchVectorProperty *) {}
+    virtual void newText(ITextVectorProperty *) {}
+    virtual void newLight(ILightVectorProperty *) {}
+    virtual void newMessage(INDI::BaseDevice *, int) {}
+    virtual void serverConnected() {}
+    virtual void serverDisconnected(int) {}
+
+    virtual void newBLOB(IBLOB *bp)
+    {
+        int set = ((unsigned char *) bp->blob)[0];
+
+        pthread_mutex_lock(&lock);
+        blobsEntered++;
+        pthread_cond_broadcast(&cond);
+        while (holdBLOBs)
+            pthread_cond_wait(&cond, &lock);
+        camEvents.push_back(set);
+        camBLOBs.push_back(set);
+        pthread_mutex_unlock(&lock);
+    }
+
+    virtual void newNumber(INumberVectorProperty *nvp)
+    {
+        pthread_mutex_lock(&lock);
+        if (!strcmp(nvp->device, "Mount"))
+            mountNumbers++;
+        else
+        {
+            camEvents.push_back((int) nvp->np[0].value);
+            camTemps++;
+        }
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+};
+
+static void send(int fd, const std::string &s)
+{
+    ASSERT_EQ((ssize_t) s.size(), write(fd, s.data(), s.size()));
+}
+
+TEST(CORE_BASECLIENT, Test_AsyncDispatch)
+{
+    static const char *encoded[NSETS] = { "AA==", "AQ==", "Ag==", "Aw==", "BA==", "BQ==", "Bg==", "Bw==", "CA==", "CQ==" };
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    TestClient client;
+    char buf[256];
+    int lfd, fd;
+
+    // A server on a port of its own
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, lfd);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(lfd, (struct sockaddr *) &addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(lfd, 1));
+    ASSERT_EQ(0, getsockname(lfd, (struct sockaddr *) &addr, &len));
+
+    client.setServer("127.0.0.1", ntohs(addr.sin_port));
+    client.setAsyncDispatch(true);
+    ASSERT_TRUE(client.connectServer());
+    fd = accept(lfd, NULL, NULL);
+    ASSERT_LE(0, fd);
+    ASSERT_LT(0, read(fd, buf, sizeof(buf)));
+
+    send(fd, "<defBLOBVector device='Cam' name='CCD1' label='Image' group='Main' state='Idle' perm='ro'>\n"
+             "  <defBLOB name='CCD1' label='Image'/>\n</defBLOBVector>\n"
+             "<defNumberVector device='Cam' name='TEMP' label='Temp' group='Main' state='Idle' perm='ro'>\n"
+             "  <defNumber name='T' label='T' format='%g' min='0' max='100' step='1'>0</defNumber>\n</defNumberVector>\n"
+             "<defNumberVector device='Mount' name='EQ' label='EQ' group='Main' state='Idle' perm='ro'>\n"
+             "  <defNumber name='RA' label='RA' format='%g' min='0' max='100' step='1'>0</defNumber>\n</defNumberVector>\n");
+
+    // Far more BLOBs than Cam takes in, each followed by a temperature, with Mount updates in between
+    for (int i = 0; i < NSETS; i++)
+    {
+        snprintf(buf, sizeof(buf), "<setBLOBVector device='Cam' name='CCD1' state='Ok'>\n"
+                 "  <oneBLOB name='CCD1' size='1' enclen='4' format='.fits'>%s</oneBLOB>\n</setBLOBVector>\n", encoded[i]);
+        send(fd, buf);
+        snprintf(buf, sizeof(buf), "<setNumberVector device='Cam' name='TEMP' state='Ok'>\n"
+                 "  <oneNumber name='T'>%d</oneNumber>\n</setNumberVector>\n", i);
+        send(fd, buf);
+        snprintf(buf, sizeof(buf), "<setNumberVector device='Mount' name='EQ' state='Ok'>\n"
+                 "  <oneNumber name='RA'>%d</oneNumber>\n</setNumberVector>\n", i);
+        send(fd, buf);
+    }
+
+    // While Cam is stuck in newBLOB(), Mount carries on
+    ASSERT_TRUE(client.waitFor(&client.blobsEntered, 1, 5));
+    EXPECT_TRUE(client.waitFor(&client.mountNumbers, NSETS, 5));
+
+    client.release();
+    EXPECT_TRUE(client.waitFor(&client.camTemps, NSETS, 5));
+
+    // Cam heard all its temperatures and the latest BLOB, in the order sent, the BLOBs that waited too long dropped
+    pthread_mutex_lock(&client.lock);
+    for (unsigned int i = 1; i < client.camEvents.size(); i++)
+        EXPECT_LE(client.camEvents[i - 1], client.camEvents[i]);
+    ASSERT_FALSE(client.camBLOBs.empty());
+    EXPECT_EQ(NSETS - 1, client.camBLOBs.back());
+    EXPECT_GE(5, (int) client.camBLOBs.size());
+    pthread_mutex_unlock(&client.lock);
+
+    client.disconnectServer();
+    close(fd);
+    close(lfd);
+}
@@ -0,0 +1,267 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "base64.h"
+#include "basedevice.h"
+#include "indiproperty.h"
+#include "lilxml.h"
+#include "zblock.h"
+
+#define NPROPS  50
+
+// The IUFill functions are in the driver library, not the client one
+static void fillNumber(INumber *np, const char *name, double value)
+{
+    memset(np, 0, sizeof(*np));
+    strncpy(np->name, name, MAXINDINAME - 1);
+    np->value = value;
+}
+
+static void fillNumberVector(INumberVectorProperty *nvp, INumber *np, int nnp, const char *name, IPState s)
+{
+    memset(nvp, 0, sizeof(*nvp));
+    strncpy(nvp->device, "Mount", MAXINDIDEVICE - 1);
+    strncpy(nvp->name, name, MAXINDINAME - 1);
+    nvp->np = np;
+    nvp->nnp = nnp;
+    nvp->p = IP_RW;
+    nvp->s = s;
+}
+
+class CORE_BASEDEVICE : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char name[MAXINDINAME];
+
+        device.setDeviceName("Mount");
+        for (int i = 0; i < NPROPS; i++)
+        {
+            for (int j = 0; j < 12; j++)
+            {
+                snprintf(name, sizeof(name), "E%d", j);
+                fillNumber(&numbers[i][j], name, j);
+            }
+            snprintf(name, sizeof(name), "P%d", i);
+            fillNumberVector(&nvp[i], numbers[i], i % 2 ? 12 : 3, name, IPS_OK);
+            device.registerProperty(&nvp[i], INDI_NUMBER);
+        }
+    }
+
+    INDI::BaseDevice device;
+    INumberVectorProperty nvp[NPROPS];
+    INumber numbers[NPROPS][12];
+};
+
+TEST_F(CORE_BASEDEVICE, Test_FindProperty)
+{
+    char name[MAXINDINAME];
+
+    for (int i = 0; i < NPROPS; i++)
+    {
+        snprintf(name, sizeof(name), "P%d", i);
+        ASSERT_EQ(&nvp[i], device.getNumber(name));
+    }
+    ASSERT_TRUE(device.getNumber("P") == NULL);
+    ASSERT_TRUE(device.getSwitch("P1") == NULL);
+}
+
+TEST_F(CORE_BASEDEVICE, Test_SameNameOtherType)
+{
+    ISwitch s[2];
+    ISwitchVectorProperty svp;
+    char errmsg[MAXRBUF];
+
+    memset(s, 0, sizeof(s));
+    strcpy(s[0].name, "A");
+    strcpy(s[1].name, "B");
+    s[0].s = ISS_ON;
+    memset(&svp, 0, sizeof(svp));
+    strcpy(svp.device, "Mount");
+    strcpy(svp.name, "P7");
+    svp.sp = s;
+    svp.nsp = 2;
+    svp.p = IP_RO;
+    svp.s = IPS_ALERT;
+    device.registerProperty(&svp, INDI_SWITCH);
+
+    ASSERT_EQ(&nvp[7], device.getNumber("P7"));
+    ASSERT_EQ(&svp, device.getSwitch("P7"));
+    ASSERT_EQ(IPS_OK, device.getPropertyState("P7"));
+
+    // Removing goes for the first of that name, leaving the other found
+    ASSERT_EQ(0, device.removeProperty("P7", errmsg));
+    ASSERT_TRUE(device.getNumber("P7") == NULL);
+    ASSERT_EQ(&svp, device.getSwitch("P7"));
+    ASSERT_EQ(IPS_ALERT, device.getPropertyState("P7"));
+}
+
+TEST_F(CORE_BASEDEVICE, Test_UnregisteredSkipped)
+{
+    INumberVectorProperty p3;
+
+    // A registered property is found past an unregistered one of the same name
+    device.getProperty("P3")->setRegistered(false);
+    fillNumberVector(&p3, numbers[0], 3, "P3", IPS_BUSY);
+    device.registerProperty(&p3, INDI_NUMBER);
+
+    ASSERT_EQ(&p3, device.getNumber("P3"));
+}
+
+TEST_F(CORE_BASEDEVICE, Test_OutsideChanges)
+{
+    INumberVectorProperty ext;
+    INDI::Property *p = new INDI::Property();
+
+    // Properties pushed through getProperties() are found as well
+    fillNumberVector(&ext, numbers[0], 3, "EXT", IPS_OK);
+    p->setProperty(&ext);
+    p->setType(INDI_NUMBER);
+    p->setRegistered(true);
+    device.getProperties()->push_back(p);
+
+    ASSERT_EQ(&ext, device.getNumber("EXT"));
+}
+
+TEST_F(CORE_BASEDEVICE, Test_FindElement)
+{
+    INumber other[10];
+    INDI::Property *p = device.getProperty("P9", INDI_NUMBER);
+    char name[MAXINDINAME];
+
+    for (int j = 0; j < 12; j++)
+    {
+        snprintf(name, sizeof(name), "E%d", j);
+        ASSERT_EQ(&numbers[9][j], p->findNumber(name));
+    }
+    ASSERT_TRUE(p->findNumber("X") == NULL);
+    ASSERT_TRUE(p->findSwitch("E1") == NULL);
+
+    p = device.getProperty("P8");
+    ASSERT_EQ(&numbers[8][2], p->findNumber("E2"));
+    ASSERT_TRUE(p->findNumber("E5") == NULL);
+
+    // The driver may point the vector at other elements
+    for (int j = 0; j < 10; j++)
+    {
+        snprintf(name, sizeof(name), "E%d", j);
+        fillNumber(&other[j], name, j);
+    }
+    nvp[9].np = other;
+    nvp[9].nnp = 10;
+    ASSERT_EQ(&other[4], device.getProperty("P9")->findNumber("E4"));
+    ASSERT_TRUE(device.getProperty("P9")->findNumber("E11") == NULL);
+}
+
+// Lets the test hand setBLOB() what a client would
+class BLOBDevice : public INDI::BaseDevice
+{
+  public:
+    using INDI::BaseDevice::setBLOB;
+};
+
+// Send n bytes compressed by zblockCompress() at level, shuffled first if shuffle, and check setBLOB() gets them back
+static void roundTrip(const unsigned char *data, size_t n, int level, bool shuffle)
+{
+    BLOBDevice device;
+    IBLOB b;
+    IBLOBVectorProperty bvp;
+    unsigned char *shuffled = NULL, *compressed = NULL;
+    size_t compressedBytes = 0;
+    char errmsg[MAXRBUF];
+
+    if (shuffle)
+    {
+        shuffled = (unsigned char *) malloc(n);
+        zblockShuffle(shuffled, data, n, 2);
+    }
+    ASSERT_EQ(0, zblockCompress(shuffle ? shuffled : data, n, level, &compressed, &compressedBytes));
+    free(shuffled);
+
+    std::string encoded(4 * ((compressedBytes + 2) / 3) + 4, '\0');
+    encoded.resize(to64frombits((unsigned char *) &encoded[0], compressed, compressedBytes));
+    free(compressed);
+
+    char head[256];
+    snprintf(head, sizeof(head), "<setBLOBVector device='Cam' name='CCD1'>\n<oneBLOB name='CCD1' size='%d' format='%s'>",
+             (int) n, shuffle ? ".fits.sz" : ".fits.z");
+    std::string xml = head + encoded + "</oneBLOB>\n</setBLOBVector>\n";
+
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, &xml[0], xml.size(), errmsg);
+    ASSERT_TRUE(nodes != NULL && nodes[0] != NULL);
+
+    memset(&b, 0, sizeof(b));
+    strcpy(b.name, "CCD1");
+    memset(&bvp, 0, sizeof(bvp));
+    strcpy(bvp.device, "Cam");
+    strcpy(bvp.name, "CCD1");
+    bvp.bp = &b;
+    bvp.nbp = 1;
+    b.bvp = &bvp;
+    device.setDeviceName("Cam");
+    device.registerProperty(&bvp, INDI_BLOB);
+
+    EXPECT_EQ(0, device.setBLOB(&bvp, nodes[0], errmsg)) << errmsg;
+    EXPECT_EQ((int) n, b.size) << "n " << n << " level " << level << " shuffle " << shuffle;
+    EXPECT_STREQ(".fits", b.format);
+    EXPECT_TRUE(b.blob != NULL && memcmp(b.blob, data, n) == 0) << "n " << n << " level " << level << " shuffle " << shuffle;
+
+    free(b.blob);
+    delXMLEle(nodes[0]);
+    free(nodes);
+    delLilXML(lp);
+}
+
+TEST(CORE_ZBLOCK, Test_DecodedBySetBLOB)
+{
+    const size_t block = 1 << 20;      // zblock.c BLOCKSIZE
+    const size_t sizes[] = { 1, 2, 3, block - 1, block, block + 1, 2 * block + 3 };
+    const int levels[] = { 1, 6, 9 };
+    unsigned char *data = (unsigned char *) malloc(2 * block + 3);
+    unsigned int seed = 1;
+
+    // 16 bit pixels, a slow ramp with noise in the low byte, as a frame would be
+    for (size_t i = 0; i < 2 * block + 3; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (i % 2) ? (unsigned char) (i / 8192) : (unsigned char) (seed >> 24);
+    }
+
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        for (unsigned int j = 0; j < sizeof(levels) / sizeof(levels[0]); j++)
+        {
+            roundTrip(data, sizes[i], levels[j], false);
+            roundTrip(data, sizes[i], levels[j], true);
+        }
+
+    free(data);
+}
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "binning.h"
+#include "fanout.h"
+
+// Pixel i of a frame of unsigned bpp bit pixels
+static uint64_t pixel(const unsigned char *p, size_t i, int bpp)
+{
+    if (bpp == 8)
+        return p[i];
+    if (bpp == 16)
+        return ((const uint16_t *) p)[i];
+    return ((const uint32_t *) p)[i];
+}
+
+// Bin one pixel at a time, as binImage() documents it
+static void reference(const unsigned char *in, unsigned char *out, int w, int h, int bpp, int bx, int by, int mode)
+{
+    uint64_t max = bpp == 8 ? 0xff : bpp == 16 ? 0xffff : 0xffffffff;
+    uint64_t div = 1;
+
+    if (mode == BIN_AVERAGE)
+        div = bx * by;
+    else if (mode == BIN_AUTO && bpp == 8 && bx * by > 1)
+        div = bx * by / 2;
+
+    for (int y = 0; y < h / by; y++)
+        for (int x = 0; x < w / bx; x++)
+        {
+            uint64_t sum = 0;
+            for (int j = 0; j < by; j++)
+                for (int i = 0; i < bx; i++)
+                    sum += pixel(in, (size_t) (y * by + j) * w + x * bx + i, bpp);
+            sum /= div;
+            if (sum > max)
+                sum = max;
+
+            size_t o = (size_t) y * (w / bx) + x;
+            if (bpp == 8)
+                out[o] = (uint8_t) sum;
+            else if (bpp == 16)
+                ((uint16_t *) out)[o] = (uint16_t) sum;
+            else
+                ((uint32_t *) out)[o] = (uint32_t) sum;
+        }
+}
+
+// Check binImage() against reference() on a w x h frame, either noise or bright enough for sums to saturate
+static void check(int w, int h, int bpp, int bx, int by, int mode, bool bright)
+{
+    size_t n = (size_t) w * h * (bpp / 8);
+    size_t nout = (size_t) (w / bx) * (h / by) * (bpp / 8);
+    std::vector<unsigned char> in(n), want(nout + 1), got(nout + 1, 0xa5);
+    unsigned int seed = w * 31 + h * 7 + bpp + bx * 3 + by;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (unsigned char) (seed >> 24);
+        if (bright)
+            in[i] |= 0xe0;
+    }
+
+    reference(&in[0], &want[0], w, h, bpp, bx, by, mode);
+    ASSERT_EQ((int) nout, binImage(&in[0], &got[0], w, h, bpp, bx, by, mode))
+            << w << "x" << h << " bpp " << bpp << " bin " << bx << "x" << by << " mode " << mode;
+    EXPECT_EQ(0, memcmp(&want[0], &got[0], nout))
+            << w << "x" << h << " bpp " << bpp << " bin " << bx << "x" << by << " mode " << mode;
+    EXPECT_EQ(0xa5, got[nout]) << "wrote past the binned frame";
+}
+
+TEST(CORE_BINNING, Test_MatchesReference)
+{
+    const int bpps[] = { 8, 16, 32 };
+    const int modes[] = { BIN_AUTO, BIN_SUM, BIN_AVERAGE };
+    const int bins[][2] = { { 1, 1 }, { 2, 2 }, { 3, 3 }, { 4, 4 }, { 1, 2 }, { 2, 1 }, { 3, 2 }, { 4, 2 }, { 2, 5 } };
+
+    for (unsigned int b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++)
+        for (unsigned int m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+            for (unsigned int k = 0; k < sizeof(bins) / sizeof(bins[0]); k++)
+            {
+                // Odd sizes leave partial bins, and rows of a length SIMD does not divide
+                check(37, 23, bpps[b], bins[k][0], bins[k][1], modes[m], false);
+                check(64, 16, bpps[b], bins[k][0], bins[k][1], modes[m], false);
+                check(37, 23, bpps[b], bins[k][0], bins[k][1], modes[m], true);
+            }
+}
+
+TEST(CORE_BINNING, Test_Threads)
+{
+    // Large enough to be split across threads, with rows left over for the last
+    fanOutSetThreads(4);
+    check(1031, 1029, 8, 2, 2, BIN_AUTO, false);
+    check(1031, 1029, 16, 3, 2, BIN_SUM, true);
+    check(1031, 1029, 16, 3, 3, BIN_AVERAGE, false);
+    check(1031, 1029, 32, 2, 3, BIN_AVERAGE, false);
+    fanOutSetThreads(0);
+}
+
+TEST(CORE_BINNING, Test_Unsupported)
+{
+    unsigned char buf[16];
+
+    ASSERT_EQ(-1, binImage(buf, buf, 4, 4, 12, 2, 2, BIN_SUM));
+    ASSERT_EQ(-1, binImage(buf, buf, 4, 4, 8, 0, 2, BIN_SUM));
+    ASSERT_EQ(0, binImage(buf, buf, 4, 4, 8, 5, 1, BIN_SUM));
+}
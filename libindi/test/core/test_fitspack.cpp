@@ -0,0 +1,225 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "fitspack.h"
+
+// The keywords INDI::CCD::addFITSKeywords() writes, one of each type it writes them with, and nhistory more cards
+static void addKeywords(fitsfile *fptr, int nhistory, int *status)
+{
+    char instrume[] = "CCD Simulator", frame[] = "Light", bayer[] = "RGGB", dateobs[] = "2026-10-17T21:04:05.125";
+    double exptime = 1.5, temp = -20.25, pixsize = 5.4, ra = 10.684708333, dec = 41.26875;
+    unsigned int bin = 2;
+    int equinox = 2000;
+
+    fits_update_key(fptr, TSTRING, "INSTRUME", instrume, "CCD Name", status);
+    fits_update_key(fptr, TDOUBLE, "EXPTIME", &exptime, "Total Exposure Time (s)", status);
+    fits_update_key(fptr, TDOUBLE, "CCD-TEMP", &temp, "CCD Temperature (Celcius)", status);
+    fits_update_key(fptr, TDOUBLE, "PIXSIZE1", &pixsize, "Pixel Size 1 (microns)", status);
+    fits_update_key(fptr, TUINT, "XBINNING", &bin, "Binning factor in width", status);
+    fits_update_key(fptr, TSTRING, "FRAME", frame, "Frame Type", status);
+    fits_update_key(fptr, TSTRING, "BAYERPAT", bayer, "Bayer color pattern", status);
+    fits_update_key(fptr, TDOUBLE, "OBJCTRA", &ra, "Object RA", status);
+    fits_update_key(fptr, TDOUBLE, "OBJCTDEC", &dec, "Object DEC", status);
+    fits_update_key(fptr, TINT, "EQUINOX", &equinox, "Equinox", status);
+    fits_update_key(fptr, TSTRING, "DATE-OBS", dateobs, "UTC start date of observation", status);
+    for (int i = 0; i < nhistory; i++)
+        fits_write_history(fptr, "Padding the header towards the next block", status);
+    fits_write_comment(fptr, "Generated by INDI", status);
+}
+
+// Write a frame with cfitsio, the way INDI::CCD::ExposureComplete() did before fitspack, and check a file laid out
+// with fitsPackHeader() and fitsPackData() from the same header cards is the same file, byte for byte
+static void check(long w, long h, long planes, int bpp, int nhistory)
+{
+    long naxes[3] = { w, h, planes };
+    int naxis = planes > 1 ? 3 : 2;
+    size_t n = (size_t) w * h * planes;
+    int imgtype = bpp == 8 ? BYTE_IMG : bpp == 16 ? USHORT_IMG : ULONG_IMG;
+    int datatype = bpp == 8 ? TBYTE : bpp == 16 ? TUSHORT : TUINT;
+    uint32_t top = bpp == 8 ? 0xff : bpp == 16 ? 0xffff : 0xffffffff;
+    std::vector<unsigned char> pixels(n * (bpp / 8));
+    uint32_t seed = (uint32_t) (w * 31 + h * 7 + planes + bpp);
+    int status = 0;
+
+    // Noise, but with the smallest and largest values and the ones either side of BZERO
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t v;
+        seed = seed * 1103515245 + 12345;
+        v = i == 0 ? 0 : i == 1 ? top : i == 2 ? top / 2 : i == 3 ? top / 2 + 1 : seed & top;
+        if (bpp == 8)
+            pixels[i] = (uint8_t) v;
+        else if (bpp == 16)
+            ((uint16_t *) &pixels[0])[i] = (uint16_t) v;
+        else
+            ((uint32_t *) &pixels[0])[i] = v;
+    }
+
+    size_t memsize = FITS_BLOCK;
+    void *memptr = malloc(memsize);
+    fitsfile *fptr;
+    char *cards = NULL;
+    int ncards = 0;
+    LONGLONG headstart, datastart, dataend;
+
+    fits_create_memfile(&fptr, &memptr, &memsize, FITS_BLOCK, realloc, &status);
+    ASSERT_EQ(0, status);
+    fits_create_img(fptr, imgtype, naxis, naxes, &status);
+    addKeywords(fptr, nhistory, &status);
+    fits_hdr2str(fptr, 0, NULL, 0, &cards, &ncards, &status);
+    fits_write_img(fptr, datatype, 1, n, &pixels[0], &status);
+    fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &status);
+    fits_close_file(fptr, &status);
+    ASSERT_EQ(0, status);
+
+    // As ExposureComplete() does
+    if (ncards > 0 && !strncmp(cards + (ncards - 1) * FITS_CARD, "END     ", 8))
+        ncards--;
+
+    size_t headerBytes = fitsPadded((ncards + 1) * FITS_CARD);
+    size_t dataBytes   = fitsPadded(n * (bpp / 8));
+    std::vector<unsigned char> packed(headerBytes + dataBytes + 1, 0xa5);
+
+    ASSERT_EQ(headerBytes, fitsPackHeader((char *) &packed[0], cards, ncards));
+    ASSERT_EQ(dataBytes, fitsPackData(&packed[headerBytes], &pixels[0], n, bpp));
+    free(cards);
+
+    // Exactly the size of the cfitsio file, both units whole blocks, and not a byte written past them
+    EXPECT_EQ(0u, headerBytes % FITS_BLOCK);
+    EXPECT_EQ(0u, dataBytes % FITS_BLOCK);
+    EXPECT_EQ(datastart, (LONGLONG) headerBytes);
+    EXPECT_EQ(dataend, (LONGLONG) (headerBytes + dataBytes));
+    ASSERT_LE((size_t) dataend, memsize);
+    EXPECT_EQ(0xa5, packed[headerBytes + dataBytes]);
+    EXPECT_EQ(0, memcmp(&packed[0], memptr, headerBytes)) << w << "x" << h << "x" << planes << " bpp " << bpp;
+    EXPECT_EQ(0, memcmp(&packed[headerBytes], (char *) memptr + headerBytes, dataBytes))
+            << w << "x" << h << "x" << planes << " bpp " << bpp;
+    free(memptr);
+
+    // Pixels big endian, less BZERO, and the padding zeros
+    for (size_t i = 0; i < n && i < 4; i++)
+    {
+        const unsigned char *p = &packed[headerBytes + i * (bpp / 8)];
+        if (bpp == 8)
+        {
+            EXPECT_EQ(pixels[i], p[0]);
+        }
+        else if (bpp == 16)
+        {
+            uint16_t v = ((uint16_t *) &pixels[0])[i] ^ 0x8000;
+            EXPECT_EQ(v >> 8, p[0]);
+            EXPECT_EQ(v & 0xff, p[1]);
+        }
+        else
+        {
+            uint32_t v = ((uint32_t *) &pixels[0])[i] ^ 0x80000000u;
+            EXPECT_EQ(v >> 24, p[0]);
+            EXPECT_EQ((v >> 16) & 0xff, p[1]);
+            EXPECT_EQ((v >> 8) & 0xff, p[2]);
+            EXPECT_EQ(v & 0xff, p[3]);
+        }
+    }
+    for (size_t i = headerBytes + n * (bpp / 8); i < headerBytes + dataBytes; i++)
+        ASSERT_EQ(0, packed[i]) << "padding byte " << i;
+
+    // And cfitsio reads back the keywords and pixels
+    void *packedptr = &packed[0];
+    size_t packedsize = headerBytes + dataBytes;
+    std::vector<unsigned char> back(pixels.size());
+    char instrume[FLEN_VALUE];
+    double exptime = 0;
+    unsigned int bin = 0;
+    int anynul = 0;
+
+    fits_open_memfile(&fptr, "fitspack.fits", READONLY, &packedptr, &packedsize, 0, NULL, &status);
+    ASSERT_EQ(0, status);
+    fits_read_key(fptr, TSTRING, "INSTRUME", instrume, NULL, &status);
+    fits_read_key(fptr, TDOUBLE, "EXPTIME", &exptime, NULL, &status);
+    fits_read_key(fptr, TUINT, "XBINNING", &bin, NULL, &status);
+    fits_read_img(fptr, datatype, 1, n, NULL, &back[0], &anynul, &status);
+    fits_close_file(fptr, &status);
+    ASSERT_EQ(0, status);
+    EXPECT_STREQ("CCD Simulator", instrume);
+    EXPECT_EQ(1.5, exptime);
+    EXPECT_EQ(2u, bin);
+    EXPECT_EQ(0, memcmp(&pixels[0], &back[0], pixels.size()));
+}
+
+TEST(CORE_FITSPACK, Test_MatchesCfitsio)
+{
+    const int bpps[] = { 8, 16, 32 };
+    const long shapes[][3] = { { 1, 1, 1 }, { 37, 23, 1 }, { 60, 48, 1 }, { 36, 40, 1 }, { 5, 4, 3 }, { 1031, 7, 1 } };
+
+    for (unsigned int b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++)
+        for (unsigned int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+        {
+            // Headers of one block and of two, data of a whole number of blocks (60x48 bytes, 36x40 shorts) and not
+            check(shapes[s][0], shapes[s][1], shapes[s][2], bpps[b], 0);
+            check(shapes[s][0], shapes[s][1], shapes[s][2], bpps[b], 30);
+        }
+}
+
+TEST(CORE_FITSPACK, Test_HeaderBlocks)
+{
+    char cards[36 * FITS_CARD + 1];
+    std::vector<char> out(3 * FITS_BLOCK, 'x');
+
+    for (int i = 0; i < 36; i++)
+        snprintf(cards + i * FITS_CARD, FITS_CARD + 1, "KEY%-5d= %20d / %-47s", i, i, "card");
+
+    EXPECT_EQ(0u, fitsPadded(0));
+    EXPECT_EQ((size_t) FITS_BLOCK, fitsPadded(1));
+    EXPECT_EQ((size_t) FITS_BLOCK, fitsPadded(FITS_BLOCK));
+    EXPECT_EQ((size_t) 2 * FITS_BLOCK, fitsPadded(FITS_BLOCK + 1));
+
+    // 35 cards and END fill one block exactly, 36 spill END into a second padded with spaces
+    ASSERT_EQ((size_t) FITS_BLOCK, fitsPackHeader(&out[0], cards, 35));
+    EXPECT_EQ(0, memcmp(&out[0], cards, 35 * FITS_CARD));
+    EXPECT_EQ("END" + std::string(FITS_CARD - 3, ' '), std::string(&out[35 * FITS_CARD], FITS_CARD));
+    EXPECT_EQ('x', out[FITS_BLOCK]);
+
+    ASSERT_EQ((size_t) 2 * FITS_BLOCK, fitsPackHeader(&out[0], cards, 36));
+    EXPECT_EQ(0, memcmp(&out[36 * FITS_CARD], "END ", 4));
+    for (int i = 36 * FITS_CARD + 3; i < 2 * FITS_BLOCK; i++)
+        ASSERT_EQ(' ', out[i]) << "header byte " << i;
+    EXPECT_EQ('x', out[2 * FITS_BLOCK]);
+}
+
+TEST(CORE_FITSPACK, Test_Unsupported)
+{
+    unsigned char in[4] = { 0 }, out[FITS_BLOCK];
+
+    ASSERT_EQ(0u, fitsPackData(out, in, 1, 12));
+    ASSERT_EQ(0u, fitsPackData(out, in, 1, 64));
+}
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fanout.h"
+#include "imagestats.h"
+
+// A frame of n unsigned bpp bit pixels, kept as 64 bit values for the reference and packed for imageStats()
+class Frame
+{
+  public:
+    Frame(int bpp) : bpp(bpp) {}
+
+    void add(uint64_t v)
+    {
+        values.push_back(v);
+        if (bpp == 8)
+            bytes.push_back((uint8_t) v);
+        else if (bpp == 16)
+        {
+            uint16_t p = (uint16_t) v;
+            bytes.insert(bytes.end(), (unsigned char *) &p, (unsigned char *) &p + 2);
+        }
+        else
+        {
+            uint32_t p = (uint32_t) v;
+            bytes.insert(bytes.end(), (unsigned char *) &p, (unsigned char *) &p + 4);
+        }
+    }
+
+    int bpp;
+    std::vector<uint64_t> values;
+    std::vector<unsigned char> bytes;
+};
+
+// Check imageStats() on f against statistics worked out one pixel at a time. A 32 bit median may be out by
+// (max-min)/65536, and its histogram is then exact only when that is below 1.
+static void check(const Frame &f, int nbins)
+{
+    size_t n = f.values.size();
+    std::vector<uint64_t> sorted(f.values);
+    std::vector<unsigned int> hist(nbins + 1, 0xdeadbeef), want(nbins, 0);
+    double s = 0, ss = 0, mean, median;
+    ImageStats st;
+
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < n; i++)
+        s += f.values[i];
+    mean = s / n;
+    for (size_t i = 0; i < n; i++)
+        ss += (f.values[i] - mean) * (f.values[i] - mean);
+    median = (sorted[(n - 1) / 2] + (double) sorted[n / 2]) / 2;
+
+    uint64_t min = sorted[0], max = sorted[n - 1];
+    for (size_t i = 0; i < n; i++)
+        want[(f.values[i] - min) * nbins / (max - min + 1)]++;
+
+    memset(&st, 0, sizeof(st));
+    st.hist = &hist[0];
+    st.nbins = nbins;
+    ASSERT_EQ(0, imageStats(&f.bytes[0], n, f.bpp, 1, &st));
+
+    EXPECT_EQ((double) min, st.min);
+    EXPECT_EQ((double) max, st.max);
+    EXPECT_NEAR(mean, st.mean, 1e-9 * (max + 1));
+    EXPECT_NEAR(sqrt(ss / n), st.stddev, 1e-6 * (max - min + 1));
+
+    bool exact = f.bpp < 32 || max - min < 65536;
+    EXPECT_NEAR(median, st.median, exact ? 0 : (max - min) / 65536.0 + 1) << "n " << n << " bpp " << f.bpp;
+
+    unsigned int total = 0;
+    for (int i = 0; i < nbins; i++)
+    {
+        if (exact)
+        {
+            EXPECT_EQ(want[i], hist[i]) << "bin " << i << " of " << nbins << ", bpp " << f.bpp;
+        }
+        total += hist[i];
+    }
+    EXPECT_EQ(n, total);
+    EXPECT_EQ(0xdeadbeef, hist[nbins]) << "wrote past the histogram";
+
+    double lo, hi;
+    ASSERT_EQ(0, imageMinMax(&f.bytes[0], n, f.bpp, &lo, &hi));
+    EXPECT_EQ((double) min, lo);
+    EXPECT_EQ((double) max, hi);
+}
+
+static Frame noise(int bpp, size_t n, uint64_t lo, uint64_t range)
+{
+    Frame f(bpp);
+    uint64_t seed = n * 131 + bpp;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        f.add(lo + (seed >> 16) % range);
+    }
+    return f;
+}
+
+TEST(CORE_IMAGESTATS, Test_EdgeCases)
+{
+    const int bpps[] = { 8, 16, 32 };
+
+    for (unsigned int b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++)
+    {
+        int bpp = bpps[b];
+        uint64_t top = bpp == 8 ? 0xff : bpp == 16 ? 0xffff : 0xffffffff;
+        Frame one(bpp), flat(bpp), ends(bpp), two(bpp);
+
+        // A single pixel, and a flat frame, all in the first bin
+        one.add(7);
+        check(one, 10);
+        for (int i = 0; i < 1000; i++)
+            flat.add(top);
+        check(flat, 10);
+
+        // Only the smallest and largest values, an even count so the median is between them
+        for (int i = 0; i < 50; i++)
+        {
+            ends.add(0);
+            ends.add(top);
+        }
+        check(ends, 1);
+        check(ends, 7);
+
+        // More bins than values
+        two.add(3);
+        two.add(4);
+        two.add(4);
+        check(two, 100);
+
+        check(noise(bpp, 12345, 0, top + 1), 64);
+        check(noise(bpp, 12346, top / 3, std::min<uint64_t>(1000, top - top / 3)), 1000);
+    }
+}
+
+TEST(CORE_IMAGESTATS, Test_Threads)
+{
+    // Large enough to be split across threads, in shares that do not divide evenly
+    fanOutSetThreads(4);
+    check(noise(8, (1 << 20) + 77, 0, 256), 256);
+    check(noise(16, (1 << 20) + 77, 100, 60000), 100);
+    check(noise(32, (1 << 20) + 77, 1 << 20, 50000), 100);
+    check(noise(32, (1 << 20) + 77, 0, 0x100000000ULL), 100);
+    fanOutSetThreads(0);
+}
+
+TEST(CORE_IMAGESTATS, Test_Unsupported)
+{
+    unsigned char buf[16] = { 0 };
+    ImageStats st;
+    double lo, hi;
+
+    memset(&st, 0, sizeof(st));
+    ASSERT_EQ(-1, imageStats(buf, 4, 12, 1, &st));
+    ASSERT_EQ(-1, imageStats(buf, 0, 8, 1, &st));
+    ASSERT_EQ(-1, imageMinMax(buf, 0, 16, &lo, &hi));
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+
+#include "indicom.h"
+
+// A raw pseudo terminal: the test writes to master, indicom reads from slave.
+class CORE_INDICOM : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        struct termios tio;
+
+        ASSERT_EQ(0, openpty(&master, &slave, NULL, NULL, NULL));
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+
+    virtual void TearDown()
+    {
+        close(master);
+        close(slave);
+    }
+
+    void send(const char *s)
+    {
+        ASSERT_EQ((ssize_t)strlen(s), write(master, s, strlen(s)));
+        // Let the line discipline pass the bytes to the slave side
+        usleep(10000);
+    }
+
+    int master, slave;
+};
+
+TEST_F(CORE_INDICOM, Test_tty_read_section_stops_at_stop_char)
+{
+    char buf[64];
+    int n = 0;
+
+    send("12:34:56#+45*00#AB");
+
+    ASSERT_EQ(TTY_OK, tty_read_section(slave, buf, '#', 1, &n));
+    ASSERT_EQ(9, n);
+    ASSERT_EQ(0, memcmp(buf, "12:34:56#", 9));
+
+    // Nothing past the stop char was taken off the line
+    ASSERT_EQ(TTY_OK, tty_read(slave, buf, 7, 1, &n));
+    ASSERT_EQ(7, n);
+    ASSERT_EQ(0, memcmp(buf, "+45*00#", 7));
+
+    ASSERT_EQ(TTY_OK, tty_read(slave, buf, 2, 1, &n));
+    ASSERT_EQ(0, memcmp(buf, "AB", 2));
+}
+
+TEST_F(CORE_INDICOM, Test_tty_read_section_leaves_rest_to_tcflush)
+{
+    char buf[64];
+    int n = 0;
+
+    send("first#stale#");
+
+    ASSERT_EQ(TTY_OK, tty_read_section(slave, buf, '#', 1, &n));
+    ASSERT_EQ(6, n);
+
+    // A driver that flushes before its next command must not see "stale#" again
+    tcflush(slave, TCIFLUSH);
+    ASSERT_EQ(TTY_TIME_OUT, tty_read_section(slave, buf, '#', 1, &n));
+}
+
+TEST_F(CORE_INDICOM, Test_tty_nread_section_overflow)
+{
+    char buf[4];
+    int n = 0;
+
+    send("ABCDEF#");
+
+    ASSERT_EQ(TTY_OVERFLOW, tty_nread_section(slave, buf, sizeof(buf), '#', 1, &n));
+    ASSERT_EQ(4, n);
+    ASSERT_EQ(0, memcmp(buf, "ABCD", 4));
+
+    ASSERT_EQ(TTY_OK, tty_nread_section(slave, buf, sizeof(buf), '#', 1, &n));
+    ASSERT_EQ(3, n);
+    ASSERT_EQ(0, memcmp(buf, "EF#", 3));
+}
+
+TEST_F(CORE_INDICOM, Test_tty_reader)
+{
+    char buf[64];
+    int n = 0;
+    TTYReader *tr = tty_reader_new(slave);
+
+    ASSERT_TRUE(tr != NULL);
+
+    send("one#two#thr");
+
+    ASSERT_EQ(TTY_OK, tty_reader_section(tr, buf, sizeof(buf), '#', 1, &n));
+    ASSERT_EQ(4, n);
+    ASSERT_EQ(0, memcmp(buf, "one#", 4));
+
+    ASSERT_EQ(TTY_OK, tty_reader_section(tr, buf, sizeof(buf), '#', 1, &n));
+    ASSERT_EQ(4, n);
+    ASSERT_EQ(0, memcmp(buf, "two#", 4));
+
+    // A frame split across reads is joined
+    send("ee#");
+    ASSERT_EQ(TTY_OK, tty_reader_section(tr, buf, sizeof(buf), '#', 1, &n));
+    ASSERT_EQ(6, n);
+    ASSERT_EQ(0, memcmp(buf, "three#", 6));
+
+    // Flushing drops both the read-ahead and the kernel queue
+    send("old#");
+    ASSERT_EQ(TTY_OK, tty_reader_read(tr, buf, 1, 1, &n));
+    ASSERT_EQ(TTY_OK, tty_reader_flush(tr));
+    ASSERT_EQ(TTY_TIME_OUT, tty_reader_section(tr, buf, sizeof(buf), '#', 1, &n));
+
+    tty_reader_free(tr);
+}
@@ -0,0 +1,312 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "indidevapi.h"
+#include "indidriver.h"
+
+#include "indidriver_shim.h"
+
+#define MAXRBUF 2048
+
+// Runs each test with the driver's stdout going into a pipe the test reads
+class CORE_INDIDRIVER : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        int p[2];
+
+        ASSERT_EQ(0, pipe(p));
+        fcntl(p[0], F_SETFL, O_NONBLOCK);
+        fflush(stdout);
+        savedStdout = dup(1);
+        dup2(p[1], 1);
+        close(p[1]);
+        out = p[0];
+    }
+
+    virtual void TearDown()
+    {
+        fflush(stdout);
+        dup2(savedStdout, 1);
+        close(savedStdout);
+        close(out);
+    }
+
+    // Return what the driver has sent since the last call
+    std::string sent()
+    {
+        std::string s;
+        char buf[4096];
+        ssize_t n;
+
+        fflush(stdout);
+        while ((n = read(out, buf, sizeof(buf))) > 0)
+            s.append(buf, n);
+        return s;
+    }
+
+    // Return how many times tag is in s
+    static int count(const std::string &s, const char *tag)
+    {
+        int n = 0;
+        for (size_t i = s.find(tag); i != std::string::npos; i = s.find(tag, i + 1))
+            n++;
+        return n;
+    }
+
+    int savedStdout, out;
+};
+
+TEST_F(CORE_INDIDRIVER, Test_PublishPolicy)
+{
+    INumber n;
+    INumberVectorProperty nvp;
+    std::string s;
+
+    IUFillNumber(&n, "RA", "RA", "%g", 0, 24, 0, 1);
+    IUFillNumberVector(&nvp, &n, 1, "Mount", "EQ", "EQ", "Main", IP_RO, 0, IPS_OK);
+    IDSetPublishPolicy(&nvp, 1, 0.2, 0.5);
+
+    // The first goes at once, repeats and changes within the deadband not at all
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+    IDSetNumber(&nvp, NULL);
+    n.value = 1.3;
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(0, count(sent(), "<setNumberVector"));
+
+    // A change sooner than minInterval is held, and only the latest goes when it is up
+    n.value = 2;
+    IDSetNumber(&nvp, NULL);
+    n.value = 3;
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(0, count(sent(), "<setNumberVector"));
+    usleep(400000);
+    s = sent();
+    ASSERT_EQ(1, count(s, "<setNumberVector"));
+    ASSERT_NE(std::string::npos, s.find(">\n      3\n"));
+
+    // New states and messages go at once
+    n.value = 4;
+    nvp.s = IPS_BUSY;
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+    IDSetNumber(&nvp, "Slewing");
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+
+    IDSetPublishPolicy(&nvp, 0, 0, 0);
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+}
+
+TEST_F(CORE_INDIDRIVER, Test_PublishPolicyFollowsName)
+{
+    INumber n;
+    INumberVectorProperty nvp;
+
+    IUFillNumber(&n, "RA", "RA", "%g", 0, 24, 0, 1);
+    IUFillNumberVector(&nvp, &n, 1, "Mount", "EQ", "EQ", "Main", IP_RO, 0, IPS_OK);
+    IDSetPublishPolicy(&nvp, 1, 0, 0);
+
+    IDSetNumber(&nvp, NULL);
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+
+    // Deleted, and its memory reused by another property: that has no policy
+    IDDelete("Mount", "EQ", NULL);
+    IUFillNumberVector(&nvp, &n, 1, "Mount", "ALTAZ", "ALTAZ", "Main", IP_RO, 0, IPS_OK);
+    IDSetNumber(&nvp, NULL);
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(2, count(sent(), "<setNumberVector"));
+
+    // Defined again under its name, it has its policy still
+    IUFillNumberVector(&nvp, &n, 1, "Mount", "EQ", "EQ", "Main", IP_RO, 0, IPS_OK);
+    IDDefNumber(&nvp, NULL);
+    IDSetNumber(&nvp, NULL);
+    IDSetNumber(&nvp, NULL);
+    ASSERT_EQ(1, count(sent(), "<setNumberVector"));
+
+    IDSetPublishPolicy(&nvp, 0, 0, 0);
+}
+
+static volatile int blobSet, numberSet;
+
+static void *setBLOB(void *p)
+{
+    IDSetBLOB((IBLOBVectorProperty *)p, NULL);
+    blobSet = 1;
+    return p;
+}
+
+static void *setNumber(void *p)
+{
+    IDSetNumber((INumberVectorProperty *)p, NULL);
+    numberSet = 1;
+    return p;
+}
+
+TEST_F(CORE_INDIDRIVER, Test_BLOBDoesNotBlock)
+{
+    const int size = 1024 * 1024;
+    IBLOB b[2];
+    IBLOBVectorProperty bvp;
+    INumber n;
+    INumberVectorProperty nvp;
+    pthread_t bt, nt;
+    std::string s;
+    int i;
+
+    IUFillBLOB(&b[0], "CCD1", "Image", ".fits");
+    IUFillBLOB(&b[1], "CCD2", "Image", ".fits");
+    for (i = 0; i < 2; i++)
+    {
+        b[i].blob = calloc(1, size);
+        b[i].bloblen = b[i].size = size;
+    }
+    IUFillBLOBVector(&bvp, b, 2, "CCD", "CCD1", "Image", "Main", IP_RO, 0, IPS_OK);
+    IUFillNumber(&n, "TEMP", "Temperature", "%g", -50, 50, 0, -10);
+    IUFillNumberVector(&nvp, &n, 1, "CCD", "TEMPERATURE", "Temperature", "Main", IP_RO, 0, IPS_OK);
+
+    // Start a BLOB far bigger than the pipe, and leave it stuck in its first part
+    blobSet = 0;
+    ASSERT_EQ(0, pthread_create(&bt, NULL, setBLOB, &bvp));
+    while (s.find("<oneBLOB") == std::string::npos)
+        s += sent();
+    usleep(100000);
+
+    // A number sent meanwhile is neither held up by it nor lost
+    numberSet = 0;
+    ASSERT_EQ(0, pthread_create(&nt, NULL, setNumber, &nvp));
+    for (i = 0; i < 200 && !numberSet; i++)
+        usleep(10000);
+
+    // Let both finish before checking, as a failure says so on stdout
+    while (!blobSet || !numberSet)
+        s += sent();
+    pthread_join(bt, NULL);
+    pthread_join(nt, NULL);
+    s += sent();
+    EXPECT_LT(i, 200);
+
+    // It goes between the two BLOBs, each in a setBLOBVector of its own
+    size_t first = s.find("</setBLOBVector>");
+    size_t number = s.find("<setNumberVector");
+    ASSERT_NE(std::string::npos, number);
+    EXPECT_LT(first, number);
+    EXPECT_LT(number, s.find("<setBLOBVector", first));
+    EXPECT_EQ(2, count(s, "<setBLOBVector"));
+    EXPECT_EQ(2, count(s, "</oneBLOB>"));
+    EXPECT_EQ(1, count(s, "</setNumberVector>"));
+
+    free(b[0].blob);
+    free(b[1].blob);
+}
+
+// A config file holding value for Focuser.POSITION
+static std::string config(int value)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "<INDIDriver>\n<newNumberVector device='Focuser' name='POSITION'>\n"
+             "  <oneNumber name='STEPS'>\n      %d\n  </oneNumber>\n</newNumberVector>\n</INDIDriver>\n", value);
+    return buf;
+}
+
+// Return the value loading path gives Focuser.POSITION, or -1
+static double load(const char *path)
+{
+    char errmsg[MAXRBUF];
+
+    shimNewNumbers = 0;
+    if (IUReadConfig(path, "Focuser", "POSITION", 1, errmsg) < 0 || shimNewNumbers != 1)
+        return -1;
+    return shimValues[0];
+}
+
+TEST_F(CORE_INDIDRIVER, Test_ConfigCache)
+{
+    char dir[] = "/tmp/test_indidriverXXXXXX";
+    char errmsg[MAXRBUF];
+    std::string path, data;
+    struct stat st;
+    INumber n;
+    INumberVectorProperty nvp;
+    FILE *fp;
+
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    setenv("HOME", dir, 1);
+    path = std::string(dir) + "/Focuser_config.xml";
+
+    IUFillNumber(&n, "STEPS", "Steps", "%g", 0, 100000, 1, 0);
+    IUFillNumberVector(&nvp, &n, 1, "Focuser", "POSITION", "Position", "Main", IP_RW, 0, IPS_IDLE);
+    IDDefNumber(&nvp, NULL);
+
+    data = config(1000);
+    ASSERT_EQ(0, IUWriteConfig(path.c_str(), "Focuser", data.c_str(), data.size(), errmsg));
+    ASSERT_EQ(1000, load(path.c_str()));
+    ASSERT_EQ(1000, load(path.c_str()));
+
+    // Rewritten in place by someone else, same size and likely the same second
+    data = config(2000);
+    fp = fopen(path.c_str(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    ASSERT_EQ(2000, load(path.c_str()));
+
+    // Saved through a symlink, the file it points to is replaced, keeping its mode
+    std::string link = std::string(dir) + "/link.xml";
+    ASSERT_EQ(0, chmod(path.c_str(), 0600));
+    ASSERT_EQ(0, symlink(path.c_str(), link.c_str()));
+    data = config(3000);
+    ASSERT_EQ(0, IUWriteConfig(link.c_str(), "Focuser", data.c_str(), data.size(), errmsg));
+    ASSERT_EQ(0, lstat(link.c_str(), &st));
+    ASSERT_TRUE(S_ISLNK(st.st_mode));
+    ASSERT_EQ(0, stat(path.c_str(), &st));
+    ASSERT_EQ(0600, (int)(st.st_mode & 07777));
+    ASSERT_EQ(3000, load(path.c_str()));
+    ASSERT_EQ(3000, load(link.c_str()));
+
+    // A save that can not be written says so
+    std::string bad = std::string(dir) + "/nodir/Focuser_config.xml";
+    errmsg[0] = '\0';
+    ASSERT_EQ(-1, IUWriteConfig(bad.c_str(), "Focuser", data.c_str(), data.size(), errmsg));
+    ASSERT_NE(0, (int)strlen(errmsg));
+    ASSERT_EQ(-1, load(bad.c_str()));
+
+    unlink(link.c_str());
+    unlink(path.c_str());
+    rmdir((std::string(dir) + "/.indi").c_str());
+    rmdir(dir);
+}
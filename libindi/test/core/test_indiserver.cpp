@@ -0,0 +1,135 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "indiserver_shim.h"
+
+static const char *number(const char *state, int v, const char *extra = "")
+{
+	static char buf[512];
+	snprintf(buf, sizeof(buf), "<setNumberVector device='Mount' name='EQ' state='%s'%s>"
+		"<oneNumber name='RA'>%d</oneNumber><oneNumber name='DEC'>%d</oneNumber></setNumberVector>", state, extra, v, v);
+	return buf;
+}
+
+/* return the contents left on q joined by '|' */
+static std::string contents(FQ *q)
+{
+	std::string s;
+	for (int i = 0; i < nFQ(q); i++)
+	{
+		const char *c = shimMsgContent(peekiFQ(q, i));
+		const char *v = strstr(c, "RA\">");
+		s += v ? std::string(v + 4, strcspn(v + 4, "<")) : std::string("?");
+		s += strstr(c, "message=") ? "m" : "";
+		s += "|";
+	}
+	return s;
+}
+
+static std::string strip(const std::string &in)
+{
+	std::string s;
+	for (size_t i = 0; i < in.size(); i++)
+		if (!isspace((unsigned char)in[i]))
+			s += in[i];
+	return s;
+}
+
+TEST(CORE_INDISERVER, Test_CompactDropsRepeats)
+{
+	FQ *q = newFQ(1);
+
+	for (int v = 1; v <= 4; v++)
+		pushFQ(q, shimXMLMsg(number("Ok", v)));
+
+	ASSERT_EQ(3, shimCompact(q, 0));
+	ASSERT_EQ("4|", strip(contents(q)));
+
+	shimFreeQ(q);
+}
+
+TEST(CORE_INDISERVER, Test_CompactKeepsStateAndMessages)
+{
+	FQ *q = newFQ(1);
+
+	pushFQ(q, shimXMLMsg(number("Busy", 1)));
+	pushFQ(q, shimXMLMsg(number("Busy", 2)));
+	pushFQ(q, shimXMLMsg(number("Ok", 3)));
+	pushFQ(q, shimXMLMsg(number("Ok", 4, " message='Slew complete'")));
+	pushFQ(q, shimXMLMsg(number("Ok", 5)));
+	pushFQ(q, shimXMLMsg("<setNumberVector device='Mount' name='EQ' state='Ok'><oneNumber name='RA'>6</oneNumber></setNumberVector>"));
+	pushFQ(q, shimXMLMsg(number("Ok", 7)));
+	pushFQ(q, shimXMLMsg("<setNumberVector device='Other' name='EQ' state='Ok'><oneNumber name='RA'>8</oneNumber></setNumberVector>"));
+	pushFQ(q, shimXMLMsg(number("Ok", 9)));
+
+	/* only Busy 1 repeats Busy 2, and 7 repeats 9 */
+	ASSERT_EQ(2, shimCompact(q, 0));
+	ASSERT_EQ("2|3|4m|5|6|8|9|", strip(contents(q)));
+
+	shimFreeQ(q);
+}
+
+TEST(CORE_INDISERVER, Test_CompactKeepsPartlySent)
+{
+	FQ *q = newFQ(1);
+
+	pushFQ(q, shimXMLMsg(number("Ok", 1)));
+	pushFQ(q, shimXMLMsg(number("Ok", 2)));
+	pushFQ(q, shimXMLMsg(number("Ok", 3)));
+
+	ASSERT_EQ(1, shimCompact(q, 10));
+	ASSERT_EQ("1|3|", strip(contents(q)));
+
+	shimFreeQ(q);
+}
+
+TEST(CORE_INDISERVER, Test_CompactLargeQueue)
+{
+	FQ *q = newFQ(1);
+
+	for (int v = 0; v < 20000; v++)
+		pushFQ(q, shimXMLMsg(number(v % 1000 == 999 ? "Alert" : "Ok", v)));
+
+	/* each run of Ok ends in one kept, as does each Alert */
+	ASSERT_EQ(20000 - 40, shimCompact(q, 0));
+	ASSERT_EQ(40, nFQ(q));
+
+	shimFreeQ(q);
+}
+
+TEST(CORE_INDISERVER, Test_BLOBCloseTag)
+{
+	const char *body = "<oneBLOB name='CCD1' size='3' format='.fits' len='4'>QUJD</oneBLOB>";
+	std::string s;
+
+	s = std::string(body) + "</setBLOBVector>";
+	ASSERT_EQ((int)s.size(), shimCloseTagEnd("setBLOBVector", s.c_str()));
+
+	/* white space may come before the '>' */
+	s = std::string(body) + "</setBLOBVector \n\t>";
+	ASSERT_EQ((int)s.size(), shimCloseTagEnd("setBLOBVector", s.c_str()));
+
+	/* a longer name or a stray '<' does not end it, nor throw the match off */
+	ASSERT_EQ(-1, shimCloseTagEnd("setBLOBVector", "</setBLOBVectors>"));
+	ASSERT_EQ(-1, shimCloseTagEnd("setBLOBVector", "</setBLOB Vector>"));
+	ASSERT_EQ(18, shimCloseTagEnd("setBLOBVector", "<</setBLOBVector >"));
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "lilxml.h"
+
+static const char *doc =
+    "<setNumberVector device='Mount' name='EQ' state='Ok' timestamp='2016-05-03T12:34:56'>\n"
+    "  <oneNumber name='RA'>\n      12.5\n  </oneNumber>\n"
+    "  <oneNumber name='DEC'>\n      -45.25\n  </oneNumber>\n"
+    "</setNumberVector>\n"
+    "<message device='Mount' message='a &amp; b'/>\n";
+
+// Parse the elements of doc, in an arena or not, and return them printed
+static std::string parse(int arena, std::vector<XMLEle *> *keep = NULL)
+{
+    LilXML *lp = newLilXML();
+    char errmsg[1024];
+    std::string out;
+
+    arenaLilXML(lp, arena);
+    for (const char *p = doc; *p; p++)
+    {
+        XMLEle *root = readXMLEle(lp, *p, errmsg);
+        if (!root)
+            continue;
+        std::vector<char> buf(sprlXMLEle(root, 0) + 1);
+        buf.resize(sprXMLEle(&buf[0], root, 0));
+        out.append(buf.begin(), buf.end());
+        if (keep)
+            keep->push_back(root);
+        else
+            delXMLEle(root);
+    }
+    delLilXML(lp);
+    return out;
+}
+
+TEST(CORE_LILXML, Test_ArenaSameTree)
+{
+    std::string plain = parse(0);
+
+    ASSERT_NE(std::string::npos, plain.find("RA"));
+    ASSERT_NE(std::string::npos, plain.find("a &amp; b"));
+    ASSERT_EQ(plain, parse(1));
+}
+
+TEST(CORE_LILXML, Test_ArenaOutlivesParser)
+{
+    std::vector<XMLEle *> roots;
+
+    // Documents stay whole after the parser is gone, until their root is deleted
+    parse(1, &roots);
+    ASSERT_EQ(2u, roots.size());
+    ASSERT_STREQ("Mount", findXMLAttValu(roots[0], "device"));
+    ASSERT_EQ(2, nXMLEle(roots[0]));
+    ASSERT_STREQ("a & b", findXMLAttValu(roots[1], "message"));
+
+    // Deleting a child only unlinks it
+    XMLEle *ra = nextXMLEle(roots[0], 1);
+    ASSERT_STREQ("RA", findXMLAttValu(ra, "name"));
+    delXMLEle(ra);
+    ASSERT_EQ(1, nXMLEle(roots[0]));
+    ASSERT_STREQ("DEC", findXMLAttValu(nextXMLEle(roots[0], 1), "name"));
+
+    // Edits after parsing still work on arena trees
+    editXMLEle(nextXMLEle(roots[0], 1), "10");
+    ASSERT_STREQ("10", pcdataXMLEle(nextXMLEle(roots[0], 1)));
+    addXMLAtt(roots[1], "extra", "yes");
+    ASSERT_STREQ("yes", findXMLAttValu(roots[1], "extra"));
+
+    for (size_t i = 0; i < roots.size(); i++)
+        delXMLEle(roots[i]);
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outbuf.h"
+
+// Return v as outBufDouble() writes it
+static std::string shortest(double v)
+{
+    OutBuf *ob = outBufGet();
+    outBufDouble(ob, v);
+    return std::string(ob->buf, ob->len);
+}
+
+// Return the significant digits in the number s
+static int digits(const std::string &s)
+{
+    std::string m = s.substr(0, s.find_first_of("eE"));
+    size_t first = m.find_first_of("123456789");
+    size_t last = m.find_last_of("123456789");
+    int n = 0;
+
+    if (first == std::string::npos)
+        return 1;
+    for (size_t i = first; i <= last; i++)
+        n += m[i] != '.';
+    return n;
+}
+
+// Check s reads back as v, in no more digits than the shortest %.Ng that does,
+// or than %.15g where outBufDouble() falls back to printf
+static void checkRoundTrip(double v)
+{
+    std::string s = shortest(v);
+    char g[32];
+    int prec;
+
+    ASSERT_EQ(std::string::npos, s.find(',')) << s;
+    ASSERT_EQ(v, strtod(s.c_str(), NULL)) << s;
+    if (v == 0)
+    {
+        ASSERT_EQ(signbit(v) != 0, signbit(strtod(s.c_str(), NULL)) != 0) << s;
+    }
+
+    for (prec = 1; prec < 17; prec++)
+    {
+        snprintf(g, sizeof(g), "%.*g", prec, v);
+        if (strtod(g, NULL) == v)
+            break;
+    }
+    snprintf(g, sizeof(g), "%.*g", prec, v);
+    ASSERT_LE(digits(s), prec < 15 && (fabs(v) < 1e-5 || fabs(v) >= 1e15) ? 15 : prec) << s << " vs " << g;
+}
+
+TEST(CORE_OUTBUF, Test_outBufDouble_exact)
+{
+    ASSERT_EQ("0", shortest(0));
+    ASSERT_EQ("-3", shortest(-3));
+    ASSERT_EQ("0.1", shortest(0.1));
+    ASSERT_EQ("-12.5", shortest(-12.5));
+    ASSERT_EQ("123456789012345", shortest(123456789012345.0));
+}
+
+TEST(CORE_OUTBUF, Test_outBufDouble_round_trip)
+{
+    static const double edge[] =
+    {
+        -0.0, 1e-5, 9.999999999999999e-6, 1e15, 999999999999999.9, 0.3, 2.0/3, M_PI, -M_E,
+        1.7976931348623157e308, 2.2250738585072014e-308, 4.9e-324, 5e-324, 123.456, 1.0000000000000002
+    };
+    uint64_t x = 88172645463325252ULL;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(edge)/sizeof(edge[0])); i++)
+        checkRoundTrip(edge[i]);
+
+    // Random bit patterns cover every exponent, random decimals the common values
+    for (i = 0; i < 50000; i++)
+    {
+        double v;
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(&v, &x, sizeof(v));
+        if (isfinite(v))
+            checkRoundTrip(v);
+        checkRoundTrip((double)(int64_t)(x % 2000000001ULL - 1000000000) / 1000.0);
+        checkRoundTrip((double)(x >> 11) * (1.0 / 9007199254740992.0) * 360.0);
+    }
+}
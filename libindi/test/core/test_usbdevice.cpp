@@ -0,0 +1,112 @@
+/*******************************************************************************
+ Copyright (C) 2026 INDI developers
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "indiusbdevice.h"
+
+#include "libusb_shim.h"
+
+#define CHUNK   4096
+
+class TestDevice : public INDI::USBDevice
+{
+  public:
+    TestDevice()
+    {
+        usb_handle = (libusb_device_handle *)this;
+        InputEndpoint = 0x82;
+    }
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Check the n bytes at buf are what the device sent from pos on
+static bool sentFrom(const unsigned char *buf, long n, long pos)
+{
+    for (long i = 0; i < n; i++)
+        if (buf[i] != shimUsbByte(pos + i))
+            return false;
+    return true;
+}
+
+TEST(CORE_USBDEVICE, Test_ReadBulkAsync)
+{
+    TestDevice dev;
+    std::vector<unsigned char> buf(64 * CHUNK);
+    long pos = shimUsbPos;
+
+    shimUsbAvailable = buf.size();
+    ASSERT_EQ((int)buf.size(), dev.ReadBulkAsync(&buf[0], buf.size(), CHUNK, 4, 1000));
+    ASSERT_TRUE(sentFrom(&buf[0], buf.size(), pos));
+    ASSERT_EQ(0, shimUsbAvailable);
+}
+
+TEST(CORE_USBDEVICE, Test_ReadBulkAsync_short)
+{
+    TestDevice dev;
+    std::vector<unsigned char> buf(16 * CHUNK);
+    long pos = shimUsbPos;
+    int cancels = shimUsbCancels;
+    double t0 = now();
+
+    // The device ends the frame in the middle of the fifth transfer, with more in flight after it
+    shimUsbAvailable = 4 * CHUNK + 100;
+    ASSERT_EQ(4 * CHUNK + 100, dev.ReadBulkAsync(&buf[0], buf.size(), CHUNK, 4, 2000));
+    ASSERT_TRUE(sentFrom(&buf[0], 4 * CHUNK + 100, pos));
+
+    // Those were cancelled rather than left to time out
+    ASSERT_LT(now() - t0, 1.0);
+    ASSERT_EQ(3, shimUsbCancels - cancels);
+}
+
+TEST(CORE_USBDEVICE, Test_ReadBulkAsync_timeout)
+{
+    TestDevice dev;
+    std::vector<unsigned char> buf(8 * CHUNK);
+
+    shimUsbAvailable = 2 * CHUNK;
+    ASSERT_EQ(LIBUSB_ERROR_TIMEOUT, dev.ReadBulkAsync(&buf[0], buf.size(), CHUNK, 4, 100));
+}
+
+TEST(CORE_USBDEVICE, Test_AbortReadBulk)
+{
+    TestDevice dev;
+    std::vector<unsigned char> buf(8 * CHUNK);
+
+    // An abort before the read cancels that read, and only that one
+    dev.AbortReadBulk();
+    shimUsbAvailable = buf.size();
+    ASSERT_EQ(LIBUSB_ERROR_INTERRUPTED, dev.ReadBulkAsync(&buf[0], buf.size(), CHUNK, 4, 1000));
+    ASSERT_EQ((int)buf.size(), dev.ReadBulkAsync(&buf[0], buf.size(), CHUNK, 4, 1000));
+}
@@ -0,0 +1,220 @@
+/* measure base64 encode and decode throughput of each kernel this CPU runs.
+ */
+
+/* Overall design:
+ * fill -s MB with random bytes and encode them once with lines of 72 chars,
+ *   as IDSetBLOB() sends them.
+ * for each kernel, time to64frombits() of the bytes and from64tobits_fast()
+ *   of the lines, then the same through the streaming API in -c byte
+ *   chunks, and check each result against the first.
+ * report MB/s of raw bytes for each, best of -r runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "base64.h"
+
+#define	DEFMB       16		/* default MB of raw bytes */
+#define	DEFCHUNK    65536	/* default bytes per streaming update */
+#define	DEFRUNS     5		/* default runs to take the best of */
+#define	LINELEN     72		/* chars per line, as IDSetBLOB() */
+
+static const char *kernels[] = {"lut", "ssse3", "avx2", "neon"};
+#define	NKERNELS	((int)(sizeof(kernels)/sizeof(kernels[0])))
+
+static char *me;			/* our name */
+static int mb = DEFMB;
+static int chunk = DEFCHUNK;
+static int runs = DEFRUNS;
+
+static unsigned char *raw;		/* random bytes */
+static int nraw;			/* bytes in raw */
+static unsigned char *lines;		/* raw in base64, in lines */
+static int nlines;			/* chars in lines */
+static unsigned char *enc;		/* encoding scratch */
+static char *dec;			/* decoding scratch */
+
+static void usage (void);
+static double timeEncode (void);
+static double timeDecode (void);
+static double timeStreamEncode (void);
+static double timeStreamDecode (void);
+static void check (const char *what, int ok);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+    base64_stream st;
+    int i;
+
+    me = av[0];
+
+    /* crack args */
+    while ((--ac > 0) && ((*++av)[0] == '-')) {
+        char *s;
+        for (s = av[0]+1; *s != '\0'; s++)
+            switch (*s) {
+            case 'c': if (ac < 2) usage(); chunk = atoi(*++av); ac--; break;
+            case 'r': if (ac < 2) usage(); runs = atoi(*++av); ac--; break;
+            case 's': if (ac < 2) usage(); mb = atoi(*++av); ac--; break;
+            default: usage();
+            }
+    }
+    if (ac > 0 || chunk < 1 || mb < 1 || runs < 1)
+        usage();
+
+    nraw = mb*1000000;
+    raw = (unsigned char *) malloc (nraw);
+    for (i = 0; i < nraw; i++)
+        raw[i] = (unsigned char) rand();
+    enc = (unsigned char *) malloc (4*nraw/3 + 4*nraw/3/LINELEN + chunk + 16);
+    dec = (char *) malloc (nraw + chunk + 16);
+
+    /* reference lines with the portable kernel */
+    base64SetKernel ("lut");
+    lines = (unsigned char *) malloc (4*nraw/3 + 4*nraw/3/LINELEN + 16);
+    to64init (&st, LINELEN);
+    nlines = to64update (&st, lines, raw, nraw);
+    nlines += to64finish (&st, lines + nlines);
+
+    printf ("%d MB, %d byte chunks, MB/s of raw bytes\n", mb, chunk);
+    printf ("%-8s %10s %10s %12s %12s\n", "kernel", "encode", "decode",
+                                        "stream enc", "stream dec");
+    for (i = 0; i < NKERNELS; i++) {
+        if (base64SetKernel (kernels[i]) < 0)
+            continue;
+        printf ("%-8s %10.1f %10.1f %12.1f %12.1f\n", kernels[i],
+                nraw/timeEncode()/1e6, nraw/timeDecode()/1e6,
+                nraw/timeStreamEncode()/1e6, nraw/timeStreamDecode()/1e6);
+        fflush (stdout);
+    }
+
+    return (0);
+}
+
+static void
+usage (void)
+{
+    fprintf (stderr, "Usage: %s [options]\n", me);
+    fprintf (stderr, "Purpose: measure base64 throughput of each kernel\n");
+    fprintf (stderr, "Options:\n");
+    fprintf (stderr, " -c c : bytes per streaming update, default %d\n", DEFCHUNK);
+    fprintf (stderr, " -r r : runs to take the best of, default %d\n", DEFRUNS);
+    fprintf (stderr, " -s s : MB of raw bytes, default %d\n", DEFMB);
+
+    exit (2);
+}
+
+/* return best seconds to encode raw in one call */
+static double
+timeEncode (void)
+{
+    double best = 1e9;
+    int r, n = 0;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        n = to64frombits (enc, raw, nraw);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+    }
+    check ("encode", n == 4*((nraw+2)/3) && enc[n/2] == lines[n/2 + n/2/LINELEN]);
+
+    return (best);
+}
+
+/* return best seconds to decode lines in one call */
+static double
+timeDecode (void)
+{
+    double best = 1e9;
+    int r, n = 0;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        n = from64tobits_fast (dec, (char *)lines, nlines);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+    }
+    check ("decode", n == nraw && memcmp (dec, raw, nraw) == 0);
+
+    return (best);
+}
+
+/* return best seconds to encode raw into lines a chunk at a time */
+static double
+timeStreamEncode (void)
+{
+    double best = 1e9;
+    int r, n = 0;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        base64_stream st;
+        int i;
+
+        to64init (&st, LINELEN);
+        for (i = n = 0; i < nraw; i += chunk)
+            n += to64update (&st, enc + n, raw + i,
+                                        nraw - i < chunk ? nraw - i : chunk);
+        n += to64finish (&st, enc + n);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+    }
+    check ("stream encode", n == nlines && memcmp (enc, lines, n) == 0);
+
+    return (best);
+}
+
+/* return best seconds to decode lines a chunk at a time */
+static double
+timeStreamDecode (void)
+{
+    double best = 1e9;
+    int r, n = 0;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        base64_stream st;
+        int i;
+
+        from64init (&st);
+        for (i = n = 0; i < nlines; i += chunk)
+            n += from64update (&st, dec + n, (char *)lines + i,
+                                    nlines - i < chunk ? nlines - i : chunk);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+        check ("stream decode end", from64finish (&st) == 0);
+    }
+    check ("stream decode", n == nraw && memcmp (dec, raw, nraw) == 0);
+
+    return (best);
+}
+
+/* complain and exit if !ok */
+static void
+check (const char *what, int ok)
+{
+    if (!ok) {
+        fprintf (stderr, "%s: %s gave wrong results\n", me, what);
+        exit (1);
+    }
+}
+
+/* return wall clock seconds */
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,268 @@
+/* measure software binning throughput of binImage() against the loop
+ * CCDChip::binFrame() used before it.
+ */
+
+/* Overall design:
+ * fill a frame of about -s megapixels with random pixels, its sides a
+ *   multiple of 12 so every factor tried bins it whole.
+ * for 8 and 16 bit pixels and square factors 2, 3 and 4, time the legacy
+ *   loop and binImage() in BIN_AUTO mode on -t threads and check their
+ *   results are identical.
+ * then time binImage() alone for 32 bit pixels, uneven factors and
+ *   BIN_AVERAGE, checking a few bins against a plain sum.
+ * report megapixels of input per second for each, best of -r runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "binning.h"
+#include "fanout.h"
+
+#define	DEFMP       60		/* default megapixels */
+#define	DEFRUNS     3		/* default runs to take the best of */
+#define	WIDTH       9600	/* frame width, a multiple of 12 */
+
+static char *me;			/* our name */
+static int mp = DEFMP;
+static int runs = DEFRUNS;
+static int threads;			/* 0 for one per CPU */
+
+static int w, h;			/* frame size */
+static unsigned char *frame;		/* random pixels, up to 32 bits */
+static unsigned char *out1, *out2;	/* binned frames */
+
+static void usage (void);
+static void legacyBin (const uint8_t *in, uint8_t *out, int bpp, int bin);
+static double timeLegacy (int bpp, int bin);
+static double timeBin (int bpp, int bx, int by, int mode, unsigned char *out);
+static void checkSome (int bpp, int bx, int by, int mode);
+static void check (const char *what, int ok);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+    size_t i, n;
+    int bpp, bin;
+
+    me = av[0];
+
+    /* crack args */
+    while ((--ac > 0) && ((*++av)[0] == '-')) {
+        char *s;
+        for (s = av[0]+1; *s != '\0'; s++)
+            switch (*s) {
+            case 'r': if (ac < 2) usage(); runs = atoi(*++av); ac--; break;
+            case 's': if (ac < 2) usage(); mp = atoi(*++av); ac--; break;
+            case 't': if (ac < 2) usage(); threads = atoi(*++av); ac--; break;
+            default: usage();
+            }
+    }
+    if (ac > 0 || mp < 1 || runs < 1 || threads < 0)
+        usage();
+
+    w = WIDTH;
+    h = (int)((double)mp*1e6/w/12 + 0.5)*12;
+    if (h < 12)
+        h = 12;
+    n = (size_t)w*h*4;
+    frame = (unsigned char *) malloc (n);
+    out1 = (unsigned char *) malloc (n);
+    out2 = (unsigned char *) malloc (n);
+    if (!frame || !out1 || !out2) {
+        fprintf (stderr, "%s: no memory for %d x %d frames\n", me, w, h);
+        exit (1);
+    }
+    for (i = 0; i < n; i++)
+        frame[i] = (unsigned char) rand();
+    fanOutSetThreads (threads);
+
+    printf ("%d x %d frame, %d threads, Mpixels/s of input\n", w, h, threads);
+    printf ("%-4s %-6s %10s %10s %8s\n", "bpp", "bin", "legacy", "binImage", "speedup");
+    for (bpp = 8; bpp <= 16; bpp += 8)
+        for (bin = 2; bin <= 4; bin++) {
+            double tl = timeLegacy (bpp, bin);
+            double tb = timeBin (bpp, bin, bin, BIN_AUTO, out2);
+            size_t nout = (size_t)(w/bin)*(h/bin)*(bpp/8);
+            char name[32];
+
+            check ("auto", memcmp (out1, out2, nout) == 0);
+            snprintf (name, sizeof(name), "%dx%d", bin, bin);
+            printf ("%-4d %-6s %10.1f %10.1f %8.1f\n", bpp, name,
+                            w*(h/1e6)/tl, w*(h/1e6)/tb, tl/tb);
+            fflush (stdout);
+        }
+
+    printf ("\n%-4s %-6s %-8s %10s\n", "bpp", "bin", "mode", "binImage");
+    {
+        static const int cases[][4] = {
+            /* bpp, bx, by, mode */
+            {8, 2, 2, BIN_AVERAGE},
+            {8, 3, 3, BIN_AVERAGE},
+            {16, 2, 2, BIN_AVERAGE},
+            {16, 3, 3, BIN_AVERAGE},
+            {16, 1, 2, BIN_SUM},
+            {16, 4, 2, BIN_SUM},
+            {32, 2, 2, BIN_SUM},
+            {32, 3, 3, BIN_AVERAGE},
+        };
+        for (i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+            const int *c = cases[i];
+            double tb = timeBin (c[0], c[1], c[2], c[3], out2);
+            char name[32];
+
+            checkSome (c[0], c[1], c[2], c[3]);
+            snprintf (name, sizeof(name), "%dx%d", c[1], c[2]);
+            printf ("%-4d %-6s %-8s %10.1f\n", c[0], name,
+                        c[3] == BIN_SUM ? "sum" : "average", w*(h/1e6)/tb);
+            fflush (stdout);
+        }
+    }
+
+    return (0);
+}
+
+static void
+usage (void)
+{
+    fprintf (stderr, "Usage: %s [options]\n", me);
+    fprintf (stderr, "Purpose: measure software binning throughput\n");
+    fprintf (stderr, "Options:\n");
+    fprintf (stderr, " -r r : runs to take the best of, default %d\n", DEFRUNS);
+    fprintf (stderr, " -s s : megapixels per frame, default %d\n", DEFMP);
+    fprintf (stderr, " -t t : threads, default 0 for one per CPU\n");
+
+    exit (2);
+}
+
+/* the loop CCDChip::binFrame() used, square bins only */
+static void
+legacyBin (const uint8_t *in, uint8_t *out, int bpp, int bin)
+{
+    int nbytes = (w/bin)*(h/bin)*(bpp/8);
+    int i, j, k, l;
+
+    memset (out, 0, nbytes);
+
+    if (bpp == 8) {
+        uint8_t *bin_buf = out;
+        double factor = (bin*bin)/2;
+        double accumulator;
+        for (i = 0; i < h; i += bin)
+            for (j = 0; j < w; j += bin) {
+                accumulator = 0;
+                for (k = 0; k < bin; k++)
+                    for (l = 0; l < bin; l++)
+                        accumulator += *(in + j + (i+k)*w + l);
+                accumulator /= factor;
+                if (accumulator > UINT8_MAX)
+                    *bin_buf = UINT8_MAX;
+                else
+                    *bin_buf += (uint8_t)accumulator;
+                bin_buf++;
+            }
+    } else {
+        uint16_t *bin_buf = (uint16_t *)out;
+        const uint16_t *in16 = (const uint16_t *)in;
+        uint16_t val;
+        for (i = 0; i < h; i += bin)
+            for (j = 0; j < w; j += bin) {
+                for (k = 0; k < bin; k++)
+                    for (l = 0; l < bin; l++) {
+                        val = *(in16 + j + (i+k)*w + l);
+                        if (val + *bin_buf > UINT16_MAX)
+                            *bin_buf = UINT16_MAX;
+                        else
+                            *bin_buf += val;
+                    }
+                bin_buf++;
+            }
+    }
+}
+
+/* return best seconds for the legacy loop, leaving its result in out1 */
+static double
+timeLegacy (int bpp, int bin)
+{
+    double best = 1e9;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        legacyBin (frame, out1, bpp, bin);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+    }
+
+    return (best);
+}
+
+/* return best seconds for binImage(), leaving its result in out */
+static double
+timeBin (int bpp, int bx, int by, int mode, unsigned char *out)
+{
+    double best = 1e9;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        int n = binImage (frame, out, w, h, bpp, bx, by, mode);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+        check ("size", n == (w/bx)*(h/by)*(bpp/8));
+    }
+
+    return (best);
+}
+
+/* check bins along the diagonal of out2 against a plain sum */
+static void
+checkSome (int bpp, int bx, int by, int mode)
+{
+    int ow = w/bx, oh = h/by;
+    uint64_t maxpix = bpp == 8 ? 0xff : bpp == 16 ? 0xffff : 0xffffffff;
+    int i, k, l;
+
+    for (i = 0; i < ow && i < oh; i += 7) {
+        uint64_t s = 0, got;
+        for (k = 0; k < by; k++)
+            for (l = 0; l < bx; l++) {
+                size_t p = (size_t)(i*by + k)*w + i*bx + l;
+                s += bpp == 8 ? frame[p] : bpp == 16 ? ((uint16_t *)frame)[p]
+                                                     : ((uint32_t *)frame)[p];
+            }
+        if (mode == BIN_AVERAGE)
+            s /= bx*by;
+        if (s > maxpix)
+            s = maxpix;
+        got = bpp == 8 ? out2[(size_t)i*ow + i] : bpp == 16 ? ((uint16_t *)out2)[(size_t)i*ow + i]
+                                                            : ((uint32_t *)out2)[(size_t)i*ow + i];
+        check ("bin", got == s);
+    }
+}
+
+/* complain and exit if !ok */
+static void
+check (const char *what, int ok)
+{
+    if (!ok) {
+        fprintf (stderr, "%s: %s gave wrong results\n", me, what);
+        exit (1);
+    }
+}
+
+/* return wall clock seconds */
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,256 @@
+/* measure how many setNumberVector messages per second a driver can send
+ * with the OutBuf serializer IDSetNumber() uses against the printf calls it
+ * made before.
+ */
+
+/* Overall design:
+ * fill a 20 element number vector with values of the usual kinds: whole
+ *   numbers, coordinates, temperatures and small fractions.
+ * time sending it -n times each way to -f, /dev/null by default, under a
+ *   mutex as IDSetNumber() does: the legacy way with setlocale(), a printf
+ *   per line and fflush(), then with one OutBuf and one write().
+ * check every value the OutBuf way reads back exactly.
+ * report messages per second for each, best of -r runs.
+ */
+
+#include <fcntl.h>
+#include <locale.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "outbuf.h"
+
+#define	DEFN        100000	/* default messages per run */
+#define	DEFRUNS     3		/* default runs to take the best of */
+#define	NNUM        20		/* elements in the vector */
+
+static char *me;			/* our name */
+static int nmsg = DEFN;
+static int runs = DEFRUNS;
+static char *outfn = "/dev/null";
+
+static pthread_mutex_t stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char names[NNUM][32];
+static double values[NNUM];
+
+static void usage (void);
+static void legacySet (const char *fmt, ...);
+static void outBufSet (int fd, const char *fmt, ...);
+static void checkValues (void);
+static const char *timestamp (void);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+    double tl = 1e9, tb = 1e9;
+    int fd, i, r;
+
+    me = av[0];
+
+    /* crack args */
+    while ((--ac > 0) && ((*++av)[0] == '-')) {
+        char *s;
+        for (s = av[0]+1; *s != '\0'; s++)
+            switch (*s) {
+            case 'f': if (ac < 2) usage(); outfn = *++av; ac--; break;
+            case 'n': if (ac < 2) usage(); nmsg = atoi(*++av); ac--; break;
+            case 'r': if (ac < 2) usage(); runs = atoi(*++av); ac--; break;
+            default: usage();
+            }
+    }
+    if (ac > 0 || nmsg < 1 || runs < 1)
+        usage();
+
+    for (i = 0; i < NNUM; i++) {
+        snprintf (names[i], sizeof(names[i]), "ELEMENT_%d", i);
+        switch (i % 4) {
+        case 0: values[i] = i*100; break;
+        case 1: values[i] = 123.456789 + i/7.0; break;
+        case 2: values[i] = -12.5 + i*0.1; break;
+        case 3: values[i] = 1.0/(i + 3); break;
+        }
+    }
+
+    /* stdout to outfn, as a driver's goes to indiserver */
+    fd = open (outfn, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0 || dup2 (fd, 1) < 0) {
+        fprintf (stderr, "%s: can not write %s\n", me, outfn);
+        exit (1);
+    }
+    close (fd);
+
+    checkValues ();
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        for (i = 0; i < nmsg; i++)
+            legacySet ("Reading %d", i);
+        dt = now() - t0;
+        if (dt < tl)
+            tl = dt;
+
+        t0 = now();
+        for (i = 0; i < nmsg; i++)
+            outBufSet (1, "Reading %d", i);
+        dt = now() - t0;
+        if (dt < tb)
+            tb = dt;
+    }
+
+    fprintf (stderr, "%d element number vector, messages/s\n", NNUM);
+    fprintf (stderr, "%10s %10s %8s\n", "legacy", "OutBuf", "speedup");
+    fprintf (stderr, "%10.0f %10.0f %8.1f\n", nmsg/tl, nmsg/tb, tl/tb);
+
+    return (0);
+}
+
+static void
+usage (void)
+{
+    fprintf (stderr, "Usage: %s [options]\n", me);
+    fprintf (stderr, "Purpose: measure setNumberVector messages per second\n");
+    fprintf (stderr, "Options:\n");
+    fprintf (stderr, " -f f : file to write to, default /dev/null\n");
+    fprintf (stderr, " -n n : messages per run, default %d\n", DEFN);
+    fprintf (stderr, " -r r : runs to take the best of, default %d\n", DEFRUNS);
+
+    exit (2);
+}
+
+/* send the vector as IDSetNumber() used to */
+static void
+legacySet (const char *fmt, ...)
+{
+    int i;
+
+    pthread_mutex_lock(&stdout_mutex);
+
+    printf ("<?xml version='1.0'?>\n");
+    char *orig = setlocale(LC_NUMERIC,"C");
+    printf ("<setNumberVector\n");
+    printf ("  device='%s'\n", "Bench");
+    printf ("  name='%s'\n", "VECTOR");
+    printf ("  state='%s'\n", "Ok");
+    printf ("  timeout='%g'\n", 60.0);
+    printf ("  timestamp='%s'\n", timestamp());
+    if (fmt) {
+        va_list ap;
+        va_start (ap, fmt);
+        printf ("  message='");
+        vprintf (fmt, ap);
+        printf ("'\n");
+        va_end (ap);
+    }
+    printf (">\n");
+
+    for (i = 0; i < NNUM; i++) {
+        printf ("  <oneNumber name='%s'>\n", names[i]);
+        printf ("      %.20g\n", values[i]);
+        printf ("  </oneNumber>\n");
+    }
+
+    printf ("</setNumberVector>\n");
+    setlocale(LC_NUMERIC,orig);
+    fflush (stdout);
+
+    pthread_mutex_unlock(&stdout_mutex);
+}
+
+/* send the vector as IDSetNumber() does now */
+static void
+outBufSet (int fd, const char *fmt, ...)
+{
+    OutBuf *ob = outBufGet();
+    va_list ap;
+    int i;
+
+    outBufPuts (ob, "<?xml version='1.0'?>\n<setNumberVector\n  device='Bench'\n  name='VECTOR'");
+    outBufPuts (ob, "\n  state='Ok'\n  timeout='");
+    outBufDouble (ob, 60.0);
+    outBufPuts (ob, "'\n  timestamp='");
+    outBufTimestamp (ob);
+    outBufPuts (ob, "'\n");
+    if (fmt) {
+        va_start (ap, fmt);
+        outBufPuts (ob, "  message='");
+        outBufVPrintf (ob, fmt, ap);
+        outBufPuts (ob, "'\n");
+        va_end (ap);
+    }
+    outBufPuts (ob, ">\n");
+
+    for (i = 0; i < NNUM; i++) {
+        outBufPuts (ob, "  <oneNumber name='");
+        outBufPuts (ob, names[i]);
+        outBufPuts (ob, "'>\n      ");
+        outBufDouble (ob, values[i]);
+        outBufPuts (ob, "\n  </oneNumber>\n");
+    }
+
+    outBufPuts (ob, "</setNumberVector>\n");
+
+    pthread_mutex_lock(&stdout_mutex);
+    outBufWrite (ob, fd);
+    pthread_mutex_unlock(&stdout_mutex);
+}
+
+/* check every value sent the OutBuf way reads back the same, even with a
+ * locale whose decimal point is a comma, if there is one
+ */
+static void
+checkValues (void)
+{
+    int p[2], i, n;
+    char buf[8192], *s;
+
+    setlocale (LC_NUMERIC, "de_DE.UTF-8");
+    if (pipe (p) < 0) {
+        fprintf (stderr, "%s: no pipe\n", me);
+        exit (1);
+    }
+    outBufSet (p[1], NULL);
+    n = read (p[0], buf, sizeof(buf)-1);
+    close (p[0]);
+    close (p[1]);
+    buf[n > 0 ? n : 0] = '\0';
+    setlocale (LC_NUMERIC, "C");
+
+    for (i = 0, s = buf; i < NNUM; i++) {
+        s = strstr (s, "'>\n      ");
+        if (!s || strtod (s + 9, &s) != values[i]) {
+            fprintf (stderr, "%s: value %d did not read back\n", me, i);
+            exit (1);
+        }
+    }
+}
+
+/* the timestamp IDSetNumber() used to send */
+static const char *
+timestamp (void)
+{
+    static char ts[32];
+    struct tm *tp;
+    time_t t;
+
+    time (&t);
+    tp = gmtime (&t);
+    strftime (ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", tp);
+    return (ts);
+}
+
+/* return wall clock seconds */
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,316 @@
+/* measure how many BLOB bytes per second indiserver delivers to its clients
+ * as the number of its I/O threads goes up.
+ */
+
+/* Overall design:
+ * for each thread count 0 .. -t, run indiserver -t n with -n copies of
+ *   ourselves as drivers, each sending setBLOBVectors of -s bytes at -r MB/s.
+ * connect -c clients that ask for everything, BLOBs too, and count what they
+ *   read in -d seconds after a short warmup, each on its own thread.
+ * print the aggregate rate for each thread count, against the rate offered.
+ *   clients that fall too far behind are shut down by the server, count those
+ *   too since a server that can not keep up loses them.
+ * we know we are being run as a driver by INDIBENCH_BLOB in our environment.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define	DEFPORT     7625	/* default port, away from the usual 7624 */
+#define	DEFCLIENTS  8		/* default n clients */
+#define	DEFDRIVERS  2		/* default n drivers */
+#define	DEFBLOB     (1024*1024)	/* default BLOB size, bytes */
+#define	DEFSECS     3		/* default seconds per run */
+#define	DEFRATE     50		/* default MB/s from each driver */
+#define	WARMUP      1.0		/* seconds to read before counting */
+
+static char *me;			/* our name */
+static char *server = "indiserver";	/* server to run */
+static int port = DEFPORT;
+static int nclients = DEFCLIENTS;
+static int ndrivers = DEFDRIVERS;
+static int blobsz = DEFBLOB;
+static int secs = DEFSECS;
+static int rate = DEFRATE;
+static int maxthreads;
+static int ndropped;			/* clients shut down in last run */
+
+typedef struct {
+    pthread_t tid;
+    int s;				/* socket to server */
+    double nbytes;			/* bytes read */
+    int dropped;			/* server shut us down */
+} Client;
+
+static void usage (void);
+static void runDriver (int n, double bps);
+static double runServer (int nthreads);
+static void *clientMain (void *arg);
+static int connectServer (void);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+    char *blob;
+    int n;
+
+    /* driver? */
+    if ((blob = getenv ("INDIBENCH_BLOB")) != NULL) {
+        runDriver (atoi (blob), atof (getenv ("INDIBENCH_RATE"))*1e6);
+        return (0);
+    }
+
+    me = av[0];
+
+    /* crack args */
+    while ((--ac > 0) && ((*++av)[0] == '-')) {
+        char *s;
+        for (s = av[0]+1; *s != '\0'; s++)
+            switch (*s) {
+            case 'c': if (ac < 2) usage(); nclients = atoi(*++av); ac--; break;
+            case 'd': if (ac < 2) usage(); secs = atoi(*++av); ac--; break;
+            case 'n': if (ac < 2) usage(); ndrivers = atoi(*++av); ac--; break;
+            case 'p': if (ac < 2) usage(); port = atoi(*++av); ac--; break;
+            case 'r': if (ac < 2) usage(); rate = atoi(*++av); ac--; break;
+            case 's': if (ac < 2) usage(); blobsz = atoi(*++av); ac--; break;
+            case 't': if (ac < 2) usage(); maxthreads = atoi(*++av); ac--; break;
+            case 'x': if (ac < 2) usage(); server = *++av; ac--; break;
+            default: usage();
+            }
+    }
+    if (ac > 0 || nclients < 1 || ndrivers < 1 || blobsz < 1 || secs < 1 ||
+                                                                rate < 1)
+        usage();
+
+    signal (SIGPIPE, SIG_IGN);
+
+    printf ("%d drivers at %d MB/s, %d byte BLOBs, %d clients, %d s per run\n",
+                                ndrivers, rate, blobsz, nclients, secs);
+    printf ("offered %.1f MB/s\n", (double)ndrivers*rate*nclients);
+    for (n = 0; n <= maxthreads; n++) {
+        double got = runServer (n);
+        printf ("threads %2d: %8.1f MB/s, %d clients dropped\n", n, got/1e6,
+                                ndropped);
+        fflush (stdout);
+    }
+
+    return (0);
+}
+
+static void
+usage (void)
+{
+    fprintf (stderr, "Usage: %s [options]\n", me);
+    fprintf (stderr, "Purpose: measure indiserver BLOB throughput vs I/O threads\n");
+    fprintf (stderr, "Options:\n");
+    fprintf (stderr, " -c c : n clients, default %d\n", DEFCLIENTS);
+    fprintf (stderr, " -d d : seconds per run, default %d\n", DEFSECS);
+    fprintf (stderr, " -n n : n drivers, default %d\n", DEFDRIVERS);
+    fprintf (stderr, " -p p : port for the server, default %d\n", DEFPORT);
+    fprintf (stderr, " -r r : MB/s sent by each driver, default %d\n", DEFRATE);
+    fprintf (stderr, " -s s : BLOB size, bytes, default %d\n", DEFBLOB);
+    fprintf (stderr, " -t t : runs with 0 .. t I/O threads, default 0\n");
+    fprintf (stderr, " -x x : indiserver to run, default indiserver from PATH\n");
+
+    exit (2);
+}
+
+/* be a driver: send setBLOBVectors of n base64 bytes at bps bytes per
+ * second forever, ignore input.
+ */
+static void
+runDriver (int n, double bps)
+{
+    double due = now();
+    char dev[64], head[256];
+    const char *tail = "\n  </oneBLOB>\n</setBLOBVector>\n";
+    char *msg, *ip;
+    int nh, nt = strlen(tail);
+
+    /* a child soaks up whatever the server sends us */
+    if (fork() == 0) {
+        char buf[4096];
+        while (read (0, buf, sizeof(buf)) > 0)
+            continue;
+        _exit (0);
+    }
+
+    snprintf (dev, sizeof(dev), "Bench%d", (int)getpid());
+    nh = snprintf (head, sizeof(head),
+        "<setBLOBVector device='%s' name='DATA' state='Ok'>\n"
+        "  <oneBLOB name='D' size='%d' format='.bin' enclen='%d'>\n",
+        dev, n*3/4, n);
+
+    msg = (char *) malloc (nh + n + nt);
+    memcpy (msg, head, nh);
+    memset (msg+nh, 'A', n);
+    memcpy (msg+nh+n, tail, nt);
+
+    while (1) {
+        size_t left = nh + n + nt;
+
+        /* keep to our rate */
+        due += left/bps;
+        if (due > now())
+            usleep ((useconds_t)((due - now())*1e6));
+
+        for (ip = msg; left > 0; ) {
+            ssize_t nw = write (1, ip, left);
+            if (nw < 0 && errno == EINTR)
+                continue;
+            if (nw <= 0)
+                exit (1);
+            ip += nw;
+            left -= nw;
+        }
+    }
+}
+
+/* run the server with nthreads I/O threads and our clients.
+ * return aggregate bytes per second the clients read.
+ */
+static double
+runServer (int nthreads)
+{
+    char portstr[32], tstr[32], blobstr[32], ratestr[32];
+    Client *clients;
+    double total = 0;
+    pid_t pid;
+    int i;
+
+    snprintf (portstr, sizeof(portstr), "%d", port);
+    snprintf (tstr, sizeof(tstr), "%d", nthreads);
+    snprintf (blobstr, sizeof(blobstr), "%d", blobsz);
+    snprintf (ratestr, sizeof(ratestr), "%d", rate);
+
+    pid = fork();
+    if (pid < 0) {
+        perror ("fork");
+        exit (1);
+    }
+    if (pid == 0) {
+        char **av = (char **) calloc (ndrivers + 8, sizeof(char *));
+        int na = 0;
+
+        setenv ("INDIBENCH_BLOB", blobstr, 1);
+        setenv ("INDIBENCH_RATE", ratestr, 1);
+        av[na++] = server;
+        av[na++] = "-p";
+        av[na++] = portstr;
+        if (nthreads > 0) {
+            av[na++] = "-t";
+            av[na++] = tstr;
+        }
+        for (i = 0; i < ndrivers; i++)
+            av[na++] = me;
+        freopen ("/dev/null", "w", stderr);
+        execvp (server, av);
+        _exit (1);
+    }
+
+    /* give it a moment to start listening */
+    clients = (Client *) calloc (nclients, sizeof(Client));
+    for (i = 0; i < nclients; i++) {
+        int tries;
+        for (tries = 0; (clients[i].s = connectServer()) < 0 && tries < 50; tries++)
+            usleep (100000);
+        if (clients[i].s < 0) {
+            fprintf (stderr, "%s: can not connect to port %d\n", me, port);
+            kill (pid, SIGTERM);
+            exit (1);
+        }
+    }
+
+    for (i = 0; i < nclients; i++)
+        pthread_create (&clients[i].tid, NULL, clientMain, &clients[i]);
+    ndropped = 0;
+    for (i = 0; i < nclients; i++) {
+        pthread_join (clients[i].tid, NULL);
+        total += clients[i].nbytes;
+        ndropped += clients[i].dropped;
+        close (clients[i].s);
+    }
+    total /= secs;
+
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+    free (clients);
+
+    /* let the port go before the next run */
+    usleep (200000);
+
+    return (total);
+}
+
+/* read everything for WARMUP then secs, counting bytes in the latter */
+static void *
+clientMain (void *arg)
+{
+    static const char hello[] =
+        "<getProperties version='1.7'/>\n<enableBLOB>Also</enableBLOB>\n";
+    Client *cp = (Client *) arg;
+    double t0 = now() + WARMUP, t1 = t0 + secs;
+    struct timeval tv = {0, 100000};
+    char buf[65536];
+
+    setsockopt (cp->s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (write (cp->s, hello, sizeof(hello)-1) < 0)
+        return (NULL);
+
+    while (now() < t1) {
+        ssize_t nr = read (cp->s, buf, sizeof(buf));
+        if (nr > 0) {
+            if (now() >= t0)
+                cp->nbytes += nr;
+        } else if (nr == 0 || (errno != EAGAIN && errno != EINTR)) {
+            cp->dropped = 1;
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/* return a socket connected to the server on localhost, else -1 */
+static int
+connectServer (void)
+{
+    struct sockaddr_in sa;
+    int s = socket (AF_INET, SOCK_STREAM, 0);
+
+    if (s < 0)
+        return (-1);
+    memset (&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons (port);
+    sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (connect (s, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close (s);
+        return (-1);
+    }
+    return (s);
+}
+
+/* return wall clock seconds */
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}
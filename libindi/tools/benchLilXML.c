@@ -0,0 +1,297 @@
+/* measure lilxml parse throughput on typical INDI traffic against memcpy.
+ */
+
+/* Overall design:
+ * build about -m MB each of setNumberVector, setTextVector and setBLOBVector
+ *   messages in memory.
+ * for each, time memcpy of the whole stream, then parsing it char by char
+ *   with readXMLEle(), then in -c byte chunks with parseXMLChunk(), without
+ *   and with an arena, deleting each document as it completes.
+ * report MB/s for each, best of -r runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lilxml.h"
+
+#define	DEFMB       16		/* default MB of each kind of message */
+#define	DEFCHUNK    65536	/* default bytes per parseXMLChunk() */
+#define	DEFRUNS     3		/* default runs to take the best of */
+
+static char *me;			/* our name */
+static int mb = DEFMB;
+static int chunk = DEFCHUNK;
+static int runs = DEFRUNS;
+
+typedef struct {
+    const char *name;			/* kind of message */
+    char *buf;				/* stream of messages */
+    size_t len;				/* bytes in buf */
+} Stream;
+
+static void usage (void);
+static void mkNumbers (Stream *sp);
+static void mkTexts (Stream *sp);
+static void mkBLOBs (Stream *sp);
+static void addStr (Stream *sp, size_t *msp, const char *str, size_t l);
+static double timeMemcpy (Stream *sp);
+static double timeReadXMLEle (Stream *sp);
+static double timeParseXMLChunk (Stream *sp, int arena);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+    Stream streams[3];
+    int i;
+
+    me = av[0];
+
+    /* crack args */
+    while ((--ac > 0) && ((*++av)[0] == '-')) {
+        char *s;
+        for (s = av[0]+1; *s != '\0'; s++)
+            switch (*s) {
+            case 'c': if (ac < 2) usage(); chunk = atoi(*++av); ac--; break;
+            case 'm': if (ac < 2) usage(); mb = atoi(*++av); ac--; break;
+            case 'r': if (ac < 2) usage(); runs = atoi(*++av); ac--; break;
+            default: usage();
+            }
+    }
+    if (ac > 0 || chunk < 1 || mb < 1 || runs < 1)
+        usage();
+
+    mkNumbers (&streams[0]);
+    mkTexts (&streams[1]);
+    mkBLOBs (&streams[2]);
+
+    printf ("%-8s %10s %12s %14s %14s  (MB/s)\n", "", "memcpy", "readXMLEle",
+                                        "parseXMLChunk", "  with arena");
+    for (i = 0; i < 3; i++) {
+        Stream *sp = &streams[i];
+        printf ("%-8s %10.1f %12.1f %14.1f %14.1f\n", sp->name,
+                        sp->len/timeMemcpy(sp)/1e6,
+                        sp->len/timeReadXMLEle(sp)/1e6,
+                        sp->len/timeParseXMLChunk(sp,0)/1e6,
+                        sp->len/timeParseXMLChunk(sp,1)/1e6);
+        fflush (stdout);
+    }
+
+    return (0);
+}
+
+static void
+usage (void)
+{
+    fprintf (stderr, "Usage: %s [options]\n", me);
+    fprintf (stderr, "Purpose: measure lilxml parse throughput\n");
+    fprintf (stderr, "Options:\n");
+    fprintf (stderr, " -c c : bytes per parseXMLChunk(), default %d\n", DEFCHUNK);
+    fprintf (stderr, " -m m : MB of each kind of message, default %d\n", DEFMB);
+    fprintf (stderr, " -r r : runs to take the best of, default %d\n", DEFRUNS);
+
+    exit (2);
+}
+
+/* fill sp with setNumberVectors like a CCD driver sends while exposing */
+static void
+mkNumbers (Stream *sp)
+{
+    size_t m = 0;
+    char msg[2048];
+    int n, i;
+
+    memset (sp, 0, sizeof(*sp));
+    sp->name = "numbers";
+    for (n = 0; sp->len < (size_t)mb*1000000; n++) {
+        int l = sprintf (msg,
+            "<setNumberVector device='CCD Simulator' name='CCD_TEMPERATURE' "
+            "state='Busy' timeout='60' timestamp='2017-01-01T00:00:%02d'>\n",
+            n%60);
+        for (i = 0; i < 8; i++)
+            l += sprintf (msg+l, "    <oneNumber name='VALUE_%d'>\n"
+                                 "      %.6f\n    </oneNumber>\n", i, n*0.123+i);
+        l += sprintf (msg+l, "</setNumberVector>\n");
+        addStr (sp, &m, msg, l);
+    }
+}
+
+/* fill sp with setTextVectors of a few hundred chars of prose each */
+static void
+mkTexts (Stream *sp)
+{
+    static const char words[] = "The quick brown fox jumps over the lazy "
+        "dog while the telescope slews to the next target &amp; settles. ";
+    size_t m = 0;
+    char msg[4096];
+    int n, i;
+
+    memset (sp, 0, sizeof(*sp));
+    sp->name = "texts";
+    for (n = 0; sp->len < (size_t)mb*1000000; n++) {
+        int l = sprintf (msg,
+            "<setTextVector device='Telescope Simulator' name='OBJECT_INFO' "
+            "state='Ok' timeout='0' timestamp='2017-01-01T00:00:00'>\n");
+        for (i = 0; i < 4; i++) {
+            l += sprintf (msg+l, "    <oneText name='INFO_%d'>\n", i);
+            l += sprintf (msg+l, "%s%s%s\n", words, words, words);
+            l += sprintf (msg+l, "    </oneText>\n");
+        }
+        l += sprintf (msg+l, "</setTextVector>\n");
+        addStr (sp, &m, msg, l);
+    }
+}
+
+/* fill sp with setBLOBVectors of 1 MB of base64 each, in 72 char lines */
+static void
+mkBLOBs (Stream *sp)
+{
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char tail[] = "\n  </oneBLOB>\n</setBLOBVector>\n";
+    int enclen = 1024*1024;
+    char *body = (char *) malloc (enclen + enclen/72 + 1);
+    size_t m = 0;
+    char head[512];
+    int l, i, j;
+
+    for (i = j = 0; i < enclen; i++) {
+        body[j++] = b64[(i*7) & 63];
+        if (i % 72 == 71)
+            body[j++] = '\n';
+    }
+
+    memset (sp, 0, sizeof(*sp));
+    sp->name = "BLOBs";
+    while (sp->len < (size_t)mb*1000000) {
+        l = sprintf (head,
+            "<setBLOBVector device='CCD Simulator' name='CCD1' state='Ok' "
+            "timeout='60' timestamp='2017-01-01T00:00:00'>\n"
+            "  <oneBLOB name='CCD1' size='%d' format='.fits' enclen='%d'>\n",
+            enclen*3/4, enclen);
+        addStr (sp, &m, head, l);
+        addStr (sp, &m, body, j);
+        addStr (sp, &m, tail, strlen(tail));
+    }
+
+    free (body);
+}
+
+/* append l bytes of str to sp, growing its buffer of *msp bytes as needed */
+static void
+addStr (Stream *sp, size_t *msp, const char *str, size_t l)
+{
+    if (sp->len + l > *msp) {
+        *msp = 2*(sp->len + l);
+        sp->buf = (char *) realloc (sp->buf, *msp);
+    }
+    memcpy (sp->buf + sp->len, str, l);
+    sp->len += l;
+}
+
+/* return best seconds to copy sp */
+static double
+timeMemcpy (Stream *sp)
+{
+    char *copy = (char *) malloc (sp->len);
+    double best = 1e9;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        double t0 = now(), dt;
+        memcpy (copy, sp->buf, sp->len);
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+    }
+
+    /* make sure the copy is not optimized away */
+    if (copy[sp->len/2] != sp->buf[sp->len/2])
+        printf ("memcpy failed\n");
+    free (copy);
+
+    return (best);
+}
+
+/* return best seconds to parse sp one char at a time */
+static double
+timeReadXMLEle (Stream *sp)
+{
+    double best = 1e9;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        LilXML *lp = newLilXML();
+        double t0 = now(), dt;
+        char ynot[1024];
+        size_t i;
+
+        for (i = 0; i < sp->len; i++) {
+            XMLEle *root = readXMLEle (lp, sp->buf[i], ynot);
+            if (root)
+                delXMLEle (root);
+            else if (ynot[0]) {
+                fprintf (stderr, "%s: %s\n", sp->name, ynot);
+                exit (1);
+            }
+        }
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+        delLilXML (lp);
+    }
+
+    return (best);
+}
+
+/* return best seconds to parse sp in chunks, with or without an arena */
+static double
+timeParseXMLChunk (Stream *sp, int arena)
+{
+    double best = 1e9;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        LilXML *lp = newLilXML();
+        double t0 = now(), dt;
+        char ynot[1024];
+        size_t i;
+
+        arenaLilXML (lp, arena);
+        for (i = 0; i < sp->len; i += chunk) {
+            int n = sp->len - i < (size_t)chunk ? (int)(sp->len - i) : chunk;
+            XMLEle **nodes = parseXMLChunk (lp, sp->buf + i, n, ynot);
+            int j;
+
+            if (!nodes) {
+                if (ynot[0]) {
+                    fprintf (stderr, "%s: %s\n", sp->name, ynot);
+                    exit (1);
+                }
+                continue;
+            }
+            for (j = 0; nodes[j]; j++)
+                delXMLEle (nodes[j]);
+            free (nodes);
+        }
+        dt = now() - t0;
+        if (dt < best)
+            best = dt;
+        delLilXML (lp);
+    }
+
+    return (best);
+}
+
+/* return wall clock seconds */
+static double
+now (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec*1e-6);
+}